@@ -23,9 +23,11 @@ func RunInferBench(cfg config.Config, registry runtime.Registry, args []string)
 	output := fs.String("output", "", "Path to save JSON results (optional)")
 	prompt := fs.String("prompt", "", "Custom prompt to benchmark (uses standard set if empty)")
 	verbose := fs.Bool("verbose", false, "Print per-iteration details")
+	image := fs.String("image", "", "Also run the vision scenario with this image (needs mmproj_path; single run only)")
 
 	// Optimization toggle flags for A/B testing.
-	kvCacheType := fs.String("kv-cache-type", "", "Override KV cache type (f16, q8_0, q4_0)")
+	kvCacheType := fs.String("kv-cache-type", "", "Override KV cache type for K and V (any ggml type: f16, q8_0, q5_1, iq4_nl, q4_0, ...)")
+	kvSweep := fs.String("kv-sweep", "", "Benchmark each KV cache type in a comma list (\"q8_0,q8_0/q4_0\" or \"default\") and compare")
 	noSpeculative := fs.Bool("no-speculative", false, "Disable speculative decoding for this run")
 	speculativeN := fs.Int("speculative-n", 0, "Override number of draft tokens (0=use config)")
 	streamChunkSize := fs.Int("stream-chunk-size", 0, "Override stream chunk size (0=use config)")
@@ -41,6 +43,8 @@ func RunInferBench(cfg config.Config, registry runtime.Registry, args []string)
 	// Apply optimization overrides to config before creating adapter.
 	if *kvCacheType != "" {
 		cfg.Runtime.Native.KVCacheType = *kvCacheType
+		cfg.Runtime.Native.KVCacheTypeK = ""
+		cfg.Runtime.Native.KVCacheTypeV = ""
 	}
 	if *noSpeculative {
 		cfg.Runtime.Native.DraftModelPath = ""
@@ -57,15 +61,19 @@ func RunInferBench(cfg config.Config, registry runtime.Registry, args []string)
 		cfg.Runtime.Native.ContextShift = &f
 	}
 
+	if *kvSweep != "" {
+		return runKVSweep(cfg, registry, *kvSweep, *iterations, *maxTokens, *warmup, *output, *prompt, *verbose, *stream)
+	}
+
 	if *compare {
 		return runComparison(cfg, registry, *iterations, *maxTokens, *warmup, *output, *prompt, *verbose, *stream)
 	}
 
-	return runSingle(cfg, registry, *iterations, *maxTokens, *warmup, *output, *prompt, *verbose, *stream)
+	return runSingle(cfg, registry, *iterations, *maxTokens, *warmup, *output, *prompt, *image, *verbose, *stream)
 }
 
 // runSingle executes a single benchmark run with the (possibly overridden) config.
-func runSingle(cfg config.Config, registry runtime.Registry, iterations, maxTokens, warmup int, output, prompt string, verbose, useStream bool) int {
+func runSingle(cfg config.Config, registry runtime.Registry, iterations, maxTokens, warmup int, output, prompt, image string, verbose, useStream bool) int {
 	backend := cfg.Runtime.Backend
 	if backend == "" {
 		backend = "http"
@@ -95,6 +103,12 @@ func runSingle(cfg config.Config, registry runtime.Registry, iterations, maxToke
 			{Name: "custom", Text: prompt},
 		}
 	}
+	if image != "" {
+		if len(benchCfg.Prompts) == 0 {
+			benchCfg.Prompts = inferbench.StandardPrompts()
+		}
+		benchCfg.Prompts = append(benchCfg.Prompts, inferbench.VisionPrompts(image)...)
+	}
 
 	mode := "Generate"
 	if useStream {
@@ -126,6 +140,54 @@ func runSingle(cfg config.Config, registry runtime.Registry, iterations, maxToke
 	return 0
 }
 
+// runKVSweep benchmarks one adapter per KV cache setting and prints the
+// memory/throughput trade-off of each.
+func runKVSweep(cfg config.Config, registry runtime.Registry, spec string, iterations, maxTokens, warmup int, output, prompt string, verbose, useStream bool) int {
+	settings, err := inferbench.ParseKVSweep(spec)
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "%v\n", err)
+		return 1
+	}
+	backend := cfg.Runtime.Backend
+	if backend == "" {
+		backend = "http"
+	}
+	factory, ok := registry[backend]
+	if !ok {
+		fmt.Fprintf(os.Stderr, "runtime backend %q not registered\n", backend)
+		return 1
+	}
+
+	benchCfg := inferbench.DefaultConfig()
+	benchCfg.Iterations = iterations
+	benchCfg.MaxTokens = maxTokens
+	benchCfg.WarmupIterations = warmup
+	benchCfg.OutputPath = output
+	benchCfg.Verbose = verbose
+	benchCfg.UseStream = useStream
+	if prompt != "" {
+		benchCfg.Prompts = []inferbench.Prompt{
+			{Name: "custom", Text: prompt},
+		}
+	}
+
+	fmt.Printf("OpenEye KV Cache Sweep\n")
+	fmt.Printf("Backend: %s  Settings: %d\n", backend, len(settings))
+
+	_, err = inferbench.SweepKVCache(context.Background(), benchCfg, settings,
+		func(s inferbench.KVCacheSetting) (runtime.Adapter, error) {
+			sweepCfg := cfg
+			sweepCfg.Runtime.Native.KVCacheTypeK = s.TypeK
+			sweepCfg.Runtime.Native.KVCacheTypeV = s.TypeV
+			return factory(sweepCfg.Runtime)
+		})
+	if err != nil {
+		fmt.Fprintf(os.Stderr, "KV sweep failed: %v\n", err)
+		return 1
+	}
+	return 0
+}
+
 // runComparison runs a baseline (no optimizations) and an optimized run, then
 // prints a delta comparison table.
 func runComparison(cfg config.Config, registry runtime.Registry, iterations, maxTokens, warmup int, output, prompt string, verbose, useStream bool) int {
@@ -145,6 +207,8 @@ func runComparison(cfg config.Config, registry runtime.Registry, iterations, max
 	baselineCfg.Runtime.Native.DraftModelPath = ""
 	baselineCfg.Runtime.Native.SpeculativeN = 0
 	baselineCfg.Runtime.Native.KVCacheType = "f16"
+	baselineCfg.Runtime.Native.KVCacheTypeK = ""
+	baselineCfg.Runtime.Native.KVCacheTypeV = ""
 	baselineCfg.Runtime.Native.StreamChunkSize = 1
 	f := false
 	baselineCfg.Runtime.Native.ContextShift = &f
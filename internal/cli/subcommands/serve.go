@@ -2,6 +2,7 @@ package subcommands
 
 import (
 	"context"
+	"encoding/json"
 	"errors"
 	"flag"
 	"fmt"
@@ -14,6 +15,7 @@ import (
 	"time"
 
 	"OpenEye/internal/config"
+	"OpenEye/internal/grammar"
 	"OpenEye/internal/pipeline"
 	"OpenEye/internal/runtime"
 	"OpenEye/server"
@@ -113,6 +115,9 @@ func RunServe(ctx context.Context, cfg config.Config, args []string) int {
 // runHTTPServer starts the HTTP server and handles requests
 func runHTTPServer(ctx context.Context, host string, port int, backend string, pipe *pipeline.Pipeline) int {
 	httpServer := server.NewHTTPServer(host, strconv.Itoa(port))
+	if metrics := pipe.Metrics(); metrics != nil {
+		httpServer.SetMetrics(metrics)
+	}
 	if err := httpServer.Start(backend); err != nil {
 		fmt.Fprintf(os.Stderr, "failed to start HTTP server: %v\n", err)
 		return 1
@@ -126,6 +131,7 @@ func runHTTPServer(ctx context.Context, host string, port int, backend string, p
 	fmt.Printf("OpenEye HTTP server listening on http://%s:%d\n", host, port)
 	fmt.Printf("  Health:   http://%s:%d/health\n", host, port)
 	fmt.Printf("  Chat API: http://%s:%d/v1/chat\n", host, port)
+	fmt.Printf("  Metrics:  http://%s:%d/metrics\n", host, port)
 
 	for {
 		select {
@@ -189,6 +195,21 @@ func runHTTPServer(ctx context.Context, host string, port int, backend string, p
 			if repeatLastN, ok := inbound.Options["repeat_last_n"].(float64); ok && repeatLastN != 0 {
 				opts.GenerationHints.RepeatLastN = int(repeatLastN)
 			}
+			// Structured output: a raw GBNF grammar, or a JSON schema
+			// converted to one.
+			if gbnf, ok := inbound.Options["grammar"].(string); ok && gbnf != "" {
+				opts.GenerationHints.Grammar = gbnf
+			}
+			if schema, ok := inbound.Options["json_schema"].(map[string]any); ok {
+				gbnf, err := schemaGrammar(schema)
+				if err != nil {
+					if respErr := inbound.RespondError(err); respErr != nil {
+						log.Printf("response error: %v", respErr)
+					}
+					return
+				}
+				opts.GenerationHints.Grammar = gbnf
+			}
 
 			result, runErr := respondWithRetry(pipe, inbound.Content, images, opts)
 			if runErr != nil {
@@ -206,6 +227,15 @@ func runHTTPServer(ctx context.Context, host string, port int, backend string, p
 	}
 }
 
+// schemaGrammar converts a decoded JSON schema request option to GBNF.
+func schemaGrammar(schema map[string]any) (string, error) {
+	raw, err := json.Marshal(schema)
+	if err != nil {
+		return "", fmt.Errorf("invalid json_schema: %w", err)
+	}
+	return grammar.FromJSONSchema(raw)
+}
+
 // runTCPServer starts the TCP server and handles requests
 func runTCPServer(ctx context.Context, host string, port int, pipe *pipeline.Pipeline) int {
 	tcpServer := server.NewTCPServer(host, strconv.Itoa(port))
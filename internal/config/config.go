@@ -68,16 +68,32 @@ type NativeBackendConfig struct {
 	// (e.g., SmolLM2-135M-Q4_K_M.gguf as draft for a 1.2B target).
 	DraftModelPath string `yaml:"draft_model_path"`
 
-	// SpeculativeN is the number of draft tokens to generate before
-	// verification. Higher values amortize more overhead but risk more
-	// rejections. Default: 5. Range: 2-8.
+	// SpeculativeN is the maximum number of draft tokens to generate
+	// before verification. Each round's actual draft length is tuned from
+	// the live acceptance rate and measured draft/target costs, and drafting
+	// stops early when the draft model is unsure. Default: 5. Range: 2-8.
 	SpeculativeN int `yaml:"speculative_n"`
 
+	// SpeculativeMode selects where speculative drafts come from:
+	// "draft" (default) uses DraftModelPath; "ngram" needs no second
+	// model and proposes continuations by matching the latest generated
+	// tokens against the prompt and earlier output (prompt lookup). It
+	// suits RAG answers and summaries that copy spans from the context.
+	SpeculativeMode string `yaml:"speculative_mode"`
+
 	// KVCacheType controls quantization of the KV cache. Lower precision
 	// reduces memory usage (allowing larger context or more headroom)
-	// with minimal quality impact. Options: "f16" (default), "q8_0", "q4_0".
+	// with minimal quality impact. Any ggml type name is accepted, e.g.
+	// "f16" (default), "q8_0", "q5_1", "q5_0", "iq4_nl", "q4_0".
 	KVCacheType string `yaml:"kv_cache_type"`
 
+	// KVCacheTypeK and KVCacheTypeV override KVCacheType for keys and
+	// values separately. Keys are the more precision-sensitive half, so
+	// e.g. q8_0 keys with q4_0 values trade less accuracy than q4_0 for
+	// both. Quantized values need flash attention.
+	KVCacheTypeK string `yaml:"kv_cache_type_k"`
+	KVCacheTypeV string `yaml:"kv_cache_type_v"`
+
 	// StreamChunkSize controls how many tokens are buffered before
 	// emitting to the stream callback. Higher values produce smoother
 	// word-level streaming. 0 or 1 = emit every token. Default: 3.
@@ -99,6 +115,13 @@ type NativeBackendConfig struct {
 	// Larger values mean fewer shifts but more content lost. Default: 1024.
 	ContextShiftDiscard int `yaml:"context_shift_discard"`
 
+	// ContextShiftKeep is the number of leading tokens a context shift
+	// never discards, so the system prompt and the prompt cache's shared
+	// prefix survive long chats. 0 (default) keeps the system-prompt span:
+	// the prompt up to its first end-of-turn token. -1 keeps nothing.
+	// Capped at half the context size.
+	ContextShiftKeep int `yaml:"context_shift_keep"`
+
 	// ContextReserveRatio is the fraction of context to reserve for new
 	// prompts and generation (0.0-1.0). Ensures headroom. Default: 0.25 (25%).
 	ContextReserveRatio float64 `yaml:"context_reserve_ratio"`
@@ -111,6 +134,47 @@ type NativeBackendConfig struct {
 	// MaxShiftAttempts is the maximum number of retry attempts for context
 	// shift operations before giving up. Default: 3.
 	MaxShiftAttempts int `yaml:"max_shift_attempts"`
+
+	// --- Prompt cache persistence ---
+
+	// PromptCacheDir enables on-disk KV snapshots of the stable prompt
+	// prefix (normally the system prompt). The first prefix shared by two
+	// consecutive prompts is saved here and restored at startup, so the
+	// first request after a restart does not re-evaluate it. Snapshots are
+	// keyed by model and token-prefix hash. Empty = disabled.
+	PromptCacheDir string `yaml:"prompt_cache_dir"`
+
+	// PrefixCacheMB is the memory budget, in megabytes, of the in-process
+	// prompt prefix cache. Recent prompts' KV states are indexed by token
+	// prefix and each request resumes from the longest cached one, so
+	// requests alternating between different system prompts or users keep
+	// their reuse. Least recently used entries are evicted first.
+	// 0 = disabled (only the previous prompt is reused).
+	PrefixCacheMB int `yaml:"prefix_cache_mb"`
+
+	// --- Vision ---
+
+	// VisionCacheMB is the memory budget, in megabytes, for encoded image
+	// embeddings kept across requests. Images are keyed by a hash of their
+	// pixels, so follow-up questions about the same frame skip the vision
+	// encoder. 0 = default (64 MB). -1 = disabled.
+	VisionCacheMB int `yaml:"vision_cache_mb"`
+
+	// --- Concurrency ---
+
+	// ParallelSlots is the number of requests that can generate at the same
+	// time on one context. Each in-flight request gets its own KV sequence
+	// and a scheduler interleaves their decode steps into a single batched
+	// llama_decode per step, so aggregate tokens/s scales with concurrent
+	// users. 0 or 1 = disabled (requests are served one at a time).
+	ParallelSlots int `yaml:"parallel_slots"`
+
+	// ScoreSequences is the number of KV sequences reserved for scoring
+	// candidate continuations (Choices labels sharing a first token) in
+	// one batched decode. 0 = none: candidates are scored one at a time,
+	// and the default single-sequence KV layout is kept. Each sequence
+	// costs a state cell on recurrent and hybrid models.
+	ScoreSequences int `yaml:"score_sequences"`
 }
 
 // HTTPBackendConfig configures the default HTTP completion backend.
@@ -831,15 +895,42 @@ func merge(base, override Config) Config {
 	if override.Runtime.Native.SpeculativeN != 0 {
 		result.Runtime.Native.SpeculativeN = override.Runtime.Native.SpeculativeN
 	}
+	if override.Runtime.Native.SpeculativeMode != "" {
+		result.Runtime.Native.SpeculativeMode = override.Runtime.Native.SpeculativeMode
+	}
 	if override.Runtime.Native.KVCacheType != "" {
 		result.Runtime.Native.KVCacheType = override.Runtime.Native.KVCacheType
 	}
+	if override.Runtime.Native.KVCacheTypeK != "" {
+		result.Runtime.Native.KVCacheTypeK = override.Runtime.Native.KVCacheTypeK
+	}
+	if override.Runtime.Native.KVCacheTypeV != "" {
+		result.Runtime.Native.KVCacheTypeV = override.Runtime.Native.KVCacheTypeV
+	}
 	if override.Runtime.Native.StreamChunkSize != 0 {
 		result.Runtime.Native.StreamChunkSize = override.Runtime.Native.StreamChunkSize
 	}
 	if override.Runtime.Native.ContextShift != nil {
 		result.Runtime.Native.ContextShift = override.Runtime.Native.ContextShift
 	}
+	if override.Runtime.Native.ContextShiftKeep != 0 {
+		result.Runtime.Native.ContextShiftKeep = override.Runtime.Native.ContextShiftKeep
+	}
+	if override.Runtime.Native.PromptCacheDir != "" {
+		result.Runtime.Native.PromptCacheDir = override.Runtime.Native.PromptCacheDir
+	}
+	if override.Runtime.Native.PrefixCacheMB != 0 {
+		result.Runtime.Native.PrefixCacheMB = override.Runtime.Native.PrefixCacheMB
+	}
+	if override.Runtime.Native.VisionCacheMB != 0 {
+		result.Runtime.Native.VisionCacheMB = override.Runtime.Native.VisionCacheMB
+	}
+	if override.Runtime.Native.ParallelSlots != 0 {
+		result.Runtime.Native.ParallelSlots = override.Runtime.Native.ParallelSlots
+	}
+	if override.Runtime.Native.ScoreSequences != 0 {
+		result.Runtime.Native.ScoreSequences = override.Runtime.Native.ScoreSequences
+	}
 
 	// Merge Image configuration
 	if override.Image.Enabled {
@@ -64,6 +64,17 @@ func TestMergeNativeOptimizationFields(t *testing.T) {
 		}
 	})
 
+	t.Run("KVCacheTypeK/V override independently", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.KVCacheTypeK = "q8_0"
+		override.Runtime.Native.KVCacheTypeV = "q4_0"
+		result := merge(base, override)
+		if result.Runtime.Native.KVCacheTypeK != "q8_0" || result.Runtime.Native.KVCacheTypeV != "q4_0" {
+			t.Errorf("KVCacheTypeK/V = %q/%q, want q8_0/q4_0",
+				result.Runtime.Native.KVCacheTypeK, result.Runtime.Native.KVCacheTypeV)
+		}
+	})
+
 	t.Run("KVCacheType not overridden when empty", func(t *testing.T) {
 		baseCfg := Config{}
 		baseCfg.Runtime.Native.KVCacheType = "q4_0"
@@ -133,6 +144,79 @@ func TestMergeNativeOptimizationFields(t *testing.T) {
 		}
 	})
 
+	t.Run("ContextShiftKeep override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.ContextShiftKeep = -1
+		result := merge(base, override)
+		if result.Runtime.Native.ContextShiftKeep != -1 {
+			t.Errorf("ContextShiftKeep = %d, want -1", result.Runtime.Native.ContextShiftKeep)
+		}
+	})
+
+	t.Run("SpeculativeMode override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.SpeculativeMode = "ngram"
+		result := merge(base, override)
+		if result.Runtime.Native.SpeculativeMode != "ngram" {
+			t.Errorf("SpeculativeMode = %q, want %q", result.Runtime.Native.SpeculativeMode, "ngram")
+		}
+	})
+
+	t.Run("PromptCacheDir override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.PromptCacheDir = "/var/cache/openeye"
+		result := merge(base, override)
+		if result.Runtime.Native.PromptCacheDir != "/var/cache/openeye" {
+			t.Errorf("PromptCacheDir = %q, want %q", result.Runtime.Native.PromptCacheDir, "/var/cache/openeye")
+		}
+	})
+
+	t.Run("VisionCacheMB override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.VisionCacheMB = -1
+		result := merge(base, override)
+		if result.Runtime.Native.VisionCacheMB != -1 {
+			t.Errorf("VisionCacheMB = %d, want -1", result.Runtime.Native.VisionCacheMB)
+		}
+	})
+
+	t.Run("PrefixCacheMB override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.PrefixCacheMB = 256
+		result := merge(base, override)
+		if result.Runtime.Native.PrefixCacheMB != 256 {
+			t.Errorf("PrefixCacheMB = %d, want 256", result.Runtime.Native.PrefixCacheMB)
+		}
+	})
+
+	t.Run("ParallelSlots override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.ParallelSlots = 4
+		result := merge(base, override)
+		if result.Runtime.Native.ParallelSlots != 4 {
+			t.Errorf("ParallelSlots = %d, want 4", result.Runtime.Native.ParallelSlots)
+		}
+	})
+
+	t.Run("ParallelSlots not overridden when zero", func(t *testing.T) {
+		baseCfg := Config{}
+		baseCfg.Runtime.Native.ParallelSlots = 2
+		override := Config{}
+		result := merge(baseCfg, override)
+		if result.Runtime.Native.ParallelSlots != 2 {
+			t.Errorf("ParallelSlots = %d, want 2", result.Runtime.Native.ParallelSlots)
+		}
+	})
+
+	t.Run("ScoreSequences override", func(t *testing.T) {
+		override := Config{}
+		override.Runtime.Native.ScoreSequences = 8
+		result := merge(base, override)
+		if result.Runtime.Native.ScoreSequences != 8 {
+			t.Errorf("ScoreSequences = %d, want 8", result.Runtime.Native.ScoreSequences)
+		}
+	})
+
 	t.Run("all optimization fields together", func(t *testing.T) {
 		f := false
 		override := Config{}
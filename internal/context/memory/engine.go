@@ -36,6 +36,12 @@ type SummaryProvider interface {
 	Summarize(ctx context.Context, texts []string) (string, error)
 }
 
+// TokenCounter counts tokens exactly, typically with the runtime model's
+// tokenizer. Implementations should batch the whole slice into one call.
+type TokenCounter interface {
+	CountTokens(texts []string) ([]int, error)
+}
+
 // EngineConfig holds configuration for the memory engine.
 type EngineConfig struct {
 	// Database settings
@@ -59,6 +65,9 @@ type EngineConfig struct {
 	CompressBatchSize  int
 	AutoCompress       bool
 	CompressEveryN     int
+
+	// TokenCounter, if set, gives exact token counts to context fitting.
+	TokenCounter TokenCounter
 }
 
 // DefaultEngineConfig returns sensible defaults.
@@ -110,6 +119,7 @@ func NewEngine(
 		},
 		AutoCompress:  cfg.AutoCompress,
 		CompressEvery: cfg.CompressEveryN,
+		TokenCounter:  cfg.TokenCounter,
 	}
 
 	// Create wrapper functions for embedder and summarizer
@@ -173,6 +173,13 @@ func (fe *FactExtractor) ExtractAsync(turns []ConversationTurn, callback func([]
 	}
 }
 
+// Caps on records per extraction call, enforced by the output grammars.
+// Generation ends once the cap is reached instead of running to MaxTokens.
+const (
+	maxEntitiesPerExtraction = 16
+	maxRelationshipsPerFact  = 4
+)
+
 // extractFacts calls the LLM to extract facts from conversation.
 func (fe *FactExtractor) extractFacts(ctx context.Context, conversation string) ([]ExtractedFact, error) {
 	prompt := fe.prompts.FactExtractionPrompt(conversation, fe.config.MaxFactsPerExtraction)
@@ -187,6 +194,7 @@ func (fe *FactExtractor) extractFacts(ctx context.Context, conversation string)
 			MinP:          0.05,
 			RepeatPenalty: 1.1,
 			RepeatLastN:   64,
+			Grammar:       FactExtractionGrammar(fe.config.MaxFactsPerExtraction),
 		},
 	})
 	if err != nil {
@@ -224,6 +232,7 @@ func (fe *FactExtractor) extractEntities(ctx context.Context, facts []ExtractedF
 			MinP:          0.05,
 			RepeatPenalty: 1.1,
 			RepeatLastN:   64,
+			Grammar:       EntityExtractionGrammar(maxEntitiesPerExtraction),
 		},
 	})
 	if err != nil {
@@ -259,6 +268,7 @@ func (fe *FactExtractor) extractRelationships(ctx context.Context, facts []Extra
 	}
 
 	var allRelationships []ExtractedRelationship
+	relGrammar := RelationshipExtractionGrammar(entityNames, maxRelationshipsPerFact)
 
 	// Extract relationships for each fact
 	for _, fact := range facts {
@@ -274,6 +284,7 @@ func (fe *FactExtractor) extractRelationships(ctx context.Context, facts []Extra
 				MinP:          0.05,
 				RepeatPenalty: 1.1,
 				RepeatLastN:   64,
+				Grammar:       relGrammar,
 			},
 		})
 		if err != nil {
@@ -330,6 +341,7 @@ func (fe *FactExtractor) EvaluateImportance(ctx context.Context, factText string
 			MinP:          0.05,
 			RepeatPenalty: 1.0,
 			RepeatLastN:   0,
+			Grammar:       importanceGrammar,
 		},
 	})
 	if err != nil {
@@ -344,16 +356,13 @@ func (fe *FactExtractor) EvaluateImportance(ctx context.Context, factText string
 func (fe *FactExtractor) ClassifyCategory(ctx context.Context, factText string) (FactCategory, error) {
 	prompt := fe.prompts.CategoryClassificationPrompt(factText)
 
+	// A classification, not generation: the backend picks the most likely
+	// category label directly.
 	resp, err := fe.manager.Generate(ctx, runtime.Request{
 		Prompt: prompt,
 		Options: runtime.GenerationOptions{
-			MaxTokens:     16,
-			Temperature:   0.1,
-			TopK:          40,
-			TopP:          0.9,
-			MinP:          0.05,
-			RepeatPenalty: 1.0,
-			RepeatLastN:   0,
+			MaxTokens: 16,
+			Choices:   factCategoryLabels,
 		},
 	})
 	if err != nil {
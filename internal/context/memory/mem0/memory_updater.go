@@ -169,6 +169,7 @@ func (mu *MemoryUpdater) decideWithLLM(ctx context.Context, newFact ExtractedFac
 			MinP:          0.05,
 			RepeatPenalty: 1.1,
 			RepeatLastN:   64,
+			Choices:       MemoryUpdateChoices(len(existingTexts)),
 		},
 	})
 	if err != nil {
@@ -3,6 +3,8 @@ package mem0
 import (
 	"fmt"
 	"strings"
+
+	"OpenEye/internal/grammar"
 )
 
 // PromptTemplates contains all prompts used by the mem0 system.
@@ -92,16 +94,13 @@ OPERATIONS:
 - DELETE <id>: New fact contradicts/invalidates an existing fact (mark for deletion)
 - NOOP: New fact is already known or redundant
 
-Respond with exactly one operation and brief reason.
-
-OUTPUT FORMAT:
-<OPERATION>|<reason>
+Respond with exactly one operation.
 
 Examples:
-ADD|This is new information about user's job
-UPDATE 2|Refines the location information in fact 2
-DELETE 1|Contradicts fact 1, user changed preference
-NOOP|Already captured in existing facts
+ADD
+UPDATE 2
+DELETE 1
+NOOP
 
 DECISION:`, newFact, existingList)
 }
@@ -224,6 +223,61 @@ type ConversationTurn struct {
 	TurnID  string // Optional identifier for the turn
 }
 
+// Output grammars. Each constrains generation to the line format its prompt
+// asks for, so a small model cannot drift from the format and the parsers
+// below never see malformed records. Backends without grammar support
+// ignore them and rely on the prompt alone.
+
+// factCategoryLabels are the category names the prompts offer, as used by
+// FactExtractionGrammar and for CategoryClassificationPrompt choices.
+var factCategoryLabels = []string{"preference", "belief", "biographical", "event", "relationship", "task", "other"}
+
+// importanceGrammar constrains ImportanceEvaluationPrompt output to a
+// single score in [0, 1].
+var importanceGrammar = "root ::= \" \"? " + grammar.Score + "\n"
+
+// FactExtractionGrammar constrains FactExtractionPrompt output to at most
+// maxFacts FACT lines with a known category and importance in [0, 1].
+func FactExtractionGrammar(maxFacts int) string {
+	return grammar.Lines("FACT", maxFacts, grammar.Enum(factCategoryLabels...), grammar.Score, grammar.Text)
+}
+
+// EntityExtractionGrammar constrains EntityExtractionPrompt output to
+// ENTITY lines with a known type.
+func EntityExtractionGrammar(maxEntities int) string {
+	return grammar.Lines("ENTITY", maxEntities,
+		grammar.Enum("person", "place", "thing", "concept", "organization", "time", "other"),
+		grammar.Text)
+}
+
+// RelationshipExtractionGrammar constrains RelationshipExtractionPrompt
+// output to REL lines between the given entities with a known relation
+// type.
+func RelationshipExtractionGrammar(entities []string, maxRels int) string {
+	entity := grammar.Text
+	if len(entities) > 0 {
+		entity = grammar.Enum(entities...)
+	}
+	return grammar.Lines("REL", maxRels,
+		entity,
+		grammar.Enum("knows", "works_at", "lives_in", "owns", "likes", "dislikes",
+			"uses", "created", "is_member_of", "related_to"),
+		entity, grammar.Score)
+}
+
+// MemoryUpdateChoices lists every decision MemoryUpdatePrompt allows for
+// numExisting listed facts, for use as GenerationOptions.Choices: the
+// model's most likely decision is taken directly instead of being parsed
+// from free text.
+func MemoryUpdateChoices(numExisting int) []string {
+	choices := make([]string, 0, 2+2*numExisting)
+	choices = append(choices, string(OpAdd), string(OpNoop))
+	for i := 1; i <= numExisting; i++ {
+		choices = append(choices, fmt.Sprintf("%s %d", OpUpdate, i), fmt.Sprintf("%s %d", OpDelete, i))
+	}
+	return choices
+}
+
 // ParseFactExtractionResponse parses the LLM response from FactExtractionPrompt.
 func ParseFactExtractionResponse(response string) []ExtractedFact {
 	var facts []ExtractedFact
@@ -9,6 +9,7 @@ import (
 	"time"
 
 	"OpenEye/internal/embedding"
+	"OpenEye/internal/tokens"
 )
 
 // HybridRetriever implements multi-signal ranking for memory retrieval.
@@ -468,13 +469,19 @@ func FormatFactsForPrompt(facts []Fact, maxTokens int) string {
 		return ""
 	}
 
+	const header = "Known facts about the user:\n"
 	var result strings.Builder
-	result.WriteString("Known facts about the user:\n")
+	result.WriteString(header)
 
-	estimatedTokens := 10 // Header
-	for _, fact := range facts {
-		factLine := "- " + fact.Text + "\n"
-		lineTokens := len(factLine) / 4 // Rough estimate
+	lines := make([]string, len(facts))
+	for i, fact := range facts {
+		lines[i] = "- " + fact.Text + "\n"
+	}
+	lineCounts := tokens.CountAll(lines)
+
+	estimatedTokens := tokens.Count(header)
+	for i, factLine := range lines {
+		lineTokens := lineCounts[i]
 
 		if estimatedTokens+lineTokens > maxTokens {
 			break
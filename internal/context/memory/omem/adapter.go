@@ -165,6 +165,7 @@ func NewAdapter(cfg Config, manager *runtime.Manager, embedder embedding.Provide
 				Options: runtime.GenerationOptions{
 					MaxTokens:   512,
 					Temperature: 0.3, // Lower temp for factual extraction
+					Grammar:     runtime.GrammarFromContext(ctx),
 				},
 			})
 			if err != nil {
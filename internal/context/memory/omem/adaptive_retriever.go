@@ -8,6 +8,8 @@ import (
 	"sort"
 	"strings"
 	"time"
+
+	"OpenEye/internal/tokens"
 )
 
 // AdaptiveRetriever provides complexity-aware hybrid retrieval with dynamic depth.
@@ -462,37 +464,32 @@ func (ar *AdaptiveRetriever) fitToTokenBudget(results []ScoredFact, maxTokens in
 	totalTokens := 0
 	truncated := make([]ScoredFact, 0, len(results))
 
-	for _, sf := range results {
-		tokens := ar.estimateTokens(sf.Fact.AtomicText)
-		if totalTokens+tokens > maxTokens {
+	for i, n := range factTokenCounts(results) {
+		if totalTokens+n > maxTokens {
 			break
 		}
-		totalTokens += tokens
-		truncated = append(truncated, sf)
+		totalTokens += n
+		truncated = append(truncated, results[i])
 	}
 
 	return truncated, totalTokens
 }
 
-// estimateTokens estimates the token count for a text.
-// Uses a simple heuristic: ~4 characters per token for English.
-func (ar *AdaptiveRetriever) estimateTokens(text string) int {
-	if text == "" {
-		return 0
-	}
-	// Rough estimate: 4 chars per token, minimum 1 token
-	tokens := (len(text) + 3) / 4
-	if tokens < 1 {
-		tokens = 1
+// factTokenCounts counts the tokens of each fact's text in one batch with
+// the shared token service.
+func factTokenCounts(facts []ScoredFact) []int {
+	texts := make([]string, len(facts))
+	for i, sf := range facts {
+		texts[i] = sf.Fact.AtomicText
 	}
-	return tokens
+	return tokens.CountAll(texts)
 }
 
-// estimateTotalTokens estimates total tokens across all facts.
+// estimateTotalTokens counts total tokens across all facts.
 func (ar *AdaptiveRetriever) estimateTotalTokens(results []ScoredFact) int {
 	total := 0
-	for _, sf := range results {
-		total += ar.estimateTokens(sf.Fact.AtomicText)
+	for _, n := range factTokenCounts(results) {
+		total += n
 	}
 	return total
 }
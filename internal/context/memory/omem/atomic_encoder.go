@@ -7,6 +7,8 @@ import (
 	"strings"
 	"sync"
 	"time"
+
+	"OpenEye/internal/runtime"
 )
 
 // AtomicEncoder performs SimpleMem-inspired semantic lossless compression.
@@ -440,6 +442,8 @@ func (ae *AtomicEncoder) extractAtomicFacts(ctx context.Context, text string) ([
 
 	prompt := ae.prompts.AtomicFactExtractionPrompt(text, ae.config.MaxFactsPerTurn)
 
+	// llmGenerate takes only a prompt; the grammar travels in the context.
+	ctx = runtime.WithGrammar(ctx, AtomicFactExtractionGrammar(ae.config.MaxFactsPerTurn))
 	response, err := ae.llmGenerate(ctx, prompt)
 	if err != nil {
 		return nil, err
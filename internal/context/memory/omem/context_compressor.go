@@ -90,6 +90,7 @@ func (cc *ContextCompressor) Compress(ctx context.Context, facts []ScoredFact, m
 func (cc *ContextCompressor) calculateImportanceScores(facts []ScoredFact, maxTokens int) []WeightedFact {
 	now := time.Now()
 	weightedFacts := make([]WeightedFact, 0, len(facts))
+	tokenCounts := factTokenCounts(facts)
 
 	for i, sf := range facts {
 		importance := sf.Fact.Importance
@@ -106,7 +107,7 @@ func (cc *ContextCompressor) calculateImportanceScores(facts []ScoredFact, maxTo
 			cc.config.RecencyWeight*recency +
 			cc.config.PositionWeight*positionScore
 
-		tokenCount := cc.estimateTokens(sf.Fact.AtomicText)
+		tokenCount := tokenCounts[i]
 
 		weightedFacts = append(weightedFacts, WeightedFact{
 			Fact:       sf.Fact,
@@ -207,17 +208,10 @@ func (cc *ContextCompressor) shuffleMiddle(facts []WeightedFact) {
 	copy(facts, shuffled)
 }
 
-func (cc *ContextCompressor) estimateTokens(text string) int {
-	if text == "" {
-		return 0
-	}
-	return (len(text) + 3) / 4
-}
-
 func (cc *ContextCompressor) estimateTotalTokens(facts []ScoredFact) int {
 	total := 0
-	for _, sf := range facts {
-		total += cc.estimateTokens(sf.Fact.AtomicText)
+	for _, n := range factTokenCounts(facts) {
+		total += n
 	}
 	return total
 }
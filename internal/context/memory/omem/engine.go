@@ -8,6 +8,7 @@ import (
 	"time"
 
 	"OpenEye/internal/rag"
+	"OpenEye/internal/tokens"
 )
 
 // Engine is the main orchestrator for the Omem memory system.
@@ -571,13 +572,9 @@ func (e *Engine) formatContextWithExternal(result *ContextResult) string {
 	return strings.TrimSpace(sb.String())
 }
 
-// estimateTokens estimates the token count for a text.
+// estimateTokens counts the tokens of text with the shared token service.
 func (e *Engine) estimateTokens(text string) int {
-	if text == "" {
-		return 0
-	}
-	// Rough estimate: ~4 characters per token
-	return (len(text) + 3) / 4
+	return tokens.Count(text)
 }
 
 // ============================================================================
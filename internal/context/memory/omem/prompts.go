@@ -3,6 +3,8 @@ package omem
 import (
 	"fmt"
 	"strings"
+
+	"OpenEye/internal/grammar"
 )
 
 // PromptTemplates contains all prompts used by the Omem system.
@@ -295,6 +297,16 @@ const (
 	OpNoop   UpdateOperation = "NOOP"
 )
 
+// AtomicFactExtractionGrammar constrains AtomicFactExtractionPrompt output
+// to at most maxFacts FACT lines with a known category and importance in
+// [0, 1], so the parser never has to skip malformed lines.
+func AtomicFactExtractionGrammar(maxFacts int) string {
+	return grammar.Lines("FACT", maxFacts,
+		grammar.Enum("preference", "belief", "biographical", "event",
+			"relationship", "task", "knowledge", "other"),
+		grammar.Score, grammar.Text)
+}
+
 // ParseFactExtractionResponse parses the LLM response from fact extraction.
 func ParseFactExtractionResponse(response string) []ExtractedFact {
 	var facts []ExtractedFact
@@ -8,6 +8,8 @@ import (
 	"strings"
 	"sync"
 	"time"
+
+	"OpenEye/internal/tokens"
 )
 
 // SlidingContextConfig configures the sliding context window manager.
@@ -32,8 +34,9 @@ func DefaultSlidingContextConfig() SlidingContextConfig {
 
 // SlidingContextWindow manages context fitting for limited context windows.
 type SlidingContextWindow struct {
-	config SlidingContextConfig
-	mu     sync.RWMutex
+	config  SlidingContextConfig
+	counter TokenCounter
+	mu      sync.RWMutex
 }
 
 // NewSlidingContextWindow creates a new sliding context window manager.
@@ -57,6 +60,14 @@ func NewSlidingContextWindow(cfg SlidingContextConfig) *SlidingContextWindow {
 	return &SlidingContextWindow{config: cfg}
 }
 
+// SetTokenCounter makes FitContext count summary and item tokens exactly
+// instead of trusting stored estimates. A nil counter restores estimation.
+func (s *SlidingContextWindow) SetTokenCounter(tc TokenCounter) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	s.counter = tc
+}
+
 // ContextItem represents a piece of context with metadata for ranking.
 type ContextItem struct {
 	ID           int64
@@ -75,10 +86,27 @@ func (s *SlidingContextWindow) FitContext(items []ContextItem, summary string, p
 
 	availableTokens := s.config.MaxTokens - promptTokens - s.config.ReservedForPrompt
 
-	// If we have a summary, reserve space for it
+	// With an exact counter, recount the summary and every item in one
+	// batch; stored TokenCounts are chars/4 estimates.
 	summaryTokens := 0
-	if summary != "" {
+	if s.counter != nil {
+		texts := make([]string, 0, len(items)+1)
+		texts = append(texts, summary)
+		for _, item := range items {
+			texts = append(texts, item.Text)
+		}
+		counts := countTokens(s.counter, texts)
+		summaryTokens = counts[0]
+		items = append([]ContextItem(nil), items...)
+		for i := range items {
+			items[i].TokenCount = counts[i+1]
+		}
+	} else if summary != "" {
 		summaryTokens = estimateTokens(summary)
+	}
+
+	// If we have a summary, reserve space for it
+	if summary != "" {
 		if summaryTokens > s.config.ReservedForSummary {
 			// Truncate summary if too long
 			summary = truncateToTokens(summary, s.config.ReservedForSummary)
@@ -162,15 +190,27 @@ func truncateToTokens(text string, maxTokens int) string {
 	return text[:maxChars] + "..."
 }
 
+// countTokens counts texts with tc in one call, falling back to the shared
+// token service when tc is nil or fails.
+func countTokens(tc TokenCounter, texts []string) []int {
+	if tc != nil {
+		if counts, err := tc.CountTokens(texts); err == nil && len(counts) == len(texts) {
+			return counts
+		}
+	}
+	return tokens.CountAll(texts)
+}
+
 // ContextBuilder helps construct context from various sources.
 type ContextBuilder struct {
-	systemMessage   string
-	summary         string
-	recentMemories  []ContextItem
-	retrievedItems  []ContextItem
-	knowledge       []string
-	maxTokens       int
-	mu              sync.Mutex
+	systemMessage  string
+	summary        string
+	recentMemories []ContextItem
+	retrievedItems []ContextItem
+	knowledge      []string
+	maxTokens      int
+	counter        TokenCounter
+	mu             sync.Mutex
 }
 
 // NewContextBuilder creates a new context builder.
@@ -181,6 +221,13 @@ func NewContextBuilder(maxTokens int) *ContextBuilder {
 	return &ContextBuilder{maxTokens: maxTokens}
 }
 
+// SetTokenCounter makes Build count tokens exactly instead of estimating.
+func (b *ContextBuilder) SetTokenCounter(tc TokenCounter) {
+	b.mu.Lock()
+	defer b.mu.Unlock()
+	b.counter = tc
+}
+
 // SetSystemMessage sets the system message.
 func (b *ContextBuilder) SetSystemMessage(msg string) {
 	b.mu.Lock()
@@ -223,14 +270,32 @@ func (b *ContextBuilder) Build(prompt string) (string, error) {
 
 	var parts []string
 	usedTokens := 0
-	promptTokens := estimateTokens(prompt)
+
+	// Count every candidate section in one batch. Memory items keep their
+	// stored counts unless an exact counter is available.
+	allMemories := b.mergeMemories()
+	texts := make([]string, 0, 3+len(b.knowledge)+len(allMemories))
+	texts = append(texts, prompt, b.systemMessage, b.summary)
+	texts = append(texts, b.knowledge...)
+	if b.counter != nil {
+		for _, item := range allMemories {
+			texts = append(texts, item.Text)
+		}
+	}
+	counts := countTokens(b.counter, texts)
+	promptTokens, sysTokens, summaryTokens := counts[0], counts[1], counts[2]
+	knowledgeTokens := counts[3 : 3+len(b.knowledge)]
+	if b.counter != nil {
+		for i, n := range counts[3+len(b.knowledge):] {
+			allMemories[i].TokenCount = n
+		}
+	}
 
 	// Reserve space for prompt
 	availableTokens := b.maxTokens - promptTokens - 100 // Buffer
 
 	// System message (required)
 	if b.systemMessage != "" {
-		sysTokens := estimateTokens(b.systemMessage)
 		if sysTokens < availableTokens {
 			parts = append(parts, "## System\n"+b.systemMessage)
 			usedTokens += sysTokens
@@ -239,7 +304,6 @@ func (b *ContextBuilder) Build(prompt string) (string, error) {
 
 	// Summary (if available)
 	if b.summary != "" && usedTokens < availableTokens {
-		summaryTokens := estimateTokens(b.summary)
 		remaining := availableTokens - usedTokens
 		if summaryTokens < remaining {
 			parts = append(parts, "\n## Memory Summary\n"+b.summary)
@@ -247,12 +311,11 @@ func (b *ContextBuilder) Build(prompt string) (string, error) {
 		} else if remaining > 100 {
 			truncated := truncateToTokens(b.summary, remaining-10)
 			parts = append(parts, "\n## Memory Summary\n"+truncated)
-			usedTokens += estimateTokens(truncated)
+			usedTokens += countTokens(b.counter, []string{truncated})[0]
 		}
 	}
 
-	// Merge and deduplicate memories
-	allMemories := b.mergeMemories()
+	// Merged and deduplicated memories
 	if len(allMemories) > 0 && usedTokens < availableTokens {
 		var memoryParts []string
 		for _, item := range allMemories {
@@ -274,7 +337,7 @@ func (b *ContextBuilder) Build(prompt string) (string, error) {
 	if len(b.knowledge) > 0 && usedTokens < availableTokens {
 		var knowledgeParts []string
 		for i, k := range b.knowledge {
-			kTokens := estimateTokens(k)
+			kTokens := knowledgeTokens[i]
 			remaining := availableTokens - usedTokens
 			if remaining < 50 {
 				break
@@ -332,12 +395,12 @@ func (b *ContextBuilder) mergeMemories() []ContextItem {
 
 // MemoryCompressor handles memory compression operations.
 type MemoryCompressor struct {
-	vectorStore   *VectorStore
-	summarizeFn   func(ctx context.Context, texts []string) (string, error)
-	embedFn       func(ctx context.Context, text string) ([]float32, error)
-	batchSize     int
+	vectorStore    *VectorStore
+	summarizeFn    func(ctx context.Context, texts []string) (string, error)
+	embedFn        func(ctx context.Context, text string) ([]float32, error)
+	batchSize      int
 	compressionAge time.Duration
-	mu            sync.Mutex
+	mu             sync.Mutex
 }
 
 // MemoryCompressorConfig configures the memory compressor.
@@ -424,6 +487,7 @@ type HybridMemoryEngine struct {
 	autoCompress    bool
 	compressCounter int
 	compressEvery   int
+	tokenCounter    TokenCounter
 	mu              sync.RWMutex
 
 	// Cache for last query embedding to avoid redundant calls
@@ -460,6 +524,9 @@ type HybridMemoryConfig struct {
 	CompressConfig MemoryCompressorConfig
 	AutoCompress   bool
 	CompressEvery  int
+
+	// TokenCounter, if set, replaces chars/4 estimates when fitting context.
+	TokenCounter TokenCounter
 }
 
 // DefaultHybridMemoryConfig returns sensible defaults.
@@ -485,6 +552,7 @@ func NewHybridMemoryEngine(
 	}
 
 	contextWindow := NewSlidingContextWindow(cfg.ContextConfig)
+	contextWindow.SetTokenCounter(cfg.TokenCounter)
 
 	compressor := NewMemoryCompressor(vectorStore, summarize, embed, cfg.CompressConfig)
 
@@ -506,6 +574,7 @@ func NewHybridMemoryEngine(
 		summarizeFn:   summarize,
 		autoCompress:  cfg.AutoCompress,
 		compressEvery: cfg.CompressEvery,
+		tokenCounter:  cfg.TokenCounter,
 	}
 
 	if engine.compressEvery <= 0 {
@@ -606,6 +675,7 @@ func (e *HybridMemoryEngine) BuildContext(ctx context.Context, query string, max
 	defer e.mu.Unlock()
 
 	builder := NewContextBuilder(maxTokens)
+	builder.SetTokenCounter(e.tokenCounter)
 
 	// Get recent memories
 	recent, err := e.vectorStore.GetRecentMemories(ctx, 10)
@@ -14,6 +14,8 @@ import (
 	"sync"
 	"time"
 
+	"OpenEye/internal/tokens"
+
 	_ "github.com/marcboeker/go-duckdb"
 )
 
@@ -723,11 +725,10 @@ func cosineSimilarityOptimized(queryNormalized, doc []float32) float64 {
 	return dot / math.Sqrt(normSq)
 }
 
+// estimateTokens counts text with the shared token service: exact when the
+// runtime can tokenize locally, otherwise a rune-based estimate.
 func estimateTokens(text string) int {
-	// Use rune count for accurate non-ASCII handling
-	// Rough estimation: ~4 chars per token for English, ~2 for CJK
-	runeCount := len([]rune(text))
-	return runeCount / 4
+	return tokens.Count(text)
 }
 
 func calculateImportance(text string, role string) float64 {
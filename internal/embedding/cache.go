@@ -102,6 +102,25 @@ func (c *CachedProvider) EmbedBatch(ctx context.Context, texts []string) ([][]fl
 	}
 	c.cache.mu.RUnlock()
 
+	// Compute missing embeddings in one call when the provider batches.
+	if bp, ok := c.provider.(BatchProvider); ok && len(toCompute) > 1 {
+		missing := make([]string, len(toCompute))
+		for k, i := range toCompute {
+			missing[k] = texts[i]
+		}
+		embeddings, err := bp.EmbedBatch(ctx, missing)
+		if err != nil {
+			return nil, err
+		}
+		c.cache.mu.Lock()
+		for k, i := range toCompute {
+			results[i] = embeddings[k]
+			c.cache.set(hashText(texts[i]), embeddings[k])
+		}
+		c.cache.mu.Unlock()
+		return results, nil
+	}
+
 	// Compute missing embeddings
 	for _, i := range toCompute {
 		embedding, err := c.provider.Embed(ctx, texts[i])
@@ -14,6 +14,13 @@ type Provider interface {
 	Close() error
 }
 
+// BatchProvider is implemented by providers that can embed several texts
+// in one call more cheaply than one Embed call per text. Results are
+// returned in input order.
+type BatchProvider interface {
+	EmbedBatch(ctx context.Context, texts []string) ([][]float32, error)
+}
+
 // ProviderFactory constructs a Provider from the embedding configuration.
 type ProviderFactory func(config.EmbeddingConfig) (Provider, error)
 
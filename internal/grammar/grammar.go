@@ -0,0 +1,76 @@
+// Package grammar builds GBNF grammars (llama.cpp's grammar format) for
+// constrained sampling. A grammar passed in runtime.GenerationOptions
+// restricts generation to text the grammar accepts, so structured output
+// (extraction records, JSON) needs no format instructions in the prompt
+// and no retry when the model drifts from the format.
+package grammar
+
+import (
+	"fmt"
+	"strings"
+)
+
+// Common field expressions for Lines.
+const (
+	// Text is a non-empty field up to the next delimiter or newline.
+	Text = `[^|\n]+`
+
+	// Score is a number in [0.0, 1.0] with at most two decimals.
+	Score = `( "0" ( "." [0-9] [0-9]? )? | "1" ( "." "0" "0"? )? )`
+)
+
+// Quote returns s as a GBNF string literal.
+func Quote(s string) string {
+	var sb strings.Builder
+	sb.Grow(len(s) + 2)
+	sb.WriteByte('"')
+	for _, r := range s {
+		switch r {
+		case '"':
+			sb.WriteString(`\"`)
+		case '\\':
+			sb.WriteString(`\\`)
+		case '\n':
+			sb.WriteString(`\n`)
+		case '\r':
+			sb.WriteString(`\r`)
+		case '\t':
+			sb.WriteString(`\t`)
+		default:
+			sb.WriteRune(r)
+		}
+	}
+	sb.WriteByte('"')
+	return sb.String()
+}
+
+// Enum returns an expression matching exactly one of values.
+func Enum(values ...string) string {
+	alts := make([]string, len(values))
+	for i, v := range values {
+		alts[i] = Quote(v)
+	}
+	return "( " + strings.Join(alts, " | ") + " )"
+}
+
+// Lines returns a grammar for up to maxLines newline-separated records of
+// the form prefix|field1|field2|..., where each field is a GBNF
+// expression. Zero records (an immediate end of generation) are allowed,
+// and generation ends once maxLines records have been produced.
+func Lines(prefix string, maxLines int, fields ...string) string {
+	if maxLines < 1 {
+		maxLines = 1
+	}
+	var line strings.Builder
+	if prefix != "" {
+		line.WriteString(Quote(prefix))
+	}
+	for i, f := range fields {
+		if i > 0 || prefix != "" {
+			line.WriteString(` "|" `)
+		}
+		line.WriteString(f)
+	}
+	return fmt.Sprintf("root ::= ( line ( \"\\n\" line ){0,%d} )?\nline ::= %s\n",
+		maxLines-1, line.String())
+}
@@ -0,0 +1,147 @@
+package grammar
+
+import (
+	"strings"
+	"testing"
+)
+
+func TestQuote(t *testing.T) {
+	got := Quote("a\"b\\c\nd")
+	want := `"a\"b\\c\nd"`
+	if got != want {
+		t.Errorf("Quote = %s, want %s", got, want)
+	}
+}
+
+func TestLines(t *testing.T) {
+	g := Lines("FACT", 3, Enum("a", "b"), Score, Text)
+	want := "root ::= ( line ( \"\\n\" line ){0,2} )?\n" +
+		`line ::= "FACT" "|" ( "a" | "b" ) "|" ` + Score + ` "|" ` + Text + "\n"
+	if g != want {
+		t.Errorf("Lines =\n%s\nwant\n%s", g, want)
+	}
+}
+
+func TestFromJSONSchemaObject(t *testing.T) {
+	g, err := FromJSONSchema([]byte(`{
+		"type": "object",
+		"properties": {
+			"name": {"type": "string", "maxLength": 20},
+			"tags": {"type": "array", "items": {"enum": ["x", "y"]}, "maxItems": 3},
+			"age": {"type": "integer"},
+			"op": {"const": "ADD"}
+		},
+		"required": ["op", "name"]
+	}`))
+	if err != nil {
+		t.Fatalf("FromJSONSchema: %v", err)
+	}
+	rules := parseRules(t, g)
+
+	root := rules["root"]
+	// Required properties first in listed order, optional ones after.
+	iOp := strings.Index(root, `"\"op\""`)
+	iName := strings.Index(root, `"\"name\""`)
+	iAge := strings.Index(root, `( "," space "\"age\""`)
+	iTags := strings.Index(root, `( "," space "\"tags\""`)
+	if iOp < 0 || iName < iOp || iAge < iName || iTags < iAge {
+		t.Errorf("root property layout wrong:\n%s", root)
+	}
+	if !strings.Contains(root, `"\"ADD\"" space`) {
+		t.Errorf("const not rendered as a literal:\n%s", root)
+	}
+	if !strings.Contains(rules["root-name"], `char{0,20}`) {
+		t.Errorf("maxLength not applied: %s", rules["root-name"])
+	}
+	if !strings.Contains(rules["root-tags"], `){0,2}`) {
+		t.Errorf("maxItems not applied: %s", rules["root-tags"])
+	}
+	for _, prim := range []string{"space", "char", "integer"} {
+		if _, ok := rules[prim]; !ok {
+			t.Errorf("primitive %q missing", prim)
+		}
+	}
+	if _, ok := rules["boolean"]; ok {
+		t.Error("unused primitive emitted")
+	}
+}
+
+func TestFromJSONSchemaOptionalOnly(t *testing.T) {
+	g, err := FromJSONSchema([]byte(`{"properties": {"a": {"type": "boolean"}, "b": {"type": "null"}}}`))
+	if err != nil {
+		t.Fatalf("FromJSONSchema: %v", err)
+	}
+	root := parseRules(t, g)["root"]
+	want := `"{" space ( "\"a\"" space ":" space boolean ( "," space "\"b\"" space ":" space null )? | "\"b\"" space ":" space null )? "}" space`
+	if root != want {
+		t.Errorf("root =\n%s\nwant\n%s", root, want)
+	}
+}
+
+func TestFromJSONSchemaRefs(t *testing.T) {
+	g, err := FromJSONSchema([]byte(`{
+		"$defs": {"node": {"type": "object", "properties": {"next": {"anyOf": [{"$ref": "#/$defs/node"}, {"type": "null"}]}}}},
+		"$ref": "#/$defs/node"
+	}`))
+	if err != nil {
+		t.Fatalf("FromJSONSchema: %v", err)
+	}
+	rules := parseRules(t, g)
+	if rules["root"] != "node" {
+		t.Errorf("root = %q, want node", rules["root"])
+	}
+	if !strings.Contains(g, "( node | null )") {
+		t.Errorf("recursive reference not resolved:\n%s", g)
+	}
+
+	for _, bad := range []string{
+		`{"allOf": [{"type": "string"}]}`,
+		`{"$ref": "#/$defs/missing"}`,
+		`{"$ref": "http://example.com/schema"}`,
+		`{"type": "date"}`,
+		`not json`,
+	} {
+		if _, err := FromJSONSchema([]byte(bad)); err == nil {
+			t.Errorf("FromJSONSchema(%s) should fail", bad)
+		}
+	}
+}
+
+// parseRules splits a grammar into rule bodies and checks every rule
+// referenced is defined.
+func parseRules(t *testing.T, g string) map[string]string {
+	t.Helper()
+	rules := make(map[string]string)
+	for _, line := range strings.Split(strings.TrimSpace(g), "\n") {
+		name, body, ok := strings.Cut(line, " ::= ")
+		if !ok {
+			t.Fatalf("malformed rule %q", line)
+		}
+		if _, dup := rules[name]; dup {
+			t.Fatalf("rule %q defined twice", name)
+		}
+		rules[name] = body
+	}
+	for name, body := range rules {
+		for _, tok := range strings.Fields(body) {
+			if isRuleRef(tok) {
+				if _, ok := rules[tok]; !ok {
+					t.Errorf("rule %q references undefined %q", name, tok)
+				}
+			}
+		}
+	}
+	return rules
+}
+
+func isRuleRef(tok string) bool {
+	if tok == "" {
+		return false
+	}
+	for _, r := range tok {
+		if !(r >= 'a' && r <= 'z' || r >= '0' && r <= '9' || r == '-') {
+			return false
+		}
+	}
+	return tok[0] >= 'a' && tok[0] <= 'z'
+}
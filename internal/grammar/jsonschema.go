@@ -0,0 +1,446 @@
+package grammar
+
+import (
+	"encoding/json"
+	"fmt"
+	"sort"
+	"strings"
+)
+
+// Primitive rules shared by every JSON grammar. Whitespace is limited so a
+// model cannot pad output indefinitely.
+var jsonPrimitives = []struct{ name, body string }{
+	{"space", `| " " | "\n" [ \t]{0,20}`},
+	{"char", `[^"\\\x7F\x00-\x1F] | [\\] ( ["\\/bfnrt] | "u" [0-9a-fA-F]{4} )`},
+	{"string", `"\"" char* "\"" space`},
+	{"number", `"-"? ( [0-9] | [1-9] [0-9]{0,15} ) ( "." [0-9]+ )? ( [eE] [-+]? [0-9]{1,3} )? space`},
+	{"integer", `"-"? ( [0-9] | [1-9] [0-9]{0,15} ) space`},
+	{"boolean", `( "true" | "false" ) space`},
+	{"null", `"null" space`},
+	{"value", `object | array | string | number | boolean | null`},
+	{"object", `"{" space ( string ":" space value ( "," space string ":" space value )* )? "}" space`},
+	{"array", `"[" space ( value ( "," space value )* )? "]" space`},
+}
+
+// FromJSONSchema converts a JSON Schema document to a GBNF grammar whose
+// root rule accepts exactly the JSON values the schema describes.
+//
+// Supported: type (including type lists), properties and required, items
+// with minItems/maxItems, enum, const, anyOf/oneOf, minLength/maxLength
+// on strings, and local $ref into #/definitions or #/$defs (recursion
+// allowed). Object properties are generated in a fixed order (see
+// propertyOrder) and no undeclared properties are allowed. Keywords that cannot be expressed
+// (pattern, format, numeric bounds) are ignored, so the grammar may accept
+// more than the schema does; allOf and remote references are errors.
+func FromJSONSchema(schema []byte) (string, error) {
+	var root map[string]any
+	dec := json.NewDecoder(strings.NewReader(string(schema)))
+	dec.UseNumber()
+	if err := dec.Decode(&root); err != nil {
+		return "", fmt.Errorf("grammar: invalid JSON schema: %w", err)
+	}
+
+	c := &schemaConverter{
+		root:  root,
+		rules: make(map[string]string),
+		refs:  make(map[string]string),
+	}
+	body, err := c.visit(root, "root")
+	if err != nil {
+		return "", err
+	}
+	if body != "root" {
+		c.add("root", body)
+	}
+	return c.render(), nil
+}
+
+type schemaConverter struct {
+	root  map[string]any
+	rules map[string]string // rule name -> body
+	order []string          // rule names in creation order
+	refs  map[string]string // $ref -> rule name
+	prims map[string]bool   // primitive rules in use
+}
+
+// add defines a rule and returns its name.
+func (c *schemaConverter) add(name, body string) string {
+	if _, ok := c.rules[name]; !ok {
+		c.order = append(c.order, name)
+	}
+	c.rules[name] = body
+	return name
+}
+
+// fresh returns an unused rule name derived from hint.
+func (c *schemaConverter) fresh(hint string) string {
+	name := ruleName(hint)
+	if _, taken := c.rules[name]; !taken && !isPrimitive(name) {
+		return name
+	}
+	for i := 1; ; i++ {
+		n := fmt.Sprintf("%s-%d", name, i)
+		if _, taken := c.rules[n]; !taken {
+			return n
+		}
+	}
+}
+
+// prim marks a primitive rule (and those it references) as used.
+func (c *schemaConverter) prim(name string) string {
+	if c.prims == nil {
+		c.prims = make(map[string]bool)
+	}
+	deps := map[string][]string{
+		"string":  {"char", "space"},
+		"number":  {"space"},
+		"integer": {"space"},
+		"boolean": {"space"},
+		"null":    {"space"},
+		"object":  {"string", "value", "space"},
+		"array":   {"value", "space"},
+		"value":   {"object", "array", "string", "number", "boolean", "null"},
+	}
+	if !c.prims[name] {
+		c.prims[name] = true
+		for _, d := range deps[name] {
+			c.prim(d)
+		}
+	}
+	return name
+}
+
+// visit returns a GBNF expression for schema; path names any rules it
+// needs to create.
+func (c *schemaConverter) visit(schema map[string]any, path string) (string, error) {
+	if ref, ok := schema["$ref"].(string); ok {
+		return c.ref(ref)
+	}
+	if v, ok := schema["const"]; ok {
+		return c.literal(v)
+	}
+	if vals, ok := schema["enum"].([]any); ok {
+		alts := make([]string, 0, len(vals))
+		for _, v := range vals {
+			lit, err := c.literal(v)
+			if err != nil {
+				return "", err
+			}
+			alts = append(alts, lit)
+		}
+		return group(alts), nil
+	}
+	for _, key := range []string{"anyOf", "oneOf"} {
+		if subs, ok := schema[key].([]any); ok {
+			alts := make([]string, 0, len(subs))
+			for i, s := range subs {
+				sub, ok := s.(map[string]any)
+				if !ok {
+					return "", fmt.Errorf("grammar: %s at %s must list schemas", key, path)
+				}
+				expr, err := c.visit(sub, fmt.Sprintf("%s-%d", path, i))
+				if err != nil {
+					return "", err
+				}
+				alts = append(alts, expr)
+			}
+			return group(alts), nil
+		}
+	}
+	if _, ok := schema["allOf"]; ok {
+		return "", fmt.Errorf("grammar: allOf at %s is not supported", path)
+	}
+
+	switch t := schema["type"].(type) {
+	case []any:
+		alts := make([]string, 0, len(t))
+		for _, name := range t {
+			s, _ := name.(string)
+			sub := make(map[string]any, len(schema))
+			for k, v := range schema {
+				sub[k] = v
+			}
+			sub["type"] = s
+			expr, err := c.visit(sub, path+"-"+s)
+			if err != nil {
+				return "", err
+			}
+			alts = append(alts, expr)
+		}
+		return group(alts), nil
+	case string:
+		return c.typed(t, schema, path)
+	case nil:
+		if _, ok := schema["properties"]; ok {
+			return c.typed("object", schema, path)
+		}
+		if _, ok := schema["items"]; ok {
+			return c.typed("array", schema, path)
+		}
+		return c.prim("value"), nil
+	default:
+		return "", fmt.Errorf("grammar: invalid type at %s", path)
+	}
+}
+
+func (c *schemaConverter) typed(t string, schema map[string]any, path string) (string, error) {
+	switch t {
+	case "string":
+		minLen, maxLen := intKey(schema, "minLength", 0), intKey(schema, "maxLength", -1)
+		if minLen == 0 && maxLen < 0 {
+			return c.prim("string"), nil
+		}
+		c.prim("char")
+		c.prim("space")
+		rep := fmt.Sprintf("{%d,}", minLen)
+		if maxLen >= 0 {
+			rep = fmt.Sprintf("{%d,%d}", minLen, maxLen)
+		}
+		return c.add(c.fresh(path), `"\"" char`+rep+` "\"" space`), nil
+	case "number", "integer", "boolean", "null":
+		return c.prim(t), nil
+	case "array":
+		items, ok := schema["items"].(map[string]any)
+		if !ok {
+			if _, has := schema["minItems"]; !has {
+				return c.prim("array"), nil
+			}
+			items = map[string]any{}
+		}
+		name := c.fresh(path)
+		c.add(name, "") // reserve before recursing
+		item, err := c.visit(items, path+"-item")
+		if err != nil {
+			return "", err
+		}
+		c.prim("space")
+		minItems, maxItems := intKey(schema, "minItems", 0), intKey(schema, "maxItems", -1)
+		var body string
+		switch {
+		case maxItems == 0:
+			body = `"[" space "]" space`
+		case minItems == 0:
+			body = fmt.Sprintf(`"[" space ( %s ( "," space %s )%s )? "]" space`, item, item, repeat(0, maxItems-1))
+		default:
+			body = fmt.Sprintf(`"[" space %s ( "," space %s )%s "]" space`, item, item, repeat(minItems-1, maxItems-1))
+		}
+		return c.add(name, body), nil
+	case "object":
+		props, ok := schema["properties"].(map[string]any)
+		if !ok || len(props) == 0 {
+			return c.prim("object"), nil
+		}
+		name := c.fresh(path)
+		c.add(name, "")
+		keys := propertyOrder(schema, props)
+		required := make(map[string]bool)
+		if req, ok := schema["required"].([]any); ok {
+			for _, r := range req {
+				if s, ok := r.(string); ok {
+					required[s] = true
+				}
+			}
+		}
+
+		var req, opt []string
+		for _, k := range keys {
+			sub, _ := props[k].(map[string]any)
+			if sub == nil {
+				sub = map[string]any{}
+			}
+			val, err := c.visit(sub, path+"-"+k)
+			if err != nil {
+				return "", err
+			}
+			kv := Quote(mustJSON(k)) + ` space ":" space ` + val
+			if required[k] {
+				req = append(req, kv)
+			} else {
+				opt = append(opt, kv)
+			}
+		}
+		c.prim("space")
+		return c.add(name, `"{" space `+objectBody(req, opt)+`"}" space`), nil
+	default:
+		return "", fmt.Errorf("grammar: unsupported type %q at %s", t, path)
+	}
+}
+
+// objectBody lays out required properties, then optional ones, each
+// optional property independently present or absent with commas placed
+// correctly.
+func objectBody(req, opt []string) string {
+	var sb strings.Builder
+	for i, kv := range req {
+		if i > 0 {
+			sb.WriteString(`"," space `)
+		}
+		sb.WriteString(kv + " ")
+	}
+	if len(req) > 0 {
+		for _, kv := range opt {
+			sb.WriteString(`( "," space ` + kv + ` )? `)
+		}
+		return sb.String()
+	}
+	if len(opt) == 0 {
+		return ""
+	}
+	// No required property: pick the first property present, then any of
+	// the ones after it.
+	alts := make([]string, len(opt))
+	for i, kv := range opt {
+		alt := kv
+		for _, next := range opt[i+1:] {
+			alt += ` ( "," space ` + next + ` )?`
+		}
+		alts[i] = alt
+	}
+	return "( " + strings.Join(alts, " | ") + " )? "
+}
+
+func (c *schemaConverter) ref(ref string) (string, error) {
+	if name, ok := c.refs[ref]; ok {
+		return name, nil
+	}
+	var defs map[string]any
+	var key string
+	switch {
+	case strings.HasPrefix(ref, "#/definitions/"):
+		defs, _ = c.root["definitions"].(map[string]any)
+		key = strings.TrimPrefix(ref, "#/definitions/")
+	case strings.HasPrefix(ref, "#/$defs/"):
+		defs, _ = c.root["$defs"].(map[string]any)
+		key = strings.TrimPrefix(ref, "#/$defs/")
+	default:
+		return "", fmt.Errorf("grammar: unsupported $ref %q", ref)
+	}
+	target, ok := defs[key].(map[string]any)
+	if !ok {
+		return "", fmt.Errorf("grammar: unresolved $ref %q", ref)
+	}
+
+	// Name the rule before visiting so recursive references resolve to it.
+	name := c.fresh(key)
+	c.refs[ref] = name
+	c.add(name, "")
+	body, err := c.visit(target, name)
+	if err != nil {
+		return "", err
+	}
+	c.add(name, body)
+	return name, nil
+}
+
+// literal returns an expression matching the JSON encoding of v.
+func (c *schemaConverter) literal(v any) (string, error) {
+	b, err := json.Marshal(v)
+	if err != nil {
+		return "", fmt.Errorf("grammar: invalid literal: %w", err)
+	}
+	return Quote(string(b)) + " " + c.prim("space"), nil
+}
+
+func (c *schemaConverter) render() string {
+	var sb strings.Builder
+	sb.WriteString("root ::= " + c.rules["root"] + "\n")
+	for _, name := range c.order {
+		if name != "root" {
+			sb.WriteString(name + " ::= " + c.rules[name] + "\n")
+		}
+	}
+	for _, p := range jsonPrimitives {
+		if c.prims[p.name] {
+			sb.WriteString(p.name + " ::= " + p.body + "\n")
+		}
+	}
+	return sb.String()
+}
+
+// propertyOrder returns the order properties are generated in: required
+// properties in their listed order, then the rest alphabetically. (The
+// decoded schema no longer knows the declaration order.)
+func propertyOrder(schema, props map[string]any) []string {
+	keys := make([]string, 0, len(props))
+	for k := range props {
+		keys = append(keys, k)
+	}
+	required := map[string]int{}
+	if req, ok := schema["required"].([]any); ok {
+		for i, r := range req {
+			if s, ok := r.(string); ok {
+				required[s] = i
+			}
+		}
+	}
+	sort.Slice(keys, func(i, j int) bool {
+		ri, iReq := required[keys[i]]
+		rj, jReq := required[keys[j]]
+		if iReq != jReq {
+			return iReq
+		}
+		if iReq {
+			return ri < rj
+		}
+		return keys[i] < keys[j]
+	})
+	return keys
+}
+
+func group(alts []string) string {
+	if len(alts) == 1 {
+		return alts[0]
+	}
+	return "( " + strings.Join(alts, " | ") + " )"
+}
+
+// repeat returns a GBNF repetition suffix for min..max occurrences; max < 0
+// means unbounded.
+func repeat(min, max int) string {
+	if max < 0 {
+		if min == 0 {
+			return "*"
+		}
+		return fmt.Sprintf("{%d,}", min)
+	}
+	return fmt.Sprintf("{%d,%d}", min, max)
+}
+
+func intKey(schema map[string]any, key string, def int) int {
+	if n, ok := schema[key].(json.Number); ok {
+		if v, err := n.Int64(); err == nil && v >= 0 {
+			return int(v)
+		}
+	}
+	return def
+}
+
+func mustJSON(s string) string {
+	b, _ := json.Marshal(s)
+	return string(b)
+}
+
+// ruleName turns a schema path into a valid GBNF rule name.
+func ruleName(s string) string {
+	var sb strings.Builder
+	for _, r := range s {
+		if r >= 'a' && r <= 'z' || r >= 'A' && r <= 'Z' || r >= '0' && r <= '9' || r == '-' {
+			sb.WriteRune(r)
+		} else {
+			sb.WriteByte('-')
+		}
+	}
+	if sb.Len() == 0 {
+		return "r"
+	}
+	return sb.String()
+}
+
+func isPrimitive(name string) bool {
+	for _, p := range jsonPrimitives {
+		if p.name == name {
+			return true
+		}
+	}
+	return false
+}
@@ -6,12 +6,15 @@ import (
 	"encoding/base64"
 	"fmt"
 	"image"
+	"image/color"
 	"image/jpeg"
 	"image/png"
 	"io"
 	"os"
 	"path/filepath"
+	"runtime"
 	"strings"
+	"sync"
 
 	"golang.org/x/image/bmp"
 	"golang.org/x/image/draw"
@@ -24,6 +27,10 @@ const (
 	FormatJPEG Format = "jpeg"
 	FormatPNG  Format = "png"
 	FormatBMP  Format = "bmp"
+	// FormatRGB is uncompressed 8-bit RGB, row by row (Width*Height*3
+	// bytes), for consumers that take pixels directly, such as the native
+	// vision encoder. It skips the encode/decode round trip.
+	FormatRGB Format = "rgb"
 )
 
 // InputType indicates how the image data is provided.
@@ -174,20 +181,30 @@ func (p *DefaultProcessor) Process(ctx context.Context, input string) (*Processe
 	return result, nil
 }
 
-// ProcessMultiple processes multiple images concurrently.
+// ProcessMultiple processes multiple images concurrently, at most
+// GOMAXPROCS at a time; results keep the order of inputs.
 func (p *DefaultProcessor) ProcessMultiple(ctx context.Context, inputs []string) ([]*ProcessedImage, error) {
 	results := make([]*ProcessedImage, len(inputs))
 	errs := make([]error, len(inputs))
 
+	sem := make(chan struct{}, runtime.GOMAXPROCS(0))
+	var wg sync.WaitGroup
 	for i, input := range inputs {
 		select {
 		case <-ctx.Done():
+			wg.Wait()
 			return nil, ctx.Err()
-		default:
+		case sem <- struct{}{}:
 		}
-		
-		results[i], errs[i] = p.Process(ctx, input)
+
+		wg.Add(1)
+		go func(i int, input string) {
+			defer wg.Done()
+			defer func() { <-sem }()
+			results[i], errs[i] = p.Process(ctx, input)
+		}(i, input)
 	}
+	wg.Wait()
 
 	// Collect errors
 	var errMsgs []string
@@ -440,6 +457,8 @@ func (p *DefaultProcessor) encode(img image.Image) ([]byte, error) {
 		if err != nil {
 			return nil, err
 		}
+	case FormatRGB:
+		return packRGB(img), nil
 	default:
 		return nil, fmt.Errorf("unsupported output format: %s", p.cfg.OutputFormat)
 	}
@@ -447,6 +466,40 @@ func (p *DefaultProcessor) encode(img image.Image) ([]byte, error) {
 	return buf.Bytes(), nil
 }
 
+// packRGB returns img's pixels as packed 8-bit RGB rows, dropping alpha.
+func packRGB(img image.Image) []byte {
+	b := img.Bounds()
+	w, h := b.Dx(), b.Dy()
+	out := make([]byte, 0, w*h*3)
+	if rgba, ok := img.(*image.RGBA); ok {
+		for y := b.Min.Y; y < b.Max.Y; y++ {
+			i := rgba.PixOffset(b.Min.X, y)
+			row := rgba.Pix[i : i+w*4]
+			for x := 0; x < len(row); x += 4 {
+				out = append(out, row[x], row[x+1], row[x+2])
+			}
+		}
+		return out
+	}
+	if ycc, ok := img.(*image.YCbCr); ok {
+		for y := b.Min.Y; y < b.Max.Y; y++ {
+			for x := b.Min.X; x < b.Max.X; x++ {
+				c := ycc.YCbCrAt(x, y)
+				r, g, bl := color.YCbCrToRGB(c.Y, c.Cb, c.Cr)
+				out = append(out, r, g, bl)
+			}
+		}
+		return out
+	}
+	for y := b.Min.Y; y < b.Max.Y; y++ {
+		for x := b.Min.X; x < b.Max.X; x++ {
+			r, g, bl, _ := img.At(x, y).RGBA()
+			out = append(out, byte(r>>8), byte(g>>8), byte(bl>>8))
+		}
+	}
+	return out
+}
+
 // MimeType returns the MIME type for the configured output format.
 func (p *DefaultProcessor) MimeType() string {
 	switch p.cfg.OutputFormat {
@@ -0,0 +1,185 @@
+package inferbench
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"time"
+
+	"OpenEye/internal/runtime"
+)
+
+// KVCacheSetting is one K/V cache type combination compared by SweepKVCache.
+// Types are ggml names as accepted by the native backend's kv_cache_type_k
+// and kv_cache_type_v settings.
+type KVCacheSetting struct {
+	TypeK string `json:"type_k"`
+	TypeV string `json:"type_v"`
+}
+
+// String renders the setting as "k" when both halves match, else "k/v".
+func (s KVCacheSetting) String() string {
+	if s.TypeK == s.TypeV {
+		return s.TypeK
+	}
+	return s.TypeK + "/" + s.TypeV
+}
+
+// DefaultKVSweep returns the cache types worth comparing on memory-bound
+// devices, from full precision down to 4-bit, plus the common split of
+// 8-bit keys with 4-bit values.
+func DefaultKVSweep() []KVCacheSetting {
+	return []KVCacheSetting{
+		{"f16", "f16"},
+		{"q8_0", "q8_0"},
+		{"q5_1", "q5_1"},
+		{"q5_0", "q5_0"},
+		{"iq4_nl", "iq4_nl"},
+		{"q4_0", "q4_0"},
+		{"q8_0", "q4_0"},
+	}
+}
+
+// ParseKVSweep parses a comma-separated list of settings, each either a
+// single type used for K and V ("q8_0") or a "k/v" pair ("q8_0/q4_0").
+// "default" selects DefaultKVSweep.
+func ParseKVSweep(spec string) ([]KVCacheSetting, error) {
+	spec = strings.TrimSpace(spec)
+	if strings.EqualFold(spec, "default") {
+		return DefaultKVSweep(), nil
+	}
+	var settings []KVCacheSetting
+	for _, item := range strings.Split(spec, ",") {
+		item = strings.ToLower(strings.TrimSpace(item))
+		if item == "" {
+			continue
+		}
+		k, v, split := strings.Cut(item, "/")
+		if !split {
+			v = k
+		}
+		if k == "" || v == "" {
+			return nil, fmt.Errorf("inferbench: invalid KV cache setting %q", item)
+		}
+		settings = append(settings, KVCacheSetting{TypeK: k, TypeV: v})
+	}
+	if len(settings) == 0 {
+		return nil, fmt.Errorf("inferbench: empty KV cache sweep")
+	}
+	return settings, nil
+}
+
+// KVCacheReporter is implemented by adapters that can report the size of
+// their KV cache (the native backend). Without it the sweep still reports
+// peak RSS.
+type KVCacheReporter interface {
+	KVCacheBytes() int64
+}
+
+// KVSweepResult is the outcome of benchmarking one KV cache setting.
+// Throughput and TTFT are means across prompts of the per-prompt medians.
+type KVSweepResult struct {
+	Setting       KVCacheSetting `json:"setting"`
+	KVCacheBytes  int64          `json:"kv_cache_bytes,omitempty"`
+	PeakRSSBytes  int64          `json:"peak_rss_bytes"`
+	PromptTPS     float64        `json:"prompt_tps"`
+	GenerationTPS float64        `json:"generation_tps"`
+	TTFT          time.Duration  `json:"ttft_ns"`
+	Error         string         `json:"error,omitempty"`
+}
+
+// SweepKVCache benchmarks each setting on a fresh adapter from newAdapter,
+// since cache types are fixed when the context is created, and prints a
+// comparison table. A setting whose adapter cannot be created (e.g. a
+// quantized V cache without flash attention) is reported with its error
+// and the sweep continues. When cfg.OutputPath is set the sweep results,
+// not the per-setting reports, are written there.
+func SweepKVCache(ctx context.Context, cfg Config, settings []KVCacheSetting,
+	newAdapter func(KVCacheSetting) (runtime.Adapter, error)) ([]KVSweepResult, error) {
+	outputPath := cfg.OutputPath
+	cfg.OutputPath = ""
+
+	results := make([]KVSweepResult, 0, len(settings))
+	for _, setting := range settings {
+		if err := ctx.Err(); err != nil {
+			return results, err
+		}
+		fmt.Printf("\n=== KV cache %s ===\n", setting)
+
+		adapter, err := newAdapter(setting)
+		if err != nil {
+			fmt.Printf("Skipping %s: %v\n", setting, err)
+			results = append(results, KVSweepResult{Setting: setting, Error: err.Error()})
+			continue
+		}
+		var kvBytes int64
+		if rep, ok := adapter.(KVCacheReporter); ok {
+			kvBytes = rep.KVCacheBytes()
+		}
+		report, err := NewRunner(adapter, cfg).Run(ctx)
+		adapter.Close()
+
+		res := sweepResult(setting, report, kvBytes)
+		if err != nil {
+			res.Error = err.Error()
+		}
+		results = append(results, res)
+	}
+
+	printKVSweep(results)
+	if outputPath != "" {
+		if err := saveJSON(results, outputPath); err != nil {
+			fmt.Printf("Warning: failed to save sweep results: %v\n", err)
+		} else {
+			fmt.Printf("\nResults saved to %s\n", outputPath)
+		}
+	}
+	return results, nil
+}
+
+// sweepResult condenses a benchmark report into one sweep row.
+func sweepResult(setting KVCacheSetting, report *BenchmarkReport, kvBytes int64) KVSweepResult {
+	res := KVSweepResult{Setting: setting, KVCacheBytes: kvBytes}
+	if report == nil {
+		return res
+	}
+	var promptTPS, genTPS []float64
+	var ttft []time.Duration
+	for _, s := range report.Summaries {
+		if s.PeakRSSBytes > res.PeakRSSBytes {
+			res.PeakRSSBytes = s.PeakRSSBytes
+		}
+		if s.PromptTPS.Median > 0 {
+			promptTPS = append(promptTPS, s.PromptTPS.Median)
+		}
+		if s.GenerationTPS.Median > 0 {
+			genTPS = append(genTPS, s.GenerationTPS.Median)
+		}
+		if s.TTFT.Median > 0 {
+			ttft = append(ttft, s.TTFT.Median)
+		}
+	}
+	res.PromptTPS = computeFloatStats(promptTPS).Mean
+	res.GenerationTPS = computeFloatStats(genTPS).Mean
+	res.TTFT = computeDurationStats(ttft).Mean
+	return res
+}
+
+// printKVSweep prints the sweep as a table.
+func printKVSweep(results []KVSweepResult) {
+	fmt.Printf("\n=== KV cache sweep ===\n")
+	fmt.Printf("%-16s %10s %10s %12s %10s %10s\n",
+		"K/V", "KV MB", "RSS MB", "prompt t/s", "gen t/s", "TTFT")
+	for _, r := range results {
+		if r.Error != "" && r.PromptTPS == 0 {
+			fmt.Printf("%-16s %s\n", r.Setting, r.Error)
+			continue
+		}
+		fmt.Printf("%-16s %10.1f %10.1f %12.1f %10.1f %10v\n",
+			r.Setting,
+			float64(r.KVCacheBytes)/(1024*1024),
+			float64(r.PeakRSSBytes)/(1024*1024),
+			r.PromptTPS, r.GenerationTPS,
+			r.TTFT.Round(time.Millisecond))
+	}
+}
@@ -40,15 +40,21 @@ type Config struct {
 	// When true, runOnce uses the streaming interface and captures
 	// inter-chunk latency and chunk count.
 	UseStream bool
+
+	// BatchOverheadIterations is the number of batch preparations timed by
+	// the batch-overhead micro-benchmark. 0 skips it. Only adapters that
+	// implement BatchOverheadProber are measured.
+	BatchOverheadIterations int
 }
 
 // DefaultConfig returns reasonable defaults for edge benchmarking.
 func DefaultConfig() Config {
 	return Config{
-		Iterations:       5,
-		MaxTokens:        128,
-		WarmupIterations: 1,
-		Verbose:          false,
+		Iterations:              5,
+		MaxTokens:               128,
+		WarmupIterations:        1,
+		Verbose:                 false,
+		BatchOverheadIterations: 10000,
 	}
 }
 
@@ -56,7 +62,8 @@ func DefaultConfig() Config {
 type Prompt struct {
 	Name   string // e.g. "short", "medium", "long", "cached"
 	Text   string
-	Repeat bool // if true, run the same prompt twice to test cache
+	Images []string // image paths, one per media marker in Text
+	Repeat bool     // if true, run the same prompt twice to test cache
 }
 
 // StandardPrompts returns a set of prompts that exercise different workloads.
@@ -82,6 +89,30 @@ func StandardPrompts() []Prompt {
 	}
 }
 
+// MediaMarker marks where an image goes in a prompt (mtmd's default).
+const MediaMarker = "<__media__>"
+
+// VisionPrompts returns a multimodal scenario for image: a chat whose
+// system prompt and earlier turns precede the image, run twice like
+// cache-test. The cold run starts from an empty KV cache; the repeat
+// shows how much the native backend reuses, namely the text before the
+// image from the prompt cache. After warmup both runs find the image's
+// embeddings in the embedding cache, so the difference isolates the text
+// prefix.
+func VisionPrompts(image string) []Prompt {
+	return []Prompt{
+		{
+			Name: "vision",
+			Text: "<|im_start|>system\nYou are a vision assistant running on a home camera. Describe what you see plainly, mention people, animals and vehicles first, and say so when something is unclear instead of guessing. Keep answers under three sentences unless asked for detail.<|im_end|>\n" +
+				"<|im_start|>user\nI'll send you frames from the front door camera. Just tell me what's going on.<|im_end|>\n" +
+				"<|im_start|>assistant\nUnderstood. Send a frame and I'll describe it.<|im_end|>\n" +
+				"<|im_start|>user\n" + MediaMarker + "\nWhat is in this frame?<|im_end|>\n<|im_start|>assistant\n",
+			Images: []string{image},
+			Repeat: true,
+		},
+	}
+}
+
 // IterationResult captures metrics from a single generation call.
 type IterationResult struct {
 	PromptName      string        `json:"prompt_name"`
@@ -118,6 +149,7 @@ type PromptSummary struct {
 	AvgTokensGen    float64       `json:"avg_tokens_generated"`
 	AvgTokensCached float64       `json:"avg_tokens_cached"`
 	CacheHitImprove float64       `json:"cache_hit_ttft_improvement_pct,omitempty"` // for Repeat prompts
+	RepeatTTFT      DurationStats `json:"repeat_prompt_ttft,omitempty"`             // for Repeat prompts: TTFT of the identical re-run
 	PeakRSSBytes    int64         `json:"peak_rss_bytes"`
 	Errors          int           `json:"errors"`
 
@@ -152,13 +184,34 @@ type FloatStats struct {
 	P95    float64 `json:"p95"`
 }
 
+// BatchOverheadProber is implemented by adapters that can time the fixed
+// cost of preparing a decode batch (the native backend). It lets the
+// runner report how much per-token overhead the persistent batch saves.
+type BatchOverheadProber interface {
+	ProbeBatchOverhead(nTokens, iterations int) (perCallAlloc, perCallArena time.Duration, err error)
+}
+
+// BatchOverheadResult reports the batch-preparation micro-benchmark for a
+// single-token (generation step) batch.
+type BatchOverheadResult struct {
+	Iterations    int           `json:"iterations"`
+	PerTokenAlloc time.Duration `json:"per_token_alloc_ns"`
+	PerTokenArena time.Duration `json:"per_token_arena_ns"`
+	PerTokenSaved time.Duration `json:"per_token_saved_ns"`
+
+	// DecodeSharePct is PerTokenSaved as a percentage of the mean
+	// per-token generation time measured by the prompt benchmarks.
+	DecodeSharePct float64 `json:"decode_share_pct,omitempty"`
+}
+
 // BenchmarkReport is the top-level result container.
 type BenchmarkReport struct {
-	Timestamp  time.Time         `json:"timestamp"`
-	Config     Config            `json:"config"`
-	SystemInfo string            `json:"system_info,omitempty"`
-	Summaries  []PromptSummary   `json:"summaries"`
-	Raw        []IterationResult `json:"raw_results,omitempty"`
+	Timestamp     time.Time            `json:"timestamp"`
+	Config        Config               `json:"config"`
+	SystemInfo    string               `json:"system_info,omitempty"`
+	Summaries     []PromptSummary      `json:"summaries"`
+	BatchOverhead *BatchOverheadResult `json:"batch_overhead,omitempty"`
+	Raw           []IterationResult    `json:"raw_results,omitempty"`
 }
 
 // Runner executes inference benchmarks against a runtime.Adapter.
@@ -205,6 +258,25 @@ func (r *Runner) Run(ctx context.Context) (*BenchmarkReport, error) {
 
 	report.Raw = allResults
 
+	// Batch-preparation micro-benchmark (native backend only).
+	if prober, ok := r.adapter.(BatchOverheadProber); ok && r.cfg.BatchOverheadIterations > 0 {
+		fmt.Printf("\n--- Micro-benchmark: batch overhead ---\n")
+		alloc, arena, err := prober.ProbeBatchOverhead(1, r.cfg.BatchOverheadIterations)
+		if err != nil {
+			fmt.Printf("Warning: batch overhead probe failed: %v\n", err)
+		} else {
+			res := &BatchOverheadResult{
+				Iterations:    r.cfg.BatchOverheadIterations,
+				PerTokenAlloc: alloc,
+				PerTokenArena: arena,
+				PerTokenSaved: alloc - arena,
+			}
+			res.DecodeSharePct = decodeSharePct(res.PerTokenSaved, report.Summaries)
+			report.BatchOverhead = res
+			printBatchOverhead(res)
+		}
+	}
+
 	// Save to file if configured.
 	if r.cfg.OutputPath != "" {
 		if err := saveReport(report, r.cfg.OutputPath); err != nil {
@@ -242,6 +314,14 @@ func (r *Runner) benchmarkPrompt(ctx context.Context, prompt Prompt) ([]Iteratio
 			fmt.Printf("  iteration %d/%d...\n", i+1, totalIter)
 		}
 
+		// Start every cache-test pair from an empty context; otherwise the
+		// "cold" run would hit the previous pair's cached prompt.
+		if prompt.Repeat {
+			if err := r.adapter.ClearContext(); err != nil {
+				fmt.Printf("Warning: clear context failed: %v\n", err)
+			}
+		}
+
 		res, err := r.runOnce(ctx, prompt, i)
 		if err != nil {
 			res.Error = err.Error()
@@ -272,6 +352,7 @@ func (r *Runner) runOnce(ctx context.Context, prompt Prompt, iteration int) (Ite
 
 	req := runtime.Request{
 		Prompt: prompt.Text,
+		Image:  prompt.Images,
 		Options: runtime.GenerationOptions{
 			MaxTokens: r.cfg.MaxTokens,
 		},
@@ -323,6 +404,7 @@ func (r *Runner) runOnceStream(ctx context.Context, prompt Prompt, iteration int
 
 	req := runtime.Request{
 		Prompt: prompt.Text,
+		Image:  prompt.Images,
 		Options: runtime.GenerationOptions{
 			MaxTokens: r.cfg.MaxTokens,
 		},
@@ -485,6 +567,7 @@ func summarize(prompt Prompt, results []IterationResult) PromptSummary {
 		validCached := filterValid(cached)
 		if len(validCached) > 0 && summary.TTFT.Mean > 0 {
 			cachedTTFT := computeDurationStats(extractDurations(validCached, func(r IterationResult) time.Duration { return r.TTFT }))
+			summary.RepeatTTFT = cachedTTFT
 			improvement := float64(summary.TTFT.Mean-cachedTTFT.Mean) / float64(summary.TTFT.Mean) * 100
 			summary.CacheHitImprove = math.Round(improvement*10) / 10
 		}
@@ -610,6 +693,25 @@ func percentileIndex(n, pct int) int {
 	return idx
 }
 
+// decodeSharePct expresses saved as a percentage of the mean per-token
+// generation time across summaries. Returns 0 when no generation
+// throughput was measured.
+func decodeSharePct(saved time.Duration, summaries []PromptSummary) float64 {
+	var sum float64
+	var n int
+	for _, s := range summaries {
+		if s.GenerationTPS.Mean > 0 {
+			sum += s.GenerationTPS.Mean
+			n++
+		}
+	}
+	if n == 0 || saved <= 0 {
+		return 0
+	}
+	perToken := time.Duration(float64(time.Second) / (sum / float64(n)))
+	return float64(saved) / float64(perToken) * 100
+}
+
 // ---------------------------------------------------------------------------
 // Output
 // ---------------------------------------------------------------------------
@@ -632,6 +734,12 @@ func printSummary(s PromptSummary) {
 	if s.PeakRSSBytes > 0 {
 		fmt.Printf("  RSS:       peak=%.1f MB\n", float64(s.PeakRSSBytes)/(1024*1024))
 	}
+	if s.RepeatTTFT.Mean > 0 {
+		fmt.Printf("  Repeat:    TTFT min=%v  avg=%v  p95=%v\n",
+			s.RepeatTTFT.Min.Round(time.Millisecond),
+			s.RepeatTTFT.Mean.Round(time.Millisecond),
+			s.RepeatTTFT.P95.Round(time.Millisecond))
+	}
 	if s.CacheHitImprove != 0 {
 		fmt.Printf("  Cache:     TTFT improvement=%.1f%%\n", s.CacheHitImprove)
 	}
@@ -652,8 +760,21 @@ func printSummary(s PromptSummary) {
 	}
 }
 
+func printBatchOverhead(r *BatchOverheadResult) {
+	fmt.Printf("  Per token: alloc=%v  arena=%v  saved=%v\n",
+		r.PerTokenAlloc, r.PerTokenArena, r.PerTokenSaved)
+	if r.DecodeSharePct > 0 {
+		fmt.Printf("  Saved:     %.2f%% of per-token decode time\n", r.DecodeSharePct)
+	}
+}
+
 func saveReport(report *BenchmarkReport, path string) error {
-	data, err := json.MarshalIndent(report, "", "  ")
+	return saveJSON(report, path)
+}
+
+// saveJSON writes v as indented JSON to path, creating parent directories.
+func saveJSON(v any, path string) error {
+	data, err := json.MarshalIndent(v, "", "  ")
 	if err != nil {
 		return err
 	}
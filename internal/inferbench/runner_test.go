@@ -1,6 +1,7 @@
 package inferbench
 
 import (
+	"strings"
 	"testing"
 	"time"
 )
@@ -241,4 +242,90 @@ func TestSummarizeCacheTest(t *testing.T) {
 	if summary.CacheHitImprove != 75.0 {
 		t.Errorf("CacheHitImprove = %f, want 75.0", summary.CacheHitImprove)
 	}
+	if summary.RepeatTTFT.Mean != 50*time.Millisecond {
+		t.Errorf("RepeatTTFT.Mean = %v, want 50ms", summary.RepeatTTFT.Mean)
+	}
+}
+
+func TestDecodeSharePct(t *testing.T) {
+	t.Run("no throughput", func(t *testing.T) {
+		if got := decodeSharePct(time.Microsecond, nil); got != 0 {
+			t.Errorf("decodeSharePct = %f, want 0", got)
+		}
+	})
+
+	t.Run("averages generation TPS", func(t *testing.T) {
+		summaries := []PromptSummary{
+			{GenerationTPS: FloatStats{Mean: 50}},
+			{GenerationTPS: FloatStats{Mean: 150}},
+			{GenerationTPS: FloatStats{Mean: 0}}, // ignored
+		}
+		// Mean 100 tok/s = 10ms per token; 100us saved = 1%.
+		got := decodeSharePct(100*time.Microsecond, summaries)
+		if got < 0.99 || got > 1.01 {
+			t.Errorf("decodeSharePct = %f, want ~1.0", got)
+		}
+	})
+}
+
+func TestParseKVSweep(t *testing.T) {
+	got, err := ParseKVSweep(" q8_0, Q8_0/q4_0 ,iq4_nl ")
+	if err != nil {
+		t.Fatalf("ParseKVSweep: %v", err)
+	}
+	want := []KVCacheSetting{{"q8_0", "q8_0"}, {"q8_0", "q4_0"}, {"iq4_nl", "iq4_nl"}}
+	if len(got) != len(want) {
+		t.Fatalf("ParseKVSweep = %v, want %v", got, want)
+	}
+	for i := range want {
+		if got[i] != want[i] {
+			t.Errorf("setting %d = %v, want %v", i, got[i], want[i])
+		}
+	}
+	if got[1].String() != "q8_0/q4_0" || got[0].String() != "q8_0" {
+		t.Errorf("String() = %q, %q", got[0].String(), got[1].String())
+	}
+
+	if def, err := ParseKVSweep("default"); err != nil || len(def) != len(DefaultKVSweep()) {
+		t.Errorf("ParseKVSweep(default) = %v, %v", def, err)
+	}
+	for _, bad := range []string{"", " , ", "q8_0/"} {
+		if _, err := ParseKVSweep(bad); err == nil {
+			t.Errorf("ParseKVSweep(%q) should fail", bad)
+		}
+	}
+}
+
+func TestSweepResult(t *testing.T) {
+	report := &BenchmarkReport{Summaries: []PromptSummary{
+		{PromptTPS: FloatStats{Median: 100}, GenerationTPS: FloatStats{Median: 20},
+			TTFT: DurationStats{Median: 100 * time.Millisecond}, PeakRSSBytes: 300},
+		{PromptTPS: FloatStats{Median: 300}, GenerationTPS: FloatStats{Median: 30},
+			TTFT: DurationStats{Median: 300 * time.Millisecond}, PeakRSSBytes: 500},
+		{}, // failed prompt: ignored
+	}}
+	res := sweepResult(KVCacheSetting{"q8_0", "q4_0"}, report, 1<<20)
+	if res.PromptTPS != 200 || res.GenerationTPS != 25 {
+		t.Errorf("TPS = %f/%f, want 200/25", res.PromptTPS, res.GenerationTPS)
+	}
+	if res.TTFT != 200*time.Millisecond {
+		t.Errorf("TTFT = %v, want 200ms", res.TTFT)
+	}
+	if res.PeakRSSBytes != 500 || res.KVCacheBytes != 1<<20 {
+		t.Errorf("memory = %d RSS, %d KV", res.PeakRSSBytes, res.KVCacheBytes)
+	}
+}
+
+func TestVisionPrompts(t *testing.T) {
+	for _, p := range VisionPrompts("frame.jpg") {
+		if got := strings.Count(p.Text, MediaMarker); got != len(p.Images) {
+			t.Errorf("%s: %d media markers for %d images", p.Name, got, len(p.Images))
+		}
+		if i := strings.Index(p.Text, MediaMarker); i < len(p.Text)/2 {
+			t.Errorf("%s: image at %d; the text prefix before it should dominate the prompt", p.Name, i)
+		}
+		if !p.Repeat {
+			t.Errorf("%s: should repeat to measure prefix reuse", p.Name)
+		}
+	}
 }
@@ -8,6 +8,7 @@ import (
 	"unicode"
 
 	"OpenEye/internal/config"
+	"OpenEye/internal/grammar"
 	"OpenEye/internal/runtime"
 )
 
@@ -74,6 +75,7 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 		Stream:        false,
 		CachePrompt:   true,
 		Stop:          options.Stop,
+		Grammar:       options.Grammar,
 	}
 
 	// If images are provided, use the multimodal prompt format
@@ -90,9 +92,13 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 	if err != nil {
 		return runtime.Response{}, err
 	}
+	text := resp.Content
+	if len(options.Choices) > 0 {
+		text = strings.TrimSpace(text)
+	}
 
 	return runtime.Response{
-		Text: resp.Content,
+		Text: text,
 		Stats: runtime.Stats{
 			TokensCached:    resp.TokensCached,
 			TokensEvaluated: resp.TokensEvaluated,
@@ -117,6 +123,7 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 		Stream:        true, // Request streaming
 		CachePrompt:   true,
 		Stop:          options.Stop,
+		Grammar:       options.Grammar,
 	}
 
 	// Handle multimodal prompts
@@ -198,6 +205,15 @@ func mergeOptions(base, override runtime.GenerationOptions) runtime.GenerationOp
 	if len(override.Stop) > 0 {
 		result.Stop = append([]string(nil), override.Stop...)
 	}
+	if override.Grammar != "" {
+		result.Grammar = override.Grammar
+	}
+	if len(override.Choices) > 0 {
+		// The server has no classification mode; constrain to the labels.
+		result.Choices = override.Choices
+		result.Grammar = "root ::= \" \"? " + grammar.Enum(override.Choices...) + "\n"
+		result.Stop = nil
+	}
 
 	return result
 }
@@ -32,6 +32,7 @@ type CompletionRequest struct {
 	Stream        bool     `json:"stream"`
 	Stop          []string `json:"stop,omitempty"`
 	CachePrompt   bool     `json:"cache_prompt"`
+	Grammar       string   `json:"grammar,omitempty"`
 }
 
 type CompletionResponse struct {
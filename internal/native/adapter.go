@@ -6,8 +6,11 @@ import (
 	"context"
 	"fmt"
 	"log"
+	"math"
+	"os"
 	"strings"
 	"sync"
+	"sync/atomic"
 	"time"
 
 	"OpenEye/internal/config"
@@ -22,30 +25,71 @@ type Adapter struct {
 	ctx    *Context
 	vision *VisionContext // nil if no mmproj configured
 	cfg    config.RuntimeConfig
-	mu     sync.Mutex
+	mu     sync.RWMutex // write-held by the serial path, read-held by parallel slots
 
 	// Prompt caching: store the last prompt's token sequence so we can
 	// reuse the KV cache prefix on the next request. On edge devices this
 	// eliminates redundant re-evaluation of system prompt + shared history,
 	// dramatically reducing time-to-first-token (TTFT).
 	lastPromptTokens []int32
+	shiftKeep        int32 // leading tokens context shifts preserve (system prompt span)
 
 	// Sampler reuse: avoid per-request allocation of CGo sampler chains.
-	// The sampler is rebuilt only when sampling parameters change; between
-	// identical requests we just Reset() the penalty history.
-	sampler     *SamplerChain
-	samplerOpts SamplerOptions
+	// Requests check a chain for their parameters out of the pool and
+	// return it when done; a reused chain only has its history Reset().
+	samplers *samplerPool
 
 	// Speculative decoding: a smaller "draft" model generates candidate tokens
 	// that the target model verifies in batch. When verification passes, we
 	// accept multiple tokens per decode step, yielding 1.5-2.5x throughput.
 	draftModel   *Model
 	draftCtx     *Context
-	speculativeN int // number of draft tokens to generate before verification
+	speculativeN int       // number of draft tokens to generate before verification
+	draftProbs   []float32 // grow-only scratch: one draft distribution row per draft token
+	draftCtl     *draftController
+
+	// Prompt-lookup speculation (speculative_mode: ngram): drafts are
+	// copied from earlier occurrences of the latest n-gram in the prompt
+	// and output instead of coming from a draft model.
+	ngramSpec bool
 
 	// Batch size limits for safety checks
 	draftBatchSize  uint32
 	targetBatchSize uint32
+
+	// Continuous batching: with parallel_slots > 1, short text-only
+	// requests run concurrently on their own KV sequences and share one
+	// batched decode per step through sched. seq0Evicted is set when the
+	// scheduler reclaimed sequence 0's cells; seq0Stale when ClearContext
+	// was requested without taking the lock. The serial path resets
+	// sequence 0 on entry in either case.
+	sched       *batchScheduler
+	seq0Evicted atomic.Bool
+	seq0Stale   atomic.Bool
+
+	// KV sequences reserved for Score (score_sequences), starting at
+	// scoreSeqBase. With none reserved, candidates are scored one at a
+	// time on sequence 0.
+	scoreSeqBase int32
+	scoreSeqs    int32
+
+	// Prompt-prefix snapshots (prompt_cache_dir): the first stable prefix
+	// shared by two consecutive prompts — normally the system prompt — is
+	// saved to disk and restored at startup. While pinnedPrefix is set,
+	// sequence 0 is reset to it between requests instead of being emptied.
+	snapshotDir  string
+	snapshotKey  string
+	pinnedPrefix []int32
+	pinnedPath   string
+	prevPrompt   []int32
+
+	// Multi-entry prefix cache (prefix_cache_mb): serialized sequence-0
+	// states of recent prompts, so a request can resume from the longest
+	// cached prefix even when the live KV belongs to a different prompt.
+	// pendingPromptState is a prompt whose state is saved after generation
+	// (see cachePromptState).
+	prefixCache        *prefixCache
+	pendingPromptState []int32
 }
 
 // newNativeAdapter constructs a native adapter from configuration.
@@ -60,7 +104,8 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 	// Initialize the backend (idempotent, but we call it here to be safe).
 	BackendInit()
 
-	// Load model.
+	// Load model, sharing the weights with other roles that use the same
+	// file (see modelRegistry).
 	modelOpts := DefaultModelOptions()
 	modelOpts.NGPULayers = int32(nc.GPULayers)
 	if nc.Mmap != nil {
@@ -107,16 +152,46 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 		}
 	}
 
-	// KV cache quantization: map config string to type enum.
-	if nc.KVCacheType != "" {
-		kvType := kvCacheTypeFromString(nc.KVCacheType)
-		ctxOpts.TypeK = kvType
-		ctxOpts.TypeV = kvType
-		if kvType > 0 {
-			log.Printf("native: KV cache quantization set to %s (saves ~%.0f%% KV memory)",
-				nc.KVCacheType, float64(kvType)*37.5) // q8_0≈37%, q4_0≈75%
-		}
+	// KV cache types: kv_cache_type sets both, the per-side settings
+	// override it.
+	knownType := func(name string) bool { return cGgmlTypeFromName(name) >= 0 }
+	ctxOpts.TypeK = kvCacheTypeOrDefault(firstNonEmpty(nc.KVCacheTypeK, nc.KVCacheType), knownType)
+	ctxOpts.TypeV = kvCacheTypeOrDefault(firstNonEmpty(nc.KVCacheTypeV, nc.KVCacheType), knownType)
+	if kvTypeQuantized(ctxOpts.TypeV) && ctxOpts.FlashAttn == 0 {
+		log.Printf("native: warning: quantized V cache (%s) requires flash attention, which is disabled", ctxOpts.TypeV)
+	}
+
+	// Speculative decoding (prompt lookup or a draft model) drops rejected
+	// drafts by cutting the KV cache back, which recurrent and hybrid
+	// memory cannot do.
+	ngramSpec, useDraft := speculationModes(nc.SpeculativeMode, nc.DraftModelPath, info.Recurrent)
+	if info.Recurrent && (nc.DraftModelPath != "" || strings.TrimSpace(nc.SpeculativeMode) != "") {
+		log.Printf("native: speculative decoding disabled — %s has recurrent memory", info.Description)
+	}
+
+	// KV sequences: 0 for the serial path, one per slot for continuous
+	// batching, then score_sequences for continuation scoring. Speculative
+	// decoding does not run on parallel slots. Extra sequences are only
+	// reserved when configured: recurrent and hybrid memory allocates a
+	// state per sequence.
+	parallelSlots := nc.ParallelSlots
+	if parallelSlots > 1 && useDraft {
+		log.Printf("native: parallel_slots ignored — not supported together with speculative decoding")
+		parallelSlots = 0
+	}
+	scoreSeqBase := int32(1)
+	if parallelSlots > 1 {
+		scoreSeqBase += int32(parallelSlots)
+	}
+	nSeqs := scoreSeqBase
+	var scoreSeqs int32
+	if nc.ScoreSequences > 0 {
+		scoreSeqs = int32(nc.ScoreSequences)
+		nSeqs += scoreSeqs
+	} else {
+		scoreSeqBase = 0
 	}
+	ctxOpts.NSeqMax = uint32(nSeqs)
 
 	llCtx, err := NewContext(model, ctxOpts)
 	if err != nil {
@@ -161,18 +236,30 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 
 	log.Printf("native: model loaded — %s, %d params, ctx=%d, batch=%d, threads=%d",
 		info.Description, info.NParams, ctxOpts.NCtx, ctxOpts.NBatch, ctxOpts.NThreads)
+	kBytes, vBytes := llCtx.KVCacheBytes()
+	log.Printf("native: KV cache K=%s V=%s, ~%.1f MB",
+		firstNonEmpty(ctxOpts.TypeK, "f16"), firstNonEmpty(ctxOpts.TypeV, "f16"),
+		float64(kBytes+vBytes)/(1024*1024))
 
 	// Initialize vision (multimodal) if an mmproj path is configured.
 	var vision *VisionContext
 	if nc.MmprojPath != "" {
+		cacheMB := nc.VisionCacheMB
+		switch {
+		case cacheMB == 0:
+			cacheMB = 64
+		case cacheMB < 0:
+			cacheMB = 0
+		}
 		var visionErr error
-		vision, visionErr = NewVisionContext(nc.MmprojPath, model, int(ctxOpts.NThreads), nc.GPULayers > 0)
+		vision, visionErr = NewVisionContext(nc.MmprojPath, model, int(ctxOpts.NThreads), nc.GPULayers > 0,
+			int64(cacheMB)<<20)
 		if visionErr != nil {
 			llCtx.Close()
 			model.Close()
 			return nil, fmt.Errorf("native: %w", visionErr)
 		}
-		log.Printf("native: vision enabled via mmproj")
+		log.Printf("native: vision enabled via mmproj (embedding cache %d MB)", cacheMB)
 	}
 
 	// Speculative decoding: load a smaller draft model if configured.
@@ -192,7 +279,14 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 	}
 	var draftBatchSize uint32 = 512
 
-	if nc.DraftModelPath != "" {
+	if ngramSpec {
+		if nc.DraftModelPath != "" {
+			log.Printf("native: speculative_mode ngram — ignoring draft_model_path")
+		}
+		log.Printf("native: prompt-lookup speculative decoding enabled — N=%d", specN)
+	}
+
+	if useDraft {
 		draftOpts := DefaultModelOptions()
 		draftOpts.NGPULayers = int32(nc.GPULayers)
 		if nc.Mmap != nil {
@@ -240,7 +334,7 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 			draftInfo.Description, draftInfo.NParams, specN)
 	}
 
-	return &Adapter{
+	a := &Adapter{
 		model:           model,
 		ctx:             llCtx,
 		vision:          vision,
@@ -248,9 +342,44 @@ func newNativeAdapter(cfg config.RuntimeConfig) (runtime.Adapter, error) {
 		draftModel:      draftModel,
 		draftCtx:        draftCtx,
 		speculativeN:    specN,
+		draftCtl:        newDraftController(specN),
+		ngramSpec:       ngramSpec,
 		draftBatchSize:  draftBatchSize,
 		targetBatchSize: targetBatchSize,
-	}, nil
+		scoreSeqBase:    scoreSeqBase,
+		scoreSeqs:       scoreSeqs,
+	}
+	// Idle chains: one per slot plus a few parameter sets for the serial
+	// path (chat, extraction, summaries).
+	a.samplers = newSamplerPool(parallelSlots+4, model.NewSamplerChain)
+
+	if parallelSlots > 1 {
+		a.sched = newBatchScheduler(llCtx, parallelSlots, int(ctxOpts.NCtx), int(targetBatchSize), func() {
+			// Out of KV cells: drop the serial path's sequence too. Only
+			// called while slots hold the read lock, so sequence 0 is idle.
+			llCtx.SeqRemove(0, 0, -1)
+			a.seq0Evicted.Store(true)
+		})
+		log.Printf("native: continuous batching enabled — %d parallel slots, %d tokens per slot",
+			parallelSlots, a.sched.slotBudget)
+	}
+
+	if nc.PrefixCacheMB > 0 {
+		a.prefixCache = newPrefixCache(int64(nc.PrefixCacheMB) << 20)
+		log.Printf("native: prompt prefix cache enabled — %d MB budget", nc.PrefixCacheMB)
+	}
+
+	if nc.PromptCacheDir != "" {
+		if err := os.MkdirAll(nc.PromptCacheDir, 0755); err != nil {
+			log.Printf("native: prompt cache dir unavailable, snapshots disabled: %v", err)
+		} else {
+			a.snapshotDir = nc.PromptCacheDir
+			a.snapshotKey = snapshotModelKey(info.Description, info.NParams, ctxOpts.NCtx, ctxOpts.TypeK, ctxOpts.TypeV)
+			a.loadPromptSnapshot()
+		}
+	}
+
+	return a, nil
 }
 
 // Name returns the adapter identifier.
@@ -258,23 +387,36 @@ func (a *Adapter) Name() string { return "native" }
 
 // Generate performs a blocking completion, returning the full response.
 func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Response, error) {
+	opts := mergeNativeOptions(a.cfg.Defaults, req.Options)
+
+	// Continuous batching: short text-only requests run on a parallel slot
+	// under the read lock, concurrently with other such requests.
+	if tokens, maxTokens, ok := a.parallelRequest(req, opts); ok {
+		defer a.mu.RUnlock()
+		text, stats, finish, err := a.generateParallel(ctx, tokens, opts, maxTokens, nil)
+		return runtime.Response{Text: text, Stats: stats, Finish: finish}, err
+	}
+
 	a.mu.Lock()
 	defer a.mu.Unlock()
+	defer a.flushPromptState()
+	a.reclaimSerial()
+	span := a.beginPerf()
 
-	opts := mergeNativeOptions(a.cfg.Defaults, req.Options)
+	// Classification among fixed labels is one restricted draw when the
+	// labels differ in their first token, else a scoring pass over all of
+	// them (text only; image prompts fall back to a grammar).
+	choice := a.planChoices(&opts, !req.HasImages())
+	if choice == nil && len(opts.Choices) > 0 && !req.HasImages() {
+		return a.chooseByScore(req.Prompt, opts.Choices, span)
+	}
 
 	// Get or reuse sampler chain for this request's parameters.
-	sampler := a.getOrBuildSampler(SamplerOptions{
-		Temperature:      float32(opts.Temperature),
-		TopK:             int32(opts.TopK),
-		TopP:             float32(opts.TopP),
-		MinP:             float32(opts.MinP),
-		RepeatPenalty:    float32(opts.RepeatPenalty),
-		RepeatLastN:      int32(opts.RepeatLastN),
-		FrequencyPenalty: 0.0,
-		PresencePenalty:  0.0,
-		Seed:             0xFFFFFFFF,
-	})
+	sampler, releaseSampler, err := a.requestSampler(opts, choice)
+	if err != nil {
+		return runtime.Response{}, err
+	}
+	defer releaseSampler()
 
 	// Reset performance counters.
 	a.ctx.PerfReset()
@@ -285,31 +427,20 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 	var maxTokens int
 
 	// --- Vision path: images present and vision context available ---
-	if len(req.Image) > 0 && a.vision != nil {
-		// Clear KV cache — prompt caching doesn't work with vision requests
-		// because the KV layout includes image embeddings that differ each time.
-		a.ctx.ClearKV()
-		a.lastPromptTokens = nil
-
-		batchSize := int32(a.cfg.Native.BatchSize)
-		if batchSize <= 0 {
-			batchSize = 512
-		}
-
-		newPos, visionErr := a.vision.EvalWithImages(a.ctx, req.Prompt, req.Image, batchSize)
+	if req.HasImages() && a.vision != nil {
+		// The text before the first image reuses the prompt cache; the
+		// images and what follows them are evaluated fresh.
+		var visionErr error
+		promptTokenCount, prefixLen, visionErr = a.evalVisionPrompt(req, &span)
 		if visionErr != nil {
 			return runtime.Response{}, fmt.Errorf("native: vision eval: %w", visionErr)
 		}
 
-		// Synchronize the context's position with where vision eval left off.
-		a.ctx.SetPos(newPos)
-		promptTokenCount = int(newPos) // approximate: vision tokens + text tokens
-
 	} else {
 		// --- Standard text-only path ---
 
 		// Resolve max tokens for generation EARLY so we can use it for space planning
-		maxTokens := opts.MaxTokens
+		maxTokens = opts.MaxTokens
 		if maxTokens <= 0 {
 			maxTokens = 512
 		}
@@ -320,40 +451,31 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 			return runtime.Response{}, fmt.Errorf("native: tokenize: %w", err)
 		}
 		promptTokenCount = len(tokens)
+		a.shiftKeep = a.shiftKeepSpan(tokens)
 
 		// Prompt caching: find the longest common prefix with the last prompt.
 		// Reuse cached KV entries and only evaluate the new suffix tokens.
 		prefixLen = commonPrefixLen(a.lastPromptTokens, tokens)
-		if prefixLen > 0 && prefixLen < len(tokens) {
-			// Partial cache hit: keep the shared prefix, discard diverging suffix
-			// and any generated tokens beyond the prompt.
-			a.ctx.TruncateKV(int32(prefixLen))
-			// Also truncate draft model to maintain sync during speculative decoding
-			if a.draftCtx != nil {
-				a.draftCtx.TruncateKV(int32(prefixLen))
-			}
-		} else if prefixLen == len(tokens) {
-			// Full cache hit: identical prompt. The KV cache contains the prompt
-			// tokens plus generated tokens from the previous call. We cannot
-			// safely truncate and re-use because the generated tokens have
-			// altered the KV state at positions beyond the prompt. Clear
-			// everything and re-evaluate from scratch.
-			a.ctx.ClearKV()
-			// Also clear draft model to maintain sync
-			if a.draftCtx != nil {
-				a.draftCtx.ClearKV()
-			}
-			prefixLen = 0
-		} else {
-			a.ctx.ClearKV()
-			// Also clear draft model to maintain sync
-			if a.draftCtx != nil {
-				a.draftCtx.ClearKV()
-			}
+		prefixLen = a.restoreCachedPrefix(tokens, prefixLen)
+		if prefixLen == len(tokens) {
+			// Full cache hit: identical prompt. With causal attention the KV
+			// entries of the prompt positions do not depend on the tokens
+			// generated after them, so keep all but the last prompt token and
+			// re-evaluate that one to get fresh logits. Recurrent and hybrid
+			// memory cannot be cut back; truncateSeq0 then starts over.
+			prefixLen--
 		}
+		// Partial cache hit: keep the shared prefix, discard diverging suffix
+		// and any generated tokens beyond the prompt (in the draft model too,
+		// to keep speculative decoding in sync).
+		prefixLen = a.truncateSeq0(prefixLen)
 
-		// Evaluate only the new tokens (from prefixLen onwards).
-		newTokens := tokens[prefixLen:]
+		// Persist the stable prompt prefix the first time it is seen.
+		evalFrom := a.snapshotStablePrefix(tokens, prefixLen)
+
+		// Evaluate only the new tokens (from evalFrom onwards).
+		newTokens := tokens[evalFrom:]
+		a.lastPromptTokens = append(make([]int32, 0, len(tokens)), tokens[:evalFrom]...)
 		if len(newTokens) > 0 {
 			// Ensure we have space BEFORE evaluating (prevents crashes)
 			a.ensureContextSpace(len(newTokens), maxTokens)
@@ -366,13 +488,24 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 			}
 		}
 
-		// Store tokens for prompt caching on next call.
-		a.lastPromptTokens = make([]int32, len(tokens))
-		copy(a.lastPromptTokens, tokens)
+		// Store the cached tokens for prompt caching on next call. A context
+		// shift during evaluation moved lastPromptTokens along with the
+		// cache; a recovery that lost track of the cache contents left it
+		// nil or out of step with the position.
+		if a.lastPromptTokens != nil && len(a.lastPromptTokens)+len(newTokens) == int(a.ctx.Pos()) {
+			a.lastPromptTokens = append(a.lastPromptTokens, newTokens...)
+			a.cachePromptState(a.lastPromptTokens)
+		} else {
+			a.lastPromptTokens = nil
+		}
 
 		// Sync draft model with prompt tokens for speculative decoding.
 		if a.draftModel != nil {
-			if err := a.syncDraftPrompt(tokens); err != nil {
+			draftTokens := a.lastPromptTokens
+			if draftTokens == nil {
+				draftTokens = tokens
+			}
+			if err := a.syncDraftPrompt(draftTokens); err != nil {
 				log.Printf("native: draft model sync failed, falling back to standard generation: %v", err)
 			}
 		}
@@ -380,7 +513,7 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 
 	// maxTokens already resolved above for text path, only resolve here for vision path
 	// Check if we're in vision mode (promptTokenCount was set via vision path)
-	if promptTokenCount > 0 && len(req.Image) > 0 {
+	if promptTokenCount > 0 && req.HasImages() {
 		maxTokens = opts.MaxTokens
 		if maxTokens <= 0 {
 			maxTokens = 512
@@ -415,10 +548,31 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 	finishReason := "length" // default: loop exhausted max tokens
 	ring := newStopRing(opts.Stop)
 
-	// Speculative decoding: if a draft model is loaded and not in vision mode,
-	// use the speculative path for faster generation.
-	useSpeculative := a.draftModel != nil && a.draftCtx != nil && len(req.Image) == 0
-	var specDrafted, specAccepted int // accumulators for speculative stats
+	// Speculative decoding: if a draft model is loaded or prompt lookup is
+	// enabled, and not in vision mode, use the speculative path for faster
+	// generation.
+	// Draft tokens are verified against the target distribution without the
+	// grammar, so grammar-constrained requests decode normally.
+	useSpeculative := !req.HasImages() && opts.Grammar == "" && choice == nil &&
+		(a.ngramSpec || (a.draftModel != nil && a.draftCtx != nil))
+	var draftSampler *SamplerChain
+	var specDraftN []int
+	var specHistory []int32 // prompt + generated tokens, for prompt lookup
+	if useSpeculative && a.ngramSpec {
+		specHistory = append([]int32(nil), a.lastPromptTokens...)
+	} else if useSpeculative {
+		draftOpts := draftSamplerOptions(samplerOptionsFor(opts))
+		if ds, err := a.samplers.get(draftOpts); err == nil {
+			draftSampler = ds
+			defer a.samplers.put(draftOpts, ds)
+			a.draftCtl.begin()
+		} else {
+			useSpeculative = false
+		}
+	}
+	var specDrafted, specAccepted int   // accumulators for speculative stats
+	var specLookups, specLookupHits int // prompt-lookup rounds and hits
+	var lastToken int32 = -1
 
 	for i := 0; i < maxTokens; {
 		// Check for cancellation.
@@ -441,16 +595,32 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 
 		if useSpeculative {
 			// --- Speculative decoding path ---
-			specResult, err := a.speculativeGenerate(sampler)
+			var specResult speculativeResult
+			var err error
+			if a.ngramSpec {
+				specResult, err = a.ngramGenerate(sampler, specHistory)
+			} else {
+				specResult, err = a.speculativeGenerate(sampler, draftSampler)
+			}
 			if err != nil {
 				// Silent fallback: if speculative fails, try standard generation once
 				log.Printf("native: speculative generation failed, falling back: %v", err)
 				useSpeculative = false
 				continue
 			}
+			if a.ngramSpec {
+				specHistory = append(specHistory, specResult.tokens...)
+				specLookups++
+				if specResult.drafted > 0 {
+					specLookupHits++
+				}
+			}
 
 			// Accumulate speculative decoding stats.
 			specDrafted += specResult.drafted
+			if specResult.draftN > 0 {
+				specDraftN = append(specDraftN, specResult.draftN)
+			}
 			specAccepted += specResult.accepted
 
 			// Record TTFT on the first generated token.
@@ -494,39 +664,43 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 			a.maybeShiftContext()
 
 		} else {
-			// --- Standard single-token path ---
-			token, err := a.ctx.SampleToken(sampler)
-			if err != nil {
-				a.lastPromptTokens = nil
-				return runtime.Response{}, fmt.Errorf("native: sample: %w", err)
+			// --- Standard path: fused native sample/decode steps ---
+			steps := a.fusedSteps(maxTokens-i, len(opts.Stop) > 0)
+			if tokensGenerated == 0 {
+				steps = 1 // keep TTFT a single-token measurement
 			}
+			step, err := a.ctx.GenerateStep(sampler, steps, true)
 
 			if tokensGenerated == 0 {
 				ttft = time.Since(startTime)
 			}
-
-			if a.model.TokenIsEOG(token) {
-				finishReason = "stop"
-				break
+			if len(step.Tokens) > 0 {
+				lastToken = step.Tokens[len(step.Tokens)-1]
 			}
 
-			piece := a.model.TokenToPiece(token)
-			result.WriteString(piece)
-			tokensGenerated++
-			i++
-
-			if ring != nil {
-				ring.write(piece)
-				if ring.check() {
-					trimmed := trimAtStop(result.String(), opts.Stop)
-					result.Reset()
-					result.WriteString(trimmed)
-					finishReason = "stop"
-					break
+			hitStop := false
+			for _, piece := range step.Pieces {
+				result.WriteString(piece)
+				tokensGenerated++
+				i++
+
+				if ring != nil {
+					ring.write(piece)
+					if ring.check() {
+						trimmed := trimAtStop(result.String(), opts.Stop)
+						result.Reset()
+						result.WriteString(trimmed)
+						hitStop = true
+						break
+					}
 				}
 			}
+			if hitStop || step.EOG {
+				finishReason = "stop"
+				break
+			}
 
-			if err := a.ctx.EvalToken(token); err != nil {
+			if err != nil {
 				a.lastPromptTokens = nil
 				return runtime.Response{}, fmt.Errorf("native: eval token: %w", err)
 			}
@@ -536,8 +710,8 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 	}
 
 	// Generation succeeded — prompt cache was already updated in the
-	// text-only path above. For vision path, prompt cache stays nil
-	// (vision requests don't benefit from text prompt caching).
+	// prompt evaluation above. For the vision path it covers the text
+	// before the first image.
 
 	perf := a.ctx.Perf()
 	duration := time.Since(startTime)
@@ -568,8 +742,17 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 		specRate = float64(specAccepted) / float64(specDrafted) * 100.0
 	}
 
+	text := result.String()
+	if choice != nil {
+		if label, ok := choice.label(opts.Choices, lastToken); ok {
+			text = label
+		}
+	} else if len(opts.Choices) > 0 {
+		text = strings.TrimSpace(text)
+	}
+
 	return runtime.Response{
-		Text: result.String(),
+		Text: text,
 		Stats: runtime.Stats{
 			TokensEvaluated:           promptTokenCount,
 			TokensGenerated:           tokensGenerated,
@@ -581,6 +764,10 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 			SpeculativeAttempted:      specDrafted,
 			SpeculativeAccepted:       specAccepted,
 			SpeculativeAcceptanceRate: specRate,
+			SpeculativeDraftN:         specDraftN,
+			SpeculativeLookups:        specLookups,
+			SpeculativeLookupHits:     specLookupHits,
+			Phases:                    a.endPerf(span),
 		},
 		Raw:    perf,
 		Finish: finishReason,
@@ -589,23 +776,38 @@ func (a *Adapter) Generate(ctx context.Context, req runtime.Request) (runtime.Re
 
 // Stream performs token-by-token streaming generation.
 func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.StreamCallback) error {
-	a.mu.Lock()
-	defer a.mu.Unlock()
+	// A label is only known once it is complete, so choice requests
+	// stream as a single event.
+	if len(req.Options.Choices) > 0 {
+		resp, err := a.Generate(ctx, req)
+		if err != nil {
+			return err
+		}
+		if err := cb(runtime.StreamEvent{Token: resp.Text}); err != nil {
+			return err
+		}
+		return cb(runtime.StreamEvent{Final: true, Stats: &resp.Stats})
+	}
 
 	opts := mergeNativeOptions(a.cfg.Defaults, req.Options)
 
+	if tokens, maxTokens, ok := a.parallelRequest(req, opts); ok {
+		defer a.mu.RUnlock()
+		return a.streamParallel(ctx, tokens, opts, maxTokens, cb)
+	}
+
+	a.mu.Lock()
+	defer a.mu.Unlock()
+	defer a.flushPromptState()
+	a.reclaimSerial()
+	span := a.beginPerf()
+
 	// Get or reuse sampler chain.
-	sampler := a.getOrBuildSampler(SamplerOptions{
-		Temperature:      float32(opts.Temperature),
-		TopK:             int32(opts.TopK),
-		TopP:             float32(opts.TopP),
-		MinP:             float32(opts.MinP),
-		RepeatPenalty:    float32(opts.RepeatPenalty),
-		RepeatLastN:      int32(opts.RepeatLastN),
-		FrequencyPenalty: 0.0,
-		PresencePenalty:  0.0,
-		Seed:             0xFFFFFFFF,
-	})
+	sampler, releaseSampler, err := a.requestSampler(opts, nil)
+	if err != nil {
+		return err
+	}
+	defer releaseSampler()
 
 	// Reset performance counters.
 	a.ctx.PerfReset()
@@ -616,25 +818,14 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 	var maxTokens int
 
 	// --- Vision path: images present and vision context available ---
-	if len(req.Image) > 0 && a.vision != nil {
-		// Clear KV cache — prompt caching doesn't work with vision requests.
-		a.ctx.ClearKV()
-		a.lastPromptTokens = nil
-
-		batchSize := int32(a.cfg.Native.BatchSize)
-		if batchSize <= 0 {
-			batchSize = 512
-		}
-
-		newPos, visionErr := a.vision.EvalWithImages(a.ctx, req.Prompt, req.Image, batchSize)
+	if req.HasImages() && a.vision != nil {
+		// The text before the first image reuses the prompt cache.
+		var visionErr error
+		promptTokenCount, prefixLen, visionErr = a.evalVisionPrompt(req, &span)
 		if visionErr != nil {
 			return fmt.Errorf("native: vision eval: %w", visionErr)
 		}
 
-		// Synchronize the context's position with where vision eval left off.
-		a.ctx.SetPos(newPos)
-		promptTokenCount = int(newPos)
-
 	} else {
 		// --- Standard text-only path ---
 
@@ -650,35 +841,27 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 			return fmt.Errorf("native: tokenize: %w", err)
 		}
 		promptTokenCount = len(tokens)
+		a.shiftKeep = a.shiftKeepSpan(tokens)
 
 		// Prompt caching: reuse KV cache prefix.
 		prefixLen = commonPrefixLen(a.lastPromptTokens, tokens)
-		if prefixLen > 0 && prefixLen < len(tokens) {
-			// Partial cache hit: keep the shared prefix, discard diverging suffix
-			// and any generated tokens beyond the prompt.
-			a.ctx.TruncateKV(int32(prefixLen))
-			// Also truncate draft model to maintain sync during speculative decoding
-			if a.draftCtx != nil {
-				a.draftCtx.TruncateKV(int32(prefixLen))
-			}
-		} else if prefixLen == len(tokens) {
-			// Full cache hit: identical prompt. The KV cache contains generated
-			// tokens from the previous call beyond the prompt. Clear and re-eval.
-			a.ctx.ClearKV()
-			// Also clear draft model to maintain sync
-			if a.draftCtx != nil {
-				a.draftCtx.ClearKV()
-			}
-			prefixLen = 0
-		} else {
-			a.ctx.ClearKV()
-			// Also clear draft model to maintain sync
-			if a.draftCtx != nil {
-				a.draftCtx.ClearKV()
-			}
+		prefixLen = a.restoreCachedPrefix(tokens, prefixLen)
+		if prefixLen == len(tokens) {
+			// Full cache hit: identical prompt. With causal attention the KV
+			// entries of the prompt positions do not depend on the tokens
+			// generated after them, so keep all but the last prompt token and
+			// re-evaluate that one to get fresh logits. Recurrent and hybrid
+			// memory cannot be cut back; truncateSeq0 then starts over.
+			prefixLen--
 		}
-
-		newTokens := tokens[prefixLen:]
+		// Partial cache hit: keep the shared prefix, discard diverging suffix
+		// and any generated tokens beyond the prompt (in the draft model too,
+		// to keep speculative decoding in sync).
+		prefixLen = a.truncateSeq0(prefixLen)
+
+		evalFrom := a.snapshotStablePrefix(tokens, prefixLen)
+		newTokens := tokens[evalFrom:]
+		a.lastPromptTokens = append(make([]int32, 0, len(tokens)), tokens[:evalFrom]...)
 		if len(newTokens) > 0 {
 			// Ensure we have space BEFORE evaluating (prevents crashes)
 			a.ensureContextSpace(len(newTokens), opts.MaxTokens)
@@ -690,13 +873,24 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 			}
 		}
 
-		// Store tokens for prompt caching on next call.
-		a.lastPromptTokens = make([]int32, len(tokens))
-		copy(a.lastPromptTokens, tokens)
+		// Store the cached tokens for prompt caching on next call. A context
+		// shift during evaluation moved lastPromptTokens along with the
+		// cache; a recovery that lost track of the cache contents left it
+		// nil or out of step with the position.
+		if a.lastPromptTokens != nil && len(a.lastPromptTokens)+len(newTokens) == int(a.ctx.Pos()) {
+			a.lastPromptTokens = append(a.lastPromptTokens, newTokens...)
+			a.cachePromptState(a.lastPromptTokens)
+		} else {
+			a.lastPromptTokens = nil
+		}
 
 		// Sync draft model with prompt tokens for speculative decoding.
 		if a.draftModel != nil {
-			if err := a.syncDraftPrompt(tokens); err != nil {
+			draftTokens := a.lastPromptTokens
+			if draftTokens == nil {
+				draftTokens = tokens
+			}
+			if err := a.syncDraftPrompt(draftTokens); err != nil {
 				log.Printf("native: draft model sync failed, falling back to standard generation: %v", err)
 			}
 		}
@@ -704,7 +898,7 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 
 	// maxTokens already resolved above for text path, only resolve here for vision path
 	// Check if we're in vision mode (promptTokenCount was set via vision path)
-	if promptTokenCount > 0 && len(req.Image) > 0 {
+	if promptTokenCount > 0 && req.HasImages() {
 		maxTokens = opts.MaxTokens
 		if maxTokens <= 0 {
 			maxTokens = 512
@@ -747,10 +941,30 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 	var chunkBuf strings.Builder
 	chunkCount := 0
 
-	// Speculative decoding: if a draft model is loaded and not in vision mode,
-	// use the speculative path for faster generation.
-	useSpeculative := a.draftModel != nil && a.draftCtx != nil && len(req.Image) == 0
-	var specDrafted, specAccepted int // accumulators for speculative stats
+	// Speculative decoding: if a draft model is loaded or prompt lookup is
+	// enabled, and not in vision mode, use the speculative path for faster
+	// generation.
+	// Draft tokens are verified against the target distribution without the
+	// grammar, so grammar-constrained requests decode normally.
+	useSpeculative := !req.HasImages() && opts.Grammar == "" &&
+		(a.ngramSpec || (a.draftModel != nil && a.draftCtx != nil))
+	var draftSampler *SamplerChain
+	var specDraftN []int
+	var specHistory []int32 // prompt + generated tokens, for prompt lookup
+	if useSpeculative && a.ngramSpec {
+		specHistory = append([]int32(nil), a.lastPromptTokens...)
+	} else if useSpeculative {
+		draftOpts := draftSamplerOptions(samplerOptionsFor(opts))
+		if ds, err := a.samplers.get(draftOpts); err == nil {
+			draftSampler = ds
+			defer a.samplers.put(draftOpts, ds)
+			a.draftCtl.begin()
+		} else {
+			useSpeculative = false
+		}
+	}
+	var specDrafted, specAccepted int   // accumulators for speculative stats
+	var specLookups, specLookupHits int // prompt-lookup rounds and hits
 
 	for i := 0; i < maxTokens; {
 		// Check cancellation.
@@ -764,16 +978,32 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 
 		if useSpeculative {
 			// --- Speculative decoding path ---
-			specResult, err := a.speculativeGenerate(sampler)
+			var specResult speculativeResult
+			var err error
+			if a.ngramSpec {
+				specResult, err = a.ngramGenerate(sampler, specHistory)
+			} else {
+				specResult, err = a.speculativeGenerate(sampler, draftSampler)
+			}
 			if err != nil {
 				// Silent fallback: if speculative fails, try standard generation once
 				log.Printf("native: speculative streaming failed, falling back: %v", err)
 				useSpeculative = false
 				continue
 			}
+			if a.ngramSpec {
+				specHistory = append(specHistory, specResult.tokens...)
+				specLookups++
+				if specResult.drafted > 0 {
+					specLookupHits++
+				}
+			}
 
 			// Accumulate speculative decoding stats.
 			specDrafted += specResult.drafted
+			if specResult.draftN > 0 {
+				specDraftN = append(specDraftN, specResult.draftN)
+			}
 			specAccepted += specResult.accepted
 
 			// Record TTFT on the first generated token.
@@ -845,72 +1075,79 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 			a.maybeShiftContext()
 
 		} else {
-			// --- Standard single-token path ---
-
-			// Sample.
-			token, err := a.ctx.SampleToken(sampler)
-			if err != nil {
-				a.lastPromptTokens = nil
-				return fmt.Errorf("native: sample: %w", err)
+			// --- Standard path: fused native sample/decode steps ---
+			// Step as many tokens as make up one stream chunk, so the Go
+			// side only wakes up when there is something to emit.
+			steps := chunkSize
+			if rem := a.fusedSteps(maxTokens-i, len(opts.Stop) > 0); steps > rem {
+				steps = rem
+			}
+			if idx == 0 && accumulated.Len() == 0 {
+				steps = 1 // keep TTFT a single-token measurement
 			}
+			step, err := a.ctx.GenerateStep(sampler, steps, true)
 
 			// Record TTFT on the first generated token.
-			if idx == 0 {
+			if idx == 0 && accumulated.Len() == 0 {
 				ttft = time.Since(startTime)
 			}
 
-			// EOG check.
-			if a.model.TokenIsEOG(token) {
-				// Flush any buffered chunk before finishing.
-				if chunkBuf.Len() > 0 {
-					if err := cb(runtime.StreamEvent{Token: chunkBuf.String(), Index: idx}); err != nil {
-						a.lastPromptTokens = nil
-						return err
+			hitStop := false
+			for _, piece := range step.Pieces {
+				accumulated.WriteString(piece)
+
+				// Check stop sequences using ring buffer.
+				if streamRing != nil {
+					streamRing.write(piece)
+					if streamRing.check() {
+						// Don't flush the chunk — it may contain the stop sequence.
+						hitStop = true
+						break
 					}
-					idx++
 				}
-				break
-			}
 
-			piece := a.model.TokenToPiece(token)
-			accumulated.WriteString(piece)
+				// Buffer the token for chunked emission.
+				chunkBuf.WriteString(piece)
+				chunkCount++
+				i++
 
-			// Check stop sequences using ring buffer.
-			if streamRing != nil {
-				streamRing.write(piece)
-				if streamRing.check() {
-					// Don't flush the chunk — it may contain the stop sequence.
-					break
+				// Flush the chunk when: buffer is full, or piece ends with whitespace
+				// (natural word boundary for readable streaming).
+				flushChunk := chunkCount >= chunkSize
+				if !flushChunk && len(piece) > 0 {
+					lastByte := piece[len(piece)-1]
+					if lastByte == ' ' || lastByte == '\n' || lastByte == '\t' {
+						flushChunk = true
+					}
 				}
-			}
 
-			// Buffer the token for chunked emission.
-			chunkBuf.WriteString(piece)
-			chunkCount++
-			i++
-
-			// Flush the chunk when: buffer is full, or piece ends with whitespace
-			// (natural word boundary for readable streaming).
-			flushChunk := chunkCount >= chunkSize
-			if !flushChunk && len(piece) > 0 {
-				lastByte := piece[len(piece)-1]
-				if lastByte == ' ' || lastByte == '\n' || lastByte == '\t' {
-					flushChunk = true
+				if flushChunk && chunkBuf.Len() > 0 {
+					if err := cb(runtime.StreamEvent{Token: chunkBuf.String(), Index: idx}); err != nil {
+						a.lastPromptTokens = nil
+						return err
+					}
+					idx++
+					chunkBuf.Reset()
+					chunkCount = 0
 				}
 			}
+			if hitStop {
+				break
+			}
 
-			if flushChunk && chunkBuf.Len() > 0 {
-				if err := cb(runtime.StreamEvent{Token: chunkBuf.String(), Index: idx}); err != nil {
-					a.lastPromptTokens = nil
-					return err
+			// EOG: flush any buffered chunk before finishing.
+			if step.EOG {
+				if chunkBuf.Len() > 0 {
+					if err := cb(runtime.StreamEvent{Token: chunkBuf.String(), Index: idx}); err != nil {
+						a.lastPromptTokens = nil
+						return err
+					}
+					idx++
 				}
-				idx++
-				chunkBuf.Reset()
-				chunkCount = 0
+				break
 			}
 
-			// Advance KV cache.
-			if err := a.ctx.EvalToken(token); err != nil {
+			if err != nil {
 				a.lastPromptTokens = nil
 				return fmt.Errorf("native: eval token: %w", err)
 			}
@@ -921,7 +1158,8 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 	}
 
 	// Streaming generation succeeded — prompt cache was already updated
-	// in the text-only path above. For vision path, it stays nil.
+	// in the prompt evaluation above (for vision, the text before the
+	// first image).
 
 	// Collect perf counters and build final stats.
 	perf := a.ctx.Perf()
@@ -961,6 +1199,10 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 		SpeculativeAttempted:      specDrafted,
 		SpeculativeAccepted:       specAccepted,
 		SpeculativeAcceptanceRate: specRate,
+		SpeculativeDraftN:         specDraftN,
+		SpeculativeLookups:        specLookups,
+		SpeculativeLookupHits:     specLookupHits,
+		Phases:                    a.endPerf(span),
 	}
 
 	// Signal completion with stats.
@@ -970,6 +1212,15 @@ func (a *Adapter) Stream(ctx context.Context, req runtime.Request, cb runtime.St
 // ClearContext clears the KV cache and resets prompt caching state.
 // This ensures a clean state between HTTP requests, similar to CLI sessions.
 func (a *Adapter) ClearContext() error {
+	// With parallel slots, every slot request starts from an exact token
+	// prefix match, so there is nothing to clear for them. Waiting for the
+	// write lock would serialize all in-flight requests; instead mark
+	// sequence 0 stale and let the next serial request reset it.
+	if a.sched != nil {
+		a.seq0Stale.Store(true)
+		return nil
+	}
+
 	a.mu.Lock()
 	defer a.mu.Unlock()
 
@@ -977,15 +1228,23 @@ func (a *Adapter) ClearContext() error {
 		return nil
 	}
 
-	a.ctx.ClearKV()
-	a.lastPromptTokens = nil
+	a.resetSeq0()
+
+	log.Printf("native: context cleared for new request")
+	return nil
+}
 
+// resetSeq0 returns sequence 0 to its between-requests state: the pinned
+// prompt prefix when a snapshot is in use, otherwise an empty cache.
+func (a *Adapter) resetSeq0() {
 	if a.draftCtx != nil {
 		a.draftCtx.ClearKV()
 	}
-
-	log.Printf("native: context cleared for new request")
-	return nil
+	if a.pinnedPrefix != nil && a.restorePinnedPrefix() {
+		return
+	}
+	a.ctx.ClearKV()
+	a.lastPromptTokens = nil
 }
 
 // Close frees all native resources.
@@ -993,10 +1252,10 @@ func (a *Adapter) Close() error {
 	a.mu.Lock()
 	defer a.mu.Unlock()
 
-	if a.sampler != nil {
-		a.sampler.Close()
-		a.sampler = nil
+	if a.sched != nil {
+		a.sched.close()
 	}
+	a.samplers.close()
 	if a.vision != nil {
 		a.vision.Close()
 		a.vision = nil
@@ -1021,46 +1280,518 @@ func (a *Adapter) Close() error {
 	return nil
 }
 
-// ---------------------------------------------------------------------------
-// Helpers
-// ---------------------------------------------------------------------------
-
-// contextShiftEnabled returns whether automatic context window sliding is on.
-// Defaults to true unless explicitly disabled.
-func (a *Adapter) contextShiftEnabled() bool {
-	if a.cfg.Native.ContextShift != nil {
-		return *a.cfg.Native.ContextShift
+// KVCacheBytes returns the estimated size of the target context's KV cache
+// (see inferbench.KVCacheReporter).
+func (a *Adapter) KVCacheBytes() int64 {
+	a.mu.RLock()
+	defer a.mu.RUnlock()
+	if a.ctx == nil {
+		return 0
 	}
-	return true // default: enabled
+	k, v := a.ctx.KVCacheBytes()
+	return int64(k + v)
 }
 
-// contextSize returns the configured context window size.
-func (a *Adapter) contextSize() int {
-	if a.cfg.Native.ContextSize > 0 {
-		return a.cfg.Native.ContextSize
+// CountTokens returns the exact token count of each text under the loaded
+// model's vocabulary (see runtime.TokenCounter).
+func (a *Adapter) CountTokens(texts []string) ([]int, error) {
+	a.mu.RLock()
+	defer a.mu.RUnlock()
+	if a.model == nil {
+		return nil, fmt.Errorf("native: adapter is closed")
 	}
-	return 2048
+	return a.model.CountTokens(texts)
 }
 
-// batchSize returns the configured batch size for the target model.
-func (a *Adapter) batchSize() int {
-	if a.cfg.Native.BatchSize > 0 {
-		return a.cfg.Native.BatchSize
+// ProbeBatchOverhead times decode batch preparation with and without the
+// context's persistent batch (see inferbench.BatchOverheadProber).
+func (a *Adapter) ProbeBatchOverhead(nTokens, iterations int) (time.Duration, time.Duration, error) {
+	a.mu.Lock()
+	defer a.mu.Unlock()
+	if a.ctx == nil {
+		return 0, 0, fmt.Errorf("native: adapter is closed")
 	}
-	return 512
+	alloc, arena := a.ctx.BenchBatchPrepare(nTokens, iterations)
+	return alloc, arena, nil
 }
 
-// contextShiftThreshold returns the configured shift threshold (0.0-1.0).
-// Default: 0.60 (60% of context size).
-func (a *Adapter) contextShiftThreshold() float64 {
-	if a.cfg.Native.ContextShiftThreshold > 0 {
-		return a.cfg.Native.ContextShiftThreshold
+// ---------------------------------------------------------------------------
+// Prompt-prefix snapshots
+// ---------------------------------------------------------------------------
+
+// loadPromptSnapshot restores the newest usable snapshot for this model
+// into sequence 0, so the first request after startup only evaluates the
+// part of its prompt beyond the snapshot.
+func (a *Adapter) loadPromptSnapshot() {
+	for _, path := range listSnapshots(a.snapshotDir, a.snapshotKey) {
+		start := time.Now()
+		tokens, err := a.ctx.LoadState(path, a.contextSize())
+		if err != nil {
+			log.Printf("native: skipping prompt snapshot: %v", err)
+			continue
+		}
+		a.pinnedPrefix = tokens
+		a.pinnedPath = path
+		a.lastPromptTokens = append([]int32(nil), tokens...)
+		a.prevPrompt = tokens
+		log.Printf("native: restored %d-token prompt prefix from %s in %v",
+			len(tokens), path, time.Since(start))
+		return
 	}
-	return 0.60 // More proactive than the old 0.75
 }
 
-// contextShiftDiscard returns the number of tokens to discard per shift.
-// Default: 1024 tokens.
+// restorePinnedPrefix resets sequence 0 to exactly the pinned prefix. The
+// cells are usually still in place (only a truncation is needed); if they
+// were shifted or cleared, the snapshot is reloaded from disk.
+func (a *Adapter) restorePinnedPrefix() bool {
+	n := len(a.pinnedPrefix)
+	if commonPrefixLen(a.lastPromptTokens, a.pinnedPrefix) != n || !a.ctx.TruncateKV(int32(n)) {
+		if _, err := a.ctx.LoadState(a.pinnedPath, a.contextSize()); err != nil {
+			log.Printf("native: prompt snapshot unavailable, dropping it: %v", err)
+			a.pinnedPrefix = nil
+			a.pinnedPath = ""
+			return false
+		}
+	}
+	a.lastPromptTokens = append([]int32(nil), a.pinnedPrefix...)
+	return true
+}
+
+// snapshotStablePrefix saves the KV state of the prefix shared by this
+// prompt and the previous one, once per process, when snapshots are
+// enabled. tokens[:prefixLen] is what sequence 0 currently holds. Returns
+// the index from which the caller must evaluate the prompt.
+func (a *Adapter) snapshotStablePrefix(tokens []int32, prefixLen int) int {
+	if a.snapshotDir == "" || a.pinnedPrefix != nil {
+		return prefixLen
+	}
+	stable := commonPrefixLen(a.prevPrompt, tokens)
+	a.prevPrompt = append([]int32(nil), tokens...)
+	if stable < minSnapshotTokens || stable >= len(tokens) {
+		return prefixLen
+	}
+
+	// Bring sequence 0 to exactly tokens[:stable].
+	if prefixLen > stable {
+		prefixLen = a.truncateSeq0(stable)
+	}
+	if prefixLen < stable {
+		if err := a.evalTokensInChunks(tokens[prefixLen:stable]); err != nil {
+			log.Printf("native: prompt snapshot skipped: %v", err)
+			return a.truncateSeq0(prefixLen)
+		}
+	}
+
+	prefix := append([]int32(nil), tokens[:stable]...)
+	path := snapshotPath(a.snapshotDir, a.snapshotKey, prefix)
+	start := time.Now()
+	if err := a.ctx.SaveState(path, prefix); err != nil {
+		log.Printf("native: prompt snapshot skipped: %v", err)
+		return stable
+	}
+	pruneSnapshots(a.snapshotDir, a.snapshotKey, maxSnapshotsPerModel)
+	a.pinnedPrefix = prefix
+	a.pinnedPath = path
+	log.Printf("native: saved %d-token prompt prefix to %s in %v", stable, path, time.Since(start))
+	return stable
+}
+
+// evalVisionPrompt evaluates a prompt with images into sequence 0. The
+// text before the first image goes through the prompt cache like a text
+// prompt, so a system prompt and chat history shared with earlier requests
+// keep their KV entries and evaluation resumes at the first divergence;
+// the images and everything after them are evaluated fresh. Afterwards
+// lastPromptTokens holds that text prefix only. Returns the prompt's KV
+// length and how many leading tokens were reused. The caller holds a.mu.
+//
+// The vision encoder starts on the images as soon as the prompt is split
+// and runs while the text prefix is evaluated, so with a long system
+// prompt or history most of the encoding is hidden behind prefill. Stage
+// timings are recorded in span.
+func (a *Adapter) evalVisionPrompt(req runtime.Request, span *perfSpan) (promptLen, cached int, err error) {
+	vp, err := a.vision.Tokenize(req.Prompt, req.Image, req.Bitmaps)
+	if err != nil {
+		return 0, 0, err
+	}
+	defer func() {
+		vp.Close()
+		span.imagePreprocess = vp.Preprocess
+		span.imageEncode = vp.Encode
+		span.imagesCached = vp.Cached
+	}()
+	a.vision.StartEncode(vp)
+
+	prefix := vp.LeadingText()
+	a.shiftKeep = a.shiftKeepSpan(prefix)
+	cached = commonPrefixLen(a.lastPromptTokens, prefix)
+	if len(prefix) > 0 {
+		cached = a.restoreCachedPrefix(prefix, cached)
+	}
+	if cached == len(prefix) && len(vp.Chunks) == 1 {
+		cached-- // nothing follows to produce logits
+	}
+	cached = a.truncateSeq0(cached)
+
+	a.lastPromptTokens = nil
+	if len(prefix) > cached {
+		if err := a.evalTokensInChunks(prefix[cached:]); err != nil {
+			return 0, 0, fmt.Errorf("eval text prefix: %w", err)
+		}
+	}
+	if len(prefix) > 0 {
+		a.lastPromptTokens = append([]int32(nil), prefix...)
+		a.cachePromptState(a.lastPromptTokens)
+	}
+
+	batchSize := int32(a.cfg.Native.BatchSize)
+	if batchSize <= 0 {
+		batchSize = 512
+	}
+	from := 0
+	if len(prefix) > 0 {
+		from = 1 // the text prefix is already in the KV cache
+	}
+	newPos, err := a.vision.EvalChunks(a.ctx, vp, from, a.ctx.Pos(), batchSize)
+	if err != nil {
+		a.lastPromptTokens = nil
+		return 0, 0, err
+	}
+	// Synchronize the context's position with where vision eval left off.
+	a.ctx.SetPos(newPos)
+	return int(newPos), cached, nil
+}
+
+// restoreCachedPrefix loads the longest cached prefix of tokens into
+// sequence 0 when it is longer than the prefix the live KV cache already
+// shares (prefixLen). At least the last prompt token is always left for
+// evaluation so there are fresh logits. Returns the reusable prefix length.
+func (a *Adapter) restoreCachedPrefix(tokens []int32, prefixLen int) int {
+	if a.prefixCache == nil {
+		return prefixLen
+	}
+	e := a.prefixCache.lookup(tokens, len(tokens)-1)
+	if e == nil || len(e.tokens) <= prefixLen {
+		return prefixLen
+	}
+	if err := a.ctx.SetStateSeqData(e.state, 0); err != nil {
+		log.Printf("native: prefix cache restore failed: %v", err)
+		a.ctx.ClearKV()
+		a.lastPromptTokens = nil
+		return 0
+	}
+	a.lastPromptTokens = e.tokens
+	return len(e.tokens)
+}
+
+// truncateSeq0 cuts sequence 0 of the target and draft contexts back to
+// their first n tokens and returns n. When n is 0 or either memory cannot
+// be cut there (recurrent and hybrid models), both are cleared instead and
+// it returns 0, so the caller evaluates the whole prompt.
+func (a *Adapter) truncateSeq0(n int) int {
+	if n > 0 && a.ctx.TruncateKV(int32(n)) &&
+		(a.draftCtx == nil || a.draftCtx.TruncateKV(int32(n))) {
+		return n
+	}
+	a.ctx.ClearKV()
+	if a.draftCtx != nil {
+		a.draftCtx.ClearKV()
+	}
+	return 0
+}
+
+// cachePromptState stores the sequence-0 state of a just-evaluated prompt
+// in the prefix cache. Skipped when the prompt is already cached or the KV
+// cache no longer matches it exactly (e.g. after a context shift).
+//
+// Serializing the state takes a while, so unless the model's memory is
+// recurrent it is left to flushPromptState after generation, off the
+// time to first token. Recurrent and hybrid state absorbs every generated
+// token and cannot be cut back to the prompt later, so it is saved now.
+func (a *Adapter) cachePromptState(tokens []int32) {
+	if a.prefixCache == nil || len(tokens) < minSnapshotTokens || int(a.ctx.Pos()) != len(tokens) {
+		return
+	}
+	if e := a.prefixCache.lookup(tokens, len(tokens)); e != nil && len(e.tokens) == len(tokens) {
+		return
+	}
+	if !a.model.Info().Recurrent {
+		a.pendingPromptState = tokens
+		return
+	}
+	if state := a.ctx.StateSeqData(0); state != nil {
+		a.prefixCache.insert(tokens, state)
+	}
+}
+
+// flushPromptState stores the prompt left pending by cachePromptState once
+// generation is over: sequence 0 is cut back to the prompt (the generated
+// tokens are not reused by the next request anyway) and its state saved.
+// Skipped when sequence 0 no longer starts with that prompt. The caller
+// holds a.mu.
+func (a *Adapter) flushPromptState() {
+	tokens := a.pendingPromptState
+	a.pendingPromptState = nil
+	if tokens == nil || len(a.lastPromptTokens) != len(tokens) ||
+		commonPrefixLen(a.lastPromptTokens, tokens) != len(tokens) {
+		return
+	}
+	if int(a.ctx.Pos()) < len(tokens) || !a.ctx.TruncateKV(int32(len(tokens))) {
+		return
+	}
+	if state := a.ctx.StateSeqData(0); state != nil {
+		a.prefixCache.insert(tokens, state)
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Continuous batching
+// ---------------------------------------------------------------------------
+
+// parallelRequest decides whether req can be served on a parallel slot. On
+// success it returns the prompt tokens and generation budget with a.mu
+// read-locked; the caller must RUnlock when done. Vision requests and
+// prompts that would not fit in one slot's share of the KV pool fall back
+// to the serial path.
+func (a *Adapter) parallelRequest(req runtime.Request, opts runtime.GenerationOptions) ([]int32, int, bool) {
+	if a.sched == nil || req.HasImages() || len(opts.Choices) > 0 {
+		return nil, 0, false
+	}
+
+	a.mu.RLock()
+	if a.model == nil {
+		a.mu.RUnlock()
+		return nil, 0, false
+	}
+
+	maxTokens := opts.MaxTokens
+	if maxTokens <= 0 {
+		maxTokens = 512
+	}
+	tokens, err := a.model.Tokenize(req.Prompt, true, true)
+	if err != nil || len(tokens) == 0 || len(tokens)+maxTokens > a.sched.slotBudget {
+		a.mu.RUnlock()
+		return nil, 0, false
+	}
+	return tokens, maxTokens, true
+}
+
+// reclaimSerial prepares the context for the serial path when parallel
+// slots are enabled. Must be called with a.mu write-locked, i.e. while no
+// slot is in use: idle slot sequences are evicted so the serial path has
+// the whole KV pool, and sequence 0 is reset if it was reclaimed.
+func (a *Adapter) reclaimSerial() {
+	if a.sched == nil || a.ctx == nil {
+		return
+	}
+	a.sched.evictIdle()
+	evicted := a.seq0Evicted.Swap(false)
+	if evicted {
+		a.ctx.TruncateKV(0)
+		a.lastPromptTokens = nil
+	}
+	if a.seq0Stale.Swap(false) || evicted {
+		a.resetSeq0()
+	}
+}
+
+// generateParallel runs one request on a parallel slot. The caller holds
+// a.mu for reading. emit, when non-nil, receives each piece as it is
+// produced; an error from emit aborts generation. Returns the generated
+// text (trimmed at a stop sequence), stats and finish reason.
+func (a *Adapter) generateParallel(ctx context.Context, tokens []int32, opts runtime.GenerationOptions, maxTokens int, emit func(string) error) (string, runtime.Stats, string, error) {
+	startTime := time.Now()
+
+	sl, reuse, err := a.sched.acquire(ctx, tokens)
+	if err != nil {
+		return "", runtime.Stats{}, "cancelled", err
+	}
+	defer a.sched.release(sl)
+
+	sampler, releaseSampler, err := a.requestSampler(opts, nil)
+	if err != nil {
+		return "", runtime.Stats{}, "", err
+	}
+	defer releaseSampler()
+	var token int32
+	token, reuse, err = a.sched.prefill(sl, tokens, reuse, sampler)
+	if err != nil {
+		return "", runtime.Stats{}, "", fmt.Errorf("native: eval prompt: %w", err)
+	}
+	ttft := time.Since(startTime)
+
+	a.sched.begin()
+	defer a.sched.end()
+
+	var result strings.Builder
+	ring := newStopRing(opts.Stop)
+	pos := int32(len(tokens))
+	generated := 0
+	finish := "length"
+
+	stats := func() runtime.Stats {
+		duration := time.Since(startTime)
+		st := runtime.Stats{
+			TokensEvaluated: len(tokens),
+			TokensGenerated: generated,
+			TokensCached:    reuse,
+			Duration:        duration,
+			TTFT:            ttft,
+		}
+		// Perf counters are context-wide and shared by all slots, so
+		// throughput is always measured on the Go side here.
+		if ttft > 0 {
+			st.PromptTPS = float64(len(tokens)-reuse) / ttft.Seconds()
+		}
+		if generated > 0 && duration > ttft {
+			st.GenerationTPS = float64(generated) / (duration - ttft).Seconds()
+		}
+		return st
+	}
+
+	for generated < maxTokens {
+		select {
+		case <-ctx.Done():
+			return result.String(), stats(), "cancelled", ctx.Err()
+		default:
+		}
+
+		if a.model.TokenIsEOG(token) {
+			finish = "stop"
+			break
+		}
+
+		piece := a.model.TokenToPiece(token)
+		result.WriteString(piece)
+		generated++
+
+		if ring != nil {
+			ring.write(piece)
+			if ring.check() {
+				trimmed := trimAtStop(result.String(), opts.Stop)
+				result.Reset()
+				result.WriteString(trimmed)
+				finish = "stop"
+				break
+			}
+		}
+
+		if emit != nil {
+			if err := emit(piece); err != nil {
+				return result.String(), stats(), "cancelled", err
+			}
+		}
+
+		if generated >= maxTokens {
+			break
+		}
+
+		next, err := a.sched.step(sl, token, pos, sampler)
+		if err != nil {
+			return result.String(), stats(), "", fmt.Errorf("native: eval token: %w", err)
+		}
+		pos++
+		token = next
+	}
+
+	return result.String(), stats(), finish, nil
+}
+
+// streamParallel is the streaming counterpart of generateParallel, applying
+// the same chunked emission as Stream.
+func (a *Adapter) streamParallel(ctx context.Context, tokens []int32, opts runtime.GenerationOptions, maxTokens int, cb runtime.StreamCallback) error {
+	chunkSize := a.cfg.Native.StreamChunkSize
+	if chunkSize <= 0 {
+		chunkSize = 1
+	}
+	var chunkBuf strings.Builder
+	chunkCount := 0
+	idx := 0
+	emitted := 0 // bytes already delivered to cb
+
+	send := func(s string) error {
+		if s == "" {
+			return nil
+		}
+		if err := cb(runtime.StreamEvent{Token: s, Index: idx}); err != nil {
+			return err
+		}
+		idx++
+		emitted += len(s)
+		return nil
+	}
+
+	text, stats, _, err := a.generateParallel(ctx, tokens, opts, maxTokens, func(piece string) error {
+		chunkBuf.WriteString(piece)
+		chunkCount++
+		// Flush on a full chunk or at a natural word boundary.
+		if chunkCount < chunkSize && !strings.HasSuffix(piece, " ") &&
+			!strings.HasSuffix(piece, "\n") && !strings.HasSuffix(piece, "\t") {
+			return nil
+		}
+		chunk := chunkBuf.String()
+		chunkBuf.Reset()
+		chunkCount = 0
+		return send(chunk)
+	})
+	if err != nil {
+		if ctx.Err() != nil {
+			_ = cb(runtime.StreamEvent{Final: true, Err: ctx.Err()})
+			return ctx.Err()
+		}
+		return err
+	}
+
+	// Deliver the unflushed tail. text is already trimmed at any stop
+	// sequence, so a partially buffered stop string is never sent.
+	if len(text) > emitted {
+		if err := send(text[emitted:]); err != nil {
+			return err
+		}
+	}
+
+	return cb(runtime.StreamEvent{Final: true, Stats: &stats})
+}
+
+// ---------------------------------------------------------------------------
+// Helpers
+// ---------------------------------------------------------------------------
+
+// contextShiftEnabled returns whether automatic context window sliding is on.
+// Defaults to true unless explicitly disabled.
+func (a *Adapter) contextShiftEnabled() bool {
+	if a.cfg.Native.ContextShift != nil {
+		return *a.cfg.Native.ContextShift
+	}
+	return true // default: enabled
+}
+
+// contextSize returns the configured context window size.
+func (a *Adapter) contextSize() int {
+	if a.cfg.Native.ContextSize > 0 {
+		return a.cfg.Native.ContextSize
+	}
+	return 2048
+}
+
+// batchSize returns the configured batch size for the target model.
+func (a *Adapter) batchSize() int {
+	if a.cfg.Native.BatchSize > 0 {
+		return a.cfg.Native.BatchSize
+	}
+	return 512
+}
+
+// contextShiftThreshold returns the configured shift threshold (0.0-1.0).
+// Default: 0.60 (60% of context size).
+func (a *Adapter) contextShiftThreshold() float64 {
+	if a.cfg.Native.ContextShiftThreshold > 0 {
+		return a.cfg.Native.ContextShiftThreshold
+	}
+	return 0.60 // More proactive than the old 0.75
+}
+
+// contextShiftDiscard returns the number of tokens to discard per shift.
+// Default: 1024 tokens.
 func (a *Adapter) contextShiftDiscard() int {
 	if a.cfg.Native.ContextShiftDiscard > 0 {
 		return a.cfg.Native.ContextShiftDiscard
@@ -1095,14 +1826,91 @@ func (a *Adapter) maxShiftAttempts() int {
 	return 3
 }
 
+// shiftContext discards nDiscard tokens of sequence 0 that follow the
+// preserved system-prompt span (a.shiftKeep) and shifts the rest down, on
+// the target and, to keep them in sync, the draft model. lastPromptTokens
+// is shifted the same way, so it still describes the cache and the next
+// request reuses at least the preserved span. Returns the number of tokens
+// discarded, which is clamped so at least one token after the span stays.
+func (a *Adapter) shiftContext(nDiscard int32) int32 {
+	nKeep, nDiscard := clampShift(a.ctx.Pos(), a.shiftKeep, nDiscard)
+	if nDiscard <= 0 {
+		return 0
+	}
+	if !a.ctx.ShiftKV(nKeep, nDiscard) {
+		log.Printf("native: context shift not supported by this model's cache")
+		return 0
+	}
+	a.lastPromptTokens = shiftTokens(a.lastPromptTokens, int(nKeep), int(nDiscard))
+
+	if a.draftCtx != nil && a.draftCtx.Pos() > nKeep+nDiscard {
+		a.draftCtx.ShiftKV(nKeep, nDiscard)
+	}
+	return nDiscard
+}
+
+// clampShift returns the span kept and the tokens discarded when a cache
+// at pos is shifted: a span covering all but the last token is not kept,
+// and at most the tokens after the span but the last are discarded.
+func clampShift(pos, nKeep, nDiscard int32) (int32, int32) {
+	if nKeep >= pos-1 {
+		nKeep = 0
+	}
+	if nKeep+nDiscard >= pos {
+		nDiscard = pos - nKeep - 1
+	}
+	return nKeep, nDiscard
+}
+
+// shiftTokens returns the token sequence a KV cache holding tokens holds
+// after ShiftKV(nKeep, nDiscard). The input is not modified.
+func shiftTokens(tokens []int32, nKeep, nDiscard int) []int32 {
+	if tokens == nil || len(tokens) <= nKeep {
+		return tokens
+	}
+	out := make([]int32, 0, len(tokens))
+	out = append(out, tokens[:nKeep]...)
+	if end := nKeep + nDiscard; end < len(tokens) {
+		out = append(out, tokens[end:]...)
+	}
+	return out
+}
+
+// shiftKeepSpan returns how many leading prompt tokens context shifts
+// preserve (see NativeConfig.ContextShiftKeep). The automatic span runs
+// through the first end-of-turn token, i.e. the chat template's system
+// turn. It is capped at half the context so a shift can still free space.
+func (a *Adapter) shiftKeepSpan(tokens []int32) int32 {
+	limit := a.contextSize() / 2
+	n := a.cfg.Native.ContextShiftKeep
+	switch {
+	case n < 0:
+		return 0
+	case n == 0:
+		for i, tok := range tokens {
+			if i >= limit {
+				break
+			}
+			if a.model.TokenIsEOG(tok) {
+				n = i + 1
+				break
+			}
+		}
+	}
+	if n > len(tokens) {
+		n = len(tokens)
+	}
+	if n > limit {
+		n = limit
+	}
+	return int32(n)
+}
+
 // maybeShiftContext checks if the KV cache is at or above the shift threshold
 // (default 60% of context size, configurable). If context shifting is enabled,
-// it discards the oldest tokens and shifts remaining positions down, freeing
-// space for continued generation. Returns the number of tokens discarded.
-//
-// After shifting, the prompt cache is invalidated since positions have changed.
-// When speculative decoding is enabled, both target and draft models are shifted
-// to maintain synchronization.
+// it discards the oldest tokens after the system-prompt span and shifts the
+// remaining positions down, freeing space for continued generation. Returns
+// the number of tokens discarded.
 func (a *Adapter) maybeShiftContext() int {
 	if !a.contextShiftEnabled() {
 		return 0
@@ -1119,22 +1927,14 @@ func (a *Adapter) maybeShiftContext() int {
 	if nDiscard <= 0 {
 		nDiscard = int32(float64(ctxSize) * 0.25) // fallback to 25%
 	}
-	if nDiscard >= a.ctx.Pos() {
-		// Shouldn't happen, but guard against it.
+	// shiftContext clamps nDiscard to what follows the kept span, which
+	// can be most of the context.
+	nDiscard = a.shiftContext(nDiscard)
+	if nDiscard == 0 {
 		return 0
 	}
-
-	// Shift target model
-	a.ctx.ShiftKV(nDiscard)
-	a.lastPromptTokens = nil // positions shifted — prompt cache invalid
-
-	// Also shift draft model to maintain synchronization during speculative decoding
-	if a.draftCtx != nil && a.draftCtx.Pos() >= nDiscard {
-		a.draftCtx.ShiftKV(nDiscard)
-	}
-
-	log.Printf("native: context shift — discarded %d oldest tokens, pos %d → %d",
-		nDiscard, currentPos, a.ctx.Pos())
+	log.Printf("native: context shift — kept %d, discarded %d oldest tokens, pos %d → %d",
+		a.shiftKeep, nDiscard, currentPos, a.ctx.Pos())
 	return int(nDiscard)
 }
 
@@ -1172,21 +1972,10 @@ func (a *Adapter) ensureContextSpace(tokensNeeded int, maxGenerationTokens int)
 		nDiscard = minDiscard
 	}
 
-	// Don't discard more than we have
-	if nDiscard >= a.ctx.Pos() {
-		nDiscard = a.ctx.Pos() - 1
-		if nDiscard <= 0 {
-			return false
-		}
-	}
-
-	// Perform the shift
-	a.ctx.ShiftKV(nDiscard)
-	a.lastPromptTokens = nil // Invalidate prompt cache
-
-	// Sync draft model
-	if a.draftCtx != nil && a.draftCtx.Pos() >= nDiscard {
-		a.draftCtx.ShiftKV(nDiscard)
+	// Perform the shift (clamped to what follows the kept span)
+	nDiscard = a.shiftContext(nDiscard)
+	if nDiscard == 0 {
+		return false
 	}
 
 	log.Printf("native: proactive context shift — freed %d tokens for %d incoming, pos %d → %d",
@@ -1245,12 +2034,10 @@ func (a *Adapter) evalTokensWithRecovery(tokens []int32, maxTokens int) error {
 			if nDiscard >= a.ctx.Pos() {
 				nDiscard = a.ctx.Pos() / 2
 			}
-			if nDiscard > 0 {
-				a.ctx.ShiftKV(nDiscard)
+			// The failed eval may have left part of its tokens in the
+			// cache, so the prompt cache no longer describes it.
+			if nDiscard = a.shiftContext(nDiscard); nDiscard > 0 {
 				a.lastPromptTokens = nil
-				if a.draftCtx != nil && a.draftCtx.Pos() >= nDiscard {
-					a.draftCtx.ShiftKV(nDiscard)
-				}
 				log.Printf("native: shifted %d tokens, pos %d → %d", nDiscard, currentPos, a.ctx.Pos())
 			}
 
@@ -1263,15 +2050,8 @@ func (a *Adapter) evalTokensWithRecovery(tokens []int32, maxTokens int) error {
 			if nDiscard < 512 {
 				nDiscard = 512
 			}
-			if nDiscard >= a.ctx.Pos() {
-				nDiscard = a.ctx.Pos() - 1
-			}
-			if nDiscard > 0 {
-				a.ctx.ShiftKV(nDiscard)
+			if nDiscard = a.shiftContext(nDiscard); nDiscard > 0 {
 				a.lastPromptTokens = nil
-				if a.draftCtx != nil && a.draftCtx.Pos() >= nDiscard {
-					a.draftCtx.ShiftKV(nDiscard)
-				}
 				log.Printf("native: shifted %d tokens, pos %d → %d", nDiscard, currentPos, a.ctx.Pos())
 			}
 
@@ -1303,36 +2083,119 @@ func (a *Adapter) evalTokensWithRecovery(tokens []int32, maxTokens int) error {
 	return fmt.Errorf("native: failed to evaluate after %d recovery attempts", maxAttempts)
 }
 
-// getOrBuildSampler returns a sampler chain for the given options, reusing
-// the cached one if the parameters haven't changed. This avoids CGo
-// allocation overhead on every request — significant on edge devices where
-// requests often share the same temperature/top-k/top-p settings.
-func (a *Adapter) getOrBuildSampler(opts SamplerOptions) *SamplerChain {
-	if a.sampler != nil && a.samplerOpts == opts {
-		// Same parameters — just reset penalty history for the new request.
-		a.sampler.Reset()
-		return a.sampler
+// requestSampler checks out the sampler chain for a request: a one-off
+// restricted chain when choice is set, else a pooled chain for opts. This
+// avoids CGo allocation overhead on every request — significant on edge
+// devices where requests often share the same temperature/top-k/top-p
+// settings. A grammar is part of the options, so repeated structured
+// requests (e.g. memory extraction) also reuse their parsed grammar.
+// release returns the chain to the pool (or frees a one-off chain).
+func (a *Adapter) requestSampler(opts runtime.GenerationOptions, choice *choicePlan) (*SamplerChain, func(), error) {
+	if choice != nil {
+		s, err := a.model.NewRestrictedSamplerChain(choice.allowed)
+		if err != nil {
+			return nil, nil, err
+		}
+		return s, s.Close, nil
 	}
-	// Parameters changed — rebuild the chain.
-	if a.sampler != nil {
-		a.sampler.Close()
+	so := samplerOptionsFor(opts)
+	s, err := a.samplers.get(so)
+	if err != nil {
+		return nil, nil, err
 	}
-	a.sampler = NewSamplerChain(opts)
-	a.samplerOpts = opts
-	return a.sampler
+	return s, func() { a.samplers.put(so, s) }, nil
 }
 
-// kvCacheTypeFromString maps a KV cache type string to the integer enum
-// used by the C binding: 0=f16 (default), 1=q8_0, 2=q4_0.
-func kvCacheTypeFromString(s string) int32 {
-	switch strings.ToLower(strings.TrimSpace(s)) {
-	case "q8_0", "q8":
-		return 1
-	case "q4_0", "q4":
-		return 2
-	default:
-		return 0 // f16
+// Upper bounds on tokens per fused GenerateStep call. With stop strings a
+// step may overshoot the stop by up to the step size (the extra tokens are
+// decoded but discarded), so those requests use shorter steps.
+const (
+	fusedStepMax     = 32
+	fusedStepStopMax = 8
+)
+
+// fusedSteps returns how many tokens the next GenerateStep may produce:
+// bounded by the remaining budget and, when context shifting is on, by the
+// distance to the shift threshold so maybeShiftContext still runs in time.
+func (a *Adapter) fusedSteps(remaining int, hasStops bool) int {
+	n := fusedStepMax
+	if hasStops {
+		n = fusedStepStopMax
+	}
+	if remaining < n {
+		n = remaining
+	}
+	if a.contextShiftEnabled() {
+		threshold := int(float64(a.contextSize()) * a.contextShiftThreshold())
+		if room := threshold - int(a.ctx.Pos()); room < n {
+			n = room
+		}
+	}
+	if n < 1 {
+		n = 1
 	}
+	return n
+}
+
+// samplerOptionsFor converts per-request generation options into sampler
+// chain options.
+func samplerOptionsFor(opts runtime.GenerationOptions) SamplerOptions {
+	return SamplerOptions{
+		Temperature:      float32(opts.Temperature),
+		TopK:             int32(opts.TopK),
+		TopP:             float32(opts.TopP),
+		MinP:             float32(opts.MinP),
+		RepeatPenalty:    float32(opts.RepeatPenalty),
+		RepeatLastN:      int32(opts.RepeatLastN),
+		FrequencyPenalty: 0.0,
+		PresencePenalty:  0.0,
+		Seed:             0xFFFFFFFF,
+		Grammar:          opts.Grammar,
+	}
+}
+
+// kvCacheTypeOrDefault normalizes a configured KV cache type. A name the
+// linked ggml does not know (known returns false) falls back to the
+// default, f16, with a warning rather than failing the model load.
+func kvCacheTypeOrDefault(name string, known func(string) bool) string {
+	name = normalizeKVCacheType(name)
+	if name != "" && !known(name) {
+		log.Printf("native: warning: unknown KV cache type %q, using f16", name)
+		return ""
+	}
+	return name
+}
+
+// speculationModes reports which speculative decoding is configured:
+// prompt lookup (speculative_mode: ngram, which takes precedence) or a
+// draft model. Neither is enabled on a model with recurrent memory, whose
+// KV cache cannot be cut back past rejected drafts.
+func speculationModes(mode, draftModelPath string, recurrent bool) (ngram, draft bool) {
+	if recurrent {
+		return false, false
+	}
+	ngram = strings.EqualFold(strings.TrimSpace(mode), "ngram")
+	return ngram, draftModelPath != "" && !ngram
+}
+
+// kvTypeQuantized reports whether a normalized KV cache type name is a
+// quantized (block) type rather than a float type.
+func kvTypeQuantized(name string) bool {
+	switch name {
+	case "", "f32", "f16", "bf16":
+		return false
+	}
+	return true
+}
+
+// firstNonEmpty returns the first non-empty string of vals.
+func firstNonEmpty(vals ...string) string {
+	for _, v := range vals {
+		if v != "" {
+			return v
+		}
+	}
+	return ""
 }
 
 // ---------------------------------------------------------------------------
@@ -1343,7 +2206,11 @@ func kvCacheTypeFromString(s string) int32 {
 // batch size limit. This prevents "n_tokens_all <= cparams.n_batch" assertion
 // failures when processing large prompts.
 func (a *Adapter) evalTokensInChunks(tokens []int32) error {
-	batchSize := int32(a.batchSize())
+	return evalInChunks(tokens, a.batchSize(), a.ctx.Eval)
+}
+
+// evalInChunks passes tokens to eval in slices of at most batchSize.
+func evalInChunks(tokens []int32, batchSize int, eval func([]int32) error) error {
 	if batchSize <= 0 {
 		batchSize = 512
 	}
@@ -1351,11 +2218,11 @@ func (a *Adapter) evalTokensInChunks(tokens []int32) error {
 	// Process tokens in chunks to respect batch size limits
 	for len(tokens) > 0 {
 		chunk := tokens
-		if int32(len(chunk)) > batchSize {
+		if len(chunk) > batchSize {
 			chunk = tokens[:batchSize]
 		}
 
-		if err := a.ctx.Eval(chunk); err != nil {
+		if err := eval(chunk); err != nil {
 			return fmt.Errorf("eval chunk of %d tokens: %w", len(chunk), err)
 		}
 
@@ -1377,26 +2244,31 @@ type speculativeResult struct {
 	hitEOG bool
 	// drafted is the number of tokens the draft model proposed this round.
 	drafted int
-	// accepted is the number of draft tokens that matched the target model.
+	// accepted is the number of draft tokens the target model accepted.
 	// This excludes the bonus token and divergence-replacement tokens.
 	accepted int
+	// draftN is the draft length the controller chose for this round
+	// (0 when the round fell back to standard generation).
+	draftN int
 }
 
 // speculativeGenerate performs one round of speculative decoding:
 //
-//  1. Draft phase: the small draft model greedily generates N candidate tokens.
-//  2. Verify phase: the target model evaluates all N draft tokens in a single
-//     batch with logits computed for every position.
-//  3. Accept phase: compare each draft token against the target model's argmax.
-//     Accept all matching tokens; at the first mismatch, use the target's token.
-//
-// Returns the accepted tokens (1 to N+1 per call). The caller should append
-// these to the output and advance both KV caches accordingly.
+//  1. Draft phase: the small draft model samples N candidate tokens with
+//     draftSampler, recording the distribution each was drawn from.
+//  2. Verify phase: the target model evaluates the drafts in a single batch
+//     and oe_speculative_verify accepts each with probability min(1, p/q),
+//     replacing the first rejected draft with a token drawn from the
+//     residual distribution (or adding a bonus token when all pass). The
+//     output is distributed exactly as if sampler had generated it, so
+//     sampled (temperature > 0) generation stays lossless; with a greedy
+//     sampler this reduces to argmax matching.
 //
-// Both the target and draft model KV caches must be in sync at the position
-// where the last token was evaluated (i.e., the prompt has already been
-// processed on both models).
-func (a *Adapter) speculativeGenerate(sampler *SamplerChain) (speculativeResult, error) {
+// Returns the emitted tokens (1 to N+1 per call). On return every emitted
+// token has been evaluated on both models and the target's logits predict
+// the next token, which is also the state this function expects on entry
+// (the prompt processed on both models).
+func (a *Adapter) speculativeGenerate(sampler, draftSampler *SamplerChain) (speculativeResult, error) {
 	// First, ensure we have space for speculative decoding
 	a.maybeShiftContext()
 
@@ -1408,76 +2280,43 @@ func (a *Adapter) speculativeGenerate(sampler *SamplerChain) (speculativeResult,
 		if len(a.lastPromptTokens) > 0 {
 			if err := a.syncDraftPrompt(a.lastPromptTokens); err != nil {
 				log.Printf("native: draft resync failed, falling back to standard: %v", err)
-				// Fall back to single token generation
-				token, err := a.ctx.SampleToken(sampler)
-				if err != nil {
-					return speculativeResult{}, fmt.Errorf("native: sample fallback: %w", err)
-				}
-				piece := a.model.TokenToPiece(token)
-				return speculativeResult{
-					tokens:   []int32{token},
-					pieces:   []string{piece},
-					hitEOG:   a.model.TokenIsEOG(token),
-					drafted:  0,
-					accepted: 0,
-				}, nil
+				return a.speculativeFallback(sampler)
 			}
 		}
 	}
 
-	// Calculate how many draft tokens we can safely generate
-	// We need: currentPos + n <= batchSize AND room in context
-	currentPos := int(a.ctx.Pos())
-	batchSize := a.batchSize()
-	ctxSize := a.contextSize()
-
-	// Determine effective speculative N based on available batch capacity and context space
-	n := a.speculativeN
-
-	// Cap by batch size
-	if currentPos+n > batchSize {
-		n = batchSize - currentPos - 1 // leave 1 token margin for safety
-	}
-
-	// Cap by available context space (with reserve)
-	availableContext := ctxSize - currentPos - int(float64(ctxSize)*a.contextReserveRatio())
-	if n > availableContext {
-		n = availableContext - 1
-	}
-
+	// Draft length chosen by the adaptive controller, then capped by
+	// available batch capacity and context space.
+	draftN := a.draftCtl.next()
+	n := a.draftBudget(draftN)
 	if n <= 0 {
 		// No room for speculative decoding, fall back to single token
-		token, err := a.ctx.SampleToken(sampler)
-		if err != nil {
-			return speculativeResult{}, fmt.Errorf("native: sample fallback: %w", err)
-		}
-		piece := a.model.TokenToPiece(token)
-		return speculativeResult{
-			tokens:   []int32{token},
-			pieces:   []string{piece},
-			hitEOG:   a.model.TokenIsEOG(token),
-			drafted:  0,
-			accepted: 0,
-		}, nil
+		return a.speculativeFallback(sampler)
 	}
 
-	vocabSize := a.model.VocabSize()
-
-	// --- 1. Draft phase: generate N candidate tokens with the draft model ---
+	// --- 1. Draft phase: sample N candidate tokens with the draft model ---
+	vocabSize := int(a.model.VocabSize())
+	if cap(a.draftProbs) < n*vocabSize {
+		a.draftProbs = make([]float32, n*vocabSize)
+	}
 	draftTokens := make([]int32, 0, n)
-	draftSampler := NewSamplerChain(SamplerOptions{
-		// Use greedy for drafting — fast and deterministic.
-		Temperature: 0.0,
-		Seed:        0xFFFFFFFF,
-	})
-	defer draftSampler.Close()
+	draftStart := a.draftCtx.Pos()
+	draftPerf := a.draftCtx.Perf()
+	draftT0 := time.Now()
 
 	for i := 0; i < n; i++ {
-		token, err := a.draftCtx.SampleToken(draftSampler)
+		token, topP, err := a.draftCtx.SampleTokenProbs(draftSampler, a.draftProbs[i*vocabSize:(i+1)*vocabSize])
 		if err != nil {
+			a.draftCtx.TruncateKV(draftStart)
 			return speculativeResult{}, fmt.Errorf("native: draft sample: %w", err)
 		}
 
+		// An unsure draft is likely to be rejected: stop drafting and
+		// verify what we have (always at least one token).
+		if i > 0 && topP < draftMinTopProb {
+			break
+		}
+
 		draftTokens = append(draftTokens, token)
 
 		// Check if the draft model hit EOG. If so, we still need to verify
@@ -1489,127 +2328,319 @@ func (a *Adapter) speculativeGenerate(sampler *SamplerChain) (speculativeResult,
 		// Advance draft model KV cache for next token.
 		if i < n-1 { // don't eval after the last draft token
 			if err := a.draftCtx.EvalToken(token); err != nil {
+				a.draftCtx.TruncateKV(draftStart)
 				return speculativeResult{}, fmt.Errorf("native: draft eval: %w", err)
 			}
 		}
 	}
 
-	if len(draftTokens) == 0 {
-		// Shouldn't happen, but fall back to single-token generation.
-		token, err := a.ctx.SampleToken(sampler)
-		if err != nil {
-			return speculativeResult{}, fmt.Errorf("native: sample fallback: %w", err)
-		}
-		piece := a.model.TokenToPiece(token)
-		return speculativeResult{
-			tokens: []int32{token},
-			pieces: []string{piece},
-			hitEOG: a.model.TokenIsEOG(token),
-		}, nil
-	}
-
-	// --- 2. Verify phase: evaluate draft tokens on target model in one batch ---
-	// Use EvalLogitsAll to get logits at every position.
-	targetPos := a.ctx.Pos() // save position before eval
-	if err := a.ctx.EvalLogitsAll(draftTokens); err != nil {
-		// Verification failed; rollback target model to pre-verify state.
-		a.ctx.TruncateKV(targetPos)
+	draftMs := perfDeltaMs(draftPerf, a.draftCtx.Perf(), draftT0)
+
+	// --- 2. Verify phase: rejection sampling against the target model ---
+	targetPos := a.ctx.Pos()
+	targetPerf := a.ctx.Perf()
+	verifyT0 := time.Now()
+	emitted, draftMatches, err := a.ctx.SpeculativeVerify(sampler, draftTokens, a.draftProbs[:len(draftTokens)*vocabSize])
+	if err != nil {
+		a.draftCtx.TruncateKV(draftStart)
 		return speculativeResult{}, fmt.Errorf("native: verify batch: %w", err)
 	}
+	a.draftCtl.observe(len(draftTokens), draftMatches,
+		draftMs/float64(len(draftTokens)), perfDeltaMs(targetPerf, a.ctx.Perf(), verifyT0))
 
-	// --- 3. Accept phase: compare draft vs target at each position ---
-	accepted := make([]int32, 0, len(draftTokens)+1)
-	acceptedPieces := make([]string, 0, len(draftTokens)+1)
+	pieces := make([]string, len(emitted))
 	hitEOG := false
-	draftMatches := 0 // count of draft tokens that matched target
-
-	for i, draftToken := range draftTokens {
-		// Get target model's logits at position i in the batch.
-		logits := a.ctx.GetLogitsAt(int32(i), vocabSize)
-		if logits == nil {
-			// Can't verify this position — accept what we have.
-			break
+	for j, tok := range emitted {
+		pieces[j] = a.model.TokenToPiece(tok)
+		if a.model.TokenIsEOG(tok) {
+			hitEOG = true
 		}
+	}
 
-		targetToken := argmaxToken(logits)
-
-		if draftToken == targetToken {
-			// Draft agrees with target — accept this token.
-			accepted = append(accepted, draftToken)
-			acceptedPieces = append(acceptedPieces, a.model.TokenToPiece(draftToken))
-			draftMatches++
-			if a.model.TokenIsEOG(draftToken) {
-				hitEOG = true
-				break
-			}
-		} else {
-			// Divergence — reject draft token, use target's choice instead.
-			accepted = append(accepted, targetToken)
-			acceptedPieces = append(acceptedPieces, a.model.TokenToPiece(targetToken))
-			if a.model.TokenIsEOG(targetToken) {
-				hitEOG = true
-			}
+	// --- 3. Draft KV sync ---
+	// The draft model evaluated draft tokens that match the emitted ones
+	// up to the first rejection. Keep those, drop the rest and evaluate
+	// the remaining emitted tokens (correction / bonus).
+	keep := int(a.draftCtx.Pos() - draftStart)
+	if keep > draftMatches {
+		keep = draftMatches
+	}
+	a.draftCtx.TruncateKV(draftStart + int32(keep))
+	for _, tok := range emitted[keep:] {
+		if err := a.draftCtx.EvalToken(tok); err != nil {
+			// Non-fatal: the next round resyncs the draft model from the
+			// prompt when its position disagrees with the target's.
+			log.Printf("native: draft model sync eval failed: %v", err)
 			break
 		}
 	}
+	if a.ctx.Pos() != targetPos+int32(len(emitted)) {
+		log.Printf("native: target position %d after verify, expected %d", a.ctx.Pos(), targetPos+int32(len(emitted)))
+	}
 
-	// If all N draft tokens matched, we can also accept one more token from
-	// the target's logits at the last position (bonus token).
-	if !hitEOG && len(accepted) == len(draftTokens) && !a.model.TokenIsEOG(draftTokens[len(draftTokens)-1]) {
-		// The target model evaluated the draft tokens, so the logits at
-		// position N-1 actually predict the token AFTER the last draft token.
-		// We already read those logits above when we verified the last draft
-		// token. To get a true bonus token, we'd need to sample from the
-		// target model's last output. Use the provided sampler for this.
-		bonusToken, err := a.ctx.SampleToken(sampler)
-		if err == nil {
-			accepted = append(accepted, bonusToken)
-			acceptedPieces = append(acceptedPieces, a.model.TokenToPiece(bonusToken))
-			if a.model.TokenIsEOG(bonusToken) {
-				hitEOG = true
-			}
-		}
+	return speculativeResult{
+		tokens:   emitted,
+		pieces:   pieces,
+		hitEOG:   hitEOG,
+		drafted:  len(draftTokens),
+		accepted: draftMatches,
+		draftN:   draftN,
+	}, nil
+}
+
+// draftBudget caps a desired draft length so the verify batch fits in one
+// decode and the drafts plus the correction or bonus token fit in the
+// context (keeping the shift reserve). May return <= 0.
+func (a *Adapter) draftBudget(n int) int {
+	if batchSize := a.batchSize(); n > batchSize-1 {
+		n = batchSize - 1
+	}
+	ctxSize := a.contextSize()
+	available := ctxSize - int(a.ctx.Pos()) - int(float64(ctxSize)*a.contextReserveRatio())
+	if n > available-1 {
+		n = available - 1
 	}
+	return n
+}
 
-	// --- 4. KV cache cleanup ---
-	// Truncate target model's KV cache to only include accepted tokens.
-	// The target model evaluated all N draft tokens, but we may have
-	// rejected some. Truncate to: original position + accepted count.
-	acceptedCount := int32(len(accepted))
-	finalTargetPos := targetPos + acceptedCount
-	if finalTargetPos < a.ctx.Pos() {
-		a.ctx.TruncateKV(finalTargetPos)
-	}
-
-	// Sync draft model's KV cache with what was accepted.
-	// The draft model may have evaluated more tokens than were accepted.
-	// Truncate it back to the same position as the target.
-	draftFinalPos := targetPos + acceptedCount
-	if draftFinalPos < a.draftCtx.Pos() {
-		a.draftCtx.TruncateKV(draftFinalPos)
-	} else if draftFinalPos > a.draftCtx.Pos() {
-		// Draft model is behind target (e.g., bonus token was accepted).
-		// Eval the extra accepted tokens on the draft model to keep in sync.
-		draftBehind := a.draftCtx.Pos()
-		for j := draftBehind - targetPos; j < acceptedCount; j++ {
-			if err := a.draftCtx.EvalToken(accepted[j]); err != nil {
-				// Non-fatal: draft model desync means next round will
-				// produce worse drafts, but generation still works.
+// speculativeFallback generates one token the standard way when a
+// speculative round is not possible, keeping the draft model in step.
+func (a *Adapter) speculativeFallback(sampler *SamplerChain) (speculativeResult, error) {
+	inSync := a.draftCtx != nil && a.draftCtx.Pos() == a.ctx.Pos()
+	step, err := a.ctx.GenerateStep(sampler, 1, true)
+	if err != nil {
+		return speculativeResult{}, fmt.Errorf("native: sample fallback: %w", err)
+	}
+	if inSync {
+		for _, tok := range step.Tokens {
+			if err := a.draftCtx.EvalToken(tok); err != nil {
 				log.Printf("native: draft model sync eval failed: %v", err)
-				break
 			}
 		}
 	}
+	return speculativeResult{
+		tokens: step.Tokens,
+		pieces: step.Pieces,
+		hitEOG: step.EOG,
+	}, nil
+}
+
+const (
+	// ngramMaxMatch and ngramMinMatch bound the length of the trailing
+	// n-gram prompt lookup searches for; longer matches are tried first
+	// because they predict the continuation more reliably.
+	ngramMaxMatch = 4
+	ngramMinMatch = 2
+)
+
+// ngramGenerate performs one round of prompt-lookup speculative decoding:
+// the continuation of the most recent earlier occurrence of history's
+// trailing n-gram is proposed as the draft and verified like a draft
+// model's. Drafts are deterministic, so their draft distributions are
+// one-hot and rejection sampling accepts each with the target's own
+// probability, keeping sampled output exact. history holds the prompt and
+// everything generated so far. With no match, one token is generated the
+// standard way.
+func (a *Adapter) ngramGenerate(sampler *SamplerChain, history []int32) (speculativeResult, error) {
+	a.maybeShiftContext()
+
+	n := a.draftBudget(a.speculativeN)
+	draft := ngramLookup(history, n)
+	if len(draft) == 0 {
+		return a.speculativeFallback(sampler)
+	}
+
+	vocabSize := int(a.model.VocabSize())
+	if cap(a.draftProbs) < len(draft)*vocabSize {
+		a.draftProbs = make([]float32, len(draft)*vocabSize)
+	}
+	probs := a.draftProbs[:len(draft)*vocabSize]
+	clear(probs)
+	for i, tok := range draft {
+		probs[i*vocabSize+int(tok)] = 1
+	}
 
+	emitted, accepted, err := a.ctx.SpeculativeVerify(sampler, draft, probs)
+	if err != nil {
+		return speculativeResult{}, fmt.Errorf("native: verify lookup draft: %w", err)
+	}
+
+	pieces := make([]string, len(emitted))
+	hitEOG := false
+	for j, tok := range emitted {
+		pieces[j] = a.model.TokenToPiece(tok)
+		if a.model.TokenIsEOG(tok) {
+			hitEOG = true
+		}
+	}
 	return speculativeResult{
-		tokens:   accepted,
-		pieces:   acceptedPieces,
+		tokens:   emitted,
+		pieces:   pieces,
 		hitEOG:   hitEOG,
-		drafted:  len(draftTokens),
-		accepted: draftMatches,
+		drafted:  len(draft),
+		accepted: accepted,
+		draftN:   len(draft),
 	}, nil
 }
 
+// ngramLookup finds the most recent earlier occurrence of the last
+// ngramMaxMatch..ngramMinMatch tokens of history and returns up to maxN
+// tokens that followed it, or nil if there is none.
+func ngramLookup(history []int32, maxN int) []int32 {
+	if maxN <= 0 {
+		return nil
+	}
+	for size := ngramMaxMatch; size >= ngramMinMatch; size-- {
+		if len(history) <= size {
+			continue
+		}
+		key := history[len(history)-size:]
+		for i := len(history) - size - 1; i >= 0; i-- {
+			if history[i] != key[0] || !equalTokens(history[i:i+size], key) {
+				continue
+			}
+			end := i + size + maxN
+			if end > len(history) {
+				end = len(history)
+			}
+			return history[i+size : end]
+		}
+	}
+	return nil
+}
+
+func equalTokens(a, b []int32) bool {
+	if len(a) != len(b) {
+		return false
+	}
+	for i := range a {
+		if a[i] != b[i] {
+			return false
+		}
+	}
+	return true
+}
+
+// draftMinTopProb is the draft confidence below which a round stops
+// drafting early: a token the draft model itself considers unlikely is
+// rarely accepted, so verifying it only wastes draft and batch compute.
+const draftMinTopProb = 0.3
+
+// draftController picks the draft length of each speculative round. It
+// keeps an EWMA of the per-token acceptance rate alpha and of the measured
+// cost of one draft token and of one verify round, and chooses the N that
+// maximizes the expected emitted tokens per millisecond,
+//
+//	(1 - alpha^(N+1)) / (1 - alpha) / (N*draftMs + verifyMs)
+//
+// so drafts get longer when the draft model tracks the target and shrink
+// to a single token when acceptance collapses (code, other languages).
+// Costs carry over between requests; acceptance restarts at the prior on
+// each request because it depends on the content being generated.
+type draftController struct {
+	maxN     int
+	alpha    float64 // EWMA per-token acceptance rate
+	draftMs  float64 // EWMA cost of one draft token (sample + decode)
+	verifyMs float64 // EWMA cost of one verify round on the target
+	rounds   int     // rounds observed since begin
+}
+
+const (
+	// draftEWMAWeight is the weight of the newest round in each EWMA.
+	draftEWMAWeight = 0.3
+
+	// draftPriorAlpha is the acceptance rate assumed at request start.
+	draftPriorAlpha = 0.7
+)
+
+// newDraftController creates a controller drafting at most maxN tokens.
+func newDraftController(maxN int) *draftController {
+	if maxN < 1 {
+		maxN = 1
+	}
+	return &draftController{maxN: maxN, alpha: draftPriorAlpha}
+}
+
+// begin resets the acceptance estimate for a new request.
+func (d *draftController) begin() {
+	d.alpha = draftPriorAlpha
+	d.rounds = 0
+}
+
+// next returns the draft length for the coming round.
+func (d *draftController) next() int {
+	if d.draftMs <= 0 || d.verifyMs <= 0 {
+		return d.maxN // no cost measurements yet
+	}
+	best, bestRate := 1, 0.0
+	for n := 1; n <= d.maxN; n++ {
+		if rate := expectedTokens(d.alpha, n) / (float64(n)*d.draftMs + d.verifyMs); rate > bestRate {
+			best, bestRate = n, rate
+		}
+	}
+	return best
+}
+
+// observe folds one round into the estimates: drafted tokens proposed,
+// accepted of them taken, and the measured per-draft-token and verify
+// costs in milliseconds (ignored when not positive).
+func (d *draftController) observe(drafted, accepted int, draftMs, verifyMs float64) {
+	if drafted <= 0 {
+		return
+	}
+	d.rounds++
+	d.alpha = ewma(d.alpha, float64(accepted)/float64(drafted))
+	if draftMs > 0 {
+		d.draftMs = ewmaInit(d.draftMs, draftMs)
+	}
+	if verifyMs > 0 {
+		d.verifyMs = ewmaInit(d.verifyMs, verifyMs)
+	}
+}
+
+// expectedTokens is the expected number of tokens emitted by a round of n
+// drafts when each is accepted independently with probability alpha: the
+// accepted prefix plus the correction or bonus token.
+func expectedTokens(alpha float64, n int) float64 {
+	if alpha >= 1 {
+		return float64(n + 1)
+	}
+	return (1 - math.Pow(alpha, float64(n+1))) / (1 - alpha)
+}
+
+func ewma(prev, sample float64) float64 {
+	return prev + draftEWMAWeight*(sample-prev)
+}
+
+// ewmaInit is ewma that adopts the first sample outright.
+func ewmaInit(prev, sample float64) float64 {
+	if prev <= 0 {
+		return sample
+	}
+	return ewma(prev, sample)
+}
+
+// perfDeltaMs returns the decode time spent between two perf snapshots of
+// a context, falling back to wall-clock time since t0 when the llama.cpp
+// counters did not advance (perf collection disabled).
+func perfDeltaMs(before, after PerfData, t0 time.Time) float64 {
+	if ms := (after.EvalMs + after.PromptMs) - (before.EvalMs + before.PromptMs); ms > 0 {
+		return ms
+	}
+	return float64(time.Since(t0).Microseconds()) / 1000.0
+}
+
+// draftSamplerOptions derives the draft model's sampler from the target's:
+// the same temperature and filters, so the draft proposes from a similar
+// distribution, but no penalties, whose history the draft does not track.
+func draftSamplerOptions(opts SamplerOptions) SamplerOptions {
+	opts.RepeatPenalty = 1.0
+	opts.RepeatLastN = 0
+	opts.FrequencyPenalty = 0
+	opts.PresencePenalty = 0
+	return opts
+}
+
 // syncDraftPrompt evaluates the prompt tokens on the draft model so its
 // KV cache is in sync with the target model. This must be called after
 // the target model processes the prompt and before speculative generation.
@@ -1685,22 +2716,6 @@ func (a *Adapter) syncDraftPrompt(tokens []int32) error {
 	return nil
 }
 
-// argmaxToken returns the token ID with the highest logit value.
-func argmaxToken(logits []float32) int32 {
-	if len(logits) == 0 {
-		return 0
-	}
-	best := int32(0)
-	bestVal := logits[0]
-	for i := int32(1); i < int32(len(logits)); i++ {
-		if logits[i] > bestVal {
-			bestVal = logits[i]
-			best = i
-		}
-	}
-	return best
-}
-
 func mergeNativeOptions(base config.GenerationDefaults, override runtime.GenerationOptions) runtime.GenerationOptions {
 	result := runtime.GenerationOptions{
 		MaxTokens:     base.MaxTokens,
@@ -1737,6 +2752,8 @@ func mergeNativeOptions(base config.GenerationDefaults, override runtime.Generat
 	if len(override.Stop) > 0 {
 		result.Stop = append([]string(nil), override.Stop...)
 	}
+	result.Grammar = override.Grammar
+	result.Choices = override.Choices
 
 	return result
 }
@@ -3,97 +3,100 @@
 package native
 
 import (
-	"math/rand"
+	"math"
+	"os"
 	"strings"
 	"testing"
+	"time"
 
 	"OpenEye/internal/config"
 	"OpenEye/internal/runtime"
 )
 
 // ---------------------------------------------------------------------------
-// kvCacheTypeFromString
+// normalizeKVCacheType
 // ---------------------------------------------------------------------------
 
-func TestKVCacheTypeFromString(t *testing.T) {
+func TestNormalizeKVCacheType(t *testing.T) {
 	tests := []struct {
-		input string
-		want  int32
+		input     string
+		want      string
+		quantized bool
 	}{
-		{"f16", 0},
-		{"F16", 0},
-		{"", 0},
-		{"unknown", 0},
-		{"q8_0", 1},
-		{"Q8_0", 1},
-		{"q8", 1},
-		{"q4_0", 2},
-		{"Q4_0", 2},
-		{"q4", 2},
-		{"  q8_0  ", 1}, // whitespace
+		{"f16", "f16", false},
+		{"F16", "f16", false},
+		{"", "", false},
+		{"bf16", "bf16", false},
+		{"q8_0", "q8_0", true},
+		{"Q8_0", "q8_0", true},
+		{"q8", "q8_0", true},
+		{"q4_0", "q4_0", true},
+		{"q4", "q4_0", true},
+		{"Q5_1", "q5_1", true},
+		{"iq4_nl", "iq4_nl", true},
+		{"  q8_0  ", "q8_0", true}, // whitespace
 	}
 	for _, tt := range tests {
-		got := kvCacheTypeFromString(tt.input)
+		got := normalizeKVCacheType(tt.input)
 		if got != tt.want {
-			t.Errorf("kvCacheTypeFromString(%q) = %d, want %d", tt.input, got, tt.want)
+			t.Errorf("normalizeKVCacheType(%q) = %q, want %q", tt.input, got, tt.want)
+		}
+		if q := kvTypeQuantized(got); q != tt.quantized {
+			t.Errorf("kvTypeQuantized(%q) = %v, want %v", got, q, tt.quantized)
 		}
 	}
 }
 
-// ---------------------------------------------------------------------------
-// argmaxToken
-// ---------------------------------------------------------------------------
-
-func TestArgmaxToken(t *testing.T) {
-	t.Run("empty", func(t *testing.T) {
-		got := argmaxToken(nil)
-		if got != 0 {
-			t.Errorf("argmaxToken(nil) = %d, want 0", got)
-		}
-	})
-
-	t.Run("single element", func(t *testing.T) {
-		got := argmaxToken([]float32{1.0})
-		if got != 0 {
-			t.Errorf("argmaxToken([1.0]) = %d, want 0", got)
-		}
-	})
-
-	t.Run("max at end", func(t *testing.T) {
-		got := argmaxToken([]float32{1.0, 2.0, 3.0, 4.0, 5.0})
-		if got != 4 {
-			t.Errorf("argmaxToken = %d, want 4", got)
-		}
-	})
-
-	t.Run("max at start", func(t *testing.T) {
-		got := argmaxToken([]float32{9.0, 2.0, 3.0, 4.0, 5.0})
-		if got != 0 {
-			t.Errorf("argmaxToken = %d, want 0", got)
+func TestKVCacheTypeOrDefault(t *testing.T) {
+	known := func(name string) bool {
+		switch name {
+		case "f16", "q8_0", "q4_0":
+			return true
 		}
-	})
-
-	t.Run("max in middle", func(t *testing.T) {
-		got := argmaxToken([]float32{1.0, 2.0, 99.0, 4.0, 5.0})
-		if got != 2 {
-			t.Errorf("argmaxToken = %d, want 2", got)
-		}
-	})
-
-	t.Run("negative values", func(t *testing.T) {
-		got := argmaxToken([]float32{-5.0, -3.0, -10.0, -1.0})
-		if got != 3 {
-			t.Errorf("argmaxToken = %d, want 3 (largest negative)", got)
+		return false
+	}
+	tests := []struct {
+		input string
+		want  string
+	}{
+		{"", ""},
+		{"F16", "f16"},
+		{"q8", "q8_0"},
+		{"unknown", ""}, // falls back to the default (f16)
+		{"q9_9", ""},
+	}
+	for _, tt := range tests {
+		if got := kvCacheTypeOrDefault(tt.input, known); got != tt.want {
+			t.Errorf("kvCacheTypeOrDefault(%q) = %q, want %q", tt.input, got, tt.want)
 		}
-	})
+	}
+}
 
-	t.Run("duplicate max", func(t *testing.T) {
-		// Should return first occurrence.
-		got := argmaxToken([]float32{1.0, 5.0, 5.0, 3.0})
-		if got != 1 {
-			t.Errorf("argmaxToken = %d, want 1 (first occurrence)", got)
-		}
-	})
+func TestSpeculationModes(t *testing.T) {
+	tests := []struct {
+		name      string
+		mode      string
+		draft     string
+		recurrent bool
+		wantNgram bool
+		wantDraft bool
+	}{
+		{"none", "", "", false, false, false},
+		{"ngram", " NGram ", "", false, true, false},
+		{"draft model", "", "draft.gguf", false, false, true},
+		{"ngram overrides draft", "ngram", "draft.gguf", false, true, false},
+		{"recurrent ngram", "ngram", "", true, false, false},
+		{"recurrent draft", "", "draft.gguf", true, false, false},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			ngram, draft := speculationModes(tt.mode, tt.draft, tt.recurrent)
+			if ngram != tt.wantNgram || draft != tt.wantDraft {
+				t.Errorf("speculationModes = (%v, %v), want (%v, %v)",
+					ngram, draft, tt.wantNgram, tt.wantDraft)
+			}
+		})
+	}
 }
 
 // ---------------------------------------------------------------------------
@@ -125,6 +128,13 @@ func TestCommonPrefixLen(t *testing.T) {
 	}
 }
 
+func TestSumLensSkipsUnwrittenPieces(t *testing.T) {
+	// A negative length marks a piece that did not fit in the step buffer.
+	if got := sumLens([]int32{3, -300, 5, 0}); got != 8 {
+		t.Errorf("sumLens = %d, want 8", got)
+	}
+}
+
 // ---------------------------------------------------------------------------
 // shouldStop
 // ---------------------------------------------------------------------------
@@ -303,37 +313,393 @@ func TestMergeNativeOptions(t *testing.T) {
 }
 
 // ---------------------------------------------------------------------------
-// Benchmarks
+// Prompt-prefix snapshots
 // ---------------------------------------------------------------------------
 
-func BenchmarkArgmaxToken(b *testing.B) {
-	// Simulate a vocab of 32000 tokens (typical for small LLMs).
-	logits := make([]float32, 32000)
-	r := rand.New(rand.NewSource(42))
-	for i := range logits {
-		logits[i] = r.Float32()*20 - 10 // range [-10, 10]
+func TestTokenPrefixHash(t *testing.T) {
+	a := tokenPrefixHash([]int32{1, 2, 3})
+	if a != tokenPrefixHash([]int32{1, 2, 3}) {
+		t.Error("hash should be deterministic")
+	}
+	if a == tokenPrefixHash([]int32{1, 2, 4}) {
+		t.Error("different tokens should hash differently")
 	}
+	if a == tokenPrefixHash([]int32{1, 2}) {
+		t.Error("prefix should hash differently from the full sequence")
+	}
+}
 
-	b.ResetTimer()
-	for i := 0; i < b.N; i++ {
-		argmaxToken(logits)
+func TestSnapshotListAndPrune(t *testing.T) {
+	dir := t.TempDir()
+	key := snapshotModelKey("test-model", 1000, 2048, "", "")
+	other := snapshotModelKey("other-model", 1000, 2048, "", "")
+
+	base := time.Now().Add(-time.Hour)
+	var paths []string
+	for i := 0; i < 3; i++ {
+		p := snapshotPath(dir, key, []int32{int32(i)})
+		if err := os.WriteFile(p, []byte("x"), 0644); err != nil {
+			t.Fatal(err)
+		}
+		mtime := base.Add(time.Duration(i) * time.Minute)
+		os.Chtimes(p, mtime, mtime)
+		paths = append(paths, p)
+	}
+	if err := os.WriteFile(snapshotPath(dir, other, []int32{9}), []byte("x"), 0644); err != nil {
+		t.Fatal(err)
+	}
+
+	got := listSnapshots(dir, key)
+	if len(got) != 3 {
+		t.Fatalf("listSnapshots returned %d files, want 3", len(got))
+	}
+	if got[0] != paths[2] {
+		t.Errorf("newest snapshot = %s, want %s", got[0], paths[2])
+	}
+
+	pruneSnapshots(dir, key, 1)
+	got = listSnapshots(dir, key)
+	if len(got) != 1 || got[0] != paths[2] {
+		t.Errorf("after prune = %v, want [%s]", got, paths[2])
+	}
+	if len(listSnapshots(dir, other)) != 1 {
+		t.Error("prune must not touch other models' snapshots")
+	}
+}
+
+// ---------------------------------------------------------------------------
+// draftController
+// ---------------------------------------------------------------------------
+
+func TestExpectedTokens(t *testing.T) {
+	if got := expectedTokens(1, 4); got != 5 {
+		t.Errorf("expectedTokens(1, 4) = %f, want 5", got)
+	}
+	if got := expectedTokens(0, 4); got != 1 {
+		t.Errorf("expectedTokens(0, 4) = %f, want 1", got)
+	}
+	// 1 + 0.5 + 0.25 = 1.75
+	if got := expectedTokens(0.5, 2); math.Abs(got-1.75) > 1e-9 {
+		t.Errorf("expectedTokens(0.5, 2) = %f, want 1.75", got)
 	}
 }
 
-func BenchmarkArgmaxTokenLargeVocab(b *testing.B) {
-	// 128k vocab (some newer models).
-	logits := make([]float32, 128000)
-	r := rand.New(rand.NewSource(42))
-	for i := range logits {
-		logits[i] = r.Float32()*20 - 10
+func TestDraftControllerAdapts(t *testing.T) {
+	d := newDraftController(8)
+	if got := d.next(); got != 8 {
+		t.Fatalf("next() before measurements = %d, want max 8", got)
 	}
 
-	b.ResetTimer()
-	for i := 0; i < b.N; i++ {
-		argmaxToken(logits)
+	// Cheap drafts that are always accepted: draft the maximum.
+	for i := 0; i < 10; i++ {
+		d.observe(8, 8, 1, 20)
+	}
+	if got := d.next(); got != 8 {
+		t.Errorf("next() at full acceptance = %d, want 8", got)
+	}
+
+	// Acceptance collapses: fall back to the shortest draft.
+	for i := 0; i < 20; i++ {
+		d.observe(4, 0, 1, 20)
+	}
+	if got := d.next(); got != 1 {
+		t.Errorf("next() at zero acceptance = %d, want 1", got)
+	}
+
+	// A new request restarts acceptance at the prior but keeps costs.
+	d.begin()
+	if d.alpha != draftPriorAlpha || d.draftMs <= 0 || d.verifyMs <= 0 {
+		t.Errorf("begin() = alpha %f draftMs %f verifyMs %f", d.alpha, d.draftMs, d.verifyMs)
+	}
+}
+
+// ---------------------------------------------------------------------------
+// ngramLookup
+// ---------------------------------------------------------------------------
+
+func TestNgramLookup(t *testing.T) {
+	tests := []struct {
+		name    string
+		history []int32
+		maxN    int
+		want    []int32
+	}{
+		{"no match", []int32{1, 2, 3, 4, 5}, 3, nil},
+		{"copies continuation", []int32{1, 2, 3, 4, 5, 9, 2, 3}, 3, []int32{4, 5, 9}},
+		{"capped by maxN", []int32{1, 2, 3, 4, 5, 9, 2, 3}, 1, []int32{4}},
+		{"most recent occurrence", []int32{7, 8, 1, 7, 8, 2, 7, 8}, 2, []int32{2, 7}},
+		{"longer match preferred", []int32{5, 2, 3, 6, 1, 2, 3, 4, 0, 1, 2, 3}, 1, []int32{4}},
+		{"single token is not enough", []int32{1, 4, 6, 1}, 2, nil},
+		{"zero budget", []int32{1, 2, 3, 1, 2}, 0, nil},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got := ngramLookup(tt.history, tt.maxN)
+			if !equalTokens(got, tt.want) {
+				t.Errorf("ngramLookup = %v, want %v", got, tt.want)
+			}
+		})
+	}
+}
+
+// ---------------------------------------------------------------------------
+// shiftTokens
+// ---------------------------------------------------------------------------
+
+func TestShiftTokens(t *testing.T) {
+	tokens := []int32{1, 2, 3, 4, 5, 6, 7, 8}
+	tests := []struct {
+		name            string
+		nKeep, nDiscard int
+		want            []int32
+	}{
+		{"keeps system span", 2, 3, []int32{1, 2, 6, 7, 8}},
+		{"no keep", 0, 3, []int32{4, 5, 6, 7, 8}},
+		{"discard past end", 3, 10, []int32{1, 2, 3}},
+		{"keep covers all", 8, 2, tokens},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			got := shiftTokens(tokens, tt.nKeep, tt.nDiscard)
+			if !equalTokens(got, tt.want) {
+				t.Errorf("shiftTokens = %v, want %v", got, tt.want)
+			}
+		})
+	}
+	if tokens[2] != 3 {
+		t.Errorf("shiftTokens modified its input: %v", tokens)
+	}
+	if shiftTokens(nil, 2, 3) != nil {
+		t.Error("shiftTokens(nil) should stay nil (no cached prompt)")
+	}
+}
+
+func TestClampShift(t *testing.T) {
+	tests := []struct {
+		name                  string
+		pos, nKeep, nDiscard  int32
+		wantKeep, wantDiscard int32
+	}{
+		{"fits", 1500, 100, 1024, 100, 1024},
+		// Defaults (ctx 2048, threshold 0.6, discard 1024) with a kept span
+		// at the contextSize()/2 cap: the shift must still free space.
+		{"large kept span past threshold", 1229, 1024, 1024, 1024, 204},
+		{"span covers all but last", 10, 9, 4, 0, 4},
+		{"nothing after span", 10, 8, 4, 8, 1},
+	}
+	for _, tt := range tests {
+		t.Run(tt.name, func(t *testing.T) {
+			keep, discard := clampShift(tt.pos, tt.nKeep, tt.nDiscard)
+			if keep != tt.wantKeep || discard != tt.wantDiscard {
+				t.Errorf("clampShift = (%d, %d), want (%d, %d)",
+					keep, discard, tt.wantKeep, tt.wantDiscard)
+			}
+		})
 	}
 }
 
+// ---------------------------------------------------------------------------
+// evalInChunks
+// ---------------------------------------------------------------------------
+
+// A stable prefix snapshot evaluates a whole system prompt plus history in
+// one go after ClearContext; it must reach llama_decode in batch-sized
+// pieces.
+func TestEvalInChunks(t *testing.T) {
+	prefix := make([]int32, 1300) // longer than two batches
+	for i := range prefix {
+		prefix[i] = int32(i)
+	}
+	var got []int32
+	calls := 0
+	err := evalInChunks(prefix, 512, func(chunk []int32) error {
+		if len(chunk) > 512 {
+			t.Fatalf("chunk of %d tokens exceeds the batch size", len(chunk))
+		}
+		calls++
+		got = append(got, chunk...)
+		return nil
+	})
+	if err != nil {
+		t.Fatal(err)
+	}
+	if calls != 3 || !equalTokens(got, prefix) {
+		t.Errorf("calls = %d, tokens in order = %v", calls, equalTokens(got, prefix))
+	}
+
+	calls = 0
+	err = evalInChunks(prefix, 512, func([]int32) error {
+		calls++
+		if calls == 2 {
+			return os.ErrInvalid
+		}
+		return nil
+	})
+	if err == nil || calls != 2 {
+		t.Errorf("err = %v after %d calls, want the second chunk's error", err, calls)
+	}
+}
+
+// ---------------------------------------------------------------------------
+// prefixCache
+// ---------------------------------------------------------------------------
+
+func TestPrefixCacheLongestPrefix(t *testing.T) {
+	c := newPrefixCache(1 << 20)
+	c.insert([]int32{1, 2, 3}, []byte("abc"))
+	c.insert([]int32{1, 2, 3, 4, 5}, []byte("abcde"))
+	c.insert([]int32{1, 9}, []byte("x"))
+
+	tests := []struct {
+		query  []int32
+		maxLen int
+		want   int // length of the matched entry, 0 = miss
+	}{
+		{[]int32{1, 2, 3, 4, 5, 6}, 6, 5},
+		{[]int32{1, 2, 3, 4, 7}, 5, 3},
+		{[]int32{1, 2, 3, 4, 5}, 4, 3}, // maxLen caps the match
+		{[]int32{1, 9, 9}, 3, 2},
+		{[]int32{1, 2}, 2, 0},
+		{[]int32{7}, 1, 0},
+	}
+	for _, tt := range tests {
+		e := c.lookup(tt.query, tt.maxLen)
+		got := 0
+		if e != nil {
+			got = len(e.tokens)
+		}
+		if got != tt.want {
+			t.Errorf("lookup(%v, %d) matched %d tokens, want %d", tt.query, tt.maxLen, got, tt.want)
+		}
+	}
+}
+
+func TestPrefixCacheLRUBudget(t *testing.T) {
+	c := newPrefixCache(10)
+	c.insert([]int32{1, 1}, make([]byte, 4))
+	c.insert([]int32{2, 2}, make([]byte, 4))
+	// Touch {1,1} so {2,2} becomes least recently used.
+	c.lookup([]int32{1, 1}, 2)
+	c.insert([]int32{3, 3}, make([]byte, 4))
+
+	if c.lookup([]int32{2, 2}, 2) != nil {
+		t.Error("least recently used entry should have been evicted")
+	}
+	if c.lookup([]int32{1, 1}, 2) == nil || c.lookup([]int32{3, 3}, 2) == nil {
+		t.Error("recently used entries should survive")
+	}
+	if c.used > c.budget {
+		t.Errorf("used %d exceeds budget %d", c.used, c.budget)
+	}
+
+	c.insert([]int32{4}, make([]byte, 11))
+	if c.lookup([]int32{4}, 1) != nil {
+		t.Error("entry larger than the budget should not be cached")
+	}
+}
+
+func TestPrefixCacheReplaceAndPrune(t *testing.T) {
+	c := newPrefixCache(100)
+	c.insert([]int32{1, 2, 3}, make([]byte, 10))
+	c.insert([]int32{1, 2, 3}, make([]byte, 20))
+	if c.len() != 1 || c.used != 20 {
+		t.Errorf("replace: len=%d used=%d, want 1 and 20", c.len(), c.used)
+	}
+	c.removeEntry(c.lookup([]int32{1, 2, 3}, 3))
+	if len(c.root.children) != 0 {
+		t.Error("empty branches should be pruned")
+	}
+}
+
+// ---------------------------------------------------------------------------
+// phaseTimings
+// ---------------------------------------------------------------------------
+
+func TestPhaseTimings(t *testing.T) {
+	const target, draft, other = 0x10, 0x20, 0x30
+	events := []PerfEvent{
+		{Kind: PerfDecode, Ctx: target, StartNs: 50, DurNs: 1000}, // before the request
+		{Kind: PerfTokenize, Ctx: 0, StartNs: 100, DurNs: 5},      // prompt
+		{Kind: PerfDecode, Ctx: target, StartNs: 110, DurNs: 400, Ubatch: 2},
+		{Kind: PerfDecode, Ctx: draft, StartNs: 520, DurNs: 100, Ubatch: 1},
+		{Kind: PerfDecode, Ctx: other, StartNs: 530, DurNs: 777}, // another adapter
+		{Kind: PerfSample, Ctx: target, StartNs: 600, DurNs: 3, N: 4},
+		{Kind: PerfDetokenize, Ctx: target, StartNs: 600, DurNs: 2, N: 4},
+		{Kind: PerfDecode, Ctx: target, StartNs: 610, DurNs: 40, Ubatch: 1},
+		{Kind: PerfKVShift, Ctx: target, StartNs: 700, DurNs: 1},
+	}
+	pt := phaseTimings(events, []uint64{target, draft}, 100)
+
+	if pt.Tokenize != 5 || pt.Sample != 3 || pt.Detokenize != 2 {
+		t.Errorf("tokenize/sample/detokenize = %v/%v/%v, want 5ns/3ns/2ns", pt.Tokenize, pt.Sample, pt.Detokenize)
+	}
+	if pt.Prefill != 500 || pt.Decode != 40 {
+		t.Errorf("prefill/decode = %v/%v, want 500ns/40ns", pt.Prefill, pt.Decode)
+	}
+	if pt.DecodeCalls != 3 || pt.Ubatches != 4 || pt.KVShifts != 1 {
+		t.Errorf("calls=%d ubatches=%d shifts=%d, want 3, 4, 1", pt.DecodeCalls, pt.Ubatches, pt.KVShifts)
+	}
+
+	// Without a sample (e.g. a failed request) every decode is prefill.
+	pt = phaseTimings(events[:5], []uint64{target, draft}, 100)
+	if pt.Prefill != 500 || pt.Decode != 0 {
+		t.Errorf("no sample: prefill/decode = %v/%v, want 500ns/0", pt.Prefill, pt.Decode)
+	}
+}
+
+// ---------------------------------------------------------------------------
+// choicePlan
+// ---------------------------------------------------------------------------
+
+// prefixTokenizer is a fake tokenizer whose tokens are 3-byte chunks.
+func prefixTokenizer(s string) []int32 {
+	var toks []int32
+	for len(s) > 0 {
+		n := 3
+		if len(s) < n {
+			n = len(s)
+		}
+		var id int32
+		for _, c := range []byte(s[:n]) {
+			id = id<<8 | int32(c)
+		}
+		toks = append(toks, id)
+		s = s[n:]
+	}
+	return toks
+}
+
+func TestChoicePlan(t *testing.T) {
+	labels := []string{"ADD", "UPDATE", "NOOP"}
+	plan, ok := newChoicePlan(labels, prefixTokenizer)
+	if !ok {
+		t.Fatal("distinct first tokens should yield a plan")
+	}
+	if len(plan.allowed) != 6 {
+		t.Errorf("allowed = %d tokens, want 6 (with and without leading space)", len(plan.allowed))
+	}
+	for _, l := range labels {
+		for _, v := range []string{l, " " + l} {
+			got, ok := plan.label(labels, prefixTokenizer(v)[0])
+			if !ok || got != l {
+				t.Errorf("label(%q) = %q, %v; want %q", v, got, ok, l)
+			}
+		}
+	}
+	if _, ok := plan.label(labels, 42); ok {
+		t.Error("unknown token should not map to a label")
+	}
+
+	// "preference" and "present" share their first token.
+	if _, ok := newChoicePlan([]string{"preference", "present"}, prefixTokenizer); ok {
+		t.Error("labels sharing a first token should not yield a plan")
+	}
+}
+
+// ---------------------------------------------------------------------------
+// Benchmarks
+// ---------------------------------------------------------------------------
+
 func BenchmarkStopRingWrite(b *testing.B) {
 	ring := newStopRing([]string{"<|im_end|>", "<|endoftext|>", "</s>"})
 	token := "Hello" // typical token
@@ -396,3 +762,97 @@ func BenchmarkCommonPrefixLen(b *testing.B) {
 		commonPrefixLen(a, b2)
 	}
 }
+
+// ---------------------------------------------------------------------------
+// samplerPool
+// ---------------------------------------------------------------------------
+
+func TestSamplerPool(t *testing.T) {
+	built := 0
+	p := newSamplerPool(2, func(SamplerOptions) (*SamplerChain, error) {
+		built++
+		return &SamplerChain{}, nil
+	})
+	chat := SamplerOptions{Temperature: 0.7}
+	extract := SamplerOptions{Temperature: 0, Grammar: "root ::= \"x\""}
+
+	a, _ := p.get(chat)
+	b, _ := p.get(chat) // concurrent sequence: its own chain
+	if a == b || built != 2 {
+		t.Fatalf("concurrent checkouts should get distinct chains (built %d)", built)
+	}
+	p.put(chat, a)
+	p.put(chat, b)
+
+	if c, _ := p.get(chat); c != b || built != 2 {
+		t.Errorf("expected the most recently returned chain to be reused")
+	} else {
+		p.put(chat, c)
+	}
+	if _, _ = p.get(extract); built != 3 {
+		t.Errorf("different options should build a new chain (built %d)", built)
+	}
+
+	// Returning a third idle chain evicts the oldest.
+	p.put(extract, &SamplerChain{})
+	if len(p.idle) != 2 || p.idle[0].opts != chat || p.idle[1].opts != extract {
+		t.Errorf("idle = %+v, want [chat extract]", p.idle)
+	}
+	p.close()
+	if len(p.idle) != 0 {
+		t.Error("close should drop idle chains")
+	}
+}
+
+// ---------------------------------------------------------------------------
+// embedCache
+// ---------------------------------------------------------------------------
+
+func TestEmbedCache(t *testing.T) {
+	c := newEmbedCache(3 * 4 * 4) // three 4-float embeddings
+	emb := func(v float32) []float32 { return []float32{v, v, v, v} }
+
+	c.put("a", emb(1))
+	c.put("b", emb(2))
+	c.put("c", emb(3))
+	if got := c.get("a"); got == nil || got[0] != 1 {
+		t.Fatalf("get(a) = %v", got)
+	}
+	c.put("d", emb(4)) // evicts b, the least recently used
+	if c.get("b") != nil {
+		t.Error("b should have been evicted")
+	}
+	for _, id := range []string{"a", "c", "d"} {
+		if c.get(id) == nil {
+			t.Errorf("%s missing", id)
+		}
+	}
+	if c.used != 3*4*4 {
+		t.Errorf("used = %d, want %d", c.used, 3*4*4)
+	}
+
+	c.put("big", make([]float32, 16)) // larger than the budget
+	if c.get("big") != nil || c.get("a") == nil {
+		t.Error("oversized embeddings should be skipped without evicting")
+	}
+}
+
+// ---------------------------------------------------------------------------
+// modelRegistry
+// ---------------------------------------------------------------------------
+
+func TestNewModelKey(t *testing.T) {
+	opts := DefaultModelOptions()
+	wd, err := os.Getwd()
+	if err != nil {
+		t.Fatal(err)
+	}
+	if a, b := newModelKey("models/m.gguf", opts), newModelKey(wd+"/models/../models/m.gguf", opts); a != b {
+		t.Errorf("relative and absolute paths differ: %v vs %v", a, b)
+	}
+	gpu := opts
+	gpu.NGPULayers = -1
+	if newModelKey("m.gguf", opts) == newModelKey("m.gguf", gpu) {
+		t.Error("different load options should not share a model")
+	}
+}
@@ -2,20 +2,68 @@
 // Thin wrapper around llama.h, translating opaque handles to/from llama types.
 
 #include "binding.h"
+#include "binding_perf.h"
 #include "llama.h"
 
+#include <math.h>
+#include <stdatomic.h>
 #include <stdlib.h>
 #include <string.h>
 
+// ---------------------------------------------------------------------------
+// Phase timing ring
+// ---------------------------------------------------------------------------
+
+// Phase events go into a fixed ring that writers never block on: a writer
+// claims a sequence number with one atomic add, marks the slot as being
+// written, fills it, then publishes it by storing its sequence number + 1.
+// When the ring wraps the oldest events are overwritten; the reader sees a
+// newer sequence in the slot and counts them as dropped.
+#define OE_PERF_RING_SIZE 16384 // power of two
+
+struct oe_perf_slot {
+    _Atomic uint64_t seq; // sequence + 1 once published, 0 while being written
+    oe_perf_event_t  ev;
+};
+
+static struct oe_perf_slot oe_perf_ring[OE_PERF_RING_SIZE];
+static _Atomic uint64_t    oe_perf_head;
+_Atomic uint64_t           oe_perf_n_calls; // see binding_perf.h
+
+static void oe_perf_push(int32_t kind, const void *ctx, int32_t n, int32_t n_ubatch,
+                         int64_t t_start, int64_t t_dur) {
+    const uint64_t seq = atomic_fetch_add_explicit(&oe_perf_head, 1, memory_order_relaxed);
+    struct oe_perf_slot *slot = &oe_perf_ring[seq & (OE_PERF_RING_SIZE - 1)];
+
+    atomic_store_explicit(&slot->seq, 0, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    slot->ev.kind       = kind;
+    slot->ev.n          = n;
+    slot->ev.n_ubatch   = n_ubatch;
+    slot->ev._pad       = 0;
+    slot->ev.ctx        = (uint64_t)(uintptr_t)ctx;
+    slot->ev.t_start_ns = t_start;
+    slot->ev.t_dur_ns   = t_dur;
+    atomic_store_explicit(&slot->seq, seq + 1, memory_order_release);
+}
+
+// Record an event that started at t_start and ends now.
+static void oe_perf_record(int32_t kind, const void *ctx, int32_t n, int32_t n_ubatch,
+                           int64_t t_start) {
+    oe_perf_push(kind, ctx, n, n_ubatch, t_start, ggml_time_ns() - t_start);
+}
+
 // ---------------------------------------------------------------------------
 // Backend lifecycle
 // ---------------------------------------------------------------------------
 
 void oe_backend_init(void) {
+    OE_PERF_CALL();
     llama_backend_init();
 }
 
 void oe_backend_free(void) {
+    OE_PERF_CALL();
     llama_backend_free();
 }
 
@@ -25,6 +73,7 @@ void oe_backend_free(void) {
 
 oe_model_t oe_model_load(const char *path, int32_t n_gpu_layers,
                           bool use_mmap, bool use_mlock) {
+    OE_PERF_CALL();
     struct llama_model_params params = llama_model_default_params();
     params.n_gpu_layers = n_gpu_layers;
     params.use_mmap     = use_mmap;
@@ -35,12 +84,14 @@ oe_model_t oe_model_load(const char *path, int32_t n_gpu_layers,
 }
 
 void oe_model_free(oe_model_t model) {
+    OE_PERF_CALL();
     if (model) {
         llama_model_free((struct llama_model *)model);
     }
 }
 
 oe_model_info_t oe_model_get_info(oe_model_t model) {
+    OE_PERF_CALL();
     oe_model_info_t info;
     memset(&info, 0, sizeof(info));
 
@@ -54,6 +105,7 @@ oe_model_info_t oe_model_get_info(oe_model_t model) {
     info.model_size   = llama_model_size(m);
     info.n_params     = llama_model_n_params(m);
     info.has_encoder   = llama_model_has_encoder(m);
+    info.recurrent     = llama_model_is_recurrent(m) || llama_model_is_hybrid(m);
 
     llama_model_desc(m, info.desc, sizeof(info.desc));
 
@@ -74,10 +126,72 @@ oe_model_info_t oe_model_get_info(oe_model_t model) {
 // Context operations
 // ---------------------------------------------------------------------------
 
+// oe_context_t points at this wrapper rather than at the bare llama_context
+// so the handle can own per-context scratch state.
+struct oe_context {
+    struct llama_context *lctx;
+    enum ggml_type        type_k;  // KV cache types the context was created with
+    enum ggml_type        type_v;
+
+    // Persistent decode batch. Sized to n_batch at creation and only ever
+    // grown, so decode calls fill it in place instead of paying a
+    // llama_batch_init/llama_batch_free pair per call (i.e. per token on
+    // the generation path).
+    struct llama_batch batch;
+    int32_t            batch_cap;
+
+    // Speculative sampling scratch (see oe_speculative_verify): candidate
+    // array and dense probability row, n_vocab entries each, allocated on
+    // first use. rng drives the accept/reject and residual draws and is
+    // seeded from the first sampler chain it serves.
+    llama_token_data *cand;
+    float            *probs;
+    int32_t           n_vocab;
+    uint64_t          rng;
+};
+
+#define OE_LCTX(ctx) (((struct oe_context *)(ctx))->lctx)
+
+// llama_decode with a phase event. llama.cpp splits the batch into
+// n_ubatch-sized micro-batches internally; the event records how many, not
+// their individual times.
+static int32_t oe_llama_decode(struct oe_context *c, struct llama_batch batch) {
+    const int64_t t0 = ggml_time_ns();
+    const int32_t rc = llama_decode(c->lctx, batch);
+    const int32_t ub = (int32_t)llama_n_ubatch(c->lctx);
+    oe_perf_record(OE_PERF_DECODE, c, batch.n_tokens,
+                   ub > 0 ? (batch.n_tokens + ub - 1) / ub : 1, t0);
+    return rc;
+}
+
+// Return the context's batch with room for n_tokens single-sequence
+// entries and n_tokens set, growing the arena if needed. Returns NULL on
+// allocation failure.
+static struct llama_batch *oe_batch_acquire(struct oe_context *c, int32_t n_tokens) {
+    if (n_tokens > c->batch_cap) {
+        int32_t cap = c->batch_cap > 0 ? c->batch_cap : 1;
+        while (cap < n_tokens) cap *= 2;
+
+        if (c->batch_cap > 0) llama_batch_free(c->batch);
+        c->batch     = llama_batch_init(cap, 0, 1);
+        c->batch_cap = c->batch.token ? cap : 0;
+        if (c->batch_cap == 0) return NULL;
+    }
+    c->batch.n_tokens = n_tokens;
+    return &c->batch;
+}
+
+void *oe_context_llama(oe_context_t ctx) {
+    OE_PERF_CALL();
+    return ctx ? (void *)OE_LCTX(ctx) : NULL;
+}
+
 oe_context_t oe_context_new(oe_model_t model, uint32_t n_ctx, uint32_t n_batch, uint32_t n_ubatch,
                              int32_t n_threads, int32_t n_threads_batch,
                              bool embeddings, int32_t flash_attn,
-                             int32_t type_k, int32_t type_v) {
+                             int32_t type_k, int32_t type_v,
+                             uint32_t n_seq_max) {
+    OE_PERF_CALL();
     struct llama_context_params params = llama_context_default_params();
 
     if (n_ctx > 0)        params.n_ctx          = n_ctx;
@@ -89,27 +203,74 @@ oe_context_t oe_context_new(oe_model_t model, uint32_t n_ctx, uint32_t n_batch,
 
     params.embeddings = embeddings;
 
+    // Multi-sequence: share one KV pool across all sequences so a single
+    // long conversation can still use the full window when others are idle.
+    if (n_seq_max > 1) {
+        params.n_seq_max  = n_seq_max;
+        params.kv_unified = true;
+    }
+
     if (flash_attn >= 0) {
         params.flash_attn_type = (enum llama_flash_attn_type)flash_attn;
     }
 
-    // KV cache quantization: 0=f16 (default), 1=q8_0, 2=q4_0
-    if (type_k == 1)      params.type_k = GGML_TYPE_Q8_0;
-    else if (type_k == 2) params.type_k = GGML_TYPE_Q4_0;
-    // else keep default (GGML_TYPE_F16)
-
-    if (type_v == 1)      params.type_v = GGML_TYPE_Q8_0;
-    else if (type_v == 2) params.type_v = GGML_TYPE_Q4_0;
-    // else keep default (GGML_TYPE_F16)
+    // KV cache types, K and V independently; -1 keeps the default (f16).
+    if (type_k >= 0 && type_k < GGML_TYPE_COUNT) params.type_k = (enum ggml_type)type_k;
+    if (type_v >= 0 && type_v < GGML_TYPE_COUNT) params.type_v = (enum ggml_type)type_v;
 
-    struct llama_context *ctx = llama_init_from_model(
+    struct llama_context *lctx = llama_init_from_model(
         (struct llama_model *)model, params);
-    return (oe_context_t)ctx;
+    if (!lctx) return NULL;
+
+    struct oe_context *c = (struct oe_context *)calloc(1, sizeof(*c));
+    if (!c) {
+        llama_free(lctx);
+        return NULL;
+    }
+    c->lctx = lctx;
+    c->type_k = params.type_k;
+    c->type_v = params.type_v;
+    oe_batch_acquire(c, (int32_t)llama_n_batch(lctx));
+    return (oe_context_t)c;
+}
+
+int32_t oe_ggml_type_from_name(const char *name) {
+    OE_PERF_CALL();
+    if (!name) return -1;
+    for (int i = 0; i < GGML_TYPE_COUNT; i++) {
+        const char *tn = ggml_type_name((enum ggml_type)i);
+        if (tn && strcmp(tn, name) == 0) return i;
+    }
+    return -1;
+}
+
+void oe_kv_cache_bytes(oe_context_t ctx, uint64_t *out_k, uint64_t *out_v) {
+    OE_PERF_CALL();
+    *out_k = 0;
+    *out_v = 0;
+    if (!ctx) return;
+    struct oe_context *c = (struct oe_context *)ctx;
+    const struct llama_model *m = llama_get_model(c->lctx);
+    int32_t n_head = llama_model_n_head(m);
+    if (n_head <= 0) return;
+
+    uint64_t n_elem = (uint64_t)llama_n_ctx(c->lctx)
+                    * (uint64_t)llama_model_n_layer(m)
+                    * (uint64_t)llama_model_n_head_kv(m)
+                    * (uint64_t)(llama_model_n_embd(m) / n_head);
+    *out_k = n_elem / ggml_blck_size(c->type_k) * ggml_type_size(c->type_k);
+    *out_v = n_elem / ggml_blck_size(c->type_v) * ggml_type_size(c->type_v);
 }
 
 void oe_context_free(oe_context_t ctx) {
+    OE_PERF_CALL();
     if (ctx) {
-        llama_free((struct llama_context *)ctx);
+        struct oe_context *c = (struct oe_context *)ctx;
+        if (c->batch_cap > 0) llama_batch_free(c->batch);
+        free(c->cand);
+        free(c->probs);
+        llama_free(c->lctx);
+        free(c);
     }
 }
 
@@ -120,23 +281,79 @@ void oe_context_free(oe_context_t ctx) {
 int32_t oe_tokenize(oe_model_t model, const char *text, int32_t text_len,
                      int32_t *tokens, int32_t n_max_tokens,
                      bool add_special, bool parse_special) {
+    OE_PERF_CALL();
     if (!model) return 0;
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
-    return llama_tokenize(vocab, text, text_len,
-                          (llama_token *)tokens, n_max_tokens,
-                          add_special, parse_special);
+    const int64_t t0 = ggml_time_ns();
+    const int32_t n = llama_tokenize(vocab, text, text_len,
+                                     (llama_token *)tokens, n_max_tokens,
+                                     add_special, parse_special);
+    oe_perf_record(OE_PERF_TOKENIZE, NULL, n > 0 ? n : -n, 0, t0);
+    return n;
 }
 
 int32_t oe_token_to_piece(oe_model_t model, int32_t token,
                            char *buf, int32_t buf_len) {
+    OE_PERF_CALL();
     if (!model) return 0;
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
-    return llama_token_to_piece(vocab, (llama_token)token, buf, buf_len, 0, false);
+    const int64_t t0 = ggml_time_ns();
+    const int32_t n = llama_token_to_piece(vocab, (llama_token)token, buf, buf_len, 0, false);
+    oe_perf_record(OE_PERF_DETOKENIZE, NULL, 1, 0, t0);
+    return n;
+}
+
+int32_t oe_tokenize_many(oe_model_t model, const char *texts,
+                         const int32_t *lens, int32_t n,
+                         int32_t *out_tokens, int32_t *out_offsets,
+                         int32_t capacity,
+                         bool add_special, bool parse_special) {
+    OE_PERF_CALL();
+    if (!model || n <= 0 || !out_offsets) return 0;
+    struct llama_model *m = (struct llama_model *)model;
+    const struct llama_vocab *vocab = llama_model_get_vocab(m);
+
+    const int64_t t0 = ggml_time_ns();
+    int32_t total = 0;
+    bool overflow = false;
+    const char *text = texts;
+    out_offsets[0] = 0;
+    for (int32_t i = 0; i < n; i++) {
+        int32_t room = overflow || !out_tokens ? 0 : capacity - total;
+        int32_t got = llama_tokenize(vocab, text, lens[i],
+                                     room > 0 ? (llama_token *)out_tokens + total : NULL,
+                                     room, add_special, parse_special);
+        if (got < 0) {
+            // Did not fit: llama_tokenize reports the size it needed.
+            // Keep counting so the caller can size one retry.
+            got = -got;
+            overflow = true;
+        }
+        total += got;
+        out_offsets[i + 1] = total;
+        text += lens[i];
+    }
+    oe_perf_record(OE_PERF_TOKENIZE, NULL, total, 0, t0);
+    return overflow ? -total : total;
+}
+
+int32_t oe_detokenize(oe_model_t model, const int32_t *tokens, int32_t n,
+                      char *buf, int32_t buf_len) {
+    OE_PERF_CALL();
+    if (!model || n <= 0) return 0;
+    struct llama_model *m = (struct llama_model *)model;
+    const struct llama_vocab *vocab = llama_model_get_vocab(m);
+    const int64_t t0 = ggml_time_ns();
+    const int32_t len = llama_detokenize(vocab, (const llama_token *)tokens, n,
+                                         buf, buf_len, false, true);
+    oe_perf_record(OE_PERF_DETOKENIZE, NULL, n, 0, t0);
+    return len;
 }
 
 bool oe_token_is_eog(oe_model_t model, int32_t token) {
+    OE_PERF_CALL();
     if (!model) return true; // treat as EOG if model is NULL (safe default)
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
@@ -144,6 +361,7 @@ bool oe_token_is_eog(oe_model_t model, int32_t token) {
 }
 
 int32_t oe_token_bos(oe_model_t model) {
+    OE_PERF_CALL();
     if (!model) return 0;
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
@@ -151,6 +369,7 @@ int32_t oe_token_bos(oe_model_t model) {
 }
 
 int32_t oe_token_eos(oe_model_t model) {
+    OE_PERF_CALL();
     if (!model) return 0;
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
@@ -158,6 +377,7 @@ int32_t oe_token_eos(oe_model_t model) {
 }
 
 int32_t oe_vocab_n_tokens(oe_model_t model) {
+    OE_PERF_CALL();
     if (!model) return 0;
     struct llama_model *m = (struct llama_model *)model;
     const struct llama_vocab *vocab = llama_model_get_vocab(m);
@@ -169,54 +389,225 @@ int32_t oe_vocab_n_tokens(oe_model_t model) {
 // ---------------------------------------------------------------------------
 
 int32_t oe_decode(oe_context_t ctx, int32_t *tokens, int32_t n_tokens) {
+    OE_PERF_CALL();
     if (!ctx || !tokens || n_tokens <= 0) return -1;
     struct llama_batch batch = llama_batch_get_one(
         (llama_token *)tokens, n_tokens);
-    return llama_decode((struct llama_context *)ctx, batch);
+    return oe_llama_decode((struct oe_context *)ctx, batch);
 }
 
 int32_t oe_decode_batch(oe_context_t ctx, int32_t *tokens, int32_t n_tokens,
                          int32_t pos_start) {
+    OE_PERF_CALL();
     if (!ctx || !tokens || n_tokens <= 0) return -1;
-    struct llama_context *c = (struct llama_context *)ctx;
+    struct oe_context *c = (struct oe_context *)ctx;
 
-    // Allocate a full batch so we can set positions and logits flags explicitly.
-    struct llama_batch batch = llama_batch_init(n_tokens, 0, 1);
-    batch.n_tokens = n_tokens;
+    // Fill the context's batch so we can set positions and logits flags explicitly.
+    struct llama_batch *batch = oe_batch_acquire(c, n_tokens);
+    if (!batch) return -2;
 
     for (int32_t i = 0; i < n_tokens; i++) {
-        batch.token[i]    = (llama_token)tokens[i];
-        batch.pos[i]      = (llama_pos)(pos_start + i);
-        batch.n_seq_id[i] = 1;
-        batch.seq_id[i][0] = 0;
+        batch->token[i]     = (llama_token)tokens[i];
+        batch->pos[i]       = (llama_pos)(pos_start + i);
+        batch->n_seq_id[i]  = 1;
+        batch->seq_id[i][0] = 0;
         // Only request logits for the last token.
-        batch.logits[i] = (i == n_tokens - 1) ? 1 : 0;
+        batch->logits[i] = (i == n_tokens - 1) ? 1 : 0;
     }
 
-    int32_t rc = llama_decode(c, batch);
-    llama_batch_free(batch);
-    return rc;
+    return oe_llama_decode(c, *batch);
+}
+
+int32_t oe_decode_token(oe_context_t ctx, int32_t token, int32_t pos) {
+    OE_PERF_CALL();
+    if (!ctx) return -1;
+    struct oe_context *c = (struct oe_context *)ctx;
+
+    struct llama_batch *batch = oe_batch_acquire(c, 1);
+    if (!batch) return -2;
+
+    batch->token[0]     = (llama_token)token;
+    batch->pos[0]       = (llama_pos)pos;
+    batch->n_seq_id[0]  = 1;
+    batch->seq_id[0][0] = 0;
+    batch->logits[0]    = 1;
+
+    return oe_llama_decode(c, *batch);
+}
+
+// Minimum free space in the text buffer before sampling another token.
+// Sampling commits the token to the sampler history, so it is not stopped
+// for a piece that does not fit: that piece's length is reported as
+// negative and the caller converts the token itself.
+#define OE_GEN_PIECE_RESERVE 256
+
+int32_t oe_generate_step(oe_context_t ctx, oe_sampler_t sampler,
+                          int32_t pos, int32_t max_steps, bool stop_on_eog,
+                          int32_t *out_tokens, int32_t *out_piece_lens,
+                          char *out_text, int32_t text_cap,
+                          int32_t *out_status, int32_t *out_decode_rc) {
+    OE_PERF_CALL();
+    if (out_status)    *out_status    = OE_GEN_MAX_STEPS;
+    if (out_decode_rc) *out_decode_rc = 0;
+    if (!ctx || !sampler || !out_tokens || !out_piece_lens || !out_text ||
+        max_steps <= 0) {
+        if (out_status) *out_status = OE_GEN_DECODE_FAIL;
+        if (out_decode_rc) *out_decode_rc = -1;
+        return 0;
+    }
+    struct oe_context *c = (struct oe_context *)ctx;
+    struct llama_sampler *smpl = (struct llama_sampler *)sampler;
+    const struct llama_vocab *vocab =
+        llama_model_get_vocab(llama_get_model(c->lctx));
+
+    int32_t n = 0;
+    int32_t text_len = 0;
+
+    // Sampling and piece conversion run once per token; accumulate them
+    // into one event each instead of flooding the ring.
+    const int64_t t_step = ggml_time_ns();
+    int64_t t_sample = 0, t_piece = 0;
+    int32_t n_sample = 0;
+
+    while (n < max_steps) {
+        if (text_cap - text_len < OE_GEN_PIECE_RESERVE) {
+            if (out_status) *out_status = OE_GEN_BUF_FULL;
+            break;
+        }
+
+        int64_t t0 = ggml_time_ns();
+        llama_token tok = llama_sampler_sample(smpl, c->lctx, -1);
+        int64_t t1 = ggml_time_ns();
+        t_sample += t1 - t0;
+        n_sample++;
+        if (stop_on_eog && llama_vocab_is_eog(vocab, tok)) {
+            if (out_status) *out_status = OE_GEN_EOG;
+            break;
+        }
+
+        int32_t len = llama_token_to_piece(vocab, tok, out_text + text_len,
+                                           text_cap - text_len, 0, false);
+        t_piece += ggml_time_ns() - t1;
+
+        struct llama_batch *batch = oe_batch_acquire(c, 1);
+        int32_t rc = -2;
+        if (batch) {
+            batch->token[0]     = tok;
+            batch->pos[0]       = (llama_pos)(pos + n);
+            batch->n_seq_id[0]  = 1;
+            batch->seq_id[0][0] = 0;
+            batch->logits[0]    = 1;
+            rc = oe_llama_decode(c, *batch);
+        }
+        if (rc != 0) {
+            if (out_status)    *out_status    = OE_GEN_DECODE_FAIL;
+            if (out_decode_rc) *out_decode_rc = rc;
+            break;
+        }
+
+        out_tokens[n]     = (int32_t)tok;
+        out_piece_lens[n] = len;
+        if (len > 0) text_len += len;
+        n++;
+    }
+
+    if (n_sample > 0) {
+        oe_perf_push(OE_PERF_SAMPLE, c, n_sample, 0, t_step, t_sample);
+        oe_perf_push(OE_PERF_DETOKENIZE, c, n, 0, t_step, t_piece);
+    }
+    return n;
+}
+
+int32_t oe_decode_multi(oe_context_t ctx, const int32_t *tokens,
+                         const int32_t *pos, const int32_t *seq_ids,
+                         const bool *want_logits, int32_t n_tokens) {
+    OE_PERF_CALL();
+    if (!ctx || !tokens || !pos || !seq_ids || n_tokens <= 0) return -1;
+    struct oe_context *c = (struct oe_context *)ctx;
+
+    struct llama_batch *batch = oe_batch_acquire(c, n_tokens);
+    if (!batch) return -2;
+
+    for (int32_t i = 0; i < n_tokens; i++) {
+        batch->token[i]     = (llama_token)tokens[i];
+        batch->pos[i]       = (llama_pos)pos[i];
+        batch->n_seq_id[i]  = 1;
+        batch->seq_id[i][0] = (llama_seq_id)seq_ids[i];
+        batch->logits[i]    = (want_logits && want_logits[i]) ? 1 : 0;
+    }
+
+    return oe_llama_decode(c, *batch);
 }
 
 int32_t oe_encode(oe_context_t ctx, int32_t *tokens, int32_t n_tokens) {
+    OE_PERF_CALL();
     if (!ctx || !tokens || n_tokens <= 0) return -1;
-    struct llama_context *c = (struct llama_context *)ctx;
+    struct oe_context *c = (struct oe_context *)ctx;
 
-    // Build a batch with all tokens marked as outputs (for embedding extraction).
-    struct llama_batch batch = llama_batch_init(n_tokens, 0, 1);
-    batch.n_tokens = n_tokens;
+    // Fill the batch with all tokens marked as outputs (for embedding extraction).
+    struct llama_batch *batch = oe_batch_acquire(c, n_tokens);
+    if (!batch) return -2;
 
     for (int32_t i = 0; i < n_tokens; i++) {
-        batch.token[i]     = (llama_token)tokens[i];
-        batch.pos[i]       = (llama_pos)i;
-        batch.n_seq_id[i]  = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i]    = 1; // mark all as outputs for embeddings
+        batch->token[i]     = (llama_token)tokens[i];
+        batch->pos[i]       = (llama_pos)i;
+        batch->n_seq_id[i]  = 1;
+        batch->seq_id[i][0] = 0;
+        batch->logits[i]    = 1; // mark all as outputs for embeddings
     }
 
-    int32_t rc = llama_encode(c, batch);
-    llama_batch_free(batch);
-    return rc;
+    return llama_encode(c->lctx, *batch);
+}
+
+int32_t oe_embed_batch(oe_context_t ctx, const int32_t *tokens_flat,
+                        const int32_t *offsets, int32_t n_seqs,
+                        float *out_matrix) {
+    OE_PERF_CALL();
+    if (!ctx || !tokens_flat || !offsets || !out_matrix || n_seqs <= 0) return -1;
+    struct oe_context *c = (struct oe_context *)ctx;
+    const struct llama_model *model = llama_get_model(c->lctx);
+    const int32_t n_embd  = llama_model_n_embd(model);
+    const int32_t n_total = offsets[n_seqs];
+    if (n_total <= 0) return -1;
+
+    struct llama_batch *batch = oe_batch_acquire(c, n_total);
+    if (!batch) return -2;
+
+    // One sequence per text; positions restart at 0 for each. Every token
+    // is an output so the pooling layer sees the whole sequence.
+    for (int32_t s = 0; s < n_seqs; s++) {
+        for (int32_t i = offsets[s]; i < offsets[s + 1]; i++) {
+            batch->token[i]     = (llama_token)tokens_flat[i];
+            batch->pos[i]       = (llama_pos)(i - offsets[s]);
+            batch->n_seq_id[i]  = 1;
+            batch->seq_id[i][0] = (llama_seq_id)s;
+            batch->logits[i]    = 1;
+        }
+    }
+
+    int32_t rc;
+    if (llama_model_has_encoder(model)) {
+        rc = llama_encode(c->lctx, *batch);
+    } else {
+        llama_memory_clear(llama_get_memory(c->lctx), true);
+        rc = oe_llama_decode(c, *batch);
+    }
+    if (rc != 0) return -3;
+
+    const bool pooled = llama_pooling_type(c->lctx) != LLAMA_POOLING_TYPE_NONE;
+    for (int32_t s = 0; s < n_seqs; s++) {
+        const float *src = pooled
+            ? llama_get_embeddings_seq(c->lctx, (llama_seq_id)s)
+            : llama_get_embeddings_ith(c->lctx, offsets[s + 1] - 1);
+        if (!src) return -4;
+
+        float *dst = out_matrix + (size_t)s * (size_t)n_embd;
+        double sum = 0.0;
+        for (int32_t j = 0; j < n_embd; j++) sum += (double)src[j] * (double)src[j];
+        const float inv = sum > 0.0 ? (float)(1.0 / sqrt(sum)) : 1.0f;
+        for (int32_t j = 0; j < n_embd; j++) dst[j] = src[j] * inv;
+    }
+    return 0;
 }
 
 // ---------------------------------------------------------------------------
@@ -224,19 +615,22 @@ int32_t oe_encode(oe_context_t ctx, int32_t *tokens, int32_t n_tokens) {
 // ---------------------------------------------------------------------------
 
 float *oe_get_logits(oe_context_t ctx, int32_t idx) {
+    OE_PERF_CALL();
     if (!ctx) return NULL;
-    return llama_get_logits_ith((struct llama_context *)ctx, idx);
+    return llama_get_logits_ith(OE_LCTX(ctx), idx);
 }
 
 float *oe_get_embeddings(oe_context_t ctx, int32_t idx) {
+    OE_PERF_CALL();
     if (!ctx) return NULL;
-    return llama_get_embeddings_ith((struct llama_context *)ctx, idx);
+    return llama_get_embeddings_ith(OE_LCTX(ctx), idx);
 }
 
 float *oe_get_embeddings_seq(oe_context_t ctx, int32_t seq_id) {
+    OE_PERF_CALL();
     if (!ctx) return NULL;
     return llama_get_embeddings_seq(
-        (struct llama_context *)ctx, (llama_seq_id)seq_id);
+        OE_LCTX(ctx), (llama_seq_id)seq_id);
 }
 
 // ---------------------------------------------------------------------------
@@ -244,8 +638,9 @@ float *oe_get_embeddings_seq(oe_context_t ctx, int32_t seq_id) {
 // ---------------------------------------------------------------------------
 
 void oe_memory_clear(oe_context_t ctx) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_memory_t mem = llama_get_memory((struct llama_context *)ctx);
+    llama_memory_t mem = llama_get_memory(OE_LCTX(ctx));
     if (mem) {
         llama_memory_clear(mem, true);
     }
@@ -253,54 +648,240 @@ void oe_memory_clear(oe_context_t ctx) {
 
 bool oe_memory_seq_rm(oe_context_t ctx, int32_t seq_id,
                        int32_t p0, int32_t p1) {
+    OE_PERF_CALL();
     if (!ctx) return false;
-    llama_memory_t mem = llama_get_memory((struct llama_context *)ctx);
+    llama_memory_t mem = llama_get_memory(OE_LCTX(ctx));
     if (!mem) return false;
     return llama_memory_seq_rm(mem, (llama_seq_id)seq_id,
                                 (llama_pos)p0, (llama_pos)p1);
 }
 
 int32_t oe_memory_seq_pos_max(oe_context_t ctx, int32_t seq_id) {
+    OE_PERF_CALL();
     if (!ctx) return -1;
-    llama_memory_t mem = llama_get_memory((struct llama_context *)ctx);
+    llama_memory_t mem = llama_get_memory(OE_LCTX(ctx));
     if (!mem) return -1;
     return (int32_t)llama_memory_seq_pos_max(mem, (llama_seq_id)seq_id);
 }
 
 void oe_memory_seq_add(oe_context_t ctx, int32_t seq_id,
                        int32_t p0, int32_t p1, int32_t delta) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_memory_t mem = llama_get_memory((struct llama_context *)ctx);
+    llama_memory_t mem = llama_get_memory(OE_LCTX(ctx));
     if (!mem) return;
     llama_memory_seq_add(mem, (llama_seq_id)seq_id,
                           (llama_pos)p0, (llama_pos)p1, (llama_pos)delta);
 }
 
+bool oe_memory_seq_shift(oe_context_t ctx, int32_t seq_id,
+                         int32_t n_keep, int32_t n_discard) {
+    OE_PERF_CALL();
+    if (!ctx || n_keep < 0 || n_discard <= 0) return false;
+    llama_memory_t mem = llama_get_memory(OE_LCTX(ctx));
+    if (!mem || !llama_memory_can_shift(mem)) return false;
+    const int64_t t0 = ggml_time_ns();
+    llama_seq_id seq = (llama_seq_id)seq_id;
+    if (!llama_memory_seq_rm(mem, seq, n_keep, n_keep + n_discard)) return false;
+    llama_memory_seq_add(mem, seq, n_keep + n_discard, -1, -n_discard);
+    oe_perf_record(OE_PERF_KV_SHIFT, ctx, n_discard, 0, t0);
+    return true;
+}
+
 // ---------------------------------------------------------------------------
-// Speculative decoding
+// State save / restore
 // ---------------------------------------------------------------------------
 
-int32_t oe_decode_batch_logits_all(oe_context_t ctx, int32_t *tokens,
-                                    int32_t n_tokens, int32_t pos_start) {
-    if (!ctx || !tokens || n_tokens <= 0) return -1;
-    struct llama_context *c = (struct llama_context *)ctx;
+size_t oe_state_seq_get_size(oe_context_t ctx, int32_t seq_id) {
+    OE_PERF_CALL();
+    if (!ctx) return 0;
+    return llama_state_seq_get_size(OE_LCTX(ctx), (llama_seq_id)seq_id);
+}
 
-    // Allocate a batch with logits enabled for ALL tokens (not just the last).
-    // This allows the target model to verify each draft token against its own
-    // probability distribution during speculative decoding.
-    struct llama_batch batch = llama_batch_init(n_tokens, 0, 1);
-    batch.n_tokens = n_tokens;
+size_t oe_state_seq_get_data(oe_context_t ctx, uint8_t *dst, size_t size,
+                              int32_t seq_id) {
+    OE_PERF_CALL();
+    if (!ctx || !dst || size == 0) return 0;
+    return llama_state_seq_get_data(OE_LCTX(ctx), dst, size, (llama_seq_id)seq_id);
+}
 
-    for (int32_t i = 0; i < n_tokens; i++) {
-        batch.token[i]     = (llama_token)tokens[i];
-        batch.pos[i]       = (llama_pos)(pos_start + i);
-        batch.n_seq_id[i]  = 1;
-        batch.seq_id[i][0] = 0;
-        batch.logits[i]    = 1; // logits for ALL tokens
+size_t oe_state_seq_set_data(oe_context_t ctx, const uint8_t *src, size_t size,
+                              int32_t dest_seq_id) {
+    OE_PERF_CALL();
+    if (!ctx || !src || size == 0) return 0;
+    return llama_state_seq_set_data(OE_LCTX(ctx), src, size, (llama_seq_id)dest_seq_id);
+}
+
+bool oe_state_save_file(oe_context_t ctx, const char *path, int32_t seq_id,
+                         const int32_t *tokens, int32_t n_tokens) {
+    OE_PERF_CALL();
+    if (!ctx || !path || (n_tokens > 0 && !tokens)) return false;
+    size_t n = llama_state_seq_save_file(OE_LCTX(ctx), path, (llama_seq_id)seq_id,
+                                         (const llama_token *)tokens,
+                                         (size_t)(n_tokens > 0 ? n_tokens : 0));
+    return n > 0;
+}
+
+int32_t oe_state_load_file(oe_context_t ctx, const char *path, int32_t dest_seq_id,
+                            int32_t *tokens_out, int32_t n_token_capacity) {
+    OE_PERF_CALL();
+    if (!ctx || !path || !tokens_out || n_token_capacity <= 0) return -1;
+    size_t n_tokens = 0;
+    size_t n = llama_state_seq_load_file(OE_LCTX(ctx), path, (llama_seq_id)dest_seq_id,
+                                         (llama_token *)tokens_out,
+                                         (size_t)n_token_capacity, &n_tokens);
+    if (n == 0) return -1;
+    return (int32_t)n_tokens;
+}
+
+// ---------------------------------------------------------------------------
+// Continuation scoring
+// ---------------------------------------------------------------------------
+
+// Log-probability of token under the logits row (log-softmax).
+static float oe_token_logprob(const float *logits, int32_t n_vocab, llama_token token) {
+    float max = logits[0];
+    for (int32_t v = 1; v < n_vocab; v++) {
+        if (logits[v] > max) max = logits[v];
+    }
+    double sum = 0.0;
+    for (int32_t v = 0; v < n_vocab; v++) {
+        sum += exp((double)(logits[v] - max));
+    }
+    return (float)((double)(logits[token] - max) - log(sum));
+}
+
+// oe_score_in_place scores candidates one per decode on sequence 0 itself,
+// for contexts without spare sequences. After each candidate sequence 0 is
+// cut back to the prefix; recurrent and hybrid memory cannot be cut, so
+// its state is saved up front and restored instead.
+static int32_t oe_score_in_place(struct oe_context *c,
+                                 const int32_t *prefix, int32_t n_prefix,
+                                 const int32_t *cand_flat,
+                                 const int32_t *cand_offsets, int32_t n_cands,
+                                 float *out_logprobs) {
+    llama_memory_t mem = llama_get_memory(c->lctx);
+    const struct llama_model *model = llama_get_model(c->lctx);
+    const int32_t n_vocab = llama_vocab_n_tokens(llama_model_get_vocab(model));
+    const int32_t n_batch = (int32_t)llama_n_batch(c->lctx);
+    const llama_pos p_last = (llama_pos)(n_prefix - 1);
+
+    uint8_t *saved = NULL;
+    size_t n_saved = 0;
+    if (llama_model_is_recurrent(model) || llama_model_is_hybrid(model)) {
+        n_saved = llama_state_seq_get_size(c->lctx, 0);
+        saved = malloc(n_saved > 0 ? n_saved : 1);
+        if (!saved) return -2;
+        n_saved = llama_state_seq_get_data(c->lctx, saved, n_saved, 0);
     }
 
-    int32_t rc = llama_decode(c, batch);
-    llama_batch_free(batch);
+    int32_t rc = 0;
+    for (int32_t k = 0; k < n_cands && rc == 0; k++) {
+        const int32_t *ct = cand_flat + cand_offsets[k];
+        const int32_t m = cand_offsets[k + 1] - cand_offsets[k];
+        if (m <= 0) { rc = -1; break; }
+        if (m > n_batch) { rc = -3; break; }
+
+        struct llama_batch *batch = oe_batch_acquire(c, m);
+        if (!batch) { rc = -2; break; }
+        for (int32_t t = 0; t < m; t++) {
+            batch->token[t]     = t == 0 ? (llama_token)prefix[p_last] : (llama_token)ct[t - 1];
+            batch->pos[t]       = p_last + t;
+            batch->n_seq_id[t]  = 1;
+            batch->seq_id[t][0] = 0;
+            batch->logits[t]    = 1;
+        }
+        rc = oe_llama_decode(c, *batch);
+        if (rc == 0) {
+            float sum = 0.0f;
+            for (int32_t t = 0; t < m; t++) {
+                sum += oe_token_logprob(llama_get_logits_ith(c->lctx, t), n_vocab, ct[t]);
+            }
+            out_logprobs[k] = sum;
+        }
+
+        if (saved) {
+            llama_memory_seq_rm(mem, 0, -1, -1);
+            if (llama_state_seq_set_data(c->lctx, saved, n_saved, 0) == 0) rc = -2;
+        } else if (!llama_memory_seq_rm(mem, 0, p_last, -1)) {
+            rc = -2;
+        }
+    }
+    free(saved);
+    return rc;
+}
+
+int32_t oe_score_continuations(oe_context_t ctx,
+                               const int32_t *prefix, int32_t n_prefix,
+                               const int32_t *cand_flat,
+                               const int32_t *cand_offsets, int32_t n_cands,
+                               int32_t seq_base, int32_t n_seqs,
+                               float *out_logprobs) {
+    OE_PERF_CALL();
+    if (!ctx || !prefix || n_prefix <= 0 || !cand_flat || !cand_offsets ||
+        n_cands <= 0 || seq_base < 0 || n_seqs <= 0 || !out_logprobs) return -1;
+    struct oe_context *c = (struct oe_context *)ctx;
+    if (seq_base == 0) {
+        return oe_score_in_place(c, prefix, n_prefix, cand_flat, cand_offsets,
+                                 n_cands, out_logprobs);
+    }
+    llama_memory_t mem = llama_get_memory(c->lctx);
+    const int32_t n_vocab = llama_vocab_n_tokens(
+        llama_model_get_vocab(llama_get_model(c->lctx)));
+    const int32_t n_batch = (int32_t)llama_n_batch(c->lctx);
+    const llama_pos p_last = (llama_pos)(n_prefix - 1);
+
+    int32_t rc = 0;
+    for (int32_t k = 0; k < n_cands && rc == 0; ) {
+        // Pack whole candidates, one sequence each, into the next batch.
+        int32_t k_end = k, n_tok = 0;
+        while (k_end < n_cands && k_end - k < n_seqs) {
+            const int32_t m = cand_offsets[k_end + 1] - cand_offsets[k_end];
+            if (m <= 0) return -1;
+            if (m > n_batch) return -3;
+            if (n_tok + m > n_batch) break;
+            n_tok += m;
+            k_end++;
+        }
+
+        struct llama_batch *batch = oe_batch_acquire(c, n_tok);
+        if (!batch) return -2;
+        int32_t i = 0;
+        for (int32_t j = k; j < k_end; j++) {
+            const llama_seq_id seq = seq_base + (j - k);
+            const int32_t *ct = cand_flat + cand_offsets[j];
+            const int32_t m = cand_offsets[j + 1] - cand_offsets[j];
+            llama_memory_seq_rm(mem, seq, -1, -1);
+            if (p_last > 0) llama_memory_seq_cp(mem, 0, seq, 0, p_last);
+            // Row t predicts ct[t]: the inputs are the last prefix token
+            // followed by all but the last candidate token.
+            for (int32_t t = 0; t < m; t++, i++) {
+                batch->token[i]     = t == 0 ? (llama_token)prefix[p_last] : (llama_token)ct[t - 1];
+                batch->pos[i]       = p_last + t;
+                batch->n_seq_id[i]  = 1;
+                batch->seq_id[i][0] = seq;
+                batch->logits[i]    = 1;
+            }
+        }
+
+        rc = oe_llama_decode(c, *batch);
+        if (rc == 0) {
+            i = 0;
+            for (int32_t j = k; j < k_end; j++) {
+                const int32_t *ct = cand_flat + cand_offsets[j];
+                const int32_t m = cand_offsets[j + 1] - cand_offsets[j];
+                float sum = 0.0f;
+                for (int32_t t = 0; t < m; t++, i++) {
+                    sum += oe_token_logprob(llama_get_logits_ith(c->lctx, i), n_vocab, ct[t]);
+                }
+                out_logprobs[j] = sum;
+            }
+        }
+        for (int32_t j = k; j < k_end; j++) {
+            llama_memory_seq_rm(mem, seq_base + (j - k), -1, -1);
+        }
+        k = k_end;
+    }
     return rc;
 }
 
@@ -309,12 +890,14 @@ int32_t oe_decode_batch_logits_all(oe_context_t ctx, int32_t *tokens,
 // ---------------------------------------------------------------------------
 
 oe_sampler_t oe_sampler_chain_new(void) {
+    OE_PERF_CALL();
     struct llama_sampler_chain_params params = llama_sampler_chain_default_params();
     struct llama_sampler *chain = llama_sampler_chain_init(params);
     return (oe_sampler_t)chain;
 }
 
 void oe_sampler_chain_add_temp(oe_sampler_t chain, float temp) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -322,6 +905,7 @@ void oe_sampler_chain_add_temp(oe_sampler_t chain, float temp) {
 }
 
 void oe_sampler_chain_add_top_k(oe_sampler_t chain, int32_t k) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -329,6 +913,7 @@ void oe_sampler_chain_add_top_k(oe_sampler_t chain, int32_t k) {
 }
 
 void oe_sampler_chain_add_top_p(oe_sampler_t chain, float p) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -336,6 +921,7 @@ void oe_sampler_chain_add_top_p(oe_sampler_t chain, float p) {
 }
 
 void oe_sampler_chain_add_min_p(oe_sampler_t chain, float p) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -344,6 +930,7 @@ void oe_sampler_chain_add_min_p(oe_sampler_t chain, float p) {
 
 void oe_sampler_chain_add_penalties(oe_sampler_t chain, int32_t last_n,
                                      float repeat, float freq, float present) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -351,6 +938,7 @@ void oe_sampler_chain_add_penalties(oe_sampler_t chain, int32_t last_n,
 }
 
 void oe_sampler_chain_add_dist(oe_sampler_t chain, uint32_t seed) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
@@ -358,53 +946,351 @@ void oe_sampler_chain_add_dist(oe_sampler_t chain, uint32_t seed) {
 }
 
 void oe_sampler_chain_add_greedy(oe_sampler_t chain) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_chain_add(
         (struct llama_sampler *)chain,
         llama_sampler_init_greedy());
 }
 
+bool oe_sampler_chain_add_grammar(oe_sampler_t chain, oe_model_t model,
+                                  const char *gbnf, const char *root) {
+    OE_PERF_CALL();
+    if (!chain || !model || !gbnf) return false;
+    struct llama_sampler *g = llama_sampler_init_grammar(
+        llama_model_get_vocab((struct llama_model *)model),
+        gbnf, root ? root : "root");
+    if (!g) return false;
+    llama_sampler_chain_add((struct llama_sampler *)chain, g);
+    return true;
+}
+
+void oe_sampler_chain_add_allowed_tokens(oe_sampler_t chain, oe_model_t model,
+                                         const int32_t *tokens, int32_t n) {
+    OE_PERF_CALL();
+    if (!chain || !model || n <= 0) return;
+    const int32_t n_vocab = llama_vocab_n_tokens(
+        llama_model_get_vocab((struct llama_model *)model));
+    bool *keep = calloc((size_t)n_vocab, sizeof(bool));
+    if (!keep) return;
+    int32_t n_keep = 0;
+    for (int32_t i = 0; i < n; i++) {
+        if (tokens[i] >= 0 && tokens[i] < n_vocab && !keep[tokens[i]]) {
+            keep[tokens[i]] = true;
+            n_keep++;
+        }
+    }
+    const int32_t n_ban = n_vocab - n_keep;
+    llama_logit_bias *lb = malloc((size_t)(n_ban > 0 ? n_ban : 1) * sizeof(*lb));
+    if (!lb) { free(keep); return; }
+    int32_t j = 0;
+    for (llama_token t = 0; t < n_vocab; t++) {
+        if (!keep[t]) {
+            lb[j].token = t;
+            lb[j].bias  = -INFINITY;
+            j++;
+        }
+    }
+    llama_sampler_chain_add((struct llama_sampler *)chain,
+        llama_sampler_init_logit_bias(n_vocab, n_ban, lb));
+    free(lb);
+    free(keep);
+}
+
 int32_t oe_sampler_sample(oe_sampler_t chain, oe_context_t ctx, int32_t idx) {
+    OE_PERF_CALL();
     if (!chain || !ctx) return 0;
-    return (int32_t)llama_sampler_sample(
+    const int64_t t0 = ggml_time_ns();
+    const llama_token tok = llama_sampler_sample(
         (struct llama_sampler *)chain,
-        (struct llama_context *)ctx, idx);
+        OE_LCTX(ctx), idx);
+    oe_perf_record(OE_PERF_SAMPLE, ctx, 1, 0, t0);
+    return (int32_t)tok;
 }
 
 void oe_sampler_reset(oe_sampler_t chain) {
+    OE_PERF_CALL();
     if (!chain) return;
     llama_sampler_reset((struct llama_sampler *)chain);
 }
 
 void oe_sampler_free(oe_sampler_t chain) {
+    OE_PERF_CALL();
     if (chain) {
         llama_sampler_free((struct llama_sampler *)chain);
     }
 }
 
+// ---------------------------------------------------------------------------
+// Speculative sampling
+// ---------------------------------------------------------------------------
+
+// Allocate the speculative scratch buffers. Returns false on failure.
+static bool oe_spec_scratch(struct oe_context *c, struct llama_sampler *chain) {
+    if (c->cand) return true;
+    const int32_t n_vocab = llama_vocab_n_tokens(
+        llama_model_get_vocab(llama_get_model(c->lctx)));
+    if (n_vocab <= 0) return false;
+
+    c->cand  = (llama_token_data *)malloc((size_t)n_vocab * sizeof(llama_token_data));
+    c->probs = (float *)malloc((size_t)n_vocab * sizeof(float));
+    if (!c->cand || !c->probs) {
+        free(c->cand);
+        free(c->probs);
+        c->cand  = NULL;
+        c->probs = NULL;
+        return false;
+    }
+    c->n_vocab = n_vocab;
+    c->rng = 0x9E3779B97F4A7C15ULL ^ (uint64_t)llama_sampler_get_seed(chain);
+    return true;
+}
+
+// Uniform float in [0, 1) from the context's xorshift64* generator.
+static float oe_spec_uniform(struct oe_context *c) {
+    c->rng ^= c->rng >> 12;
+    c->rng ^= c->rng << 25;
+    c->rng ^= c->rng >> 27;
+    return (float)((c->rng * 0x2545F4914F6CDD1DULL) >> 40) / 16777216.0f;
+}
+
+// Compute the distribution chain samples from at batch index idx into the
+// dense row out (n_vocab floats). Every sampler but the last (dist or
+// greedy) is applied to the logits; a final greedy sampler yields a one-hot
+// row, a final dist sampler the softmax of the filtered, scaled logits.
+// If top_p is non-NULL it receives the softmax probability of the most
+// likely candidate (the model's confidence, also for greedy chains).
+static bool oe_spec_probs(struct oe_context *c, struct llama_sampler *chain,
+                          int32_t idx, float *out, float *top_p) {
+    const float *logits = llama_get_logits_ith(c->lctx, idx);
+    if (!logits) return false;
+    const int64_t t0 = ggml_time_ns();
+
+    for (int32_t i = 0; i < c->n_vocab; i++) {
+        c->cand[i].id    = i;
+        c->cand[i].logit = logits[i];
+        c->cand[i].p     = 0.0f;
+    }
+    llama_token_data_array cur = { c->cand, (size_t)c->n_vocab, -1, false };
+
+    const int n = llama_sampler_chain_n(chain);
+    for (int k = 0; k < n - 1; k++) {
+        llama_sampler_apply(llama_sampler_chain_get(chain, k), &cur);
+    }
+    if (cur.size == 0) return false;
+
+    memset(out, 0, (size_t)c->n_vocab * sizeof(float));
+    size_t best = 0;
+    for (size_t i = 1; i < cur.size; i++) {
+        if (cur.data[i].logit > cur.data[best].logit) best = i;
+    }
+    const float max_logit = cur.data[best].logit;
+    double sum = 0.0;
+    for (size_t i = 0; i < cur.size; i++) {
+        sum += exp((double)(cur.data[i].logit - max_logit));
+    }
+    if (top_p) *top_p = (float)(1.0 / sum);
+
+    const bool greedy = n > 0 &&
+        strcmp(llama_sampler_name(llama_sampler_chain_get(chain, n - 1)), "greedy") == 0;
+    if (greedy) {
+        out[cur.data[best].id] = 1.0f;
+    } else {
+        for (size_t i = 0; i < cur.size; i++) {
+            out[cur.data[i].id] = (float)(exp((double)(cur.data[i].logit - max_logit)) / sum);
+        }
+    }
+    oe_perf_record(OE_PERF_SAMPLE, c, 1, 0, t0);
+    return true;
+}
+
+// Draw a token from a dense row of non-negative weights summing to total.
+static int32_t oe_spec_draw(struct oe_context *c, const float *w, double total) {
+    const double u = (double)oe_spec_uniform(c) * total;
+    double acc = 0.0;
+    int32_t last = 0;
+    for (int32_t i = 0; i < c->n_vocab; i++) {
+        if (w[i] <= 0.0f) continue;
+        acc += w[i];
+        last = i;
+        if (u < acc) return i;
+    }
+    return last;
+}
+
+int32_t oe_sampler_sample_probs(oe_sampler_t chain, oe_context_t ctx,
+                                 int32_t idx, float *out_probs, float *out_top_p) {
+    OE_PERF_CALL();
+    if (!chain || !ctx || !out_probs) return -1;
+    struct oe_context *c = (struct oe_context *)ctx;
+    struct llama_sampler *smpl = (struct llama_sampler *)chain;
+    if (!oe_spec_scratch(c, smpl)) return -1;
+    if (!oe_spec_probs(c, smpl, idx, out_probs, out_top_p)) return -1;
+
+    const int32_t token = oe_spec_draw(c, out_probs, 1.0);
+    llama_sampler_accept(smpl, token);
+    return token;
+}
+
+// Decode a single token at pos with logits, for the emitted correction or
+// bonus token. Returns llama_decode's code.
+static int32_t oe_spec_decode_one(struct oe_context *c, int32_t token, int32_t pos) {
+    struct llama_batch *batch = oe_batch_acquire(c, 1);
+    if (!batch) return -2;
+    batch->token[0]     = token;
+    batch->pos[0]       = pos;
+    batch->n_seq_id[0]  = 1;
+    batch->seq_id[0][0] = 0;
+    batch->logits[0]    = 1;
+    return oe_llama_decode(c, *batch);
+}
+
+// Error exit of oe_speculative_verify. Accepted drafts were fed to the
+// sampler as they were checked (later drafts' distributions depend on
+// them), but the caller drops their KV on error, so the sampler's
+// repetition and grammar state is reset rather than left ahead of it.
+static int32_t oe_spec_fail(struct llama_sampler *smpl) {
+    llama_sampler_reset(smpl);
+    return -1;
+}
+
+int32_t oe_speculative_verify(oe_context_t target_ctx, oe_sampler_t sampler,
+                               int32_t pos, const int32_t *draft_tokens,
+                               const float *draft_probs, int32_t n_draft,
+                               int32_t *out_tokens, int32_t *out_accepted,
+                               int32_t *out_decode_rc) {
+    OE_PERF_CALL();
+    if (!target_ctx || !sampler || !draft_tokens || !draft_probs ||
+        !out_tokens || n_draft <= 0) return -1;
+    struct oe_context *c = (struct oe_context *)target_ctx;
+    struct llama_sampler *smpl = (struct llama_sampler *)sampler;
+    if (!oe_spec_scratch(c, smpl)) return -1;
+    if (out_accepted) *out_accepted = 0;
+    if (out_decode_rc) *out_decode_rc = 0;
+
+    float *p = c->probs;
+    int32_t n_out = 0;
+    int32_t rc;
+
+    // Target distribution for draft i is at batch index i-1 of the verify
+    // batch, except for draft 0, whose distribution comes from the logits
+    // the caller's last decode left behind. Check it first so a rejected
+    // first draft costs no verify batch at all.
+    for (int32_t i = 0; i < n_draft; i++) {
+        if (i == 1) {
+            // Draft 0 accepted: evaluate all drafts in one batch.
+            struct llama_batch *batch = oe_batch_acquire(c, n_draft);
+            if (!batch) return -1;
+            for (int32_t j = 0; j < n_draft; j++) {
+                batch->token[j]     = draft_tokens[j];
+                batch->pos[j]       = pos + j;
+                batch->n_seq_id[j]  = 1;
+                batch->seq_id[j][0] = 0;
+                batch->logits[j]    = 1;
+            }
+            rc = oe_llama_decode(c, *batch);
+            if (rc != 0) {
+                if (out_decode_rc) *out_decode_rc = rc;
+                llama_memory_seq_rm(llama_get_memory(c->lctx), 0, pos, -1);
+                return oe_spec_fail(smpl);
+            }
+        }
+
+        if (!oe_spec_probs(c, smpl, i == 0 ? -1 : i - 1, p, NULL)) return oe_spec_fail(smpl);
+
+        const float  *q   = draft_probs + (size_t)i * (size_t)c->n_vocab;
+        const int32_t tok = draft_tokens[i];
+        const float   pt  = p[tok];
+        const float   qt  = q[tok];
+
+        // Accept with probability min(1, p/q).
+        if (qt > 0.0f && (pt >= qt || oe_spec_uniform(c) * qt < pt)) {
+            out_tokens[n_out++] = tok;
+            llama_sampler_accept(smpl, tok);
+            continue;
+        }
+
+        // Rejected: resample from the residual max(0, p - q), normalized.
+        double total = 0.0;
+        for (int32_t v = 0; v < c->n_vocab; v++) {
+            const float r = p[v] - q[v];
+            p[v] = r > 0.0f ? r : 0.0f;
+            total += p[v];
+        }
+        if (total <= 0.0) {
+            // p == q up to rounding: fall back to sampling p itself.
+            oe_spec_probs(c, smpl, i == 0 ? -1 : i - 1, p, NULL);
+            total = 1.0;
+        }
+        const int32_t fix = oe_spec_draw(c, p, total);
+        if (out_accepted) *out_accepted = n_out;
+
+        // Drop the rejected drafts' KV and evaluate the correction in
+        // their place so the caller resumes with fresh logits.
+        if (i > 0 && !llama_memory_seq_rm(llama_get_memory(c->lctx), 0, pos + i, -1)) {
+            if (out_decode_rc) *out_decode_rc = OE_SPEC_RC_TRUNCATE;
+            return oe_spec_fail(smpl);
+        }
+        rc = oe_spec_decode_one(c, fix, pos + i);
+        if (rc != 0) {
+            if (out_decode_rc) *out_decode_rc = rc;
+            return oe_spec_fail(smpl);
+        }
+        llama_sampler_accept(smpl, fix);
+        out_tokens[n_out++] = fix;
+        return n_out;
+    }
+
+    // Every draft accepted. If there was only one draft it has not been
+    // decoded yet; otherwise the verify batch's last row predicts the
+    // bonus token.
+    if (out_accepted) *out_accepted = n_out;
+    if (n_draft == 1) {
+        rc = oe_spec_decode_one(c, draft_tokens[0], pos);
+        if (rc != 0) {
+            if (out_decode_rc) *out_decode_rc = rc;
+            return oe_spec_fail(smpl);
+        }
+    }
+    if (!oe_spec_probs(c, smpl, n_draft == 1 ? -1 : n_draft - 1, p, NULL)) return n_out;
+    const int32_t bonus = oe_spec_draw(c, p, 1.0);
+    rc = oe_spec_decode_one(c, bonus, pos + n_draft);
+    if (rc != 0) {
+        if (out_decode_rc) *out_decode_rc = rc;
+        return n_out;
+    }
+    llama_sampler_accept(smpl, bonus);
+    out_tokens[n_out++] = bonus;
+    return n_out;
+}
+
 // ---------------------------------------------------------------------------
 // Context control
 // ---------------------------------------------------------------------------
 
 void oe_set_embeddings(oe_context_t ctx, bool enabled) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_set_embeddings((struct llama_context *)ctx, enabled);
+    llama_set_embeddings(OE_LCTX(ctx), enabled);
 }
 
 void oe_set_causal_attn(oe_context_t ctx, bool causal) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_set_causal_attn((struct llama_context *)ctx, causal);
+    llama_set_causal_attn(OE_LCTX(ctx), causal);
 }
 
 void oe_set_warmup(oe_context_t ctx, bool warmup) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_set_warmup((struct llama_context *)ctx, warmup);
+    llama_set_warmup(OE_LCTX(ctx), warmup);
 }
 
 void oe_set_n_threads(oe_context_t ctx, int32_t n_threads,
                        int32_t n_threads_batch) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_set_n_threads((struct llama_context *)ctx,
+    llama_set_n_threads(OE_LCTX(ctx),
                          n_threads, n_threads_batch);
 }
 
@@ -413,13 +1299,14 @@ void oe_set_n_threads(oe_context_t ctx, int32_t n_threads,
 // ---------------------------------------------------------------------------
 
 oe_perf_data_t oe_perf_context(oe_context_t ctx) {
+    OE_PERF_CALL();
     oe_perf_data_t data;
     memset(&data, 0, sizeof(data));
 
     if (!ctx) return data;
 
     struct llama_perf_context_data perf =
-        llama_perf_context((struct llama_context *)ctx);
+        llama_perf_context(OE_LCTX(ctx));
 
     data.t_load_ms   = perf.t_load_ms;
     data.t_p_eval_ms = perf.t_p_eval_ms;
@@ -431,11 +1318,105 @@ oe_perf_data_t oe_perf_context(oe_context_t ctx) {
 }
 
 void oe_perf_context_reset(oe_context_t ctx) {
+    OE_PERF_CALL();
     if (!ctx) return;
-    llama_perf_context_reset((struct llama_context *)ctx);
+    llama_perf_context_reset(OE_LCTX(ctx));
+}
+
+int64_t oe_perf_now_ns(void) {
+    OE_PERF_CALL();
+    return ggml_time_ns();
+}
+
+int32_t oe_perf_drain(uint64_t *cursor, oe_perf_event_t *out, int32_t cap,
+                      uint64_t *out_dropped) {
+    OE_PERF_CALL();
+    if (!cursor || !out || cap <= 0) return 0;
+    const uint64_t head = atomic_load_explicit(&oe_perf_head, memory_order_acquire);
+    uint64_t i = *cursor;
+    uint64_t dropped = 0;
+    if (head - i > OE_PERF_RING_SIZE) {
+        // The writers lapped the reader: everything before the last
+        // OE_PERF_RING_SIZE events is gone.
+        dropped += head - OE_PERF_RING_SIZE - i;
+        i = head - OE_PERF_RING_SIZE;
+    }
+
+    int32_t n = 0;
+    for (; i < head && n < cap; i++) {
+        struct oe_perf_slot *slot = &oe_perf_ring[i & (OE_PERF_RING_SIZE - 1)];
+        const uint64_t seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        if (seq < i + 1) break; // claimed but not yet published: next drain
+        if (seq == i + 1) {
+            // Copy, then make sure no writer reclaimed the slot meanwhile.
+            oe_perf_event_t ev = slot->ev;
+            atomic_thread_fence(memory_order_acquire);
+            if (atomic_load_explicit(&slot->seq, memory_order_relaxed) == i + 1) {
+                out[n++] = ev;
+                continue;
+            }
+        }
+        dropped++; // overwritten by a later lap
+    }
+    *cursor = i;
+    if (out_dropped) *out_dropped += dropped;
+    return n;
+}
+
+uint64_t oe_perf_cursor(void) {
+    OE_PERF_CALL();
+    return atomic_load_explicit(&oe_perf_head, memory_order_acquire);
+}
+
+uint64_t oe_perf_calls(void) {
+    OE_PERF_CALL();
+    return atomic_load_explicit(&oe_perf_n_calls, memory_order_relaxed);
+}
+
+void oe_bench_batch_prepare(oe_context_t ctx, int32_t n_tokens, int32_t n_iters,
+                             double *alloc_ns, double *arena_ns) {
+    OE_PERF_CALL();
+    if (alloc_ns) *alloc_ns = 0;
+    if (arena_ns) *arena_ns = 0;
+    if (!ctx || n_tokens <= 0 || n_iters <= 0) return;
+    struct oe_context *c = (struct oe_context *)ctx;
+
+    // Per-call batch construction as decode did it before the arena existed.
+    int64_t t0 = ggml_time_us();
+    for (int32_t it = 0; it < n_iters; it++) {
+        struct llama_batch batch = llama_batch_init(n_tokens, 0, 1);
+        batch.n_tokens = n_tokens;
+        for (int32_t i = 0; i < n_tokens; i++) {
+            batch.token[i]     = i;
+            batch.pos[i]       = i;
+            batch.n_seq_id[i]  = 1;
+            batch.seq_id[i][0] = 0;
+            batch.logits[i]    = (i == n_tokens - 1) ? 1 : 0;
+        }
+        llama_batch_free(batch);
+    }
+    int64_t t1 = ggml_time_us();
+
+    // Same fill through the persistent arena.
+    for (int32_t it = 0; it < n_iters; it++) {
+        struct llama_batch *batch = oe_batch_acquire(c, n_tokens);
+        if (!batch) return;
+        for (int32_t i = 0; i < n_tokens; i++) {
+            batch->token[i]     = i;
+            batch->pos[i]       = i;
+            batch->n_seq_id[i]  = 1;
+            batch->seq_id[i][0] = 0;
+            batch->logits[i]    = (i == n_tokens - 1) ? 1 : 0;
+        }
+    }
+    int64_t t2 = ggml_time_us();
+
+    if (alloc_ns) *alloc_ns = (double)(t1 - t0) * 1000.0 / n_iters;
+    if (arena_ns) *arena_ns = (double)(t2 - t1) * 1000.0 / n_iters;
 }
 
 const char *oe_system_info(void) {
+    OE_PERF_CALL();
     return llama_print_system_info();
 }
 
@@ -461,6 +1442,7 @@ static void oe_log_noop_callback(enum ggml_log_level level, const char *text, vo
 }
 
 void oe_log_to_file(const char *path) {
+    OE_PERF_CALL();
     // Close previous file if any (but not stderr).
     if (oe_log_fp && oe_log_fp != stderr) {
         fclose(oe_log_fp);
@@ -478,6 +1460,7 @@ void oe_log_to_file(const char *path) {
 }
 
 void oe_log_disable(void) {
+    OE_PERF_CALL();
     if (oe_log_fp && oe_log_fp != stderr) {
         fclose(oe_log_fp);
         oe_log_fp = NULL;
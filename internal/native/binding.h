@@ -34,6 +34,7 @@ typedef struct {
     char     desc[256];
     char     chat_template[4096];
     bool     has_encoder;
+    bool     recurrent;   // recurrent or hybrid memory (no partial seq_rm)
 } oe_model_info_t;
 
 // ---------------------------------------------------------------------------
@@ -47,6 +48,37 @@ typedef struct {
     int32_t n_eval;
 } oe_perf_data_t;
 
+// ---------------------------------------------------------------------------
+// Phase timing events (see oe_perf_drain)
+// ---------------------------------------------------------------------------
+typedef enum {
+    OE_PERF_TOKENIZE   = 0, // oe_tokenize / oe_tokenize_many
+    OE_PERF_DECODE     = 1, // one llama_decode call
+    OE_PERF_SAMPLE     = 2, // sampler draws (one event per oe_generate_step)
+    OE_PERF_DETOKENIZE = 3, // token pieces / oe_detokenize
+    OE_PERF_KV_SHIFT   = 4, // oe_memory_seq_shift
+} oe_perf_kind_t;
+
+typedef struct {
+    int32_t  kind;       // oe_perf_kind_t
+    int32_t  n;          // tokens processed (draws for OE_PERF_SAMPLE)
+    int32_t  n_ubatch;   // OE_PERF_DECODE: micro-batches llama_decode split n into
+    int32_t  _pad;
+    uint64_t ctx;        // context the event ran on, 0 for model-level calls
+    int64_t  t_start_ns; // oe_perf_now_ns clock
+    int64_t  t_dur_ns;
+} oe_perf_event_t;
+
+// ---------------------------------------------------------------------------
+// Fused generation status (oe_generate_step)
+// ---------------------------------------------------------------------------
+typedef enum {
+    OE_GEN_MAX_STEPS   = 0, // produced max_steps tokens
+    OE_GEN_EOG         = 1, // sampled an end-of-generation token (not returned)
+    OE_GEN_BUF_FULL    = 2, // text buffer too small for another piece
+    OE_GEN_DECODE_FAIL = 3, // llama_decode failed; see out_decode_rc
+} oe_gen_status_t;
+
 // ---------------------------------------------------------------------------
 // Backend lifecycle
 // ---------------------------------------------------------------------------
@@ -81,16 +113,36 @@ oe_model_info_t oe_model_get_info(oe_model_t model);
 // n_threads_batch: threads for batch processing (0 = same as n_threads)
 // embeddings:   enable embedding extraction
 // flash_attn:   enable flash attention (-1=auto, 0=off, 1=on)
-// type_k:       KV cache key type (0=f16, 1=q8_0, 2=q4_0)
-// type_v:       KV cache value type (0=f16, 1=q8_0, 2=q4_0)
+// type_k:       KV cache key type as a ggml_type (see
+//               oe_ggml_type_from_name), -1 = default (f16)
+// type_v:       KV cache value type, likewise. Quantized V caches
+//               need flash attention.
+// n_seq_max:    maximum number of parallel sequences (0 or 1 = single).
+//               When > 1 the KV cache is unified so all sequences share
+//               the n_ctx cells instead of splitting them statically.
 oe_context_t oe_context_new(oe_model_t model, uint32_t n_ctx, uint32_t n_batch, uint32_t n_ubatch,
                              int32_t n_threads, int32_t n_threads_batch,
                              bool embeddings, int32_t flash_attn,
-                             int32_t type_k, int32_t type_v);
+                             int32_t type_k, int32_t type_v,
+                             uint32_t n_seq_max);
 
 // Free an inference context.
 void oe_context_free(oe_context_t ctx);
 
+// Look up a ggml tensor type by its ggml_type_name ("f16", "bf16", "q8_0",
+// "q5_1", "q5_0", "iq4_nl", "q4_1", "q4_0", ...). Returns -1 if no type
+// has that name.
+int32_t oe_ggml_type_from_name(const char *name);
+
+// Estimated size in bytes of the context's K and V cache buffers:
+// n_ctx cells x n_layer x n_head_kv x head_dim at the configured types.
+// Assumes head_dim = n_embd / n_head, which holds for most architectures.
+void oe_kv_cache_bytes(oe_context_t ctx, uint64_t *out_k, uint64_t *out_v);
+
+// Return the underlying llama_context* of a context handle, for other
+// binding units (e.g. vision) that call llama.cpp directly.
+void *oe_context_llama(oe_context_t ctx);
+
 // ---------------------------------------------------------------------------
 // Tokenization
 // ---------------------------------------------------------------------------
@@ -107,6 +159,24 @@ int32_t oe_tokenize(oe_model_t model, const char *text, int32_t text_len,
 int32_t oe_token_to_piece(oe_model_t model, int32_t token,
                            char *buf, int32_t buf_len);
 
+// Tokenize n texts packed back to back in texts (text i is lens[i] bytes)
+// in one call. Tokens are written contiguously to out_tokens; text i owns
+// out_tokens[out_offsets[i] .. out_offsets[i+1]), so out_offsets must hold
+// n + 1 entries. The offsets are filled even when out_tokens is too small
+// (or NULL), which makes a capacity-0 call a pure batch token count.
+// Returns the total token count, or its negation if it exceeds capacity.
+int32_t oe_tokenize_many(oe_model_t model, const char *texts,
+                         const int32_t *lens, int32_t n,
+                         int32_t *out_tokens, int32_t *out_offsets,
+                         int32_t capacity,
+                         bool add_special, bool parse_special);
+
+// Convert a token sequence back to text in one call. Special tokens are
+// rendered as text. Returns the number of bytes written, or negative if
+// buf is too small (the absolute value is the required size).
+int32_t oe_detokenize(oe_model_t model, const int32_t *tokens, int32_t n,
+                      char *buf, int32_t buf_len);
+
 // Check if a token signals end-of-generation.
 bool oe_token_is_eog(oe_model_t model, int32_t token);
 
@@ -132,11 +202,68 @@ int32_t oe_decode(oe_context_t ctx, int32_t *tokens, int32_t n_tokens);
 int32_t oe_decode_batch(oe_context_t ctx, int32_t *tokens, int32_t n_tokens,
                          int32_t pos_start);
 
+// Evaluate one token of sequence 0 at pos, with logits. This is the
+// per-token generation step: it fills the context's persistent batch in
+// place, so it neither allocates nor needs a Go-side token slice.
+// Returns 0 on success, 1 if KV cache is full, negative on error.
+int32_t oe_decode_token(oe_context_t ctx, int32_t token, int32_t pos);
+
+// Evaluate a batch of independent (token, pos, seq_id, want_logits) tuples
+// in a single llama_decode call. This is the continuous-batching entry
+// point: the decode steps of several in-flight sequences are interleaved
+// into one batch. Logits of entry i (for oe_get_logits and
+// oe_sampler_sample) are addressed by its batch index i and are only
+// available when want_logits[i] is set. want_logits may be NULL (no logits).
+// Returns 0 on success, 1 if KV cache is full, negative on error.
+int32_t oe_decode_multi(oe_context_t ctx, const int32_t *tokens,
+                         const int32_t *pos, const int32_t *seq_ids,
+                         const bool *want_logits, int32_t n_tokens);
+
+// Run the sample -> detokenize -> decode loop natively for up to max_steps
+// tokens of sequence 0, starting with the logits of the last decode and
+// placing new tokens at pos, pos+1, ...
+//
+// Every returned token has been decoded into the KV cache. Token i is
+// written to out_tokens[i] and its UTF-8 piece to out_text (pieces are
+// concatenated, out_piece_lens[i] bytes each, no terminator). A piece that
+// does not fit in the remaining text buffer is not written; its
+// out_piece_lens entry is the negated size it needs and the caller converts
+// the token with oe_token_to_piece. out_tokens and out_piece_lens must hold
+// max_steps entries.
+//
+// When stop_on_eog is set, an end-of-generation token ends the loop with
+// OE_GEN_EOG; it is neither returned nor decoded. On OE_GEN_DECODE_FAIL the
+// failing token is not returned and *out_decode_rc holds llama_decode's code
+// (1 = KV cache full).
+//
+// Returns the number of tokens produced; the reason the loop ended is
+// stored in *out_status.
+int32_t oe_generate_step(oe_context_t ctx, oe_sampler_t sampler,
+                          int32_t pos, int32_t max_steps, bool stop_on_eog,
+                          int32_t *out_tokens, int32_t *out_piece_lens,
+                          char *out_text, int32_t text_cap,
+                          int32_t *out_status, int32_t *out_decode_rc);
+
 // Encode a batch of tokens using the model's encoder (for BERT/encoder models).
 // All tokens are marked as outputs so embeddings can be extracted for each.
 // Returns 0 on success, negative on error.
 int32_t oe_encode(oe_context_t ctx, int32_t *tokens, int32_t n_tokens);
 
+// Embed n_seqs texts in a single encode (encoder models) or decode
+// (decoder models, after clearing the KV cache). Text s is
+// tokens_flat[offsets[s]:offsets[s+1]]; offsets has n_seqs+1 entries and
+// offsets[0] == 0. Each text is evaluated as its own sequence (seq_id s),
+// so the context must allow n_seqs sequences and the whole batch must fit
+// in one ubatch. The pooled embedding of each sequence (last-token
+// embedding when pooling is disabled) is L2-normalized and written to row
+// s of out_matrix, which holds n_seqs * n_embd floats in row-major order.
+//
+// Returns 0 on success, -1 on invalid arguments, -2 if the batch cannot be
+// allocated, -3 if encode/decode fails and -4 if embeddings are missing.
+int32_t oe_embed_batch(oe_context_t ctx, const int32_t *tokens_flat,
+                        const int32_t *offsets, int32_t n_seqs,
+                        float *out_matrix);
+
 // ---------------------------------------------------------------------------
 // Logits & Embeddings
 // ---------------------------------------------------------------------------
@@ -176,16 +303,72 @@ int32_t oe_memory_seq_pos_max(oe_context_t ctx, int32_t seq_id);
 void oe_memory_seq_add(oe_context_t ctx, int32_t seq_id,
                        int32_t p0, int32_t p1, int32_t delta);
 
+// Context shift that preserves the first n_keep positions of seq_id (the
+// system prompt): removes [n_keep, n_keep + n_discard) and shifts the tail
+// down by n_discard so positions stay contiguous. Returns false, leaving
+// the cache untouched, if the memory cannot shift (e.g. recurrent models)
+// or the range is empty.
+bool oe_memory_seq_shift(oe_context_t ctx, int32_t seq_id,
+                         int32_t n_keep, int32_t n_discard);
+
+// ---------------------------------------------------------------------------
+// State save / restore
+// ---------------------------------------------------------------------------
+
+// Size in bytes of the serialized KV state of one sequence.
+size_t oe_state_seq_get_size(oe_context_t ctx, int32_t seq_id);
+
+// Serialize the KV state of seq_id into dst (capacity size bytes).
+// Returns the number of bytes written, 0 on failure.
+size_t oe_state_seq_get_data(oe_context_t ctx, uint8_t *dst, size_t size,
+                              int32_t seq_id);
+
+// Restore a state produced by oe_state_seq_get_data into dest_seq_id.
+// Returns the number of bytes read, 0 on failure.
+size_t oe_state_seq_set_data(oe_context_t ctx, const uint8_t *src, size_t size,
+                              int32_t dest_seq_id);
+
+// Write the KV state of seq_id plus the tokens it was built from to path.
+// Returns true on success.
+bool oe_state_save_file(oe_context_t ctx, const char *path, int32_t seq_id,
+                         const int32_t *tokens, int32_t n_tokens);
+
+// Load a file written by oe_state_save_file into dest_seq_id. The stored
+// tokens are copied to tokens_out (capacity n_token_capacity). Returns the
+// number of tokens, or -1 on failure (missing file, incompatible model or
+// KV layout, capacity too small).
+int32_t oe_state_load_file(oe_context_t ctx, const char *path, int32_t dest_seq_id,
+                            int32_t *tokens_out, int32_t n_token_capacity);
+
 // ---------------------------------------------------------------------------
-// Speculative decoding
+// Continuation scoring
 // ---------------------------------------------------------------------------
 
-// Evaluate a batch of tokens with logits computed for ALL tokens (not just
-// the last one). This is needed for speculative decoding verification: the
-// target model evaluates N draft tokens and checks each one against its own
-// distribution. Returns 0 on success, 1 if KV cache full, negative on error.
-int32_t oe_decode_batch_logits_all(oe_context_t ctx, int32_t *tokens,
-                                    int32_t n_tokens, int32_t pos_start);
+// Score n_cands continuations of a prompt by log-likelihood. Candidate k is
+// cand_flat[cand_offsets[k]:cand_offsets[k+1]] (cand_offsets has n_cands+1
+// entries); out_logprobs[k] receives the sum of its tokens' log-probs.
+//
+// prefix[0..n_prefix-1) must already be in sequence 0 at positions
+// 0..n_prefix-2. Each candidate gets its own sequence, seq_base + j for
+// j < n_seqs, holding a copy of that prefix (a metadata-only copy in the
+// unified KV cache); the last prefix token is evaluated per candidate so
+// its logits score the candidate's first token. Candidates are packed into
+// as few batches as n_batch and n_seqs allow, and the scoring sequences are
+// cleared again before returning. Sequence 0 is not modified.
+//
+// seq_base 0 means no sequences are reserved: candidates are then scored
+// one at a time on sequence 0, which is restored to the prefix after each
+// (by truncation, or from a saved copy of its state on recurrent and
+// hybrid memory).
+// Returns 0 on success, 1 if the KV cache is full, negative on error (-3:
+// a candidate is longer than n_batch; -2: out of memory, or sequence 0
+// could not be restored).
+int32_t oe_score_continuations(oe_context_t ctx,
+                               const int32_t *prefix, int32_t n_prefix,
+                               const int32_t *cand_flat,
+                               const int32_t *cand_offsets, int32_t n_cands,
+                               int32_t seq_base, int32_t n_seqs,
+                               float *out_logprobs);
 
 // ---------------------------------------------------------------------------
 // Sampler chain
@@ -217,6 +400,20 @@ void oe_sampler_chain_add_dist(oe_sampler_t chain, uint32_t seed);
 // Add a greedy (argmax) sampler to the chain.
 void oe_sampler_chain_add_greedy(oe_sampler_t chain);
 
+// Add a GBNF grammar sampler to the chain. Tokens that cannot continue a
+// string the grammar accepts are masked out, and end-of-generation is only
+// allowed once the grammar is complete. Add it first so later filters only
+// see legal tokens. Returns false if the grammar fails to parse.
+bool oe_sampler_chain_add_grammar(oe_sampler_t chain, oe_model_t model,
+                                  const char *gbnf, const char *root);
+
+// Add a sampler that bans every token except tokens[0..n), restricting
+// the next draw to that set (e.g. the first tokens of classification
+// labels). Add it first and follow it with greedy for an argmax over the
+// allowed tokens.
+void oe_sampler_chain_add_allowed_tokens(oe_sampler_t chain, oe_model_t model,
+                                         const int32_t *tokens, int32_t n);
+
 // Sample a token from the given context at the specified output index.
 // idx = -1 means the last token in the batch.
 int32_t oe_sampler_sample(oe_sampler_t chain, oe_context_t ctx, int32_t idx);
@@ -227,6 +424,51 @@ void oe_sampler_reset(oe_sampler_t chain);
 // Free the sampler chain and all samplers it owns.
 void oe_sampler_free(oe_sampler_t chain);
 
+// ---------------------------------------------------------------------------
+// Speculative sampling
+// ---------------------------------------------------------------------------
+
+// Sample a token at batch index idx (-1 = last) like oe_sampler_sample, and
+// also write the distribution it was drawn from to out_probs (n_vocab
+// floats, dense). Every sampler but the chain's final dist/greedy one is
+// applied; a greedy chain yields a one-hot row. The token is accepted into
+// the chain. Returns -1 on error. Used for draft tokens, whose
+// probabilities oe_speculative_verify needs. If out_top_p is non-NULL it
+// receives the probability of the most likely candidate, which callers use
+// to stop drafting once the draft model becomes unsure.
+int32_t oe_sampler_sample_probs(oe_sampler_t chain, oe_context_t ctx,
+                                 int32_t idx, float *out_probs, float *out_top_p);
+
+// Verify n_draft draft tokens against the target context with speculative
+// rejection sampling: draft i is accepted with probability
+// min(1, p(x)/q(x)), where p is the target distribution under sampler and
+// q is row i of draft_probs (n_draft x n_vocab, from
+// oe_sampler_sample_probs). At the first rejection a replacement is drawn
+// from the normalized residual max(0, p - q); if all drafts are accepted a
+// bonus token is drawn from p. The output follows exactly the target
+// sampler's distribution, whatever the draft model proposes.
+//
+// On entry the target context must hold logits for the token at pos (from
+// its last decode). On return every token in out_tokens (capacity
+// n_draft + 1) has been decoded at pos, pos+1, ..., the KV of rejected
+// drafts removed, and the last decode's logits predict the next token.
+// Emitted tokens are accepted into sampler, each only once it is in the
+// KV cache.
+//
+// Returns the number of tokens written, or -1 on error (*out_decode_rc
+// holds llama_decode's code when a decode failed, 1 = KV cache full, or
+// OE_SPEC_RC_TRUNCATE when the rejected drafts could not be removed, as
+// with recurrent memory). On error the sampler is reset, since drafts it
+// already accepted are not kept.
+// *out_accepted receives the number of draft tokens accepted.
+#define OE_SPEC_RC_TRUNCATE (-100)
+
+int32_t oe_speculative_verify(oe_context_t target_ctx, oe_sampler_t sampler,
+                               int32_t pos, const int32_t *draft_tokens,
+                               const float *draft_probs, int32_t n_draft,
+                               int32_t *out_tokens, int32_t *out_accepted,
+                               int32_t *out_decode_rc);
+
 // ---------------------------------------------------------------------------
 // Context control
 // ---------------------------------------------------------------------------
@@ -254,6 +496,34 @@ oe_perf_data_t oe_perf_context(oe_context_t ctx);
 // Reset performance counters.
 void oe_perf_context_reset(oe_context_t ctx);
 
+// Monotonic clock used by perf event timestamps, in nanoseconds.
+int64_t oe_perf_now_ns(void);
+
+// Copy recorded phase events into out (up to cap) and return the count.
+// Events are kept in a fixed-size lock-free ring shared by all contexts;
+// *cursor is the reader's position (from oe_perf_cursor) and is advanced
+// past the returned events. Events overwritten before they were read are
+// added to *out_dropped. Reading does not consume events, so any number
+// of readers can follow the ring, each with its own cursor. Safe against
+// concurrent writers.
+int32_t oe_perf_drain(uint64_t *cursor, oe_perf_event_t *out, int32_t cap,
+                      uint64_t *out_dropped);
+
+// Position of the next event to be recorded: a cursor from which
+// oe_perf_drain returns only events recorded after this call.
+uint64_t oe_perf_cursor(void);
+
+// Total number of calls into this binding (each one a cgo crossing) since
+// the process started.
+uint64_t oe_perf_calls(void);
+
+// Micro-benchmark for decode batch preparation. Builds an n_tokens batch
+// n_iters times, first with a llama_batch_init/llama_batch_free pair per
+// call and then through the context's persistent batch, and reports the
+// mean cost per call in nanoseconds. No decode is run.
+void oe_bench_batch_prepare(oe_context_t ctx, int32_t n_tokens, int32_t n_iters,
+                             double *alloc_ns, double *arena_ns);
+
 // Get system info string (CPU features, etc.)
 const char *oe_system_info(void);
 
@@ -0,0 +1,17 @@
+// OpenEye native binding — call counter shared by the C sources. Internal:
+// not included from Go.
+
+#ifndef OPENEYE_BINDING_PERF_H
+#define OPENEYE_BINDING_PERF_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+extern _Atomic uint64_t oe_perf_n_calls;
+
+// Every exported function starts with this, so oe_perf_calls counts cgo
+// crossings into the binding.
+#define OE_PERF_CALL() \
+    atomic_fetch_add_explicit(&oe_perf_n_calls, 1, memory_order_relaxed)
+
+#endif // OPENEYE_BINDING_PERF_H
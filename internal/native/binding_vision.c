@@ -2,6 +2,7 @@
 // Wraps the mtmd (multimodal) API for image+text evaluation.
 
 #include "binding_vision.h"
+#include "binding_perf.h"
 #include "mtmd.h"
 #include "mtmd-helper.h"
 #include "llama.h"
@@ -14,8 +15,21 @@
 // Vision context lifecycle
 // ---------------------------------------------------------------------------
 
+// A vision context: the mtmd context and the text model it feeds. Encoder
+// output rows are the text model's input embedding width, which is what
+// mtmd's decode helper reads back.
+struct oe_vision {
+    mtmd_context             *mctx;
+    const struct llama_model *model;
+};
+
+static mtmd_context *oe_vision_mctx(oe_vision_t vctx) {
+    return ((struct oe_vision *)vctx)->mctx;
+}
+
 oe_vision_t oe_vision_init(const char *mmproj_path, oe_model_t text_model,
                             int n_threads, bool use_gpu) {
+    OE_PERF_CALL();
     if (!mmproj_path || !text_model) return NULL;
 
     struct mtmd_context_params params = mtmd_context_params_default();
@@ -29,78 +43,97 @@ oe_vision_t oe_vision_init(const char *mmproj_path, oe_model_t text_model,
         (const struct llama_model *)text_model,
         params);
 
-    return (oe_vision_t)ctx;
+    if (!ctx) return NULL;
+
+    struct oe_vision *v = malloc(sizeof(*v));
+    if (!v) {
+        mtmd_free(ctx);
+        return NULL;
+    }
+    v->mctx  = ctx;
+    v->model = (const struct llama_model *)text_model;
+    return (oe_vision_t)v;
 }
 
 void oe_vision_free(oe_vision_t vctx) {
+    OE_PERF_CALL();
     if (vctx) {
-        mtmd_free((mtmd_context *)vctx);
+        mtmd_free(oe_vision_mctx(vctx));
+        free(vctx);
     }
 }
 
 bool oe_vision_supported(oe_vision_t vctx) {
+    OE_PERF_CALL();
     if (!vctx) return false;
-    return mtmd_support_vision((mtmd_context *)vctx);
+    return mtmd_support_vision(oe_vision_mctx(vctx));
 }
 
 // ---------------------------------------------------------------------------
 // Bitmap loading
 // ---------------------------------------------------------------------------
 
+// Set a bitmap's id to an FNV-1a hash of its dimensions and pixels.
+static void oe_vision_set_content_id(mtmd_bitmap *bmp) {
+    uint64_t h = 1469598103934665603ULL;
+    uint32_t dims[2] = { mtmd_bitmap_get_nx(bmp), mtmd_bitmap_get_ny(bmp) };
+    const unsigned char *p = (const unsigned char *)dims;
+    for (size_t i = 0; i < sizeof(dims); i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    p = mtmd_bitmap_get_data(bmp);
+    size_t n = mtmd_bitmap_get_n_bytes(bmp);
+    for (size_t i = 0; i < n; i++) {
+        h = (h ^ p[i]) * 1099511628211ULL;
+    }
+    char id[17];
+    snprintf(id, sizeof(id), "%016llx", (unsigned long long)h);
+    mtmd_bitmap_set_id(bmp, id);
+}
+
 oe_bitmap_t oe_vision_load_image(oe_vision_t vctx, const char *path) {
+    OE_PERF_CALL();
     if (!vctx || !path) return NULL;
     mtmd_bitmap *bmp = mtmd_helper_bitmap_init_from_file(
-        (mtmd_context *)vctx, path);
+        oe_vision_mctx(vctx), path);
+    if (bmp) oe_vision_set_content_id(bmp);
+    return (oe_bitmap_t)bmp;
+}
+
+oe_bitmap_t oe_vision_bitmap_from_rgb(oe_vision_t vctx, uint32_t width,
+                                       uint32_t height, const unsigned char *rgb) {
+    OE_PERF_CALL();
+    if (!vctx || !rgb || width == 0 || height == 0) return NULL;
+    mtmd_bitmap *bmp = mtmd_bitmap_init(width, height, rgb);
+    if (bmp) oe_vision_set_content_id(bmp);
     return (oe_bitmap_t)bmp;
 }
 
 void oe_vision_bitmap_free(oe_bitmap_t bmp) {
+    OE_PERF_CALL();
     if (bmp) {
         mtmd_bitmap_free((mtmd_bitmap *)bmp);
     }
 }
 
 // ---------------------------------------------------------------------------
-// Tokenize + Evaluate
+// Tokenize, encode, evaluate
 // ---------------------------------------------------------------------------
 
-int32_t oe_vision_eval(oe_vision_t vctx, oe_context_t lctx,
-                        const char *prompt, const char **image_paths,
-                        int n_images, int32_t n_past, int32_t n_batch,
-                        int32_t *new_n_past) {
-    if (!vctx || !lctx || !prompt) return -1;
-    if (n_images > 0 && !image_paths) return -1;
-
-    mtmd_context *mctx = (mtmd_context *)vctx;
-    struct llama_context *llctx = (struct llama_context *)lctx;
-
-    // Load all bitmaps from file paths.
-    mtmd_bitmap **bitmaps = NULL;
-    if (n_images > 0) {
-        bitmaps = (mtmd_bitmap **)calloc(n_images, sizeof(mtmd_bitmap *));
-        if (!bitmaps) return -2;
-
-        for (int i = 0; i < n_images; i++) {
-            bitmaps[i] = mtmd_helper_bitmap_init_from_file(mctx, image_paths[i]);
-            if (!bitmaps[i]) {
-                // Clean up already loaded bitmaps.
-                for (int j = 0; j < i; j++) {
-                    mtmd_bitmap_free(bitmaps[j]);
-                }
-                free(bitmaps);
-                return -3; // image load failed
-            }
-        }
-    }
-
-    // Tokenize prompt with image markers.
+oe_chunks_t oe_vision_tokenize(oe_vision_t vctx, const char *prompt,
+                                const oe_bitmap_t *bitmaps, int n_bitmaps,
+                                int32_t *rc) {
+    OE_PERF_CALL();
+    int32_t dummy;
+    if (!rc) rc = &dummy;
+    *rc = -1;
+    if (!vctx || !prompt) return NULL;
+    if (n_bitmaps > 0 && !bitmaps) return NULL;
+
     mtmd_input_chunks *chunks = mtmd_input_chunks_init();
     if (!chunks) {
-        for (int i = 0; i < n_images; i++) {
-            mtmd_bitmap_free(bitmaps[i]);
-        }
-        free(bitmaps);
-        return -4;
+        *rc = -2;
+        return NULL;
     }
 
     mtmd_input_text input_text;
@@ -108,41 +141,137 @@ int32_t oe_vision_eval(oe_vision_t vctx, oe_context_t lctx,
     input_text.add_special   = true;
     input_text.parse_special = true;
 
-    int32_t tok_rc = mtmd_tokenize(mctx, chunks, &input_text,
+    int32_t tok_rc = mtmd_tokenize(oe_vision_mctx(vctx), chunks, &input_text,
                                     (const mtmd_bitmap **)bitmaps,
-                                    (size_t)n_images);
+                                    (size_t)n_bitmaps);
+    if (tok_rc != 0) {
+        mtmd_input_chunks_free(chunks);
+        *rc = -5; // tokenization failed (marker/bitmap mismatch)
+        return NULL;
+    }
 
-    // Free bitmaps after tokenization — they're no longer needed.
-    for (int i = 0; i < n_images; i++) {
-        mtmd_bitmap_free(bitmaps[i]);
+    *rc = 0;
+    return (oe_chunks_t)chunks;
+}
+
+void oe_vision_chunks_free(oe_chunks_t chunks) {
+    OE_PERF_CALL();
+    if (chunks) {
+        mtmd_input_chunks_free((mtmd_input_chunks *)chunks);
     }
-    free(bitmaps);
+}
 
-    if (tok_rc != 0) {
-        mtmd_input_chunks_free(chunks);
-        return -5; // tokenization failed (marker/bitmap mismatch)
+int32_t oe_vision_chunks_count(oe_chunks_t chunks) {
+    OE_PERF_CALL();
+    if (!chunks) return 0;
+    return (int32_t)mtmd_input_chunks_size((const mtmd_input_chunks *)chunks);
+}
+
+static const mtmd_input_chunk *oe_vision_chunk(oe_chunks_t chunks, int32_t i) {
+    if (!chunks || i < 0 || i >= oe_vision_chunks_count(chunks)) return NULL;
+    return mtmd_input_chunks_get((const mtmd_input_chunks *)chunks, (size_t)i);
+}
+
+int32_t oe_vision_chunk_type(oe_chunks_t chunks, int32_t i) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!chunk) return -1;
+    switch (mtmd_input_chunk_get_type(chunk)) {
+    case MTMD_INPUT_CHUNK_TYPE_TEXT:  return OE_CHUNK_TEXT;
+    case MTMD_INPUT_CHUNK_TYPE_IMAGE: return OE_CHUNK_IMAGE;
+    default:                          return OE_CHUNK_AUDIO;
     }
+}
 
-    // Evaluate all chunks (text + encoded images) into the llama context.
-    llama_pos out_n_past = (llama_pos)n_past;
-    int32_t eval_rc = mtmd_helper_eval_chunks(
-        mctx, llctx, chunks,
-        (llama_pos)n_past,      // n_past
-        0,                       // seq_id
-        (int32_t)n_batch,        // n_batch
-        true,                    // logits_last
-        &out_n_past);
+int32_t oe_vision_chunk_n_tokens(oe_chunks_t chunks, int32_t i) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!chunk) return 0;
+    return (int32_t)mtmd_input_chunk_get_n_tokens(chunk);
+}
 
-    mtmd_input_chunks_free(chunks);
+int32_t oe_vision_chunk_text_tokens(oe_chunks_t chunks, int32_t i,
+                                     int32_t *out, int32_t n_max) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!chunk || mtmd_input_chunk_get_type(chunk) != MTMD_INPUT_CHUNK_TYPE_TEXT) {
+        return -1;
+    }
+    size_t n = 0;
+    const llama_token *tokens = mtmd_input_chunk_get_tokens_text(chunk, &n);
+    if (out && tokens) {
+        size_t n_copy = n < (size_t)n_max ? n : (size_t)n_max;
+        memcpy(out, tokens, n_copy * sizeof(int32_t));
+    }
+    return (int32_t)n;
+}
+
+const char *oe_vision_chunk_id(oe_chunks_t chunks, int32_t i) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    const char *id = chunk ? mtmd_input_chunk_get_id(chunk) : NULL;
+    return id ? id : "";
+}
 
-    if (eval_rc != 0) {
+int64_t oe_vision_chunk_n_floats(oe_vision_t vctx, oe_chunks_t chunks, int32_t i) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!vctx || !chunk) return 0;
+    if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_TEXT) return 0;
+    const struct oe_vision *v = (const struct oe_vision *)vctx;
+    return (int64_t)mtmd_input_chunk_get_n_tokens(chunk) *
+           (int64_t)llama_model_n_embd_inp(v->model);
+}
+
+int32_t oe_vision_encode_chunk(oe_vision_t vctx, oe_chunks_t chunks, int32_t i,
+                                float *out, int64_t n_floats) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!vctx || !chunk || !out) return -1;
+    if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_TEXT) return -1;
+    const int64_t need = oe_vision_chunk_n_floats(vctx, chunks, i);
+    if (need <= 0 || n_floats < need) return -3;
+
+    mtmd_context *mctx = oe_vision_mctx(vctx);
+    if (mtmd_encode_chunk(mctx, chunk) != 0) {
+        return -2;
+    }
+    const float *embd = mtmd_get_output_embd(mctx);
+    if (!embd) return -2;
+    memcpy(out, embd, (size_t)need * sizeof(float));
+    return 0;
+}
+
+int32_t oe_vision_eval_chunk(oe_vision_t vctx, oe_context_t lctx,
+                              oe_chunks_t chunks, int32_t i, const float *embd,
+                              int32_t n_past, int32_t n_batch, bool logits_last,
+                              int32_t *new_n_past) {
+    OE_PERF_CALL();
+    const mtmd_input_chunk *chunk = oe_vision_chunk(chunks, i);
+    if (!vctx || !lctx || !chunk) return -1;
+
+    mtmd_context *mctx = oe_vision_mctx(vctx);
+    struct llama_context *llctx = (struct llama_context *)oe_context_llama(lctx);
+    llama_pos out_n_past = (llama_pos)n_past;
+    int32_t rc;
+
+    if (mtmd_input_chunk_get_type(chunk) == MTMD_INPUT_CHUNK_TYPE_TEXT) {
+        rc = mtmd_helper_eval_chunk_single(mctx, llctx, chunk,
+                                           (llama_pos)n_past, 0, n_batch,
+                                           logits_last, &out_n_past);
+    } else {
+        if (!embd) return -1;
+        rc = mtmd_helper_decode_image_chunk(mctx, llctx, chunk, (float *)embd,
+                                            (llama_pos)n_past, 0, n_batch,
+                                            &out_n_past);
+    }
+    if (rc != 0) {
         return -6; // eval failed
     }
 
     if (new_n_past) {
         *new_n_past = (int32_t)out_n_past;
     }
-
     return 0;
 }
 
@@ -172,6 +301,7 @@ static void oe_vision_log_noop_cb(enum ggml_log_level level, const char *text, v
 }
 
 void oe_vision_log_to_file(const char *path) {
+    OE_PERF_CALL();
     if (oe_vision_log_fp && oe_vision_log_fp != stderr) {
         fclose(oe_vision_log_fp);
         oe_vision_log_fp = NULL;
@@ -187,6 +317,7 @@ void oe_vision_log_to_file(const char *path) {
 }
 
 void oe_vision_log_disable(void) {
+    OE_PERF_CALL();
     if (oe_vision_log_fp && oe_vision_log_fp != stderr) {
         fclose(oe_vision_log_fp);
         oe_vision_log_fp = NULL;
@@ -199,5 +330,6 @@ void oe_vision_log_disable(void) {
 // ---------------------------------------------------------------------------
 
 const char *oe_vision_default_marker(void) {
+    OE_PERF_CALL();
     return mtmd_default_marker();
 }
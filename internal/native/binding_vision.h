@@ -37,29 +37,81 @@ bool oe_vision_supported(oe_vision_t vctx);
 // Bitmap (image) loading
 // ---------------------------------------------------------------------------
 
+// Bitmaps carry a content id: a hash of the image's dimensions and decoded
+// pixels, so the same picture gets the same id whether it came from a
+// file or from memory.
+
 // Load an image from a file path into a bitmap. Returns NULL on failure.
 oe_bitmap_t oe_vision_load_image(oe_vision_t vctx, const char *path);
 
+// Create a bitmap from width * height pixels of packed 8-bit RGB (the data
+// is copied). Returns NULL on failure.
+oe_bitmap_t oe_vision_bitmap_from_rgb(oe_vision_t vctx, uint32_t width,
+                                       uint32_t height, const unsigned char *rgb);
+
 // Free a loaded bitmap.
 void oe_vision_bitmap_free(oe_bitmap_t bmp);
 
 // ---------------------------------------------------------------------------
-// Tokenize + Evaluate (high-level)
+// Tokenize, encode, evaluate
 // ---------------------------------------------------------------------------
 
-// Tokenize a prompt containing <__media__> markers with the given images,
-// then evaluate all chunks (text + image) into the llama context.
-// On success, returns 0 and writes the new KV cache position to *new_n_past.
-// On failure, returns a negative error code.
-//
-// image_paths: array of file paths, one per <__media__> marker in prompt.
-// n_images:    number of image paths (must match marker count in prompt).
-// n_past:      current KV cache position (typically 0 after clear).
-// n_batch:     batch size for evaluation (should match context's n_batch).
-int32_t oe_vision_eval(oe_vision_t vctx, oe_context_t lctx,
-                        const char *prompt, const char **image_paths,
-                        int n_images, int32_t n_past, int32_t n_batch,
-                        int32_t *new_n_past);
+// Chunk types returned by oe_vision_chunk_type.
+#define OE_CHUNK_TEXT  0
+#define OE_CHUNK_IMAGE 1
+#define OE_CHUNK_AUDIO 2
+
+// Split a prompt containing <__media__> markers into text and image chunks,
+// one bitmap per marker. Image chunk ids are the bitmaps' content ids. The
+// bitmaps are not consumed; free them after this returns.
+// Returns NULL on failure and writes a negative error code to *rc:
+// -1 invalid arguments, -2 allocation failure, -5 tokenization failed
+// (marker/image count mismatch).
+oe_chunks_t oe_vision_tokenize(oe_vision_t vctx, const char *prompt,
+                                const oe_bitmap_t *bitmaps, int n_bitmaps,
+                                int32_t *rc);
+
+// Free a chunk list.
+void oe_vision_chunks_free(oe_chunks_t chunks);
+
+// Number of chunks in the list.
+int32_t oe_vision_chunks_count(oe_chunks_t chunks);
+
+// Type of chunk i (OE_CHUNK_*).
+int32_t oe_vision_chunk_type(oe_chunks_t chunks, int32_t i);
+
+// Number of tokens (text tokens or image embeddings) in chunk i.
+int32_t oe_vision_chunk_n_tokens(oe_chunks_t chunks, int32_t i);
+
+// Copy up to n_max tokens of text chunk i into out. Returns the chunk's
+// token count, or -1 if chunk i is not a text chunk.
+int32_t oe_vision_chunk_text_tokens(oe_chunks_t chunks, int32_t i,
+                                     int32_t *out, int32_t n_max);
+
+// Content id of image chunk i, or "" for text chunks.
+const char *oe_vision_chunk_id(oe_chunks_t chunks, int32_t i);
+
+// Number of floats in the embeddings of image chunk i: n_tokens rows of
+// the text model's input embedding width (llama_model_n_embd_inp, which
+// can differ from n_embd). Returns 0 for text chunks.
+int64_t oe_vision_chunk_n_floats(oe_vision_t vctx, oe_chunks_t chunks, int32_t i);
+
+// Run the vision encoder on image chunk i and copy its embeddings into out,
+// which holds n_floats floats. Returns 0 on success, -1 on invalid
+// arguments, -2 if the encoder failed, -3 if n_floats is less than
+// oe_vision_chunk_n_floats.
+int32_t oe_vision_encode_chunk(oe_vision_t vctx, oe_chunks_t chunks, int32_t i,
+                                float *out, int64_t n_floats);
+
+// Evaluate chunk i into sequence 0 of the llama context at position n_past.
+// Image chunks are decoded from embd, as produced by oe_vision_encode_chunk;
+// text chunks ignore it. logits_last requests logits for the last token of
+// a text chunk. On success, returns 0 and writes the new KV cache position
+// to *new_n_past; returns a negative error code on failure.
+int32_t oe_vision_eval_chunk(oe_vision_t vctx, oe_context_t lctx,
+                              oe_chunks_t chunks, int32_t i, const float *embd,
+                              int32_t n_past, int32_t n_batch, bool logits_last,
+                              int32_t *new_n_past);
 
 // ---------------------------------------------------------------------------
 // Log control (redirects mtmd logs along with llama logs)
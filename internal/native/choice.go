@@ -0,0 +1,179 @@
+//go:build native
+
+package native
+
+import (
+	"context"
+	"fmt"
+	"time"
+
+	"OpenEye/internal/grammar"
+	"OpenEye/internal/runtime"
+)
+
+// choicePlan classifies a prompt among fixed labels with a single restricted
+// draw: each label is identified by its first token (with and without a
+// leading space, since labels usually follow a "LABEL:" cue), every other
+// token is banned, and the argmax decides.
+type choicePlan struct {
+	first   map[int32]int // first token -> index into the labels
+	allowed []int32
+}
+
+// newChoicePlan builds a plan for labels, or returns false when two labels
+// share a first token and one draw cannot tell them apart.
+func newChoicePlan(labels []string, tokenize func(string) []int32) (*choicePlan, bool) {
+	p := &choicePlan{first: make(map[int32]int)}
+	for i, label := range labels {
+		for _, variant := range []string{label, " " + label} {
+			toks := tokenize(variant)
+			if len(toks) == 0 {
+				return nil, false
+			}
+			if j, seen := p.first[toks[0]]; seen {
+				if j != i {
+					return nil, false
+				}
+				continue
+			}
+			p.first[toks[0]] = i
+			p.allowed = append(p.allowed, toks[0])
+		}
+	}
+	return p, len(p.allowed) > 0
+}
+
+// label returns the label chosen by token.
+func (p *choicePlan) label(labels []string, token int32) (string, bool) {
+	i, ok := p.first[token]
+	if !ok {
+		return "", false
+	}
+	return labels[i], true
+}
+
+// planChoices prepares opts for a request with Choices. Labels separable by
+// their first token get a plan for a one-token restricted draw. Otherwise
+// it returns nil and, unless the caller can score the labels instead
+// (scorable), gives opts an equivalent grammar so the labels are generated
+// in full. Stop sequences are dropped since the output is a bare label.
+// The caller holds a.mu.
+func (a *Adapter) planChoices(opts *runtime.GenerationOptions, scorable bool) *choicePlan {
+	if len(opts.Choices) == 0 {
+		return nil
+	}
+	opts.Stop = nil
+	plan, ok := newChoicePlan(opts.Choices, func(s string) []int32 {
+		toks, _ := a.model.Tokenize(s, false, false)
+		return toks
+	})
+	if ok {
+		opts.MaxTokens = 1
+		opts.Grammar = ""
+		return plan
+	}
+	if !scorable {
+		opts.Grammar = "root ::= \" \"? " + grammar.Enum(opts.Choices...) + "\n"
+	}
+	return nil
+}
+
+// Score returns the log-likelihood of each continuation following prompt,
+// summed over its tokens. Continuations are tokenized on their own, so
+// one that follows a "LABEL:" cue should carry its leading space. All
+// candidates share the prompt's KV entries (reused from the prompt cache
+// where possible) and are evaluated rather than generated: together in one
+// batched decode when score_sequences reserves KV sequences for them, one
+// at a time on the prompt's own sequence otherwise.
+func (a *Adapter) Score(ctx context.Context, prompt string, continuations []string) ([]float64, error) {
+	if err := ctx.Err(); err != nil {
+		return nil, err
+	}
+	a.mu.Lock()
+	defer a.mu.Unlock()
+	a.reclaimSerial()
+	scores, _, err := a.scoreLocked(prompt, continuations)
+	return scores, err
+}
+
+// scoreLocked implements Score; the caller holds a.mu. It also returns the
+// prompt's token count and how many of them came from the prompt cache.
+func (a *Adapter) scoreLocked(prompt string, continuations []string) ([]float64, runtime.Stats, error) {
+	var st runtime.Stats
+	tokens, err := a.model.Tokenize(prompt, true, true)
+	if err != nil {
+		return nil, st, fmt.Errorf("native: tokenize: %w", err)
+	}
+	if len(tokens) == 0 {
+		return nil, st, fmt.Errorf("native: empty prompt")
+	}
+	cands := make([][]int32, len(continuations))
+	longest := 0
+	for i, c := range continuations {
+		toks, err := a.model.Tokenize(c, false, false)
+		if err != nil || len(toks) == 0 {
+			return nil, st, fmt.Errorf("native: cannot score continuation %q", c)
+		}
+		cands[i] = toks
+		if len(toks) > longest {
+			longest = len(toks)
+		}
+	}
+	if len(tokens)+longest > a.contextSize() {
+		return nil, st, fmt.Errorf("native: prompt too long to score (%d tokens)", len(tokens))
+	}
+
+	// Sequence 0 must hold the prompt minus its last token; reuse what the
+	// prompt cache already has.
+	keep := len(tokens) - 1
+	prefixLen := commonPrefixLen(a.lastPromptTokens, tokens)
+	if prefixLen > keep {
+		prefixLen = keep
+	}
+	prefixLen = a.truncateSeq0(prefixLen)
+	a.lastPromptTokens = nil
+	if keep > prefixLen {
+		if err := a.evalTokensInChunks(tokens[prefixLen:keep]); err != nil {
+			return nil, st, fmt.Errorf("native: eval prompt: %w", err)
+		}
+	}
+	a.lastPromptTokens = append(make([]int32, 0, len(tokens)), tokens[:keep]...)
+
+	st.TokensEvaluated = len(tokens)
+	st.TokensCached = prefixLen
+	nSeqs := a.scoreSeqs
+	if nSeqs == 0 {
+		nSeqs = 1 // in place on sequence 0
+	}
+	scores, err := a.ctx.ScoreContinuations(tokens, cands, a.scoreSeqBase, nSeqs)
+	if err != nil && a.scoreSeqBase == 0 {
+		// Sequence 0 may no longer hold the prompt.
+		a.truncateSeq0(0)
+		a.lastPromptTokens = nil
+	}
+	return scores, st, err
+}
+
+// chooseByScore answers a Choices request whose labels share first tokens
+// by scoring every label in full and returning the most likely one.
+func (a *Adapter) chooseByScore(prompt string, labels []string, span perfSpan) (runtime.Response, error) {
+	start := time.Now()
+	conts := make([]string, len(labels))
+	for i, l := range labels {
+		conts[i] = " " + l
+	}
+	scores, st, err := a.scoreLocked(prompt, conts)
+	if err != nil {
+		return runtime.Response{}, err
+	}
+	best := 0
+	for i, s := range scores {
+		if s > scores[best] {
+			best = i
+		}
+	}
+	st.Duration = time.Since(start)
+	st.TTFT = st.Duration
+	st.Phases = a.endPerf(span)
+	return runtime.Response{Text: labels[best], Stats: st, Finish: "stop"}, nil
+}
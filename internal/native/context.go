@@ -9,7 +9,9 @@ import "C"
 import (
 	"fmt"
 	"log"
+	"strings"
 	"sync"
+	"time"
 )
 
 // Context wraps a llama.cpp inference context. It holds the KV cache and
@@ -24,6 +26,11 @@ type Context struct {
 
 	// Track the current position in the KV cache for auto-advancing decode.
 	pos int32
+
+	// Scratch buffers reused across GenerateStep calls.
+	stepTokens []int32
+	stepLens   []int32
+	stepText   []byte
 }
 
 // ContextOptions configures the inference context.
@@ -52,11 +59,18 @@ type ContextOptions struct {
 	// FlashAttn controls flash attention: -1=auto, 0=disabled, 1=enabled.
 	FlashAttn int32
 
-	// TypeK controls KV cache key quantization: 0=f16, 1=q8_0, 2=q4_0.
-	TypeK int32
+	// TypeK is the KV cache key type by ggml name ("f16", "q8_0",
+	// "q5_1", "q5_0", "iq4_nl", "q4_0", ...). "" = f16.
+	TypeK string
+
+	// TypeV is the KV cache value type, set independently of TypeK.
+	// Quantized value caches need flash attention.
+	TypeV string
 
-	// TypeV controls KV cache value quantization: 0=f16, 1=q8_0, 2=q4_0.
-	TypeV int32
+	// NSeqMax is the number of independent sequences the KV cache can
+	// hold. 0 or 1 = single sequence. Values > 1 enable multi-sequence
+	// batching (see DecodeMulti) over a unified KV pool.
+	NSeqMax uint32
 }
 
 // DefaultContextOptions returns sensible defaults for edge inference.
@@ -84,9 +98,18 @@ func NewContext(model *Model, opts ContextOptions) (*Context, error) {
 		nBatch = nUbatch
 	}
 
+	typeK, err := kvCacheType(opts.TypeK)
+	if err != nil {
+		return nil, err
+	}
+	typeV, err := kvCacheType(opts.TypeV)
+	if err != nil {
+		return nil, err
+	}
+
 	handle := cContextNew(model.handle, opts.NCtx, nBatch, nUbatch,
 		opts.NThreads, opts.NThreadsBatch, opts.Embeddings, opts.FlashAttn,
-		opts.TypeK, opts.TypeV)
+		typeK, typeV, opts.NSeqMax)
 	if handle == nil {
 		return nil, fmt.Errorf("native: failed to create context")
 	}
@@ -124,9 +147,26 @@ func (c *Context) Eval(tokens []int32) error {
 	return nil
 }
 
-// EvalToken processes a single token, appending it to the KV cache.
+// EvalToken processes a single token, appending it to the KV cache. This is
+// the per-token generation step, so it goes straight to the context's
+// persistent C batch without building a Go slice.
 func (c *Context) EvalToken(token int32) error {
-	return c.Eval([]int32{token})
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return fmt.Errorf("native: context is closed")
+	}
+
+	rc := cDecodeToken(c.handle, token, c.pos)
+	if rc != 0 {
+		if rc == 1 {
+			return fmt.Errorf("native: KV cache full, need larger context or shorter prompt")
+		}
+		return fmt.Errorf("native: decode failed with code %d", rc)
+	}
+
+	c.pos++
+	return nil
 }
 
 // Encode processes a batch of tokens through the model's encoder path.
@@ -166,6 +206,309 @@ func (c *Context) SampleToken(sampler *SamplerChain) (int32, error) {
 	return token, nil
 }
 
+// SampleTokenProbs samples like SampleToken and also writes the
+// distribution the token was drawn from into probs, which must hold one
+// float per vocabulary entry. It additionally returns the probability of
+// the most likely candidate (the model's confidence). Used to draft tokens
+// for SpeculativeVerify.
+func (c *Context) SampleTokenProbs(sampler *SamplerChain, probs []float32) (int32, float32, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return 0, 0, fmt.Errorf("native: context is closed")
+	}
+	if sampler == nil {
+		return 0, 0, fmt.Errorf("native: sampler is nil")
+	}
+	if len(probs) == 0 {
+		return 0, 0, fmt.Errorf("native: probability buffer is empty")
+	}
+	token, topP := cSamplerSampleProbs(sampler.handle, c.handle, -1, probs)
+	if token < 0 {
+		return 0, 0, fmt.Errorf("native: sampling with probabilities failed")
+	}
+	return token, topP, nil
+}
+
+// SpeculativeVerify verifies draft tokens against this (target) context by
+// speculative rejection sampling under sampler; draftProbs holds the draft
+// distribution of each draft token, one vocabulary-sized row per token.
+// It returns the emitted tokens (accepted drafts plus one correction or
+// bonus token) and how many drafts were accepted. The emitted tokens are
+// decoded into the KV cache at the current position and the position
+// counter advanced past them. On error the cache is rolled back.
+func (c *Context) SpeculativeVerify(sampler *SamplerChain, draft []int32, draftProbs []float32) ([]int32, int, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil, 0, fmt.Errorf("native: context is closed")
+	}
+	if sampler == nil {
+		return nil, 0, fmt.Errorf("native: sampler is nil")
+	}
+	if len(draft) == 0 || len(draftProbs) == 0 || len(draftProbs)%len(draft) != 0 {
+		return nil, 0, fmt.Errorf("native: %d draft tokens with %d probabilities", len(draft), len(draftProbs))
+	}
+
+	out := make([]int32, len(draft)+1)
+	n, accepted, rc := cSpeculativeVerify(c.handle, sampler.handle, c.pos, draft, draftProbs, out)
+	if n < 0 {
+		cMemorySeqRm(c.handle, 0, c.pos, -1)
+		switch rc {
+		case 1:
+			return nil, 0, fmt.Errorf("native: KV cache full during speculative verify")
+		case C.OE_SPEC_RC_TRUNCATE:
+			return nil, 0, fmt.Errorf("native: KV cache cannot be truncated past rejected drafts")
+		}
+		return nil, 0, fmt.Errorf("native: speculative verify failed (decode code %d)", rc)
+	}
+	c.pos += n
+	return out[:n], int(accepted), nil
+}
+
+// StepResult is the output of one GenerateStep call.
+type StepResult struct {
+	// Tokens are the generated tokens, all already decoded into the KV cache.
+	Tokens []int32
+
+	// Pieces holds the UTF-8 text of each token in Tokens.
+	Pieces []string
+
+	// EOG reports that an end-of-generation token was sampled. It is not
+	// included in Tokens and was not decoded.
+	EOG bool
+}
+
+// stepPieceBytes is the text buffer reserved per step in GenerateStep.
+const stepPieceBytes = 64
+
+// GenerateStep runs up to maxSteps iterations of sample -> detokenize ->
+// decode entirely in C, in a single CGo call and under one lock, starting
+// from the logits of the previous decode. When stopOnEOG is set the loop
+// ends at an end-of-generation token. The Go side only needs to wake up
+// between steps to check stop strings and stream the pieces.
+//
+// On a decode failure the tokens produced before it are still returned
+// (and the position advanced past them) together with the error.
+func (c *Context) GenerateStep(sampler *SamplerChain, maxSteps int, stopOnEOG bool) (StepResult, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return StepResult{}, fmt.Errorf("native: context is closed")
+	}
+	if sampler == nil {
+		return StepResult{}, fmt.Errorf("native: sampler is nil")
+	}
+	if maxSteps <= 0 {
+		return StepResult{}, nil
+	}
+
+	if cap(c.stepTokens) < maxSteps {
+		c.stepTokens = make([]int32, maxSteps)
+		c.stepLens = make([]int32, maxSteps)
+	}
+	// Room for the C-side piece reserve plus the typical piece per step.
+	if textCap := 256 + maxSteps*stepPieceBytes; cap(c.stepText) < textCap {
+		c.stepText = make([]byte, textCap)
+	}
+	tokens := c.stepTokens[:maxSteps]
+	lens := c.stepLens[:maxSteps]
+	text := c.stepText[:cap(c.stepText)]
+
+	n, status, rc := cGenerateStep(c.handle, sampler.handle, c.pos, int32(maxSteps), stopOnEOG, tokens, lens, text)
+	c.pos += n
+
+	res := StepResult{
+		Tokens: make([]int32, n),
+		Pieces: make([]string, n),
+		EOG:    status == int32(C.OE_GEN_EOG),
+	}
+	copy(res.Tokens, tokens[:n])
+	all := string(text[:sumLens(lens[:n])])
+	off := 0
+	for i := int32(0); i < n; i++ {
+		if lens[i] < 0 {
+			// Did not fit in the step buffer; convert it on its own.
+			res.Pieces[i] = cTokenToPiece(c.modelH, tokens[i])
+			continue
+		}
+		res.Pieces[i] = all[off : off+int(lens[i])]
+		off += int(lens[i])
+	}
+
+	if status == int32(C.OE_GEN_DECODE_FAIL) {
+		if rc == 1 {
+			return res, fmt.Errorf("native: KV cache full, need larger context or shorter prompt")
+		}
+		return res, fmt.Errorf("native: decode failed with code %d", rc)
+	}
+	return res, nil
+}
+
+// sumLens returns the bytes written for lens, skipping the negative entries
+// of pieces that were not written.
+func sumLens(lens []int32) int {
+	total := 0
+	for _, l := range lens {
+		if l > 0 {
+			total += int(l)
+		}
+	}
+	return total
+}
+
+// SeqEntry is one (token, pos, seq_id, want_logits) tuple of a
+// multi-sequence batch.
+type SeqEntry struct {
+	Token      int32
+	Pos        int32
+	SeqID      int32
+	WantLogits bool
+}
+
+// DecodeMulti evaluates a multi-sequence batch in a single llama_decode call
+// and then samples one token for every entry that requested logits, using
+// the sampler at the same index in samplers (entries without logits must
+// have a nil sampler). Decode and sampling happen under one lock so no
+// other decode can overwrite the logits in between.
+//
+// Unlike Eval, DecodeMulti does not touch the sequence-0 position counter;
+// callers track per-sequence positions themselves.
+func (c *Context) DecodeMulti(entries []SeqEntry, samplers []*SamplerChain) ([]int32, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil, fmt.Errorf("native: context is closed")
+	}
+	if len(entries) == 0 {
+		return nil, nil
+	}
+
+	n := len(entries)
+	tokens := make([]int32, n)
+	pos := make([]int32, n)
+	seqIDs := make([]int32, n)
+	wantLogits := make([]bool, n)
+	for i, e := range entries {
+		tokens[i] = e.Token
+		pos[i] = e.Pos
+		seqIDs[i] = e.SeqID
+		wantLogits[i] = e.WantLogits
+	}
+
+	rc := cDecodeMulti(c.handle, tokens, pos, seqIDs, wantLogits)
+	if rc != 0 {
+		if rc == 1 {
+			return nil, fmt.Errorf("native: KV cache full during multi-sequence decode")
+		}
+		return nil, fmt.Errorf("native: multi-sequence decode failed with code %d", rc)
+	}
+
+	// Logits are addressed by batch index, so entry i samples at index i.
+	sampled := make([]int32, n)
+	for i, e := range entries {
+		if e.WantLogits && i < len(samplers) && samplers[i] != nil {
+			sampled[i] = cSamplerSample(samplers[i].handle, c.handle, int32(i))
+		}
+	}
+	return sampled, nil
+}
+
+// PrefillSeq evaluates prompt tokens for seqID starting at posStart, in
+// chunks of at most nBatch tokens, and samples the first generated token
+// from the last chunk's logits. The whole prefill runs under the context
+// lock so interleaved multi-sequence steps cannot clobber the logits.
+func (c *Context) PrefillSeq(seqID int32, tokens []int32, posStart int32, nBatch int, sampler *SamplerChain) (int32, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return 0, fmt.Errorf("native: context is closed")
+	}
+	if len(tokens) == 0 {
+		return 0, fmt.Errorf("native: empty prefill for sequence %d", seqID)
+	}
+	if nBatch <= 0 {
+		nBatch = 512
+	}
+
+	pos := posStart
+	for len(tokens) > 0 {
+		chunk := tokens
+		if len(chunk) > nBatch {
+			chunk = tokens[:nBatch]
+		}
+		tokens = tokens[len(chunk):]
+
+		n := len(chunk)
+		posArr := make([]int32, n)
+		seqIDs := make([]int32, n)
+		wantLogits := make([]bool, n)
+		for i := range chunk {
+			posArr[i] = pos + int32(i)
+			seqIDs[i] = seqID
+		}
+		// Only the very last prompt token needs logits.
+		wantLogits[n-1] = len(tokens) == 0
+
+		rc := cDecodeMulti(c.handle, chunk, posArr, seqIDs, wantLogits)
+		if rc != 0 {
+			if rc == 1 {
+				return 0, fmt.Errorf("native: KV cache full during prefill of sequence %d", seqID)
+			}
+			return 0, fmt.Errorf("native: prefill of sequence %d failed with code %d", seqID, rc)
+		}
+		pos += int32(n)
+	}
+
+	if sampler == nil {
+		return 0, fmt.Errorf("native: sampler is nil")
+	}
+	return cSamplerSample(sampler.handle, c.handle, -1), nil
+}
+
+// ScoreContinuations returns the summed log-probability of each candidate
+// token sequence following prefix. All but the last prefix token must
+// already be in sequence 0; candidates are evaluated in sequences
+// seqBase..seqBase+nSeqs-1, which share that prefix without re-evaluating
+// it and are empty again on return. seqBase 0 scores the candidates one at
+// a time on sequence 0 itself, which is restored to the prefix afterwards;
+// on error its contents are undefined.
+func (c *Context) ScoreContinuations(prefix []int32, cands [][]int32, seqBase, nSeqs int32) ([]float64, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil, fmt.Errorf("native: context is closed")
+	}
+	out := make([]float32, len(cands))
+	switch rc := cScoreContinuations(c.handle, prefix, cands, seqBase, nSeqs, out); rc {
+	case 0:
+	case 1:
+		return nil, fmt.Errorf("native: KV cache full while scoring")
+	case -3:
+		return nil, fmt.Errorf("native: scoring candidate longer than the batch size")
+	default:
+		return nil, fmt.Errorf("native: scoring failed with code %d", rc)
+	}
+	scores := make([]float64, len(out))
+	for i, v := range out {
+		scores[i] = float64(v)
+	}
+	return scores, nil
+}
+
+// SeqRemove removes positions [p0, p1) of seqID from the KV cache.
+// p1 < 0 means "to the end". Does not touch the sequence-0 position counter.
+// Returns false if nothing was removed: recurrent and hybrid memory cannot
+// drop part of a sequence, only all of it.
+func (c *Context) SeqRemove(seqID, p0, p1 int32) bool {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return false
+	}
+	return cMemorySeqRm(c.handle, seqID, p0, p1)
+}
+
 // GetEmbeddings returns the embedding vector for the last evaluated token.
 // Requires that the context was created with Embeddings=true.
 func (c *Context) GetEmbeddings() []float32 {
@@ -177,6 +520,48 @@ func (c *Context) GetEmbeddings() []float32 {
 	return cGetEmbeddings(c.handle, c.modelH, -1)
 }
 
+// EmbedBatch embeds several token sequences in a single encode/decode, one
+// KV sequence each, and returns their L2-normalized embeddings in order.
+// The context must have been created with NSeqMax >= len(seqs) and the
+// total token count must fit in one ubatch. The KV cache is cleared.
+func (c *Context) EmbedBatch(seqs [][]int32) ([][]float32, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil, fmt.Errorf("native: context is closed")
+	}
+	if len(seqs) == 0 {
+		return nil, nil
+	}
+	nEmbd := int(cModelGetInfo(c.modelH).NEmbedding)
+	if nEmbd <= 0 {
+		return nil, fmt.Errorf("native: model has no embedding dimension")
+	}
+
+	offsets := make([]int32, len(seqs)+1)
+	for i, s := range seqs {
+		offsets[i+1] = offsets[i] + int32(len(s))
+	}
+	flat := make([]int32, 0, offsets[len(seqs)])
+	for _, s := range seqs {
+		flat = append(flat, s...)
+	}
+
+	// One backing array for all rows: a single allocation per batch.
+	matrix := make([]float32, len(seqs)*nEmbd)
+	rc := cEmbedBatch(c.handle, flat, offsets, matrix)
+	c.pos = 0
+	if rc != 0 {
+		return nil, fmt.Errorf("native: embed batch failed with code %d", rc)
+	}
+
+	out := make([][]float32, len(seqs))
+	for i := range out {
+		out[i] = matrix[i*nEmbd : (i+1)*nEmbd : (i+1)*nEmbd]
+	}
+	return out, nil
+}
+
 // GetEmbeddingsSeq returns pooled embeddings for sequence 0.
 func (c *Context) GetEmbeddingsSeq() []float32 {
 	c.mu.Lock()
@@ -208,36 +593,83 @@ func (c *Context) ClearKV() {
 // TruncateKV removes tokens from position p0 onwards from the KV cache
 // and resets the position counter to p0. Useful for prompt caching:
 // keep the shared prefix, discard the diverging suffix.
-func (c *Context) TruncateKV(p0 int32) {
+//
+// Returns false, with the cache and position unchanged, when the memory
+// cannot be cut at p0: recurrent and hybrid models keep one state that
+// has already absorbed every evaluated token, so only truncating to the
+// current end or to 0 works. Callers then clear and re-evaluate.
+func (c *Context) TruncateKV(p0 int32) bool {
 	c.mu.Lock()
 	defer c.mu.Unlock()
 	if c.closed {
-		return
+		return false
+	}
+	if !cMemorySeqRm(c.handle, 0, p0, -1) {
+		return false
 	}
-	cMemorySeqRm(c.handle, 0, p0, -1)
 	c.pos = p0
+	return true
 }
 
-// ShiftKV implements context window sliding. It removes the oldest nDiscard
-// tokens from the KV cache and shifts the remaining positions down by
-// nDiscard, keeping them contiguous. The position counter is updated
-// accordingly. This enables infinite-length conversations by recycling
-// context space instead of failing when the window fills up.
+// ShiftKV implements context window sliding. It keeps the first nKeep
+// positions (the system prompt), removes the nDiscard tokens after them
+// from the KV cache and shifts the remaining positions down by nDiscard,
+// keeping them contiguous. The position counter is updated accordingly.
+// This enables infinite-length conversations by recycling context space
+// instead of failing when the window fills up.
 //
-// The caller must ensure nDiscard < c.pos. Typically called when the
-// context reaches ~90% capacity, discarding ~25% of the oldest entries.
-func (c *Context) ShiftKV(nDiscard int32) {
+// The caller must ensure nKeep+nDiscard < c.pos. Returns false, with the
+// cache unchanged, if the range is invalid or the model's memory cannot
+// be shifted.
+func (c *Context) ShiftKV(nKeep, nDiscard int32) bool {
 	c.mu.Lock()
 	defer c.mu.Unlock()
-	if c.closed || nDiscard <= 0 || nDiscard >= c.pos {
-		return
+	if c.closed || nKeep < 0 || nDiscard <= 0 || nKeep+nDiscard >= c.pos {
+		return false
+	}
+	if !cMemorySeqShift(c.handle, 0, nKeep, nDiscard) {
+		return false
 	}
-	// 1. Remove tokens in positions [0, nDiscard) for sequence 0.
-	cMemorySeqRm(c.handle, 0, 0, nDiscard)
-	// 2. Shift remaining positions [nDiscard, inf) down by nDiscard.
-	cMemorySeqAdd(c.handle, 0, nDiscard, -1, -nDiscard)
-	// 3. Update position counter.
 	c.pos -= nDiscard
+	return true
+}
+
+// KVCacheBytes returns the estimated size of the K and V cache buffers at
+// the context's cache types (see oe_kv_cache_bytes).
+func (c *Context) KVCacheBytes() (k, v uint64) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return 0, 0
+	}
+	return cKVCacheBytes(c.handle)
+}
+
+// kvCacheType resolves a KV cache type name to its ggml_type value, or -1
+// for "" (the default, f16).
+func kvCacheType(name string) (int32, error) {
+	name = normalizeKVCacheType(name)
+	if name == "" {
+		return -1, nil
+	}
+	t := cGgmlTypeFromName(name)
+	if t < 0 {
+		return 0, fmt.Errorf("native: unknown KV cache type %q", name)
+	}
+	return t, nil
+}
+
+// normalizeKVCacheType lower-cases a configured KV cache type and expands
+// the short aliases "q8" and "q4" to their ggml names.
+func normalizeKVCacheType(s string) string {
+	s = strings.ToLower(strings.TrimSpace(s))
+	switch s {
+	case "q8":
+		return "q8_0"
+	case "q4":
+		return "q4_0"
+	}
+	return s
 }
 
 // SetThreads updates the thread counts for generation and batch processing.
@@ -328,6 +760,14 @@ func (c *Context) WarmupFull(nTokens int) error {
 	return nil
 }
 
+// perfID identifies the context in perf events (PerfEvent.Ctx).
+func (c *Context) perfID() uint64 {
+	if c == nil {
+		return 0
+	}
+	return uint64(uintptr(c.handle))
+}
+
 // Perf returns performance counters since last reset.
 func (c *Context) Perf() PerfData {
 	c.mu.Lock()
@@ -348,6 +788,20 @@ func (c *Context) PerfReset() {
 	cPerfContextReset(c.handle)
 }
 
+// BenchBatchPrepare measures the mean cost of preparing an nTokens decode
+// batch, once with a fresh llama_batch per call and once through the
+// context's persistent batch. No tokens are decoded, so the KV cache is
+// untouched.
+func (c *Context) BenchBatchPrepare(nTokens, iterations int) (perCallAlloc, perCallArena time.Duration) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed || nTokens <= 0 || iterations <= 0 {
+		return 0, 0
+	}
+	allocNs, arenaNs := cBenchBatchPrepare(c.handle, int32(nTokens), int32(iterations))
+	return time.Duration(allocNs), time.Duration(arenaNs)
+}
+
 // Handle returns the raw C context handle for use by VisionContext and other
 // low-level operations. Returns nil if the context has been closed.
 func (c *Context) Handle() C.oe_context_t {
@@ -375,44 +829,6 @@ func (c *Context) SetPos(pos int32) {
 	c.pos = pos
 }
 
-// EvalLogitsAll processes a batch of tokens like Eval, but computes logits
-// for ALL tokens in the batch (not just the last). This is needed for
-// speculative decoding verification where the target model must check each
-// draft token's logits individually.
-func (c *Context) EvalLogitsAll(tokens []int32) error {
-	c.mu.Lock()
-	defer c.mu.Unlock()
-	if c.closed {
-		return fmt.Errorf("native: context is closed")
-	}
-	if len(tokens) == 0 {
-		return nil
-	}
-
-	rc := cDecodeBatchLogitsAll(c.handle, tokens, c.pos)
-	if rc != 0 {
-		if rc == 1 {
-			return fmt.Errorf("native: KV cache full during speculative verify")
-		}
-		return fmt.Errorf("native: decode logits-all failed with code %d", rc)
-	}
-
-	c.pos += int32(len(tokens))
-	return nil
-}
-
-// GetLogitsAt returns the logits for the token at the given batch output
-// index. The vocabSize must match the model's vocabulary size.
-// The returned slice is context-owned and valid until the next decode call.
-func (c *Context) GetLogitsAt(idx int32, vocabSize int32) []float32 {
-	c.mu.Lock()
-	defer c.mu.Unlock()
-	if c.closed {
-		return nil
-	}
-	return cGetLogits(c.handle, idx, vocabSize)
-}
-
 // Close frees the context. The parent Model must outlive this Context.
 func (c *Context) Close() error {
 	c.mu.Lock()
@@ -87,6 +87,8 @@ func newNativeEmbeddingProvider(cfg config.EmbeddingConfig) (embedding.Provider,
 	if nc.Threads > 0 {
 		ctxOpts.NThreads = int32(nc.Threads)
 	}
+	// Allow EmbedBatch to pack several texts, one sequence each.
+	ctxOpts.NSeqMax = embedBatchMaxSeqs
 
 	llCtx, err := NewContext(model, ctxOpts)
 	if err != nil {
@@ -177,6 +179,93 @@ func (p *EmbeddingProvider) Embed(_ context.Context, text string) ([]float32, er
 	return nil, fmt.Errorf("native embedding: all fallback attempts failed: %w", lastErr)
 }
 
+// embedBatchMaxSeqs is the most texts EmbedBatch packs into one native call
+// (and the number of sequences the embedding context is created with).
+const embedBatchMaxSeqs = 16
+
+// EmbedBatch embeds texts, packing as many as fit into one ubatch per
+// native call (see Context.EmbedBatch) instead of one encode per text.
+// Texts too long to share a batch, and batches that fail, are embedded
+// one at a time through Embed and its fallback logic.
+func (p *EmbeddingProvider) EmbedBatch(ctx context.Context, texts []string) ([][]float32, error) {
+	results := make([][]float32, len(texts))
+	for _, i := range p.embedPacked(texts, results) {
+		if err := ctx.Err(); err != nil {
+			return nil, err
+		}
+		vec, err := p.Embed(ctx, texts[i])
+		if err != nil {
+			return nil, err
+		}
+		results[i] = vec
+	}
+	return results, nil
+}
+
+// embedPacked fills results for every text that could be embedded in a
+// packed batch and returns the indices of the texts it left unset.
+func (p *EmbeddingProvider) embedPacked(texts []string, results [][]float32) []int {
+	p.mu.Lock()
+	defer p.mu.Unlock()
+
+	var rest []int
+	if p.model == nil || p.ctx == nil {
+		for i := range texts {
+			rest = append(rest, i)
+		}
+		return rest
+	}
+
+	budget := p.batchTokenBudget()
+	var group []int
+	var seqs [][]int32
+	nTokens := 0
+
+	flush := func() {
+		if len(group) == 0 {
+			return
+		}
+		vecs, err := p.ctx.EmbedBatch(seqs)
+		if err != nil {
+			log.Printf("native embedding: batch of %d failed, embedding individually: %v", len(group), err)
+			rest = append(rest, group...)
+		} else {
+			for k, i := range group {
+				results[i] = vecs[k]
+			}
+		}
+		group, seqs, nTokens = group[:0], seqs[:0], 0
+	}
+
+	for i, text := range texts {
+		tokens, err := p.model.Tokenize(text, true, true)
+		if err != nil || len(tokens) == 0 || len(tokens) > budget {
+			rest = append(rest, i)
+			continue
+		}
+		if nTokens+len(tokens) > budget || len(group) == embedBatchMaxSeqs {
+			flush()
+		}
+		group = append(group, i)
+		seqs = append(seqs, tokens)
+		nTokens += len(tokens)
+	}
+	flush()
+	return rest
+}
+
+// batchTokenBudget is the most tokens one packed batch may hold: all of
+// them must fit in a single ubatch and in the context window.
+func (p *EmbeddingProvider) batchTokenBudget() int {
+	budget := int(p.nuBatch)
+	for _, n := range []uint32{p.ctxOpts.NBatch, p.ctxOpts.NCtx} {
+		if n > 0 && (budget <= 0 || int(n) < budget) {
+			budget = int(n)
+		}
+	}
+	return budget
+}
+
 // tryEmbed attempts to compute embeddings, returning error if it fails.
 func (p *EmbeddingProvider) tryEmbed(tokens []int32, truncated bool) ([]float32, error) {
 	if p.ctx == nil {
@@ -97,6 +97,7 @@ type ModelInfo struct {
 	Description  string
 	ChatTemplate string
 	HasEncoder   bool
+	Recurrent    bool // recurrent or hybrid memory: sequences cannot be truncated
 }
 
 // cModelGetInfo retrieves model metadata.
@@ -112,6 +113,7 @@ func cModelGetInfo(m C.oe_model_t) ModelInfo {
 		Description:  C.GoString(&ci.desc[0]),
 		ChatTemplate: C.GoString(&ci.chat_template[0]),
 		HasEncoder:   bool(ci.has_encoder),
+		Recurrent:    bool(ci.recurrent),
 	}
 }
 
@@ -122,11 +124,11 @@ func cModelGetInfo(m C.oe_model_t) ModelInfo {
 // cContextNew creates an inference context.
 func cContextNew(m C.oe_model_t, nCtx, nBatch, nUbatch uint32,
 	nThreads, nThreadsBatch int32, embeddings bool, flashAttn int32,
-	typeK, typeV int32) C.oe_context_t {
+	typeK, typeV int32, nSeqMax uint32) C.oe_context_t {
 	return C.oe_context_new(m, C.uint32_t(nCtx), C.uint32_t(nBatch), C.uint32_t(nUbatch),
 		C.int32_t(nThreads), C.int32_t(nThreadsBatch),
 		C.bool(embeddings), C.int32_t(flashAttn),
-		C.int32_t(typeK), C.int32_t(typeV))
+		C.int32_t(typeK), C.int32_t(typeV), C.uint32_t(nSeqMax))
 }
 
 // cContextFree frees an inference context.
@@ -134,6 +136,20 @@ func cContextFree(ctx C.oe_context_t) {
 	C.oe_context_free(ctx)
 }
 
+// cGgmlTypeFromName resolves a ggml type name; -1 if unknown.
+func cGgmlTypeFromName(name string) int32 {
+	cname := C.CString(name)
+	defer C.free(unsafe.Pointer(cname))
+	return int32(C.oe_ggml_type_from_name(cname))
+}
+
+// cKVCacheBytes returns the estimated K and V cache buffer sizes.
+func cKVCacheBytes(ctx C.oe_context_t) (uint64, uint64) {
+	var k, v C.uint64_t
+	C.oe_kv_cache_bytes(ctx, &k, &v)
+	return uint64(k), uint64(v)
+}
+
 // ---------------------------------------------------------------------------
 // Tokenization — low-level C wrappers
 // ---------------------------------------------------------------------------
@@ -157,6 +173,67 @@ func cTokenize(m C.oe_model_t, text string, tokens []int32,
 	return n
 }
 
+// cTokenizeMany tokenizes texts in one C call. Tokens land in tokens
+// (which may be nil for a pure count); offsets must have len(texts)+1
+// entries and receives the per-text token ranges. Returns the total token
+// count, negative if it exceeded len(tokens).
+func cTokenizeMany(m C.oe_model_t, texts []string, tokens, offsets []int32,
+	addSpecial, parseSpecial bool) int32 {
+	if len(texts) == 0 {
+		return 0
+	}
+	size := 0
+	for _, t := range texts {
+		size += len(t)
+	}
+	// Pack the texts back to back. Neither buffer holds Go pointers, so
+	// both can be handed to C directly.
+	packed := make([]byte, 0, size+1)
+	lens := make([]int32, len(texts))
+	for i, t := range texts {
+		packed = append(packed, t...)
+		lens[i] = int32(len(t))
+	}
+	packed = append(packed, 0)
+
+	var tokPtr *C.int32_t
+	if len(tokens) > 0 {
+		tokPtr = (*C.int32_t)(unsafe.Pointer(&tokens[0]))
+	}
+	n := int32(C.oe_tokenize_many(m, (*C.char)(unsafe.Pointer(&packed[0])),
+		(*C.int32_t)(unsafe.Pointer(&lens[0])), C.int32_t(len(texts)),
+		tokPtr, (*C.int32_t)(unsafe.Pointer(&offsets[0])), C.int32_t(len(tokens)),
+		C.bool(addSpecial), C.bool(parseSpecial)))
+	runtime.KeepAlive(packed)
+	runtime.KeepAlive(lens)
+	runtime.KeepAlive(tokens)
+	runtime.KeepAlive(offsets)
+	return n
+}
+
+// cDetokenize converts a token sequence to text in one C call.
+func cDetokenize(m C.oe_model_t, tokens []int32) string {
+	if len(tokens) == 0 {
+		return ""
+	}
+	tokPtr := (*C.int32_t)(unsafe.Pointer(&tokens[0]))
+	// Most pieces are a few bytes; start with a generous guess and retry
+	// once with the exact size if it was too small.
+	buf := make([]byte, len(tokens)*8)
+	n := C.oe_detokenize(m, tokPtr, C.int32_t(len(tokens)),
+		(*C.char)(unsafe.Pointer(&buf[0])), C.int32_t(len(buf)))
+	if n < 0 {
+		buf = make([]byte, -n)
+		n = C.oe_detokenize(m, tokPtr, C.int32_t(len(tokens)),
+			(*C.char)(unsafe.Pointer(&buf[0])), C.int32_t(len(buf)))
+	}
+	runtime.KeepAlive(tokens)
+	if n <= 0 {
+		return ""
+	}
+	return string(buf[:n])
+}
+
 // cTokenToPiece converts a token ID to its text piece.
 func cTokenToPiece(m C.oe_model_t, token int32) string {
 	buf := make([]byte, 128)
@@ -222,6 +299,82 @@ func cDecodeBatch(ctx C.oe_context_t, tokens []int32, posStart int32) int32 {
 	return rc
 }
 
+// cDecodeToken evaluates a single sequence-0 token at pos through the
+// context's persistent batch.
+func cDecodeToken(ctx C.oe_context_t, token, pos int32) int32 {
+	return int32(C.oe_decode_token(ctx, C.int32_t(token), C.int32_t(pos)))
+}
+
+// cGenerateStep runs the fused native sample/detokenize/decode loop.
+// tokens and pieceLens must hold at least maxSteps entries; text receives
+// the concatenated pieces. Returns the number of tokens produced, the
+// oe_gen_status_t and llama_decode's code on failure.
+func cGenerateStep(ctx C.oe_context_t, sampler C.oe_sampler_t, pos, maxSteps int32,
+	stopOnEOG bool, tokens, pieceLens []int32, text []byte) (n, status, decodeRC int32) {
+	if maxSteps <= 0 || len(tokens) < int(maxSteps) || len(pieceLens) < int(maxSteps) || len(text) == 0 {
+		return 0, int32(C.OE_GEN_DECODE_FAIL), -1
+	}
+	var cStatus, cRC C.int32_t
+	cN := C.oe_generate_step(ctx, sampler, C.int32_t(pos), C.int32_t(maxSteps), C.bool(stopOnEOG),
+		(*C.int32_t)(unsafe.Pointer(&tokens[0])),
+		(*C.int32_t)(unsafe.Pointer(&pieceLens[0])),
+		(*C.char)(unsafe.Pointer(&text[0])), C.int32_t(len(text)),
+		&cStatus, &cRC)
+	runtime.KeepAlive(tokens)
+	runtime.KeepAlive(pieceLens)
+	runtime.KeepAlive(text)
+	return int32(cN), int32(cStatus), int32(cRC)
+}
+
+// cDecodeMulti evaluates independent (token, pos, seq_id, want_logits)
+// tuples in a single llama_decode call. All slices must have equal length.
+func cDecodeMulti(ctx C.oe_context_t, tokens, pos, seqIDs []int32, wantLogits []bool) int32 {
+	if len(tokens) == 0 {
+		return 0
+	}
+	rc := int32(C.oe_decode_multi(ctx,
+		(*C.int32_t)(unsafe.Pointer(&tokens[0])),
+		(*C.int32_t)(unsafe.Pointer(&pos[0])),
+		(*C.int32_t)(unsafe.Pointer(&seqIDs[0])),
+		(*C.bool)(unsafe.Pointer(&wantLogits[0])),
+		C.int32_t(len(tokens))))
+	runtime.KeepAlive(tokens)
+	runtime.KeepAlive(pos)
+	runtime.KeepAlive(seqIDs)
+	runtime.KeepAlive(wantLogits)
+	return rc
+}
+
+// cScoreContinuations sums the log-probs of each candidate continuation
+// of prefix; see oe_score_continuations. out must have len(cands) entries.
+func cScoreContinuations(ctx C.oe_context_t, prefix []int32, cands [][]int32, seqBase, nSeqs int32, out []float32) int32 {
+	if len(prefix) == 0 || len(cands) == 0 {
+		return -1
+	}
+	offsets := make([]int32, len(cands)+1)
+	for i, c := range cands {
+		offsets[i+1] = offsets[i] + int32(len(c))
+	}
+	flat := make([]int32, 0, offsets[len(cands)]+1)
+	for _, c := range cands {
+		flat = append(flat, c...)
+	}
+	if len(flat) == 0 {
+		return -1
+	}
+	rc := int32(C.oe_score_continuations(ctx,
+		(*C.int32_t)(unsafe.Pointer(&prefix[0])), C.int32_t(len(prefix)),
+		(*C.int32_t)(unsafe.Pointer(&flat[0])),
+		(*C.int32_t)(unsafe.Pointer(&offsets[0])), C.int32_t(len(cands)),
+		C.int32_t(seqBase), C.int32_t(nSeqs),
+		(*C.float)(unsafe.Pointer(&out[0]))))
+	runtime.KeepAlive(prefix)
+	runtime.KeepAlive(flat)
+	runtime.KeepAlive(offsets)
+	runtime.KeepAlive(out)
+	return rc
+}
+
 // cEncode runs the encoder path (for BERT/encoder-only models).
 // All tokens are marked as outputs for embedding extraction.
 func cEncode(ctx C.oe_context_t, tokens []int32) int32 {
@@ -239,42 +392,67 @@ func cEncode(ctx C.oe_context_t, tokens []int32) int32 {
 // Embeddings — low-level C wrappers
 // ---------------------------------------------------------------------------
 
-// cGetEmbeddings returns the embedding vector for the given output index.
-// The returned slice is a Go-owned copy; the caller may hold it indefinitely.
-func cGetEmbeddings(ctx C.oe_context_t, m C.oe_model_t, idx int32) []float32 {
-	ptr := C.oe_get_embeddings(ctx, C.int32_t(idx))
+// cEmbedBatch embeds len(offsets)-1 token sequences packed in tokensFlat in
+// one native call, writing L2-normalized rows into out (row-major).
+func cEmbedBatch(ctx C.oe_context_t, tokensFlat, offsets []int32, out []float32) int32 {
+	if len(tokensFlat) == 0 || len(offsets) < 2 || len(out) == 0 {
+		return -1
+	}
+	rc := int32(C.oe_embed_batch(ctx,
+		(*C.int32_t)(unsafe.Pointer(&tokensFlat[0])),
+		(*C.int32_t)(unsafe.Pointer(&offsets[0])),
+		C.int32_t(len(offsets)-1),
+		(*C.float)(unsafe.Pointer(&out[0]))))
+	runtime.KeepAlive(tokensFlat)
+	runtime.KeepAlive(offsets)
+	runtime.KeepAlive(out)
+	return rc
+}
+
+// cEmbeddingsView wraps a context-owned embedding row without copying.
+// The view is valid until the next decode/encode call or context free.
+func cEmbeddingsView(ptr *C.float, m C.oe_model_t) []float32 {
 	if ptr == nil {
 		return nil
 	}
-	info := cModelGetInfo(m)
-	nEmbd := info.NEmbedding
+	nEmbd := cModelGetInfo(m).NEmbedding
 	if nEmbd <= 0 {
 		return nil
 	}
+	return unsafe.Slice((*float32)(unsafe.Pointer(ptr)), nEmbd)
+}
+
+// cGetEmbeddingsView returns a view of the embedding at output index idx.
+func cGetEmbeddingsView(ctx C.oe_context_t, m C.oe_model_t, idx int32) []float32 {
+	return cEmbeddingsView(C.oe_get_embeddings(ctx, C.int32_t(idx)), m)
+}
+
+// cGetEmbeddingsSeqView returns a view of the pooled embedding of seqID.
+func cGetEmbeddingsSeqView(ctx C.oe_context_t, m C.oe_model_t, seqID int32) []float32 {
+	return cEmbeddingsView(C.oe_get_embeddings_seq(ctx, C.int32_t(seqID)), m)
+}
+
+// cGetEmbeddings returns the embedding vector for the given output index.
+// The returned slice is a Go-owned copy; the caller may hold it indefinitely.
+func cGetEmbeddings(ctx C.oe_context_t, m C.oe_model_t, idx int32) []float32 {
 	// Copy from C-owned memory into a Go-allocated slice so the caller
 	// is not left holding a dangling pointer after the next Eval/Close.
-	cSlice := unsafe.Slice((*float32)(unsafe.Pointer(ptr)), nEmbd)
-	result := make([]float32, nEmbd)
-	copy(result, cSlice)
-	return result
+	return cloneFloats(cGetEmbeddingsView(ctx, m, idx))
 }
 
 // cGetEmbeddingsSeq returns pooled embeddings for a sequence.
 // The returned slice is a Go-owned copy; the caller may hold it indefinitely.
 func cGetEmbeddingsSeq(ctx C.oe_context_t, m C.oe_model_t, seqID int32) []float32 {
-	ptr := C.oe_get_embeddings_seq(ctx, C.int32_t(seqID))
-	if ptr == nil {
-		return nil
-	}
-	info := cModelGetInfo(m)
-	nEmbd := info.NEmbedding
-	if nEmbd <= 0 {
+	return cloneFloats(cGetEmbeddingsSeqView(ctx, m, seqID))
+}
+
+// cloneFloats copies a context-owned view into Go memory (nil stays nil).
+func cloneFloats(view []float32) []float32 {
+	if view == nil {
 		return nil
 	}
-	// Copy from C-owned memory into a Go-allocated slice.
-	cSlice := unsafe.Slice((*float32)(unsafe.Pointer(ptr)), nEmbd)
-	result := make([]float32, nEmbd)
-	copy(result, cSlice)
+	result := make([]float32, len(view))
+	copy(result, view)
 	return result
 }
 
@@ -306,33 +484,72 @@ func cMemorySeqAdd(ctx C.oe_context_t, seqID, p0, p1, delta int32) {
 		C.int32_t(p0), C.int32_t(p1), C.int32_t(delta))
 }
 
+// cMemorySeqShift removes [nKeep, nKeep+nDiscard) from a sequence and
+// shifts the tail down. Returns false if the memory cannot shift.
+func cMemorySeqShift(ctx C.oe_context_t, seqID, nKeep, nDiscard int32) bool {
+	return bool(C.oe_memory_seq_shift(ctx, C.int32_t(seqID),
+		C.int32_t(nKeep), C.int32_t(nDiscard)))
+}
+
 // ---------------------------------------------------------------------------
-// Speculative decoding — low-level C wrappers
+// State save / restore — low-level C wrappers
 // ---------------------------------------------------------------------------
 
-// cDecodeBatchLogitsAll evaluates tokens with logits computed for ALL tokens.
-// This is used for speculative decoding verification where the target model
-// needs to check each draft token against its own distribution.
-func cDecodeBatchLogitsAll(ctx C.oe_context_t, tokens []int32, posStart int32) int32 {
-	if len(tokens) == 0 {
-		return 0
+// cStateSeqGetData serializes the KV state of seqID. Returns nil on failure.
+func cStateSeqGetData(ctx C.oe_context_t, seqID int32) []byte {
+	size := C.oe_state_seq_get_size(ctx, C.int32_t(seqID))
+	if size == 0 {
+		return nil
 	}
-	rc := int32(C.oe_decode_batch_logits_all(ctx,
-		(*C.int32_t)(unsafe.Pointer(&tokens[0])),
-		C.int32_t(len(tokens)), C.int32_t(posStart)))
+	buf := make([]byte, int(size))
+	n := C.oe_state_seq_get_data(ctx, (*C.uint8_t)(unsafe.Pointer(&buf[0])), size, C.int32_t(seqID))
+	runtime.KeepAlive(buf)
+	if n == 0 {
+		return nil
+	}
+	return buf[:int(n)]
+}
+
+// cStateSeqSetData restores a serialized sequence state into destSeqID.
+func cStateSeqSetData(ctx C.oe_context_t, data []byte, destSeqID int32) bool {
+	if len(data) == 0 {
+		return false
+	}
+	n := C.oe_state_seq_set_data(ctx, (*C.uint8_t)(unsafe.Pointer(&data[0])),
+		C.size_t(len(data)), C.int32_t(destSeqID))
+	runtime.KeepAlive(data)
+	return n != 0
+}
+
+// cStateSaveFile writes the state of seqID and its tokens to path.
+func cStateSaveFile(ctx C.oe_context_t, path string, seqID int32, tokens []int32) bool {
+	cPath := C.CString(path)
+	defer C.free(unsafe.Pointer(cPath))
+	var tokPtr *C.int32_t
+	if len(tokens) > 0 {
+		tokPtr = (*C.int32_t)(unsafe.Pointer(&tokens[0]))
+	}
+	ok := C.oe_state_save_file(ctx, cPath, C.int32_t(seqID), tokPtr, C.int32_t(len(tokens)))
 	runtime.KeepAlive(tokens)
-	return rc
+	return bool(ok)
 }
 
-// cGetLogits returns the logits for the token at output index idx.
-// Returns nil if idx is invalid. The returned pointer is context-owned
-// and valid until the next decode call.
-func cGetLogits(ctx C.oe_context_t, idx int32, vocabSize int32) []float32 {
-	ptr := C.oe_get_logits(ctx, C.int32_t(idx))
-	if ptr == nil {
+// cStateLoadFile loads a state file into destSeqID and returns its tokens,
+// or nil on failure.
+func cStateLoadFile(ctx C.oe_context_t, path string, destSeqID int32, capacity int) []int32 {
+	if capacity <= 0 {
+		return nil
+	}
+	cPath := C.CString(path)
+	defer C.free(unsafe.Pointer(cPath))
+	tokens := make([]int32, capacity)
+	n := C.oe_state_load_file(ctx, cPath, C.int32_t(destSeqID),
+		(*C.int32_t)(unsafe.Pointer(&tokens[0])), C.int32_t(capacity))
+	runtime.KeepAlive(tokens)
+	if n < 0 {
 		return nil
 	}
-	return unsafe.Slice((*float32)(unsafe.Pointer(ptr)), vocabSize)
+	return tokens[:int(n)]
 }
 
 // ---------------------------------------------------------------------------
@@ -373,11 +590,60 @@ func cSamplerChainAddGreedy(chain C.oe_sampler_t) {
 	C.oe_sampler_chain_add_greedy(chain)
 }
 
+// cSamplerChainAddGrammar adds a GBNF grammar sampler; false if the
+// grammar does not parse.
+func cSamplerChainAddGrammar(chain C.oe_sampler_t, model C.oe_model_t, gbnf, root string) bool {
+	cgbnf := C.CString(gbnf)
+	defer C.free(unsafe.Pointer(cgbnf))
+	croot := C.CString(root)
+	defer C.free(unsafe.Pointer(croot))
+	return bool(C.oe_sampler_chain_add_grammar(chain, model, cgbnf, croot))
+}
+
+// cSamplerChainAddAllowedTokens adds a sampler banning all but tokens.
+func cSamplerChainAddAllowedTokens(chain C.oe_sampler_t, model C.oe_model_t, tokens []int32) {
+	if len(tokens) == 0 {
+		return
+	}
+	C.oe_sampler_chain_add_allowed_tokens(chain, model,
+		(*C.int32_t)(unsafe.Pointer(&tokens[0])), C.int32_t(len(tokens)))
+}
+
 // cSamplerSample samples a token from context at the given output index.
 func cSamplerSample(chain C.oe_sampler_t, ctx C.oe_context_t, idx int32) int32 {
 	return int32(C.oe_sampler_sample(chain, ctx, C.int32_t(idx)))
 }
 
+// cSamplerSampleProbs samples at idx and writes the sampling distribution
+// into probs (vocab-sized). Returns the token (-1 on error) and the top
+// candidate's probability.
+func cSamplerSampleProbs(chain C.oe_sampler_t, ctx C.oe_context_t, idx int32, probs []float32) (int32, float32) {
+	var topP C.float
+	rc := int32(C.oe_sampler_sample_probs(chain, ctx, C.int32_t(idx),
+		(*C.float)(unsafe.Pointer(&probs[0])), &topP))
+	runtime.KeepAlive(probs)
+	return rc, float32(topP)
+}
+
+// cSpeculativeVerify runs rejection-sampling verification of draft on the
+// target context (see oe_speculative_verify). out needs len(draft)+1
+// entries. Returns the number of emitted tokens (-1 on error), the number
+// of accepted drafts and llama_decode's code on decode failure.
+func cSpeculativeVerify(ctx C.oe_context_t, chain C.oe_sampler_t, pos int32,
+	draft []int32, draftProbs []float32, out []int32) (n, accepted, decodeRC int32) {
+	var cAccepted, cRC C.int32_t
+	n = int32(C.oe_speculative_verify(ctx, chain, C.int32_t(pos),
+		(*C.int32_t)(unsafe.Pointer(&draft[0])),
+		(*C.float)(unsafe.Pointer(&draftProbs[0])),
+		C.int32_t(len(draft)),
+		(*C.int32_t)(unsafe.Pointer(&out[0])),
+		&cAccepted, &cRC))
+	runtime.KeepAlive(draft)
+	runtime.KeepAlive(draftProbs)
+	runtime.KeepAlive(out)
+	return n, int32(cAccepted), int32(cRC)
+}
+
 // cSamplerReset resets sampler chain state.
 func cSamplerReset(chain C.oe_sampler_t) {
 	C.oe_sampler_reset(chain)
@@ -438,6 +704,77 @@ func cPerfContextReset(ctx C.oe_context_t) {
 	C.oe_perf_context_reset(ctx)
 }
 
+// cBenchBatchPrepare measures the per-call cost of building an nTokens
+// decode batch with and without the persistent arena, in nanoseconds.
+func cBenchBatchPrepare(ctx C.oe_context_t, nTokens, nIters int32) (allocNs, arenaNs float64) {
+	var a, b C.double
+	C.oe_bench_batch_prepare(ctx, C.int32_t(nTokens), C.int32_t(nIters), &a, &b)
+	return float64(a), float64(b)
+}
+
+// PerfEventKind identifies the phase a perf event timed (oe_perf_kind_t).
+type PerfEventKind int32
+
+const (
+	PerfTokenize   PerfEventKind = C.OE_PERF_TOKENIZE
+	PerfDecode     PerfEventKind = C.OE_PERF_DECODE
+	PerfSample     PerfEventKind = C.OE_PERF_SAMPLE
+	PerfDetokenize PerfEventKind = C.OE_PERF_DETOKENIZE
+	PerfKVShift    PerfEventKind = C.OE_PERF_KV_SHIFT
+)
+
+// PerfEvent is one phase timing from the native perf ring.
+type PerfEvent struct {
+	Kind    PerfEventKind
+	N       int32  // tokens processed (draws for PerfSample)
+	Ubatch  int32  // PerfDecode: micro-batches the decode was split into
+	Ctx     uint64 // context the event ran on (Context.perfID), 0 for model-level calls
+	StartNs int64  // cPerfNow clock
+	DurNs   int64
+}
+
+// cPerfNow returns the perf event clock in nanoseconds.
+func cPerfNow() int64 {
+	return int64(C.oe_perf_now_ns())
+}
+
+// cPerfDrain appends every event after *cursor to out, advancing the
+// cursor, and returns the events plus how many were overwritten unread.
+func cPerfDrain(cursor *uint64, out []PerfEvent) ([]PerfEvent, uint64) {
+	var buf [256]C.oe_perf_event_t
+	var dropped C.uint64_t
+	cur := C.uint64_t(*cursor)
+	for {
+		n := int(C.oe_perf_drain(&cur, &buf[0], C.int32_t(len(buf)), &dropped))
+		for _, ev := range buf[:n] {
+			out = append(out, PerfEvent{
+				Kind:    PerfEventKind(ev.kind),
+				N:       int32(ev.n),
+				Ubatch:  int32(ev.n_ubatch),
+				Ctx:     uint64(ev.ctx),
+				StartNs: int64(ev.t_start_ns),
+				DurNs:   int64(ev.t_dur_ns),
+			})
+		}
+		if n < len(buf) {
+			break
+		}
+	}
+	*cursor = uint64(cur)
+	return out, uint64(dropped)
+}
+
+// cPerfCursor returns a ring cursor positioned after every event recorded
+// so far.
+func cPerfCursor() uint64 {
+	return uint64(C.oe_perf_cursor())
+}
+
+// cPerfCalls returns the number of calls into the C binding so far.
+func cPerfCalls() uint64 {
+	return uint64(C.oe_perf_calls())
+}
+
 // SystemInfo returns a string describing CPU features and build info.
 func SystemInfo() string {
 	return C.GoString(C.oe_system_info())
@@ -464,39 +801,108 @@ func cVisionSupported(vctx C.oe_vision_t) bool {
 	return bool(C.oe_vision_supported(vctx))
 }
 
-// cVisionEval tokenizes a prompt with image markers and evaluates all chunks.
-// Returns 0 on success, negative on error. Writes the new KV position to newNPast.
-func cVisionEval(vctx C.oe_vision_t, lctx C.oe_context_t,
-	prompt string, imagePaths []string, nPast, nBatch int32) (newNPast int32, rc int32) {
+// cVisionLoadImage loads an image file into a bitmap. Returns nil on failure.
+func cVisionLoadImage(vctx C.oe_vision_t, path string) C.oe_bitmap_t {
+	cpath := C.CString(path)
+	defer C.free(unsafe.Pointer(cpath))
+	return C.oe_vision_load_image(vctx, cpath)
+}
+
+// cVisionBitmapFromRGB copies packed RGB pixels into a bitmap. Returns nil
+// on failure.
+func cVisionBitmapFromRGB(vctx C.oe_vision_t, width, height int, rgb []byte) C.oe_bitmap_t {
+	if len(rgb) == 0 || len(rgb) != width*height*3 {
+		return nil
+	}
+	bmp := C.oe_vision_bitmap_from_rgb(vctx, C.uint32_t(width), C.uint32_t(height),
+		(*C.uchar)(unsafe.Pointer(&rgb[0])))
+	runtime.KeepAlive(rgb)
+	return bmp
+}
+
+// cVisionBitmapFree frees a bitmap.
+func cVisionBitmapFree(bmp C.oe_bitmap_t) {
+	C.oe_vision_bitmap_free(bmp)
+}
 
+// cVisionTokenize splits a prompt with image markers into chunks, one
+// bitmap per marker. Returns nil and a negative rc on failure.
+func cVisionTokenize(vctx C.oe_vision_t, prompt string, bitmaps []C.oe_bitmap_t) (C.oe_chunks_t, int32) {
 	cprompt := C.CString(prompt)
 	defer C.free(unsafe.Pointer(cprompt))
 
-	var cPaths **C.char
-	nImages := len(imagePaths)
-	if nImages > 0 {
-		// Allocate array of C strings for image paths.
-		pathPtrs := make([]*C.char, nImages)
-		for i, p := range imagePaths {
-			pathPtrs[i] = C.CString(p)
-		}
-		defer func() {
-			for _, cp := range pathPtrs {
-				C.free(unsafe.Pointer(cp))
-			}
-		}()
-		// cPaths points into pathPtrs which holds Go-allocated *C.char pointers.
-		// The elements themselves are C-allocated strings (safe to pass to C),
-		// but we must keep pathPtrs alive until C returns.
-		cPaths = (**C.char)(unsafe.Pointer(&pathPtrs[0]))
+	// bitmaps holds C pointers only, so it may be passed to C directly.
+	var cBitmaps *C.oe_bitmap_t
+	if len(bitmaps) > 0 {
+		cBitmaps = &bitmaps[0]
 	}
+	var rc C.int32_t
+	chunks := C.oe_vision_tokenize(vctx, cprompt, cBitmaps, C.int(len(bitmaps)), &rc)
+	runtime.KeepAlive(bitmaps)
+	return chunks, int32(rc)
+}
 
-	var outNPast C.int32_t
-	ret := C.oe_vision_eval(vctx, lctx, cprompt, cPaths,
-		C.int(nImages), C.int32_t(nPast), C.int32_t(nBatch), &outNPast)
-	runtime.KeepAlive(imagePaths) // keep Go strings alive while C holds derived pointers
-	runtime.KeepAlive(cPaths)     // keep pathPtrs array alive through the C call
+// cVisionChunksFree frees a chunk list.
+func cVisionChunksFree(chunks C.oe_chunks_t) {
+	C.oe_vision_chunks_free(chunks)
+}
+
+// cVisionChunksCount returns the number of chunks in the list.
+func cVisionChunksCount(chunks C.oe_chunks_t) int {
+	return int(C.oe_vision_chunks_count(chunks))
+}
+
+// cVisionChunk returns the type, token count and content id of chunk i.
+func cVisionChunk(chunks C.oe_chunks_t, i int) (typ int32, nTokens int, id string) {
+	typ = int32(C.oe_vision_chunk_type(chunks, C.int32_t(i)))
+	nTokens = int(C.oe_vision_chunk_n_tokens(chunks, C.int32_t(i)))
+	id = C.GoString(C.oe_vision_chunk_id(chunks, C.int32_t(i)))
+	return typ, nTokens, id
+}
 
+// cVisionChunkTextTokens returns the tokens of text chunk i.
+func cVisionChunkTextTokens(chunks C.oe_chunks_t, i int) []int32 {
+	n := int(C.oe_vision_chunk_text_tokens(chunks, C.int32_t(i), nil, 0))
+	if n <= 0 {
+		return nil
+	}
+	tokens := make([]int32, n)
+	C.oe_vision_chunk_text_tokens(chunks, C.int32_t(i), (*C.int32_t)(unsafe.Pointer(&tokens[0])), C.int32_t(n))
+	runtime.KeepAlive(tokens)
+	return tokens
+}
+
+// cVisionChunkNFloats returns the number of floats in the embeddings of
+// image chunk i.
+func cVisionChunkNFloats(vctx C.oe_vision_t, chunks C.oe_chunks_t, i int) int {
+	return int(C.oe_vision_chunk_n_floats(vctx, chunks, C.int32_t(i)))
+}
+
+// cVisionEncodeChunk runs the vision encoder on image chunk i and copies
+// its embeddings into out.
+func cVisionEncodeChunk(vctx C.oe_vision_t, chunks C.oe_chunks_t, i int, out []float32) int32 {
+	if len(out) == 0 {
+		return -1
+	}
+	rc := C.oe_vision_encode_chunk(vctx, chunks, C.int32_t(i),
+		(*C.float)(unsafe.Pointer(&out[0])), C.int64_t(len(out)))
+	runtime.KeepAlive(out)
+	return int32(rc)
+}
+
+// cVisionEvalChunk evaluates chunk i into the llama context; embd holds the
+// embeddings of an image chunk and is ignored for text chunks.
+func cVisionEvalChunk(vctx C.oe_vision_t, lctx C.oe_context_t, chunks C.oe_chunks_t,
+	i int, embd []float32, nPast, nBatch int32, logitsLast bool) (newNPast int32, rc int32) {
+
+	var cEmbd *C.float
+	if len(embd) > 0 {
+		cEmbd = (*C.float)(unsafe.Pointer(&embd[0]))
+	}
+	var outNPast C.int32_t
+	ret := C.oe_vision_eval_chunk(vctx, lctx, chunks, C.int32_t(i), cEmbd,
+		C.int32_t(nPast), C.int32_t(nBatch), C.bool(logitsLast), &outNPast)
+	runtime.KeepAlive(embd)
 	return int32(outNPast), int32(ret)
 }
 
@@ -12,12 +12,17 @@ import (
 )
 
 // Model wraps a loaded GGUF model. It is safe for concurrent use (the
-// underlying llama_model is thread-safe for read operations).
+// underlying llama_model is thread-safe for read operations). Models
+// loaded from the same file with the same options share one llama_model
+// (see modelRegistry); each is closed independently.
 type Model struct {
 	handle C.oe_model_t
 	info   ModelInfo
 	mu     sync.RWMutex
 	closed bool
+
+	key    modelKey
+	shared *sharedModel
 }
 
 // ModelOptions configures model loading behavior.
@@ -42,18 +47,20 @@ func DefaultModelOptions() ModelOptions {
 	}
 }
 
-// LoadModel loads a GGUF model from the given path.
+// LoadModel loads a GGUF model from the given path, or shares the
+// weights already loaded from it with the same options.
 func LoadModel(path string, opts ModelOptions) (*Model, error) {
-	handle := cModelLoad(path, opts.NGPULayers, opts.UseMmap, opts.UseMlock)
-	if handle == nil {
-		return nil, fmt.Errorf("native: failed to load model from %q", path)
+	key := newModelKey(path, opts)
+	sm, err := acquireModel(key)
+	if err != nil {
+		return nil, err
 	}
 
-	info := cModelGetInfo(handle)
-
 	return &Model{
-		handle: handle,
-		info:   info,
+		handle: sm.handle,
+		info:   sm.info,
+		key:    key,
+		shared: sm,
 	}, nil
 }
 
@@ -93,25 +100,92 @@ func (m *Model) Tokenize(text string, addSpecial, parseSpecial bool) ([]int32, e
 		return nil, fmt.Errorf("native: model is closed")
 	}
 
-	// First pass: determine required size.
-	n := cTokenize(m.handle, text, nil, addSpecial, parseSpecial)
+	// A token covers at least one byte, so len(text) plus room for BOS/EOS
+	// almost always fits in one pass. If not, n is the negated required
+	// size and a second pass uses exactly that.
+	tokens := make([]int32, len(text)+2)
+	n := cTokenize(m.handle, text, tokens, addSpecial, parseSpecial)
+	if n < 0 {
+		tokens = make([]int32, -n)
+		n = cTokenize(m.handle, text, tokens, addSpecial, parseSpecial)
+		if n < 0 {
+			return nil, fmt.Errorf("native: tokenization failed, need %d tokens", -n)
+		}
+	}
 	if n == 0 {
 		return nil, nil
 	}
 
-	// If n is negative, its absolute value is the required buffer size.
-	size := n
-	if size < 0 {
-		size = -size
+	return tokens[:n], nil
+}
+
+// TokenizeBatch tokenizes many texts in a single C call. The returned
+// slices share one backing array.
+func (m *Model) TokenizeBatch(texts []string, addSpecial, parseSpecial bool) ([][]int32, error) {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.closed {
+		return nil, fmt.Errorf("native: model is closed")
+	}
+	if len(texts) == 0 {
+		return nil, nil
 	}
 
+	size := len(texts) * 2
+	for _, t := range texts {
+		size += len(t)
+	}
 	tokens := make([]int32, size)
-	n = cTokenize(m.handle, text, tokens, addSpecial, parseSpecial)
+	offsets := make([]int32, len(texts)+1)
+	n := cTokenizeMany(m.handle, texts, tokens, offsets, addSpecial, parseSpecial)
 	if n < 0 {
-		return nil, fmt.Errorf("native: tokenization failed, need %d tokens", -n)
+		tokens = make([]int32, -n)
+		n = cTokenizeMany(m.handle, texts, tokens, offsets, addSpecial, parseSpecial)
+		if n < 0 {
+			return nil, fmt.Errorf("native: batch tokenization failed, need %d tokens", -n)
+		}
 	}
 
-	return tokens[:n], nil
+	out := make([][]int32, len(texts))
+	for i := range texts {
+		out[i] = tokens[offsets[i]:offsets[i+1]:offsets[i+1]]
+	}
+	return out, nil
+}
+
+// CountTokens returns the exact token count of each text, without special
+// tokens, using one C call and no token buffer.
+func (m *Model) CountTokens(texts []string) ([]int, error) {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.closed {
+		return nil, fmt.Errorf("native: model is closed")
+	}
+	if len(texts) == 0 {
+		return nil, nil
+	}
+
+	offsets := make([]int32, len(texts)+1)
+	cTokenizeMany(m.handle, texts, nil, offsets, false, false)
+
+	counts := make([]int, len(texts))
+	for i := range counts {
+		counts[i] = int(offsets[i+1] - offsets[i])
+	}
+	return counts, nil
+}
+
+// Detokenize converts a token sequence back to text in one C call. Unlike
+// concatenating TokenToPiece results it applies the vocabulary's
+// detokenization rules (e.g. leading-space handling) once for the whole
+// sequence.
+func (m *Model) Detokenize(tokens []int32) string {
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.closed {
+		return ""
+	}
+	return cDetokenize(m.handle, tokens)
 }
 
 // TokenToPiece converts a token ID to its string representation.
@@ -164,7 +238,8 @@ func (m *Model) VocabSize() int32 {
 	return cVocabNTokens(m.handle)
 }
 
-// Close frees the model and all associated resources.
+// Close releases the model. The weights are freed once no other Model
+// shares them.
 func (m *Model) Close() error {
 	m.mu.Lock()
 	defer m.mu.Unlock()
@@ -172,7 +247,8 @@ func (m *Model) Close() error {
 		return nil
 	}
 	m.closed = true
-	cModelFree(m.handle)
+	releaseModel(m.key, m.shared)
 	m.handle = nil
+	m.shared = nil
 	return nil
 }
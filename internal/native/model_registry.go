@@ -0,0 +1,102 @@
+//go:build native
+
+package native
+
+/*
+#include "binding.h"
+*/
+import "C"
+import (
+	"fmt"
+	"log"
+	"path/filepath"
+	"sync"
+)
+
+// modelRegistry shares loaded GGUF weights across the process. The chat
+// adapter, a summarizer or memory engine with its own runtime manager, and
+// the embedding provider all load their model through LoadModel; when they
+// name the same file with the same load options they get one llama_model
+// and each create their own context on it, instead of mapping and warming
+// the weights again. The weights are freed when the last holder closes
+// its Model.
+var modelRegistry = struct {
+	mu      sync.Mutex
+	entries map[modelKey]*sharedModel
+}{entries: make(map[modelKey]*sharedModel)}
+
+// modelKey identifies a loaded model: its absolute path and the options
+// that change what is loaded.
+type modelKey struct {
+	path string
+	opts ModelOptions
+}
+
+// newModelKey returns the registry key for path loaded with opts.
+func newModelKey(path string, opts ModelOptions) modelKey {
+	if abs, err := filepath.Abs(path); err == nil {
+		path = abs
+	}
+	return modelKey{path: filepath.Clean(path), opts: opts}
+}
+
+// sharedModel is one loaded model and the number of Models holding it.
+// ready is closed once loading has finished; handle is nil if it failed.
+type sharedModel struct {
+	handle C.oe_model_t
+	info   ModelInfo
+	refs   int
+	ready  chan struct{}
+}
+
+// acquireModel returns the loaded model for key, loading it on first use.
+// Concurrent first uses of the same key wait for a single load; loads of
+// different models run in parallel.
+func acquireModel(key modelKey) (*sharedModel, error) {
+	reg := &modelRegistry
+	reg.mu.Lock()
+	if sm := reg.entries[key]; sm != nil {
+		sm.refs++
+		users := sm.refs
+		reg.mu.Unlock()
+		<-sm.ready
+		if sm.handle == nil {
+			return nil, fmt.Errorf("native: failed to load model from %q", key.path)
+		}
+		log.Printf("native: sharing loaded model %s (%d users)", filepath.Base(key.path), users)
+		return sm, nil
+	}
+	sm := &sharedModel{refs: 1, ready: make(chan struct{})}
+	reg.entries[key] = sm
+	reg.mu.Unlock()
+
+	sm.handle = cModelLoad(key.path, key.opts.NGPULayers, key.opts.UseMmap, key.opts.UseMlock)
+	if sm.handle == nil {
+		// Forget the failed load so a later call tries again.
+		reg.mu.Lock()
+		delete(reg.entries, key)
+		reg.mu.Unlock()
+		close(sm.ready)
+		return nil, fmt.Errorf("native: failed to load model from %q", key.path)
+	}
+	sm.info = cModelGetInfo(sm.handle)
+	close(sm.ready)
+	return sm, nil
+}
+
+// releaseModel drops one reference to sm, loaded for key, and frees the
+// model with the last one.
+func releaseModel(key modelKey, sm *sharedModel) {
+	reg := &modelRegistry
+	reg.mu.Lock()
+	sm.refs--
+	if sm.refs > 0 {
+		reg.mu.Unlock()
+		return
+	}
+	if reg.entries[key] == sm {
+		delete(reg.entries, key)
+	}
+	reg.mu.Unlock()
+	cModelFree(sm.handle)
+}
@@ -0,0 +1,113 @@
+//go:build native
+
+package native
+
+import (
+	"math"
+	"sync"
+	"time"
+
+	"OpenEye/internal/runtime"
+)
+
+// perfEvents recycles the buffers requests read their events into.
+var perfEvents = sync.Pool{New: func() any { return new([]PerfEvent) }}
+
+// perfSpan marks the start of a request for phase accounting. The C event
+// ring is process-wide (every context and model records into it); each
+// span reads it from its own cursor, so requests on different adapters
+// never consume each other's events.
+type perfSpan struct {
+	cursor  uint64
+	startNs int64
+	calls   uint64
+	ctxs    [2]uint64 // target and draft contexts
+
+	// Vision stages, timed on the Go side (see VisionPrompt).
+	imagePreprocess time.Duration
+	imageEncode     time.Duration
+	imagesCached    int
+}
+
+// beginPerf starts phase accounting for a serial request.
+func (a *Adapter) beginPerf() perfSpan {
+	return perfSpan{
+		cursor:  cPerfCursor(),
+		startNs: cPerfNow(),
+		calls:   cPerfCalls(),
+		ctxs:    [2]uint64{a.ctx.perfID(), a.draftCtx.perfID()},
+	}
+}
+
+// endPerf returns the phase breakdown of the request started by span.
+// Calls into the binding are counted process-wide, so concurrent work on
+// other adapters (e.g. embeddings) is included in CgoCalls, and so is
+// their tokenization, which is not tied to a context.
+func (a *Adapter) endPerf(span perfSpan) runtime.PhaseTimings {
+	buf := perfEvents.Get().(*[]PerfEvent)
+	events, dropped := cPerfDrain(&span.cursor, (*buf)[:0])
+	pt := phaseTimings(events, span.ctxs[:], span.startNs)
+	*buf = events
+	perfEvents.Put(buf)
+	pt.CgoCalls = int(cPerfCalls() - span.calls)
+	pt.EventsDropped = int(dropped)
+	pt.ImagePreprocess = span.imagePreprocess
+	pt.ImageEncode = span.imageEncode
+	pt.ImagesCached = span.imagesCached
+	return pt
+}
+
+// phaseTimings sums the events that belong to a request: those that
+// started at or after startNs and either ran on one of ctxs or on no
+// context at all (tokenization). Decodes before the request's first sample
+// are prompt prefill; the rest are generation.
+func phaseTimings(events []PerfEvent, ctxs []uint64, startNs int64) runtime.PhaseTimings {
+	own := func(ev PerfEvent) bool {
+		if ev.StartNs < startNs {
+			return false
+		}
+		if ev.Ctx == 0 {
+			return true
+		}
+		for _, c := range ctxs {
+			if c != 0 && ev.Ctx == c {
+				return true
+			}
+		}
+		return false
+	}
+
+	firstSample := int64(math.MaxInt64)
+	for _, ev := range events {
+		if ev.Kind == PerfSample && ev.StartNs < firstSample && own(ev) {
+			firstSample = ev.StartNs
+		}
+	}
+
+	var pt runtime.PhaseTimings
+	for _, ev := range events {
+		if !own(ev) {
+			continue
+		}
+		d := time.Duration(ev.DurNs)
+		switch ev.Kind {
+		case PerfTokenize:
+			pt.Tokenize += d
+		case PerfDecode:
+			pt.DecodeCalls++
+			pt.Ubatches += int(ev.Ubatch)
+			if ev.StartNs < firstSample {
+				pt.Prefill += d
+			} else {
+				pt.Decode += d
+			}
+		case PerfSample:
+			pt.Sample += d
+		case PerfDetokenize:
+			pt.Detokenize += d
+		case PerfKVShift:
+			pt.KVShifts++
+		}
+	}
+	return pt
+}
@@ -0,0 +1,168 @@
+//go:build native
+
+package native
+
+import (
+	"container/list"
+	"sync"
+)
+
+// prefixCache maps token prefixes to serialized KV states of sequence 0
+// (see Context.StateSeqData). It is a radix tree over token sequences, so
+// a lookup finds the longest cached prefix of a prompt in O(len(prompt)),
+// whichever earlier request it came from. Entries are evicted in LRU order
+// once their total size exceeds the byte budget.
+//
+// This lets requests that alternate between a few distinct prompt
+// prefixes (personas, users, tools) resume from their own KV state instead
+// of re-evaluating whenever the single live cache belongs to someone else.
+type prefixCache struct {
+	mu     sync.Mutex
+	root   *prefixNode
+	budget int64
+	used   int64
+	lru    *list.List // of *prefixEntry, most recent at the front
+}
+
+// prefixNode is a radix tree node. edge is the token run leading from the
+// parent to this node; children are keyed by the first token of their edge.
+type prefixNode struct {
+	edge     []int32
+	parent   *prefixNode
+	children map[int32]*prefixNode
+	entry    *prefixEntry
+}
+
+// prefixEntry is one cached KV state covering tokens.
+type prefixEntry struct {
+	tokens []int32
+	state  []byte
+	node   *prefixNode
+	elem   *list.Element
+}
+
+// newPrefixCache creates a cache holding at most budget bytes of state.
+func newPrefixCache(budget int64) *prefixCache {
+	return &prefixCache{
+		root:   &prefixNode{children: make(map[int32]*prefixNode)},
+		budget: budget,
+		lru:    list.New(),
+	}
+}
+
+// lookup returns the cached entry with the longest token sequence that is
+// a prefix of tokens[:maxLen], or nil. The entry is marked recently used.
+func (c *prefixCache) lookup(tokens []int32, maxLen int) *prefixEntry {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	if maxLen > len(tokens) {
+		maxLen = len(tokens)
+	}
+	tokens = tokens[:maxLen]
+
+	var best *prefixEntry
+	node := c.root
+	for len(tokens) > 0 {
+		child := node.children[tokens[0]]
+		if child == nil || commonPrefixLen(child.edge, tokens) < len(child.edge) {
+			break
+		}
+		tokens = tokens[len(child.edge):]
+		node = child
+		if node.entry != nil {
+			best = node.entry
+		}
+	}
+	if best != nil {
+		c.lru.MoveToFront(best.elem)
+	}
+	return best
+}
+
+// insert caches state for tokens, replacing any existing entry for the
+// same sequence, then evicts least recently used entries until the cache
+// fits its budget. States larger than the whole budget are not cached.
+func (c *prefixCache) insert(tokens []int32, state []byte) {
+	if len(tokens) == 0 || int64(len(state)) > c.budget {
+		return
+	}
+	c.mu.Lock()
+	defer c.mu.Unlock()
+
+	node := c.root
+	rest := tokens
+	for len(rest) > 0 {
+		child := node.children[rest[0]]
+		if child == nil {
+			leaf := &prefixNode{
+				edge:     append([]int32(nil), rest...),
+				parent:   node,
+				children: make(map[int32]*prefixNode),
+			}
+			node.children[rest[0]] = leaf
+			node = leaf
+			break
+		}
+		n := commonPrefixLen(child.edge, rest)
+		if n < len(child.edge) {
+			// Split the edge: node -> mid (edge[:n]) -> child (edge[n:]).
+			mid := &prefixNode{
+				edge:     child.edge[:n:n],
+				parent:   node,
+				children: make(map[int32]*prefixNode),
+			}
+			child.edge = child.edge[n:]
+			child.parent = mid
+			mid.children[child.edge[0]] = child
+			node.children[mid.edge[0]] = mid
+			child = mid
+		}
+		node = child
+		rest = rest[n:]
+	}
+
+	if old := node.entry; old != nil {
+		// Replace in place; the node stays in the tree.
+		c.lru.Remove(old.elem)
+		c.used -= int64(len(old.state))
+	}
+	e := &prefixEntry{
+		tokens: append([]int32(nil), tokens...),
+		state:  state,
+		node:   node,
+	}
+	e.elem = c.lru.PushFront(e)
+	node.entry = e
+	c.used += int64(len(state))
+
+	for c.used > c.budget {
+		oldest := c.lru.Back()
+		if oldest == nil {
+			break
+		}
+		c.removeEntry(oldest.Value.(*prefixEntry))
+	}
+}
+
+// removeEntry drops e and prunes tree nodes that no longer lead anywhere.
+// Caller holds c.mu.
+func (c *prefixCache) removeEntry(e *prefixEntry) {
+	c.lru.Remove(e.elem)
+	c.used -= int64(len(e.state))
+
+	node := e.node
+	node.entry = nil
+	for node != c.root && node.entry == nil && len(node.children) == 0 {
+		parent := node.parent
+		delete(parent.children, node.edge[0])
+		node = parent
+	}
+}
+
+// len returns the number of cached entries.
+func (c *prefixCache) len() int {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	return c.lru.Len()
+}
@@ -7,6 +7,8 @@ package native
 */
 import "C"
 
+import "fmt"
+
 // SamplerChain wraps a llama.cpp sampler chain that applies a sequence of
 // sampling operations (temperature, top-k, top-p, penalties, etc.) to logits
 // before selecting a token.
@@ -45,6 +47,11 @@ type SamplerOptions struct {
 
 	// Seed for random sampling. 0xFFFFFFFF = random seed.
 	Seed uint32
+
+	// Grammar constrains output to a GBNF grammar (start rule "root").
+	// Empty = unconstrained. Grammar chains need the model's vocabulary,
+	// so they are built with Model.NewSamplerChain.
+	Grammar string
 }
 
 // DefaultSamplerOptions returns balanced defaults suitable for chat.
@@ -76,7 +83,53 @@ func DefaultSamplerOptions() SamplerOptions {
 // per-token sampler overhead for deterministic generation.
 func NewSamplerChain(opts SamplerOptions) *SamplerChain {
 	chain := cSamplerChainNew()
+	addSamplers(chain, opts)
+	return &SamplerChain{handle: chain}
+}
 
+// NewSamplerChain creates a sampler chain like the package-level
+// NewSamplerChain, preceded by a grammar sampler when opts.Grammar is set.
+// The grammar masks illegal tokens before penalties and filters run, so
+// the remaining stages only redistribute probability among legal tokens.
+func (m *Model) NewSamplerChain(opts SamplerOptions) (*SamplerChain, error) {
+	if opts.Grammar == "" {
+		return NewSamplerChain(opts), nil
+	}
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.closed {
+		return nil, fmt.Errorf("native: model is closed")
+	}
+	chain := cSamplerChainNew()
+	if !cSamplerChainAddGrammar(chain, m.handle, opts.Grammar, "root") {
+		cSamplerFree(chain)
+		return nil, fmt.Errorf("native: invalid grammar")
+	}
+	addSamplers(chain, opts)
+	return &SamplerChain{handle: chain}, nil
+}
+
+// NewRestrictedSamplerChain creates a greedy chain that can only produce
+// one of allowed: every other token is banned before the argmax. One draw
+// from it classifies the context among labels that differ in their first
+// token.
+func (m *Model) NewRestrictedSamplerChain(allowed []int32) (*SamplerChain, error) {
+	if len(allowed) == 0 {
+		return nil, fmt.Errorf("native: no allowed tokens")
+	}
+	m.mu.RLock()
+	defer m.mu.RUnlock()
+	if m.closed {
+		return nil, fmt.Errorf("native: model is closed")
+	}
+	chain := cSamplerChainNew()
+	cSamplerChainAddAllowedTokens(chain, m.handle, allowed)
+	cSamplerChainAddGreedy(chain)
+	return &SamplerChain{handle: chain}, nil
+}
+
+// addSamplers appends the canonical sampling stages for opts to chain.
+func addSamplers(chain C.oe_sampler_t, opts SamplerOptions) {
 	// 1. Repetition/frequency/presence penalties (before any filtering).
 	if opts.RepeatLastN > 0 && (opts.RepeatPenalty != 1.0 ||
 		opts.FrequencyPenalty != 0.0 || opts.PresencePenalty != 0.0) {
@@ -89,7 +142,7 @@ func NewSamplerChain(opts SamplerOptions) *SamplerChain {
 	// deterministic at these temperatures, so the filtering overhead is wasted.
 	if opts.Temperature <= 0.3 {
 		cSamplerChainAddGreedy(chain)
-		return &SamplerChain{handle: chain}
+		return
 	}
 
 	// 2. Top-K filtering.
@@ -118,8 +171,6 @@ func NewSamplerChain(opts SamplerOptions) *SamplerChain {
 	} else {
 		cSamplerChainAddDist(chain, opts.Seed)
 	}
-
-	return &SamplerChain{handle: chain}
 }
 
 // Reset clears the sampler's internal state (e.g., penalty token history).
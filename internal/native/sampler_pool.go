@@ -0,0 +1,82 @@
+//go:build native
+
+package native
+
+import "sync"
+
+// samplerPool keeps idle sampler chains keyed by their SamplerOptions, so
+// requests that alternate between parameter sets (temperature 0 memory
+// extraction, 0.7 chat) reuse a chain instead of rebuilding one through
+// several CGo allocations each time.
+//
+// A chain is checked out for the duration of one request and belongs to
+// that request's sequence alone, so concurrent sequences on parallel slots
+// each keep their own repetition-penalty and grammar state. Returned
+// chains are reset on the next checkout; the least recently returned
+// chains are freed once more than maxIdle are idle.
+type samplerPool struct {
+	mu      sync.Mutex
+	build   func(SamplerOptions) (*SamplerChain, error)
+	idle    []pooledSampler // oldest first
+	maxIdle int
+}
+
+type pooledSampler struct {
+	opts  SamplerOptions
+	chain *SamplerChain
+}
+
+// newSamplerPool returns a pool that creates chains with build.
+func newSamplerPool(maxIdle int, build func(SamplerOptions) (*SamplerChain, error)) *samplerPool {
+	if maxIdle < 1 {
+		maxIdle = 1
+	}
+	return &samplerPool{build: build, maxIdle: maxIdle}
+}
+
+// get checks out a chain for opts, reusing the most recently returned idle
+// one with the same options.
+func (p *samplerPool) get(opts SamplerOptions) (*SamplerChain, error) {
+	p.mu.Lock()
+	for i := len(p.idle) - 1; i >= 0; i-- {
+		if p.idle[i].opts == opts {
+			chain := p.idle[i].chain
+			p.idle = append(p.idle[:i], p.idle[i+1:]...)
+			p.mu.Unlock()
+			chain.Reset()
+			return chain, nil
+		}
+	}
+	p.mu.Unlock()
+	return p.build(opts)
+}
+
+// put returns a chain checked out for opts.
+func (p *samplerPool) put(opts SamplerOptions, chain *SamplerChain) {
+	if chain == nil {
+		return
+	}
+	p.mu.Lock()
+	p.idle = append(p.idle, pooledSampler{opts: opts, chain: chain})
+	var evicted []*SamplerChain
+	for len(p.idle) > p.maxIdle {
+		evicted = append(evicted, p.idle[0].chain)
+		p.idle = p.idle[1:]
+	}
+	p.mu.Unlock()
+	for _, c := range evicted {
+		c.Close()
+	}
+}
+
+// close frees every idle chain. Call it only once no request holds a
+// chain.
+func (p *samplerPool) close() {
+	p.mu.Lock()
+	idle := p.idle
+	p.idle = nil
+	p.mu.Unlock()
+	for _, s := range idle {
+		s.chain.Close()
+	}
+}
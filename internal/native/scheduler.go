@@ -0,0 +1,297 @@
+//go:build native
+
+package native
+
+import (
+	"context"
+	"fmt"
+	"strings"
+	"sync"
+	"sync/atomic"
+	"time"
+)
+
+// batchScheduler implements continuous batching over a single multi-sequence
+// context. Each in-flight request owns a parallelSlot (one KV sequence) and
+// submits one decode step per generated token; the scheduler goroutine
+// gathers the pending steps of all active slots and evaluates them with a
+// single llama_decode call, so N concurrent requests cost roughly one
+// weight pass per step instead of N.
+//
+// Sequence 0 is reserved for the adapter's serial path (vision, speculative
+// decoding, oversized prompts); slots use sequence IDs 1..N.
+type batchScheduler struct {
+	ctx    *Context
+	nBatch int
+
+	// slotBudget is the largest prompt+generation length (in tokens) a
+	// single slot may use. Longer requests are served on the serial path.
+	slotBudget int
+
+	mu    sync.Mutex
+	slots []*parallelSlot
+	sem   chan struct{} // one token per free slot
+
+	// active counts slots that are past prefill and submitting steps. The
+	// scheduler dispatches as soon as every active slot has a step queued.
+	active int32
+
+	// gatherWindow bounds how long the scheduler waits for stragglers
+	// before decoding a partial batch.
+	gatherWindow time.Duration
+
+	steps    chan *stepRequest
+	stop     chan struct{}
+	stopOnce sync.Once
+	done     chan struct{}
+
+	// onKVFull is invoked (from the scheduler goroutine or a prefilling
+	// request) when the shared KV pool is exhausted. It must free space
+	// held outside the scheduler, e.g. the serial path's sequence 0.
+	onKVFull func()
+}
+
+// parallelSlot is one KV sequence available to concurrent requests.
+type parallelSlot struct {
+	seqID int32
+	busy  bool
+
+	// cached holds the tokens whose KV currently lives in this sequence,
+	// in position order. It lets a follow-up request with the same
+	// system prompt skip re-evaluating the shared prefix.
+	cached []int32
+}
+
+type stepRequest struct {
+	entry   SeqEntry
+	sampler *SamplerChain
+	reply   chan stepResult
+}
+
+type stepResult struct {
+	token int32
+	err   error
+}
+
+// newBatchScheduler creates a scheduler for nSlots concurrent sequences and
+// starts its dispatch goroutine. ctx must have been created with
+// NSeqMax >= nSlots+1.
+func newBatchScheduler(ctx *Context, nSlots, nCtx, nBatch int, onKVFull func()) *batchScheduler {
+	s := &batchScheduler{
+		ctx:          ctx,
+		nBatch:       nBatch,
+		slotBudget:   nCtx / nSlots,
+		slots:        make([]*parallelSlot, nSlots),
+		sem:          make(chan struct{}, nSlots),
+		gatherWindow: time.Millisecond,
+		steps:        make(chan *stepRequest, nSlots),
+		stop:         make(chan struct{}),
+		done:         make(chan struct{}),
+		onKVFull:     onKVFull,
+	}
+	for i := range s.slots {
+		s.slots[i] = &parallelSlot{seqID: int32(i + 1)}
+		s.sem <- struct{}{}
+	}
+	go s.run()
+	return s
+}
+
+// acquire reserves a free slot, preferring the one whose cached tokens share
+// the longest prefix with prompt. It returns the slot and the number of
+// prompt tokens whose KV can be reused. Blocks until a slot is free or ctx
+// is cancelled.
+func (s *batchScheduler) acquire(ctx context.Context, prompt []int32) (*parallelSlot, int, error) {
+	select {
+	case <-s.sem:
+	case <-ctx.Done():
+		return nil, 0, ctx.Err()
+	case <-s.stop:
+		return nil, 0, fmt.Errorf("native: scheduler stopped")
+	}
+
+	s.mu.Lock()
+	defer s.mu.Unlock()
+
+	var best *parallelSlot
+	bestLen := -1
+	for _, sl := range s.slots {
+		if sl.busy {
+			continue
+		}
+		n := commonPrefixLen(sl.cached, prompt)
+		if n > bestLen {
+			best, bestLen = sl, n
+		}
+	}
+	// The semaphore guarantees a free slot exists.
+	best.busy = true
+
+	// Always re-evaluate at least the last prompt token so there are fresh
+	// logits to sample the first generated token from.
+	if bestLen >= len(prompt) {
+		bestLen = len(prompt) - 1
+	}
+	if bestLen < 0 {
+		bestLen = 0
+	}
+	return best, bestLen, nil
+}
+
+// release returns a slot to the free pool. The slot keeps its cached KV so
+// the next request can reuse the prefix.
+func (s *batchScheduler) release(sl *parallelSlot) {
+	s.mu.Lock()
+	sl.busy = false
+	s.mu.Unlock()
+	s.sem <- struct{}{}
+}
+
+// evictIdle drops the KV of every idle slot. Used to free the shared pool
+// when it runs out and before the serial path takes over the context.
+func (s *batchScheduler) evictIdle() {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	for _, sl := range s.slots {
+		if !sl.busy && len(sl.cached) > 0 {
+			s.ctx.SeqRemove(sl.seqID, 0, -1)
+			sl.cached = nil
+		}
+	}
+}
+
+// prefill evaluates prompt[reuse:] into the slot's sequence and samples the
+// first generated token, returning it with the number of prompt tokens
+// actually reused. On KV exhaustion it evicts idle sequences once and
+// retries. When the sequence cannot be cut back to reuse (recurrent or
+// hybrid memory), it is cleared and the whole prompt is evaluated.
+func (s *batchScheduler) prefill(sl *parallelSlot, prompt []int32, reuse int, sampler *SamplerChain) (int32, int, error) {
+	if !s.ctx.SeqRemove(sl.seqID, int32(reuse), -1) {
+		s.ctx.SeqRemove(sl.seqID, 0, -1)
+		reuse = 0
+	}
+	sl.cached = append(sl.cached[:reuse], prompt[reuse:]...)
+
+	token, err := s.ctx.PrefillSeq(sl.seqID, prompt[reuse:], int32(reuse), s.nBatch, sampler)
+	if err != nil && strings.Contains(err.Error(), "KV cache full") {
+		s.reclaim()
+		token, err = s.ctx.PrefillSeq(sl.seqID, prompt[reuse:], int32(reuse), s.nBatch, sampler)
+	}
+	if err != nil {
+		s.ctx.SeqRemove(sl.seqID, 0, -1)
+		sl.cached = nil
+		return 0, 0, err
+	}
+	return token, reuse, nil
+}
+
+// begin marks a slot as actively generating. Every begin must be paired
+// with an end once the request stops submitting steps.
+func (s *batchScheduler) begin() { atomic.AddInt32(&s.active, 1) }
+
+// end marks a slot as no longer generating.
+func (s *batchScheduler) end() { atomic.AddInt32(&s.active, -1) }
+
+// step submits token at pos for the slot's sequence and blocks until the
+// batched decode has run, returning the next sampled token.
+func (s *batchScheduler) step(sl *parallelSlot, token, pos int32, sampler *SamplerChain) (int32, error) {
+	req := &stepRequest{
+		entry:   SeqEntry{Token: token, Pos: pos, SeqID: sl.seqID, WantLogits: true},
+		sampler: sampler,
+		reply:   make(chan stepResult, 1),
+	}
+	select {
+	case s.steps <- req:
+	case <-s.stop:
+		return 0, fmt.Errorf("native: scheduler stopped")
+	}
+	select {
+	case r := <-req.reply:
+		if r.err == nil {
+			sl.cached = append(sl.cached, token)
+		}
+		return r.token, r.err
+	case <-s.stop:
+		return 0, fmt.Errorf("native: scheduler stopped")
+	}
+}
+
+// run is the dispatch loop: wait for a first step, gather the remaining
+// active slots' steps (bounded by gatherWindow), decode them as one batch.
+func (s *batchScheduler) run() {
+	defer close(s.done)
+	timer := time.NewTimer(time.Hour)
+	timer.Stop()
+
+	for {
+		var first *stepRequest
+		select {
+		case first = <-s.steps:
+		case <-s.stop:
+			return
+		}
+
+		batch := []*stepRequest{first}
+		timer.Reset(s.gatherWindow)
+	gather:
+		for len(batch) < int(atomic.LoadInt32(&s.active)) {
+			select {
+			case r := <-s.steps:
+				batch = append(batch, r)
+			case <-timer.C:
+				break gather
+			case <-s.stop:
+				break gather
+			}
+		}
+		if !timer.Stop() {
+			select {
+			case <-timer.C:
+			default:
+			}
+		}
+
+		s.dispatch(batch)
+	}
+}
+
+// dispatch decodes one gathered batch and replies to every request in it.
+func (s *batchScheduler) dispatch(batch []*stepRequest) {
+	entries := make([]SeqEntry, len(batch))
+	samplers := make([]*SamplerChain, len(batch))
+	for i, r := range batch {
+		entries[i] = r.entry
+		samplers[i] = r.sampler
+	}
+
+	tokens, err := s.ctx.DecodeMulti(entries, samplers)
+	if err != nil && strings.Contains(err.Error(), "KV cache full") {
+		s.reclaim()
+		tokens, err = s.ctx.DecodeMulti(entries, samplers)
+	}
+
+	for i, r := range batch {
+		if err != nil {
+			r.reply <- stepResult{err: err}
+			continue
+		}
+		r.reply <- stepResult{token: tokens[i]}
+	}
+}
+
+// reclaim frees KV space held by idle slots and by the serial path.
+func (s *batchScheduler) reclaim() {
+	s.evictIdle()
+	if s.onKVFull != nil {
+		s.onKVFull()
+	}
+}
+
+// close stops the dispatch goroutine. Callers must ensure no request is
+// still using a slot.
+func (s *batchScheduler) close() {
+	s.stopOnce.Do(func() {
+		close(s.stop)
+		<-s.done
+	})
+}
@@ -0,0 +1,162 @@
+//go:build native
+
+package native
+
+import (
+	"encoding/binary"
+	"fmt"
+	"hash/fnv"
+	"os"
+	"path/filepath"
+	"sort"
+	"strings"
+)
+
+// ---------------------------------------------------------------------------
+// KV state save / restore
+// ---------------------------------------------------------------------------
+
+// StateSeqData serializes the KV cache of seqID (cells, positions and
+// K/V data). Returns nil if the sequence is empty or serialization fails.
+func (c *Context) StateSeqData(seqID int32) []byte {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil
+	}
+	return cStateSeqGetData(c.handle, seqID)
+}
+
+// SetStateSeqData restores a state produced by StateSeqData into seqID,
+// replacing whatever the sequence held. When seqID is 0 the position
+// counter is moved to just past the restored cells.
+func (c *Context) SetStateSeqData(data []byte, seqID int32) error {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return fmt.Errorf("native: context is closed")
+	}
+	cMemorySeqRm(c.handle, seqID, 0, -1)
+	if !cStateSeqSetData(c.handle, data, seqID) {
+		return fmt.Errorf("native: restoring sequence %d state failed", seqID)
+	}
+	if seqID == 0 {
+		c.pos = cMemorySeqPosMax(c.handle, 0) + 1
+	}
+	return nil
+}
+
+// SaveState writes the sequence-0 KV cache and the tokens it was built
+// from to path.
+func (c *Context) SaveState(path string, tokens []int32) error {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return fmt.Errorf("native: context is closed")
+	}
+	if !cStateSaveFile(c.handle, path, 0, tokens) {
+		return fmt.Errorf("native: saving state to %s failed", path)
+	}
+	return nil
+}
+
+// LoadState replaces sequence 0 with the state stored at path and returns
+// the tokens it was built from. capacity bounds the number of tokens read
+// (normally the context size). The position counter is set past the
+// restored tokens.
+func (c *Context) LoadState(path string, capacity int) ([]int32, error) {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if c.closed {
+		return nil, fmt.Errorf("native: context is closed")
+	}
+	cMemorySeqRm(c.handle, 0, 0, -1)
+	tokens := cStateLoadFile(c.handle, path, 0, capacity)
+	if tokens == nil {
+		cMemorySeqRm(c.handle, 0, 0, -1)
+		c.pos = 0
+		return nil, fmt.Errorf("native: loading state from %s failed", path)
+	}
+	c.pos = int32(len(tokens))
+	return tokens, nil
+}
+
+// ---------------------------------------------------------------------------
+// Prompt-prefix snapshots on disk
+// ---------------------------------------------------------------------------
+
+const (
+	// promptSnapshotExt is the file extension of prompt-prefix snapshots.
+	promptSnapshotExt = ".kvstate"
+
+	// minSnapshotTokens is the shortest stable prefix worth persisting.
+	minSnapshotTokens = 32
+
+	// maxSnapshotsPerModel bounds how many snapshots are kept per model
+	// key; older ones are pruned after each save.
+	maxSnapshotsPerModel = 4
+)
+
+// snapshotModelKey identifies the model and KV layout a snapshot was taken
+// with. A state file is only valid for the exact same model weights,
+// context size and KV cache types.
+func snapshotModelKey(desc string, nParams uint64, nCtx uint32, typeK, typeV string) string {
+	h := fnv.New64a()
+	fmt.Fprintf(h, "%s|%d|%d|%s|%s", desc, nParams, nCtx, typeK, typeV)
+	return fmt.Sprintf("%016x", h.Sum64())
+}
+
+// tokenPrefixHash returns a stable hash of a token sequence.
+func tokenPrefixHash(tokens []int32) string {
+	h := fnv.New64a()
+	var buf [4]byte
+	for _, t := range tokens {
+		binary.LittleEndian.PutUint32(buf[:], uint32(t))
+		h.Write(buf[:])
+	}
+	return fmt.Sprintf("%016x", h.Sum64())
+}
+
+// snapshotPath returns the file that stores the KV snapshot of tokens.
+func snapshotPath(dir, modelKey string, tokens []int32) string {
+	return filepath.Join(dir, modelKey+"-"+tokenPrefixHash(tokens)+promptSnapshotExt)
+}
+
+// listSnapshots returns the snapshot files for modelKey, newest first.
+func listSnapshots(dir, modelKey string) []string {
+	entries, err := os.ReadDir(dir)
+	if err != nil {
+		return nil
+	}
+	type snap struct {
+		path  string
+		mtime int64
+	}
+	var snaps []snap
+	for _, e := range entries {
+		name := e.Name()
+		if e.IsDir() || !strings.HasPrefix(name, modelKey+"-") || !strings.HasSuffix(name, promptSnapshotExt) {
+			continue
+		}
+		info, err := e.Info()
+		if err != nil {
+			continue
+		}
+		snaps = append(snaps, snap{filepath.Join(dir, name), info.ModTime().UnixNano()})
+	}
+	sort.Slice(snaps, func(i, j int) bool { return snaps[i].mtime > snaps[j].mtime })
+
+	paths := make([]string, len(snaps))
+	for i, s := range snaps {
+		paths[i] = s.path
+	}
+	return paths
+}
+
+// pruneSnapshots removes all but the keep newest snapshots for modelKey.
+func pruneSnapshots(dir, modelKey string, keep int) {
+	paths := listSnapshots(dir, modelKey)
+	for i := keep; i < len(paths); i++ {
+		os.Remove(paths[i])
+	}
+}
@@ -11,12 +11,16 @@ import (
 	"fmt"
 	"log"
 	"sync"
+	"time"
+
+	"OpenEye/internal/runtime"
 )
 
 // VisionContext manages a multimodal (vision) context backed by an mmproj model.
 // It provides the ability to evaluate prompts containing image references.
 type VisionContext struct {
 	vctx   C.oe_vision_t
+	cache  *embedCache // nil if embedding caching is disabled
 	closed bool
 	mu     sync.Mutex
 }
@@ -29,7 +33,10 @@ type VisionContext struct {
 // This is safe because the model outlives the vision context (adapter.Close
 // frees vision before model), and the adapter's mutex serializes all
 // operations so the model cannot be closed while this is running.
-func NewVisionContext(mmprojPath string, model *Model, nThreads int, useGPU bool) (*VisionContext, error) {
+//
+// cacheBytes is the budget for encoded image embeddings kept across
+// requests; 0 disables the cache.
+func NewVisionContext(mmprojPath string, model *Model, nThreads int, useGPU bool, cacheBytes int64) (*VisionContext, error) {
 	if model == nil || model.IsClosed() {
 		return nil, fmt.Errorf("vision: text model is nil or closed")
 	}
@@ -45,35 +52,270 @@ func NewVisionContext(mmprojPath string, model *Model, nThreads int, useGPU bool
 	}
 
 	log.Printf("native/vision: mmproj loaded from %s (vision supported)", mmprojPath)
-	return &VisionContext{vctx: vctx}, nil
+	v := &VisionContext{vctx: vctx}
+	if cacheBytes > 0 {
+		v.cache = newEmbedCache(cacheBytes)
+	}
+	return v, nil
 }
 
-// EvalWithImages tokenizes a prompt containing <__media__> markers, loads the
-// referenced images, runs the vision encoder on image chunks, and evaluates
-// all chunks into the llama context's KV cache.
-//
-// Returns the new KV cache position after evaluation, or an error.
-// The caller is responsible for clearing/managing KV cache before calling this.
-//
-// Safety: ctx.Handle() is called under this method's lock. The adapter's mutex
-// ensures the llama context cannot be closed concurrently.
-func (v *VisionContext) EvalWithImages(ctx *Context, prompt string, imagePaths []string, nBatch int32) (newPos int32, err error) {
+// VisionPrompt is a prompt split into text and image chunks by
+// VisionContext.Tokenize. Close frees it.
+type VisionPrompt struct {
+	chunks C.oe_chunks_t
+	Chunks []VisionChunk
+
+	// Stage timings: loading the images and splitting the prompt, and
+	// the vision encoder summed over images. Cached counts images whose
+	// embeddings came from the cache.
+	Preprocess time.Duration
+	Encode     time.Duration
+	Cached     int
+
+	// Set by StartEncode: one result per image chunk, in chunk order.
+	encoded []chan encodeResult
+	stop    chan struct{}
+	done    chan struct{}
+}
+
+// VisionChunk describes one chunk of a VisionPrompt.
+type VisionChunk struct {
+	Image  bool    // image embeddings rather than text
+	Len    int     // text tokens or image embeddings
+	Tokens []int32 // text chunks only
+	id     string  // image content id
+}
+
+type encodeResult struct {
+	embd   []float32
+	cached bool
+	dur    time.Duration
+	err    error
+}
+
+// LeadingText returns the tokens of the text before the first image, nil
+// when the prompt starts with one. They match what Model.Tokenize returns
+// for that text with special tokens enabled, so they can be compared with
+// a text prompt's tokens.
+func (p *VisionPrompt) LeadingText() []int32 {
+	if len(p.Chunks) == 0 || p.Chunks[0].Image {
+		return nil
+	}
+	return p.Chunks[0].Tokens
+}
+
+// Close stops a pending StartEncode and frees the chunk list.
+func (p *VisionPrompt) Close() {
+	if p.stop != nil {
+		close(p.stop)
+		<-p.done
+		p.stop = nil
+	}
+	if p.chunks != nil {
+		cVisionChunksFree(p.chunks)
+		p.chunks = nil
+	}
+}
+
+// Tokenize splits a prompt containing <__media__> markers into text and
+// image chunks, one image per marker. The images are the already decoded
+// bitmaps when any are given, otherwise the files at imagePaths; several
+// images are loaded in parallel.
+func (v *VisionContext) Tokenize(prompt string, imagePaths []string, bitmaps []runtime.Bitmap) (*VisionPrompt, error) {
 	v.mu.Lock()
 	defer v.mu.Unlock()
 
 	if v.closed {
+		return nil, fmt.Errorf("vision: context is closed")
+	}
+
+	start := time.Now()
+	bmps, err := v.loadBitmaps(imagePaths, bitmaps)
+	if err != nil {
+		return nil, err
+	}
+	chunks, rc := cVisionTokenize(v.vctx, prompt, bmps)
+	for _, b := range bmps {
+		cVisionBitmapFree(b)
+	}
+	if chunks == nil {
+		return nil, fmt.Errorf("vision: tokenize failed (rc=%d) — check <__media__> marker count matches image count", rc)
+	}
+
+	p := &VisionPrompt{chunks: chunks, Chunks: make([]VisionChunk, cVisionChunksCount(chunks))}
+	for i := range p.Chunks {
+		typ, n, id := cVisionChunk(chunks, i)
+		c := VisionChunk{Image: typ != C.OE_CHUNK_TEXT, Len: n, id: id}
+		if !c.Image {
+			c.Tokens = cVisionChunkTextTokens(chunks, i)
+		}
+		p.Chunks[i] = c
+	}
+	p.Preprocess = time.Since(start)
+	return p, nil
+}
+
+// StartEncode runs the vision encoder over p's image chunks, in order, on
+// a separate goroutine, so the caller can evaluate text on the llama
+// context meanwhile. EvalChunks takes each image's embeddings as it
+// reaches that chunk, so decoding one image overlaps encoding the next.
+// Close waits for the goroutine.
+func (v *VisionContext) StartEncode(p *VisionPrompt) {
+	if p.stop != nil {
+		return
+	}
+	p.encoded = make([]chan encodeResult, len(p.Chunks))
+	for i, c := range p.Chunks {
+		if c.Image {
+			p.encoded[i] = make(chan encodeResult, 1)
+		}
+	}
+	p.stop = make(chan struct{})
+	p.done = make(chan struct{})
+	go func() {
+		defer close(p.done)
+		for i, c := range p.Chunks {
+			if !c.Image {
+				continue
+			}
+			select {
+			case <-p.stop:
+				return
+			default:
+			}
+			r := v.encodeImage(p, i)
+			p.encoded[i] <- r
+			if r.err != nil {
+				return
+			}
+		}
+	}()
+}
+
+// EvalChunks evaluates the chunks of p from index from onwards into the
+// llama context's KV cache at position nPast. Image embeddings come from
+// StartEncode when it was called and are encoded here otherwise; images
+// whose embeddings are still cached from an earlier request (same pixels)
+// skip the encoder.
+//
+// Returns the new KV cache position after evaluation, or an error.
+// The caller is responsible for managing the KV cache before calling this.
+//
+// Safety: the encoder may run concurrently on StartEncode's goroutine. It
+// only touches the vision context's own buffers; evaluation reads the
+// vision context's settings and writes the llama context, which the
+// adapter's mutex keeps open and to itself.
+func (v *VisionContext) EvalChunks(ctx *Context, p *VisionPrompt, from int, nPast, nBatch int32) (newPos int32, err error) {
+	if v.IsClosed() {
 		return 0, fmt.Errorf("vision: context is closed")
 	}
 	if ctx == nil || ctx.IsClosed() {
 		return 0, fmt.Errorf("vision: llama context is nil or closed")
 	}
 
-	newNPast, rc := cVisionEval(v.vctx, ctx.Handle(), prompt, imagePaths, 0, nBatch)
-	if rc != 0 {
-		return 0, fmt.Errorf("vision: eval failed (rc=%d) — check image paths and <__media__> marker count matches image count", rc)
+	newPos = nPast
+	n := len(p.Chunks)
+	for i := from; i < n; i++ {
+		var embd []float32
+		if p.Chunks[i].Image {
+			var r encodeResult
+			if p.encoded != nil {
+				r = <-p.encoded[i]
+			} else {
+				r = v.encodeImage(p, i)
+			}
+			if r.err != nil {
+				return 0, r.err
+			}
+			embd = r.embd
+			p.Encode += r.dur
+			if r.cached {
+				p.Cached++
+			}
+		}
+		var rc int32
+		newPos, rc = cVisionEvalChunk(v.vctx, ctx.Handle(), p.chunks, i, embd, newPos, nBatch, i == n-1)
+		if rc != 0 {
+			return 0, fmt.Errorf("vision: eval of chunk %d/%d failed (rc=%d)", i+1, n, rc)
+		}
+	}
+	return newPos, nil
+}
+
+// loadBitmaps creates one mtmd bitmap per image, from pixels when given and
+// from files otherwise, decoding files concurrently. The caller frees them.
+// The caller holds v.mu.
+func (v *VisionContext) loadBitmaps(paths []string, pixels []runtime.Bitmap) ([]C.oe_bitmap_t, error) {
+	n := len(paths)
+	if len(pixels) > 0 {
+		n = len(pixels)
+	}
+	bmps := make([]C.oe_bitmap_t, n)
+	load := func(i int) {
+		if len(pixels) > 0 {
+			p := pixels[i]
+			bmps[i] = cVisionBitmapFromRGB(v.vctx, p.Width, p.Height, p.RGB)
+		} else {
+			bmps[i] = cVisionLoadImage(v.vctx, paths[i])
+		}
+	}
+	if n == 1 {
+		load(0)
+	} else {
+		var wg sync.WaitGroup
+		for i := 0; i < n; i++ {
+			wg.Add(1)
+			go func(i int) {
+				defer wg.Done()
+				load(i)
+			}(i)
+		}
+		wg.Wait()
+	}
+
+	for i, b := range bmps {
+		if b != nil {
+			continue
+		}
+		for _, other := range bmps {
+			if other != nil {
+				cVisionBitmapFree(other)
+			}
+		}
+		if len(pixels) > 0 {
+			return nil, fmt.Errorf("vision: invalid bitmap %d (%dx%d, %d bytes)",
+				i+1, pixels[i].Width, pixels[i].Height, len(pixels[i].RGB))
+		}
+		return nil, fmt.Errorf("vision: failed to load image %q", paths[i])
 	}
+	return bmps, nil
+}
 
-	return newNPast, nil
+// encodeImage returns the embeddings of image chunk i of p, from the cache
+// when the same image was encoded before.
+func (v *VisionContext) encodeImage(p *VisionPrompt, i int) encodeResult {
+	v.mu.Lock()
+	defer v.mu.Unlock()
+
+	start := time.Now()
+	c := p.Chunks[i]
+	if v.closed {
+		return encodeResult{err: fmt.Errorf("vision: context is closed")}
+	}
+	n := cVisionChunkNFloats(v.vctx, p.chunks, i)
+	if v.cache != nil {
+		if embd := v.cache.get(c.id); embd != nil && len(embd) == n {
+			return encodeResult{embd: embd, cached: true, dur: time.Since(start)}
+		}
+	}
+	embd := make([]float32, n)
+	if rc := cVisionEncodeChunk(v.vctx, p.chunks, i, embd); rc != 0 {
+		return encodeResult{err: fmt.Errorf("vision: image encode failed (rc=%d)", rc)}
+	}
+	if v.cache != nil {
+		v.cache.put(c.id, embd)
+	}
+	return encodeResult{embd: embd, dur: time.Since(start)}
 }
 
 // Close frees the vision context and its resources.
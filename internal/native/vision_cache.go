@@ -0,0 +1,70 @@
+//go:build native
+
+package native
+
+import (
+	"container/list"
+	"sync"
+)
+
+// embedCache holds vision encoder outputs keyed by image content id (see
+// oe_vision_tokenize), so follow-up questions about the same picture skip
+// the encoder. Entries are evicted in LRU order once their total size
+// exceeds the byte budget.
+type embedCache struct {
+	mu      sync.Mutex
+	budget  int64
+	used    int64
+	entries map[string]*list.Element
+	lru     *list.List // of *embedEntry, most recent at the front
+}
+
+type embedEntry struct {
+	id   string
+	embd []float32
+}
+
+// newEmbedCache creates a cache holding at most budget bytes of embeddings.
+func newEmbedCache(budget int64) *embedCache {
+	return &embedCache{
+		budget:  budget,
+		entries: make(map[string]*list.Element),
+		lru:     list.New(),
+	}
+}
+
+func embedBytes(embd []float32) int64 { return int64(len(embd)) * 4 }
+
+// get returns the embeddings cached for id, or nil.
+func (c *embedCache) get(id string) []float32 {
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	el := c.entries[id]
+	if el == nil {
+		return nil
+	}
+	c.lru.MoveToFront(el)
+	return el.Value.(*embedEntry).embd
+}
+
+// put caches embd under id. Embeddings larger than the whole budget are
+// not cached.
+func (c *embedCache) put(id string, embd []float32) {
+	size := embedBytes(embd)
+	if id == "" || size > c.budget {
+		return
+	}
+	c.mu.Lock()
+	defer c.mu.Unlock()
+	if el := c.entries[id]; el != nil {
+		c.lru.MoveToFront(el)
+		return
+	}
+	c.entries[id] = c.lru.PushFront(&embedEntry{id: id, embd: embd})
+	c.used += size
+	for c.used > c.budget {
+		e := c.lru.Remove(c.lru.Back()).(*embedEntry)
+		delete(c.entries, e.id)
+		c.used -= embedBytes(e.embd)
+	}
+}
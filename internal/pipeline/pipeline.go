@@ -16,6 +16,7 @@ import (
 	"OpenEye/internal/image"
 	"OpenEye/internal/rag"
 	"OpenEye/internal/runtime"
+	"OpenEye/internal/tokens"
 )
 
 // Options controls how the pipeline produces a response.
@@ -64,6 +65,12 @@ func New(cfg config.Config, registry runtime.Registry) (*Pipeline, error) {
 		return nil, fmt.Errorf("pipeline: failed to initialise runtime: %w", err)
 	}
 
+	// Budget fitters everywhere count with the model's own tokenizer when
+	// the backend can tokenize locally.
+	if tc := mgr.TokenCounter(); tc != nil {
+		tokens.SetCounter(tc)
+	}
+
 	store, err := memory.NewStore(cfg.Memory.Path)
 	if err != nil {
 		mgr.Close()
@@ -98,10 +105,12 @@ func New(cfg config.Config, registry runtime.Registry) (*Pipeline, error) {
 		}
 	}
 
-	// Initialize image processor if enabled
+	// Initialize image processor if enabled. The native backend always
+	// gets one, since it takes decoded pixels rather than files.
 	var imageProcessor image.Processor
-	if cfg.Image.Enabled {
-		imageProcessor = initializeImageProcessor(cfg.Image)
+	native := strings.EqualFold(cfg.Runtime.Backend, "native")
+	if cfg.Image.Enabled || native {
+		imageProcessor = initializeImageProcessor(cfg.Image, native)
 	}
 
 	// Initialize Omem long-term memory if enabled
@@ -175,13 +184,19 @@ func initializeVectorEngine(cfg config.Config, embedder embedding.Provider, mgr
 	var summarizerWrapper *summarizerProviderWrapper
 	if mgr != nil {
 		summarizerWrapper = &summarizerProviderWrapper{manager: mgr}
+		if mgr.TokenCounter() != nil {
+			engineCfg.TokenCounter = tokens.Default()
+		}
 	}
 
 	return memory.NewEngine(engineCfg, embeddingWrapper, summarizerWrapper)
 }
 
-// initializeImageProcessor creates an image processor from config.
-func initializeImageProcessor(cfg config.ImageConfig) image.Processor {
+// initializeImageProcessor creates an image processor from config. With
+// pixels set it outputs raw RGB for the native vision encoder and accepts
+// base64 input regardless of auto_detect_input, since the HTTP server
+// passes uploaded images through undecoded.
+func initializeImageProcessor(cfg config.ImageConfig, pixels bool) image.Processor {
 	format := image.FormatJPEG
 	switch strings.ToLower(cfg.OutputFormat) {
 	case "png":
@@ -201,6 +216,11 @@ func initializeImageProcessor(cfg config.ImageConfig) image.Processor {
 		AutoDetectInput:     cfg.AutoDetectInput,
 		OutputAsBase64:      cfg.OutputAsBase64,
 	}
+	if pixels {
+		processorCfg.OutputFormat = image.FormatRGB
+		processorCfg.AutoDetectInput = true
+		processorCfg.OutputAsBase64 = false
+	}
 
 	return image.NewProcessor(processorCfg)
 }
@@ -291,6 +311,9 @@ func (p *Pipeline) Close() error {
 		}
 	}
 	if p.manager != nil {
+		if p.manager.TokenCounter() != nil {
+			tokens.SetCounter(nil)
+		}
 		if err := p.manager.Close(); err != nil && firstErr == nil {
 			firstErr = err
 		}
@@ -308,6 +331,14 @@ func (p *Pipeline) ClearContext() error {
 	return p.manager.ClearContext()
 }
 
+// Metrics returns the runtime's request metrics, or nil without a runtime.
+func (p *Pipeline) Metrics() *runtime.Metrics {
+	if p == nil || p.manager == nil {
+		return nil
+	}
+	return p.manager.Metrics()
+}
+
 // GetMemoryStats returns statistics about the memory system.
 func (p *Pipeline) GetMemoryStats(ctx context.Context) (map[string]interface{}, error) {
 	if p == nil {
@@ -392,19 +423,36 @@ func (p *Pipeline) Respond(ctx context.Context, message string, images []string,
 		return Result{}, nil
 	}
 
-	// Process images (resize, format)
+	// Process images (resize, format). The native backend takes the
+	// decoded pixels directly.
 	log.Printf("pipeline: received %d image(s) from CLI", len(images))
-	processedImages, err := p.processImages(ctx, images)
-	if err != nil {
-		log.Printf("warning: failed to process images: %v", err)
-		processedImages = images // Fallback to original
+	var processedImages []string
+	var bitmaps []runtime.Bitmap
+	var err error
+	if p.decodesToPixels() && len(images) > 0 {
+		bitmaps, err = p.decodeImages(ctx, images)
+		if err != nil {
+			log.Printf("warning: failed to decode images: %v", err)
+			processedImages = images // Fallback to original
+		}
+	} else {
+		processedImages, err = p.processImages(ctx, images)
+		if err != nil {
+			log.Printf("warning: failed to process images: %v", err)
+			processedImages = images // Fallback to original
+		}
 	}
-	if len(processedImages) > 0 {
-		log.Printf("pipeline: processed %d image(s)", len(processedImages))
+	imageCount := len(processedImages) + len(bitmaps)
+	if imageCount > 0 {
+		log.Printf("pipeline: processed %d image(s)", imageCount)
 	}
 
 	// Check cache
-	cacheKey := generateCacheKey(normalized, processedImages)
+	cacheImages := processedImages
+	if len(bitmaps) > 0 {
+		cacheImages = images
+	}
+	cacheKey := generateCacheKey(normalized, cacheImages)
 	if cached, ok := p.responseCache.Load(cacheKey); ok {
 		log.Println("returning cached response")
 		return cached.(Result), nil
@@ -523,8 +571,8 @@ func (p *Pipeline) Respond(ctx context.Context, message string, images []string,
 
 	// Assemble Context
 	promptMessage := normalized
-	if len(processedImages) > 0 {
-		promptMessage = addImageMarkers(normalized, len(processedImages))
+	if imageCount > 0 {
+		promptMessage = addImageMarkers(normalized, imageCount)
 	}
 
 	ctxBuilder := conversation.NewContext(p.cfg.Conversation.SystemMessage, promptMessage)
@@ -578,11 +626,11 @@ func (p *Pipeline) Respond(ctx context.Context, message string, images []string,
 	}
 
 	// Log if images are being sent
-	if len(processedImages) > 0 {
-		log.Printf("pipeline: sending request with %d image(s) to runtime", len(processedImages))
+	if imageCount > 0 {
+		log.Printf("pipeline: sending request with %d image(s) to runtime", imageCount)
 	}
 
-	req := runtime.Request{Prompt: prompt, Image: processedImages}
+	req := runtime.Request{Prompt: prompt, Image: processedImages, Bitmaps: bitmaps}
 	req.Options = mergeOptions(p.cfg.Runtime.Defaults, opts.GenerationHints)
 
 	if opts.Stream {
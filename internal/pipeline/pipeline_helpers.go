@@ -11,6 +11,7 @@ import (
 
 	"OpenEye/internal/config"
 	"OpenEye/internal/embedding"
+	"OpenEye/internal/image"
 	"OpenEye/internal/rag"
 	"OpenEye/internal/runtime"
 )
@@ -53,10 +54,32 @@ func mergeOptions(defaults config.GenerationDefaults, hints runtime.GenerationOp
 	if hints.Stop == nil && defaults.Stop != nil {
 		result.Stop = append([]string(nil), defaults.Stop...)
 	}
+	result.Grammar = hints.Grammar
+	result.Choices = hints.Choices
 
 	return result
 }
 
+// decodesToPixels reports whether images go to the runtime as decoded
+// bitmaps (see runtime.Request.Bitmaps) rather than files or base64.
+func (p *Pipeline) decodesToPixels() bool {
+	return p.imageProcessor != nil && p.imageProcessor.Config().OutputFormat == image.FormatRGB
+}
+
+// decodeImages decodes and resizes input images (file paths or base64)
+// into bitmaps, without the temp files and re-encoding of processImages.
+func (p *Pipeline) decodeImages(ctx context.Context, inputs []string) ([]runtime.Bitmap, error) {
+	processed, err := p.imageProcessor.ProcessMultiple(ctx, inputs)
+	if err != nil {
+		return nil, err
+	}
+	bitmaps := make([]runtime.Bitmap, len(processed))
+	for i, img := range processed {
+		bitmaps[i] = runtime.Bitmap{Width: img.Width, Height: img.Height, RGB: img.Data}
+	}
+	return bitmaps, nil
+}
+
 // processImages processes input images using the configured image processor.
 // Returns processed image data (base64 or file paths depending on config).
 func (p *Pipeline) processImages(ctx context.Context, inputs []string) ([]string, error) {
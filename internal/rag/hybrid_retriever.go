@@ -11,6 +11,7 @@ import (
 
 	"OpenEye/internal/config"
 	"OpenEye/internal/embedding"
+	"OpenEye/internal/tokens"
 )
 
 type HybridRetrieverConfig struct {
@@ -570,7 +571,7 @@ func isAdjacent(id1, id2 string) bool {
 	return idx2 == idx1+1
 }
 
-// estimateTokenCount estimates token count for text using rune count for accuracy.
+// estimateTokenCount counts the tokens of text with the shared token service.
 func estimateTokenCount(text string) int {
-	return len([]rune(text)) / 4
+	return tokens.Count(text)
 }
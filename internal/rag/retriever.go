@@ -446,22 +446,28 @@ func buildIndex(corpusPath string, chunkSize, overlap int, embedder embedding.Pr
 		}
 
 		slices := chunkText(content, chunkSize, overlap)
+		var texts []string
+		var ids []int
 		for idx, chunk := range slices {
 			cleaned := strings.TrimSpace(chunk)
 			if cleaned == "" {
 				continue
 			}
-			embeddingVec, embedErr := embedWithTimeout(embedder, cleaned)
-			if embedErr != nil {
-				return embedErr
-			}
+			texts = append(texts, cleaned)
+			ids = append(ids, idx)
+		}
+		vectors, embedErr := embedAllWithTimeout(embedder, texts)
+		if embedErr != nil {
+			return embedErr
+		}
+		for k, embeddingVec := range vectors {
 			vector := make([]float32, len(embeddingVec))
 			copy(vector, embeddingVec)
 			normalizeVector(vector)
 			chunks = append(chunks, vectorChunk{
-				id:     fmt.Sprintf("%s#%d", relPath, idx),
+				id:     fmt.Sprintf("%s#%d", relPath, ids[k]),
 				source: relPath,
-				text:   cleaned,
+				text:   texts[k],
 				vector: vector,
 			})
 		}
@@ -505,6 +511,26 @@ func embedWithTimeout(embedder embedding.Provider, text string) ([]float32, erro
 	return embedder.Embed(ctx, text)
 }
 
+// embedAllWithTimeout embeds a document's chunks, in one call when the
+// provider supports batching and one call per chunk otherwise.
+func embedAllWithTimeout(embedder embedding.Provider, texts []string) ([][]float32, error) {
+	bp, ok := embedder.(embedding.BatchProvider)
+	if !ok || len(texts) < 2 {
+		vectors := make([][]float32, len(texts))
+		for i, text := range texts {
+			vec, err := embedWithTimeout(embedder, text)
+			if err != nil {
+				return nil, err
+			}
+			vectors[i] = vec
+		}
+		return vectors, nil
+	}
+	ctx, cancel := context.WithTimeout(context.Background(), time.Duration(len(texts))*45*time.Second)
+	defer cancel()
+	return bp.EmbedBatch(ctx, texts)
+}
+
 func extractDocumentText(path, ext string) (string, error) {
 	switch ext {
 	case ".pdf":
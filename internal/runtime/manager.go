@@ -11,6 +11,7 @@ import (
 // Manager routes generation requests to configured runtime adapters.
 type Manager struct {
 	adapter Adapter
+	metrics *Metrics
 }
 
 // NewManager constructs the runtime manager using the provided configuration.
@@ -30,7 +31,7 @@ func NewManager(cfg config.RuntimeConfig, registry Registry) (*Manager, error) {
 		return nil, err
 	}
 
-	return &Manager{adapter: adapter}, nil
+	return &Manager{adapter: adapter, metrics: NewMetrics()}, nil
 }
 
 // Close frees adapter resources.
@@ -46,7 +47,13 @@ func (m *Manager) Generate(ctx context.Context, req Request) (Response, error) {
 	if m == nil || m.adapter == nil {
 		return Response{}, fmt.Errorf("runtime: no adapter configured")
 	}
-	return m.adapter.Generate(ctx, req)
+	resp, err := m.adapter.Generate(ctx, req)
+	if err != nil {
+		m.metrics.ObserveFailure()
+	} else {
+		m.metrics.Observe(resp.Stats)
+	}
+	return resp, err
 }
 
 // Stream requests a streaming generation.
@@ -54,7 +61,16 @@ func (m *Manager) Stream(ctx context.Context, req Request, cb StreamCallback) er
 	if m == nil || m.adapter == nil {
 		return fmt.Errorf("runtime: no adapter configured")
 	}
-	return m.adapter.Stream(ctx, req, cb)
+	err := m.adapter.Stream(ctx, req, func(evt StreamEvent) error {
+		if evt.Final && evt.Stats != nil {
+			m.metrics.Observe(*evt.Stats)
+		}
+		return cb(evt)
+	})
+	if err != nil {
+		m.metrics.ObserveFailure()
+	}
+	return err
 }
 
 // ClearContext clears the adapter's context state between requests.
@@ -66,6 +82,24 @@ func (m *Manager) ClearContext() error {
 	return m.adapter.ClearContext()
 }
 
+// Metrics returns the request metrics recorded by the manager.
+func (m *Manager) Metrics() *Metrics {
+	if m == nil {
+		return nil
+	}
+	return m.metrics
+}
+
+// TokenCounter returns the adapter's exact token counter, or nil if the
+// backend cannot count tokens locally.
+func (m *Manager) TokenCounter() TokenCounter {
+	if m == nil || m.adapter == nil {
+		return nil
+	}
+	tc, _ := m.adapter.(TokenCounter)
+	return tc
+}
+
 // Registry maps backend keys to factories initialising adapters.
 type Registry map[string]AdapterFactory
 
@@ -0,0 +1,150 @@
+package runtime
+
+import (
+	"bufio"
+	"fmt"
+	"io"
+	"sync"
+	"time"
+)
+
+// latencyBuckets are the histogram upper bounds, in seconds, for request
+// duration and TTFT: from a cached prompt on a desktop to a long
+// generation on a Raspberry Pi.
+var latencyBuckets = []float64{0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 30, 60, 120}
+
+// histogram is a cumulative Prometheus-style histogram.
+type histogram struct {
+	counts []uint64 // per bucket, non-cumulative; last entry is +Inf
+	sum    float64
+	count  uint64
+}
+
+func newHistogram() histogram {
+	return histogram{counts: make([]uint64, len(latencyBuckets)+1)}
+}
+
+func (h *histogram) observe(d time.Duration) {
+	v := d.Seconds()
+	i := 0
+	for i < len(latencyBuckets) && v > latencyBuckets[i] {
+		i++
+	}
+	h.counts[i]++
+	h.sum += v
+	h.count++
+}
+
+// Metrics aggregates the Stats of completed requests for export in the
+// Prometheus text format. The Manager records every request it serves.
+type Metrics struct {
+	mu sync.Mutex
+
+	requests uint64
+	failures uint64
+
+	tokensEvaluated uint64
+	tokensGenerated uint64
+	tokensCached    uint64
+
+	duration histogram
+	ttft     histogram
+
+	phases        [7]float64 // seconds, in phaseNames order
+	decodeCalls   uint64
+	ubatches      uint64
+	kvShifts      uint64
+	cgoCalls      uint64
+	eventsDropped uint64
+}
+
+var phaseNames = [7]string{"tokenize", "prefill", "decode", "sample", "detokenize", "image_preprocess", "image_encode"}
+
+// NewMetrics returns an empty metrics set.
+func NewMetrics() *Metrics {
+	return &Metrics{duration: newHistogram(), ttft: newHistogram()}
+}
+
+// Observe records a completed request.
+func (m *Metrics) Observe(st Stats) {
+	if m == nil {
+		return
+	}
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	m.requests++
+	m.tokensEvaluated += uint64(st.TokensEvaluated)
+	m.tokensGenerated += uint64(st.TokensGenerated)
+	m.tokensCached += uint64(st.TokensCached)
+	m.duration.observe(st.Duration)
+	if st.TTFT > 0 {
+		m.ttft.observe(st.TTFT)
+	}
+
+	p := st.Phases
+	for i, d := range [7]time.Duration{p.Tokenize, p.Prefill, p.Decode, p.Sample, p.Detokenize, p.ImagePreprocess, p.ImageEncode} {
+		m.phases[i] += d.Seconds()
+	}
+	m.decodeCalls += uint64(p.DecodeCalls)
+	m.ubatches += uint64(p.Ubatches)
+	m.kvShifts += uint64(p.KVShifts)
+	m.cgoCalls += uint64(p.CgoCalls)
+	m.eventsDropped += uint64(p.EventsDropped)
+}
+
+// ObserveFailure records a request that returned an error.
+func (m *Metrics) ObserveFailure() {
+	if m == nil {
+		return
+	}
+	m.mu.Lock()
+	m.failures++
+	m.mu.Unlock()
+}
+
+// WritePrometheus writes the metrics in the Prometheus text exposition
+// format (version 0.0.4).
+func (m *Metrics) WritePrometheus(w io.Writer) error {
+	m.mu.Lock()
+	defer m.mu.Unlock()
+
+	bw := bufio.NewWriter(w)
+	counter := func(name, help string, v uint64) {
+		fmt.Fprintf(bw, "# HELP %s %s\n# TYPE %s counter\n%s %d\n", name, help, name, name, v)
+	}
+
+	counter("openeye_requests_total", "Completed generation requests.", m.requests)
+	counter("openeye_request_failures_total", "Generation requests that returned an error.", m.failures)
+	counter("openeye_prompt_tokens_total", "Prompt tokens evaluated.", m.tokensEvaluated)
+	counter("openeye_generated_tokens_total", "Tokens generated.", m.tokensGenerated)
+	counter("openeye_cached_tokens_total", "Prompt tokens reused from the KV cache.", m.tokensCached)
+
+	writeHistogram(bw, "openeye_request_duration_seconds", "Generation request duration.", &m.duration)
+	writeHistogram(bw, "openeye_ttft_seconds", "Time to first generated token.", &m.ttft)
+
+	fmt.Fprintf(bw, "# HELP openeye_native_phase_seconds_total Time spent in the native runtime by phase.\n")
+	fmt.Fprintf(bw, "# TYPE openeye_native_phase_seconds_total counter\n")
+	for i, name := range phaseNames {
+		fmt.Fprintf(bw, "openeye_native_phase_seconds_total{phase=%q} %g\n", name, m.phases[i])
+	}
+	counter("openeye_native_decode_calls_total", "llama_decode calls.", m.decodeCalls)
+	counter("openeye_native_ubatches_total", "Micro-batches processed by llama_decode.", m.ubatches)
+	counter("openeye_native_kv_shifts_total", "KV cache context shifts.", m.kvShifts)
+	counter("openeye_native_cgo_calls_total", "Calls from Go into the native binding.", m.cgoCalls)
+	counter("openeye_native_perf_events_dropped_total", "Phase timing events lost to ring overflow.", m.eventsDropped)
+
+	return bw.Flush()
+}
+
+func writeHistogram(w io.Writer, name, help string, h *histogram) {
+	fmt.Fprintf(w, "# HELP %s %s\n# TYPE %s histogram\n", name, help, name)
+	var cum uint64
+	for i, le := range latencyBuckets {
+		cum += h.counts[i]
+		fmt.Fprintf(w, "%s_bucket{le=\"%g\"} %d\n", name, le, cum)
+	}
+	cum += h.counts[len(latencyBuckets)]
+	fmt.Fprintf(w, "%s_bucket{le=\"+Inf\"} %d\n", name, cum)
+	fmt.Fprintf(w, "%s_sum %g\n%s_count %d\n", name, h.sum, name, h.count)
+}
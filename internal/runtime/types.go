@@ -11,11 +11,30 @@ var ErrStreamingUnsupported = errors.New("runtime: streaming not supported by ad
 
 // Request captures a model prompt along with tunable generation options.
 type Request struct {
-	Prompt  string
-	Image   []string
+	Prompt string
+	Image  []string
+
+	// Bitmaps are already decoded images, one per media marker in the
+	// prompt, used instead of Image by the native backend so the pixels
+	// need no temp file or second decode. Other backends ignore them.
+	Bitmaps []Bitmap
+
 	Options GenerationOptions
 }
 
+// Bitmap is a decoded image as packed 8-bit RGB rows (Width*Height*3
+// bytes).
+type Bitmap struct {
+	Width  int
+	Height int
+	RGB    []byte
+}
+
+// HasImages reports whether the request carries images in either form.
+func (r Request) HasImages() bool {
+	return len(r.Image) > 0 || len(r.Bitmaps) > 0
+}
+
 // GenerationOptions maps to the most common inference controls for SLMs.
 type GenerationOptions struct {
 	MaxTokens     int
@@ -26,6 +45,32 @@ type GenerationOptions struct {
 	RepeatPenalty float64
 	RepeatLastN   int
 	Stop          []string
+
+	// Grammar is a GBNF grammar (start rule "root") that generated text
+	// must match; see package grammar. Empty = unconstrained. Adapters that
+	// cannot constrain sampling ignore it.
+	Grammar string
+
+	// Choices turns the request into a classification: the response text
+	// is exactly one of these labels. The native backend picks the most
+	// likely label directly instead of generating free text; other
+	// backends constrain generation to the labels with a grammar.
+	Choices []string
+}
+
+type grammarKey struct{}
+
+// WithGrammar returns a context carrying a GBNF grammar for callers that
+// generate through a prompt-only function (e.g. the omem engine's LLM hook)
+// and so cannot set GenerationOptions.Grammar themselves.
+func WithGrammar(ctx context.Context, gbnf string) context.Context {
+	return context.WithValue(ctx, grammarKey{}, gbnf)
+}
+
+// GrammarFromContext returns the grammar set by WithGrammar, if any.
+func GrammarFromContext(ctx context.Context) string {
+	g, _ := ctx.Value(grammarKey{}).(string)
+	return g
 }
 
 // Response contains the final text plus optional statistics.
@@ -65,6 +110,47 @@ type Stats struct {
 	// Higher is better — 100% means the draft model perfectly predicted
 	// the target model's output.
 	SpeculativeAcceptanceRate float64
+
+	// SpeculativeDraftN is the draft length the adaptive controller chose
+	// for each speculative round, in order (nil if speculative is off).
+	// Rounds may draft fewer tokens when the draft model loses confidence.
+	SpeculativeDraftN []int
+
+	// SpeculativeLookups and SpeculativeLookupHits count prompt-lookup
+	// (speculative_mode: ngram) rounds and those that found a match to
+	// draft from. Zero with a draft model or speculative off.
+	SpeculativeLookups    int
+	SpeculativeLookupHits int
+
+	// Phases breaks the request down by where the time went inside the
+	// native runtime. Zero for other backends.
+	Phases PhaseTimings
+}
+
+// PhaseTimings is the per-phase time a request spent in the native layer,
+// measured around each llama.cpp call.
+type PhaseTimings struct {
+	Tokenize   time.Duration
+	Prefill    time.Duration // prompt decode, before the first sample
+	Decode     time.Duration // decode after the first sample (generation, verification)
+	Sample     time.Duration
+	Detokenize time.Duration
+
+	// Vision requests: loading the images and splitting the prompt, and
+	// the vision encoder. Encoding runs alongside the text prefill, so it
+	// overlaps Prefill rather than adding to it.
+	ImagePreprocess time.Duration
+	ImageEncode     time.Duration
+	ImagesCached    int // images whose embeddings came from the cache
+
+	DecodeCalls int // llama_decode calls
+	Ubatches    int // micro-batches those calls were split into
+	KVShifts    int // context shifts
+	CgoCalls    int // calls from Go into the C binding
+
+	// EventsDropped counts timing events lost to ring overflow; when
+	// non-zero the durations above are undercounted.
+	EventsDropped int
 }
 
 // StreamEvent is emitted for each token or checkpoint during streaming.
@@ -89,3 +175,10 @@ type Adapter interface {
 	ClearContext() error
 	Close() error
 }
+
+// TokenCounter is implemented by adapters that can count tokens exactly
+// with the loaded model's tokenizer. Context builders use it in place of a
+// characters-per-token estimate.
+type TokenCounter interface {
+	CountTokens(texts []string) ([]int, error)
+}
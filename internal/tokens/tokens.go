@@ -0,0 +1,187 @@
+// Package tokens provides the process-wide token counting service used by
+// every context budget fitter (memory, omem, mem0, RAG). When the runtime
+// can tokenize locally, counts come from the model's own vocabulary, so
+// assembled prompts land at their budget instead of overshooting the
+// context size and forcing KV shifts. Otherwise a characters-per-token
+// estimate is used. Counts are memoized per string.
+package tokens
+
+import (
+	"sync"
+	"unicode/utf8"
+)
+
+// Counter counts tokens exactly for a batch of texts, typically in a
+// single call into the tokenizer (see runtime.TokenCounter).
+type Counter interface {
+	CountTokens(texts []string) ([]int, error)
+}
+
+// defaultCacheEntries bounds the memoized counts of the default service.
+const defaultCacheEntries = 8192
+
+// Service memoizes token counts for strings. It is safe for concurrent use
+// and itself implements Counter, so it can be handed to code that expects
+// an exact counter.
+//
+// The cache keeps two generations: when the current map fills up it
+// becomes the previous one and a new map is started. A hit in the
+// previous generation is promoted, so frequently used strings (system
+// prompts, stored facts) survive while one-off texts age out.
+type Service struct {
+	mu       sync.Mutex
+	counter  Counter
+	capacity int
+	cur      map[string]int
+	prev     map[string]int
+}
+
+// NewService creates a service backed by counter (nil for estimates only)
+// that memoizes up to about capacity strings.
+func NewService(counter Counter, capacity int) *Service {
+	if capacity <= 0 {
+		capacity = defaultCacheEntries
+	}
+	return &Service{
+		counter:  counter,
+		capacity: capacity,
+		cur:      make(map[string]int),
+	}
+}
+
+// SetCounter replaces the exact counter and drops memoized counts, which
+// may have come from a different tokenizer or from the estimate.
+func (s *Service) SetCounter(counter Counter) {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	s.counter = counter
+	s.cur = make(map[string]int)
+	s.prev = nil
+}
+
+// Exact reports whether counts come from a real tokenizer.
+func (s *Service) Exact() bool {
+	s.mu.Lock()
+	defer s.mu.Unlock()
+	return s.counter != nil
+}
+
+// Count returns the token count of text.
+func (s *Service) Count(text string) int {
+	if text == "" {
+		return 0
+	}
+	return s.CountAll([]string{text})[0]
+}
+
+// CountAll returns the token count of each text. Strings not in the cache
+// are counted in one batch call to the exact counter; without a counter,
+// or if the call fails, they are estimated instead.
+func (s *Service) CountAll(texts []string) []int {
+	counts := make([]int, len(texts))
+
+	s.mu.Lock()
+	counter := s.counter
+	var missIdx []int
+	var missTexts []string
+	for i, t := range texts {
+		if t == "" {
+			continue
+		}
+		if n, ok := s.lookup(t); ok {
+			counts[i] = n
+			continue
+		}
+		missIdx = append(missIdx, i)
+		missTexts = append(missTexts, t)
+	}
+	s.mu.Unlock()
+
+	if len(missTexts) == 0 {
+		return counts
+	}
+
+	// Count outside the lock: an exact count crosses into the tokenizer.
+	var exact []int
+	if counter != nil {
+		if got, err := counter.CountTokens(missTexts); err == nil && len(got) == len(missTexts) {
+			exact = got
+		}
+	}
+	if exact == nil {
+		// Estimates are cheaper to recompute than to memoize.
+		for j, i := range missIdx {
+			counts[i] = Estimate(missTexts[j])
+		}
+		return counts
+	}
+
+	s.mu.Lock()
+	// Skip memoizing if the counter changed while we were counting.
+	memoize := s.counter == counter
+	for j, i := range missIdx {
+		counts[i] = exact[j]
+		if memoize {
+			s.store(missTexts[j], exact[j])
+		}
+	}
+	s.mu.Unlock()
+	return counts
+}
+
+// CountTokens implements Counter.
+func (s *Service) CountTokens(texts []string) ([]int, error) {
+	return s.CountAll(texts), nil
+}
+
+// lookup returns a memoized count, promoting hits from the previous
+// generation. Caller holds s.mu.
+func (s *Service) lookup(text string) (int, bool) {
+	if n, ok := s.cur[text]; ok {
+		return n, true
+	}
+	if n, ok := s.prev[text]; ok {
+		s.store(text, n)
+		return n, true
+	}
+	return 0, false
+}
+
+// store memoizes a count, rotating generations when full. Caller holds
+// s.mu.
+func (s *Service) store(text string, n int) {
+	if len(s.cur) >= s.capacity {
+		s.prev = s.cur
+		s.cur = make(map[string]int, s.capacity)
+	}
+	s.cur[text] = n
+}
+
+// Estimate is the fallback heuristic: about four characters per token,
+// counted in runes so non-ASCII text is not overcounted, rounded up.
+func Estimate(text string) int {
+	return (utf8.RuneCountInString(text) + 3) / 4
+}
+
+var defaultService = NewService(nil, defaultCacheEntries)
+
+// Default returns the process-wide service.
+func Default() *Service {
+	return defaultService
+}
+
+// SetCounter installs the exact counter of the process-wide service.
+// Passing nil reverts to estimates.
+func SetCounter(counter Counter) {
+	defaultService.SetCounter(counter)
+}
+
+// Count returns the token count of text from the process-wide service.
+func Count(text string) int {
+	return defaultService.Count(text)
+}
+
+// CountAll returns token counts for texts from the process-wide service.
+func CountAll(texts []string) []int {
+	return defaultService.CountAll(texts)
+}
@@ -0,0 +1,91 @@
+package tokens
+
+import (
+	"errors"
+	"strings"
+	"testing"
+)
+
+// wordCounter counts whitespace-separated words and records its calls.
+type wordCounter struct {
+	calls [][]string
+	fail  bool
+}
+
+func (w *wordCounter) CountTokens(texts []string) ([]int, error) {
+	w.calls = append(w.calls, append([]string(nil), texts...))
+	if w.fail {
+		return nil, errors.New("tokenizer unavailable")
+	}
+	counts := make([]int, len(texts))
+	for i, t := range texts {
+		counts[i] = len(strings.Fields(t))
+	}
+	return counts, nil
+}
+
+func TestServiceMemoizesExactCounts(t *testing.T) {
+	wc := &wordCounter{}
+	s := NewService(wc, 16)
+
+	got := s.CountAll([]string{"one two three", "", "four"})
+	if got[0] != 3 || got[1] != 0 || got[2] != 1 {
+		t.Fatalf("CountAll = %v, want [3 0 1]", got)
+	}
+	if len(wc.calls) != 1 || len(wc.calls[0]) != 2 {
+		t.Fatalf("expected one batched call with 2 texts, got %v", wc.calls)
+	}
+
+	// Cached strings are not sent to the counter again; new ones are
+	// batched together.
+	got = s.CountAll([]string{"four", "five six", "one two three"})
+	if got[0] != 1 || got[1] != 2 || got[2] != 3 {
+		t.Fatalf("CountAll = %v, want [1 2 3]", got)
+	}
+	if len(wc.calls) != 2 || len(wc.calls[1]) != 1 || wc.calls[1][0] != "five six" {
+		t.Fatalf("expected only the miss to be counted, got %v", wc.calls)
+	}
+
+	// Replacing the counter drops memoized counts.
+	s.SetCounter(wc)
+	s.Count("four")
+	if len(wc.calls) != 3 {
+		t.Fatalf("expected recount after SetCounter, got %d calls", len(wc.calls))
+	}
+}
+
+func TestServiceFallsBackToEstimate(t *testing.T) {
+	text := strings.Repeat("x", 10)
+
+	if got := NewService(nil, 0).Count(text); got != 3 {
+		t.Fatalf("estimate = %d, want 3", got)
+	}
+
+	wc := &wordCounter{fail: true}
+	s := NewService(wc, 0)
+	if got := s.Count(text); got != 3 {
+		t.Fatalf("failed counter: got %d, want estimate 3", got)
+	}
+	// Failures are not memoized, so a recovered counter is used next time.
+	wc.fail = false
+	if got := s.Count(text); got != 1 {
+		t.Fatalf("recovered counter: got %d, want 1", got)
+	}
+}
+
+func TestServiceCacheIsBounded(t *testing.T) {
+	wc := &wordCounter{}
+	s := NewService(wc, 2)
+	for _, text := range []string{"a", "b", "c", "d", "e"} {
+		s.Count(text)
+	}
+	if n := len(s.cur) + len(s.prev); n > 4 {
+		t.Fatalf("cache holds %d entries, want at most 4", n)
+	}
+	// "e" was counted last and must still be cached.
+	calls := len(wc.calls)
+	s.Count("e")
+	if len(wc.calls) != calls {
+		t.Fatalf("recent entry was evicted")
+	}
+}
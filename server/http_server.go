@@ -2,12 +2,11 @@ package server
 
 import (
 	"context"
-	"encoding/base64"
 	"encoding/json"
 	"fmt"
+	"io"
 	"log"
 	"net/http"
-	"os"
 	"strings"
 	"sync"
 	"time"
@@ -36,6 +35,11 @@ type HealthResponse struct {
 	Uptime  string `json:"uptime"`
 }
 
+// MetricsSource renders metrics in the Prometheus text exposition format.
+type MetricsSource interface {
+	WritePrometheus(w io.Writer) error
+}
+
 // HTTPServer represents an HTTP server that handles chat requests
 type HTTPServer struct {
 	Address        string
@@ -45,6 +49,7 @@ type HTTPServer struct {
 	mu             sync.RWMutex
 	shutdown       chan struct{}
 	startTime      time.Time
+	metrics        MetricsSource
 }
 
 // HTTPMessage represents a single HTTP request with facilities to respond
@@ -91,6 +96,11 @@ func NewHTTPServer(address, port string) *HTTPServer {
 	}
 }
 
+// SetMetrics enables the /metrics endpoint. Call before Start.
+func (s *HTTPServer) SetMetrics(m MetricsSource) {
+	s.metrics = m
+}
+
 // Start begins listening for HTTP requests
 func (s *HTTPServer) Start(backend string) error {
 	mux := http.NewServeMux()
@@ -112,6 +122,20 @@ func (s *HTTPServer) Start(backend string) error {
 		json.NewEncoder(w).Encode(resp)
 	})
 
+	// Prometheus metrics endpoint
+	if s.metrics != nil {
+		mux.HandleFunc("/metrics", func(w http.ResponseWriter, r *http.Request) {
+			if r.Method != http.MethodGet {
+				http.Error(w, "Method not allowed", http.StatusMethodNotAllowed)
+				return
+			}
+			w.Header().Set("Content-Type", "text/plain; version=0.0.4; charset=utf-8")
+			if err := s.metrics.WritePrometheus(w); err != nil {
+				log.Printf("Failed to write metrics: %v", err)
+			}
+		})
+	}
+
 	// Chat endpoint
 	mux.HandleFunc("/v1/chat", func(w http.ResponseWriter, r *http.Request) {
 		if r.Method != http.MethodPost {
@@ -128,42 +152,15 @@ func (s *HTTPServer) Start(backend string) error {
 		// Check if native backend (for image handling)
 		isNative := strings.ToLower(backend) == "native"
 
-		// Process images if needed for native backend
+		// Images (file paths or base64) go to the pipeline as-is; for the
+		// native backend it decodes them to pixels in memory.
 		images := req.Images
-		if isNative && len(images) > 0 {
-			processedImages := make([]string, 0, len(images))
-			for _, img := range images {
-				// Check if already a file path
-				if _, err := os.Stat(img); err == nil {
-					processedImages = append(processedImages, img)
-					continue
-				}
-
-				// Assume base64, decode and save to temp file
-				path, err := s.saveBase64ToTemp(img)
-				if err != nil {
-					log.Printf("Failed to save image: %v", err)
-					continue
-				}
-				processedImages = append(processedImages, path)
-			}
-			images = processedImages
-		}
 
 		if req.Stream {
 			s.handleStreaming(w, r, req, images, isNative)
 		} else {
 			s.handleNonStreaming(w, r, req, images, isNative)
 		}
-
-		// Cleanup temp files after processing
-		if isNative {
-			for _, path := range images {
-				if strings.Contains(path, "openeye-vision-") {
-					os.Remove(path)
-				}
-			}
-		}
 	})
 
 	s.httpServer = &http.Server{
@@ -289,35 +286,6 @@ func (s *HTTPServer) handleStreaming(w http.ResponseWriter, r *http.Request, req
 	}
 }
 
-// saveBase64ToTemp decodes base64 image data and saves it to a temporary file
-func (s *HTTPServer) saveBase64ToTemp(base64Data string) (string, error) {
-	// Remove data URI prefix if present
-	if idx := strings.Index(base64Data, ","); idx != -1 {
-		base64Data = base64Data[idx+1:]
-	}
-
-	// Decode base64
-	data, err := base64.StdEncoding.DecodeString(base64Data)
-	if err != nil {
-		return "", fmt.Errorf("failed to decode base64: %w", err)
-	}
-
-	// Create temp file
-	tmpFile, err := os.CreateTemp("", "openeye-vision-*.jpg")
-	if err != nil {
-		return "", fmt.Errorf("failed to create temp file: %w", err)
-	}
-	defer tmpFile.Close()
-
-	// Write data
-	if _, err := tmpFile.Write(data); err != nil {
-		os.Remove(tmpFile.Name())
-		return "", fmt.Errorf("failed to write temp file: %w", err)
-	}
-
-	return tmpFile.Name(), nil
-}
-
 // Stop gracefully shuts down the HTTP server
 func (s *HTTPServer) Stop() error {
 	s.mu.Lock()